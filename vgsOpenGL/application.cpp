@@ -7,28 +7,102 @@
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <cmath>
 #include <memory>
 #include <cstdlib>
 
 #include "tinyfiledialogs.h"
 #include "application.h"
 #include "imgui.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb_image_resize2.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
-#define GLEW_STATIC
-#include "GL/glew.h"
+#include "folder_scan.h"
+#include "gl_stats.h"
+#include "grid_layout.h"
+#include "grid_renderer.h"
+#include "image_viewer.h"
+#include "thumbnail.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_loader.h"
+#include "texture.h"
+#include "perf_stats.h"
+#include "perf_overlay.h"
+#include "resize_service.h"
+#include "trace.h"
 
 std::string g_thumbnailCacheDir;
 std::string g_selectedFolderPath;
-std::vector<ImageData> g_images;
+ImageCatalog g_images;
+
+size_t g_vramBudgetBytes = 512u * 1024u * 1024u;
+size_t g_ramCacheBudgetBytes = 256u * 1024u * 1024u;
+
+static RamThumbnailCache g_ramCache;
+static ThumbnailLoader g_thumbnailLoader;
+static CacheTierStats g_cacheStats;
+static uint32_t g_folderGeneration = 0;
+static size_t g_vramResidentBytes = 0;
+static uint32_t g_frameIndex = 0;
+
+// Tile layout cached in g_images.layoutX/Y/Width/Height. Images appended to
+// the catalogue are laid out after the others; everything is laid out again
+// only when the grid width, the layout or the set of failed images changes.
+// Either way at most kGridLayoutItemsPerFrame images are placed per frame,
+// the rest on the frames after.
+static std::unique_ptr<GridLayout> g_layout = CreateGridLayout(GridLayoutKind::Masonry);
+static bool g_layoutDirty = true;
+static bool g_layoutBacklog = false; // Images are left to lay out next frame
+static GridSpatialIndex g_layoutIndex;
+
+// Ctrl+wheel zoom: tile size range and the size change per wheel notch
+static const float kMinTileSize = 64.0f;
+static const float kMaxTileSize = 1024.0f;
+static const float kZoomStep = 1.15f;
+static float g_gridTileSize = 0.0f; // Set by zooming, 0 keeps the layout's default
+
+// Visible tiles drawn this much wider than the base thumbnail load its
+// large level in the background
+static const float kLargeThumbnailThreshold = 1.25f;
+// Share of the per-frame upload budget one large level takes
+static const size_t kLargeUploadCost = 4;
+
+// Tiles of the visible rows, collected again only when the layout, the
+// scroll position or the residency of a thumbnail changes
+static std::vector<GridTile> g_gridTiles;
+static bool g_gridTilesDirty = true;
+static float g_gridScrollY = -1.0f;
+static float g_gridViewHeight = -1.0f;
+static int64_t g_selectedImage = -1;
+
+// Uploads per frame from the RAM tier and from finished disk loads, so a
+// large scroll does not stall a single frame on glTexImage2D
+static const size_t kMaxUploadsPerFrame = 8;
+static bool g_uploadBacklog = false; // Uploads were deferred to the next frame
+
+// Scroll speeds, in content pixels per second, above which the grid counts
+// as flinging and below which it has settled again
+static const float kFlingSpeed = 4000.0f;
+static const float kSettledSpeed = 1000.0f;
+static const float kScrollSmoothingSeconds = 0.08f;
+// A fling is assumed to carry on for this long at its current speed; the
+// tiles around that landing point are loaded first
+static const float kFlingCarrySeconds = 0.35f;
+// While flinging, uploads go to the landing region only and the grid is
+// drawn two mip levels down (quarter resolution)
+static const size_t kMaxFlingUploadsPerFrame = 2;
+static const float kFlingLodBias = 2.0f;
+
+static float g_scrollVelocity = 0.0f;  // Smoothed, positive when scrolling down
+static float g_lastScrollY = 0.0f;
+static bool g_flinging = false;
+static size_t g_uploadLimit = kMaxUploadsPerFrame;
 
 void initializeThumbnailDir() {
+	// VGS_THUMBNAIL_DIR moves the cache, e.g. for benchmarks on a scratch disk
+	const char* thumbnailDir = std::getenv("VGS_THUMBNAIL_DIR");
+	if (thumbnailDir && thumbnailDir[0] != '\0') {
+		g_thumbnailCacheDir = thumbnailDir;
+		return;
+	}
+
 	const char* userProfile = std::getenv("USERPROFILE");
 	if (!userProfile) {
 		std::cerr << "Error: USERPROFILE environment variable not found" << std::endl;
@@ -46,183 +120,455 @@ void initializeThumbnailDir() {
 	}
 }
 
-GLuint generateTexture(unsigned char* pixels, int width, int height, int channels) {
-	if (!pixels || width <= 0 || height <= 0 || channels <= 0) {
-		std::cerr << "Invalid pixel data for texture creation." << std::endl;
-		return 0;
+static void initializeCacheBudgets() {
+	if (const char* vramMB = std::getenv("VGS_VRAM_BUDGET_MB")) {
+		g_vramBudgetBytes = (size_t)std::strtoull(vramMB, nullptr, 10) * 1024u * 1024u;
 	}
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	if (const char* ramMB = std::getenv("VGS_RAM_CACHE_MB")) {
+		g_ramCacheBudgetBytes = (size_t)std::strtoull(ramMB, nullptr, 10) * 1024u * 1024u;
+	}
+	g_ramCache.SetBudget(g_ramCacheBudgetBytes);
+}
 
-	// Set texture wrapping and filtering options
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+static size_t textureBytes(int width, int height, int channels) {
+	// Plus a full mip chain. RGB is stored as RGBA, only grey textures
+	// really take less.
+	size_t texelBytes = channels == 1 ? 1 : 4;
+	return (size_t)width * height * texelBytes * 4 / 3;
+}
+
+// What the grid draws for a tile changed, e.g. its thumbnail became resident
+static void invalidateGridTile(size_t index) {
+	g_gridTilesDirty = true;
+	float top = g_images.layoutY[index];
+	GridRenderer::InvalidateRange(top, top + g_images.layoutHeight[index]);
+}
 
-	GLenum format = GL_RGBA; // Default to RGBA
-	if (channels == 3) {
-		format = GL_RGB;
+// VRAM taken by the thumbnail texture of a resident image
+static size_t residentBytes(size_t index) {
+	int width = g_images.thumbnailWidth[index];
+	int height = g_images.thumbnailHeight[index];
+	if (g_images.largeThumbnailFlags[index] & LargeThumbnailResident) {
+		largeThumbnailSizeFor(g_images.fullResWidth[index], g_images.fullResHeight[index], width, height);
 	}
-	else if (channels == 1) {
-		format = GL_RED; 
+	return textureBytes(width, height, g_images.thumbnailChannels[index]);
+}
+
+static void uploadThumbnail(size_t index, const ThumbnailPixels& thumbnail) {
+	TextureHandle texture = generateTexture(thumbnail.pixels.data(), thumbnail.width, thumbnail.height, thumbnail.channels, thumbnail.levels);
+	if (!texture) {
+		g_images.thumbnailState[index] = ThumbnailState::Failed;
+		g_layoutDirty = true;
+		return;
 	}
+	g_images.thumbnailTexture[index] = std::move(texture);
+	g_images.thumbnailWidth[index] = (uint16_t)thumbnail.width;
+	g_images.thumbnailHeight[index] = (uint16_t)thumbnail.height;
+	g_images.thumbnailChannels[index] = (uint8_t)thumbnail.channels;
+	g_images.thumbnailState[index] = ThumbnailState::Resident;
+	g_vramResidentBytes += textureBytes(thumbnail.width, thumbnail.height, thumbnail.channels);
+	invalidateGridTile(index);
+}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
-	glGenerateMipmap(GL_TEXTURE_2D); // Generate mipmaps for better quality at different scales
+static void evictThumbnail(size_t index) {
+	if (g_images.thumbnailState[index] != ThumbnailState::Resident) {
+		return;
+	}
+	g_vramResidentBytes -= residentBytes(index);
+	g_images.thumbnailTexture[index].Reset();
+	g_images.largeThumbnailFlags[index] &= ~LargeThumbnailResident;
+	g_images.thumbnailState[index] = ThumbnailState::NotLoaded;
+	invalidateGridTile(index);
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0); // Unbind texture
-	return textureID;
+static void releaseAllImages() {
+	ImageViewer::Close();
+	g_thumbnailLoader.CancelPending();
+	g_ramCache.Clear();
+	g_images.Clear();
+	g_vramResidentBytes = 0;
+	g_cacheStats = CacheTierStats();
+	g_folderGeneration++;
+	g_layoutDirty = true;
+	g_layoutIndex.Clear();
+	g_gridTiles.clear();
+	g_gridTilesDirty = true;
+	g_selectedImage = -1;
+	GridRenderer::InvalidateAll();
+	g_scrollVelocity = 0.0f;
+	g_flinging = false;
 }
 
-void deleteTexture(GLuint& textureID) {
-	if (textureID != 0) {
-		glDeleteTextures(1, &textureID);
-		textureID = 0;
+// Makes sure the thumbnail of image `index` is on its way to VRAM. Tiles are
+// counted once per visit (when they enter the prefetch window) against the
+// tier that satisfied them.
+static void requestThumbnail(size_t index, size_t& uploadsThisFrame) {
+	bool entering = g_images.lastWantedFrame[index] + 1 < g_frameIndex;
+	g_images.lastWantedFrame[index] = g_frameIndex;
+
+	ThumbnailState state = g_images.thumbnailState[index];
+	if (state == ThumbnailState::Resident) {
+		if (entering) {
+			g_cacheStats.vramHits++;
+		}
+		return;
 	}
+	if (state != ThumbnailState::NotLoaded) {
+		return;
+	}
+
+	if (g_ramCache.Contains((uint32_t)index)) {
+		if (uploadsThisFrame >= g_uploadLimit) {
+			g_uploadBacklog = true;
+			return; // Try again next frame
+		}
+		ThumbnailPixels thumbnail;
+		if (g_ramCache.Fetch((uint32_t)index, thumbnail)) {
+			uploadThumbnail(index, thumbnail);
+			uploadsThisFrame++;
+			g_cacheStats.ramHits++;
+			return;
+		}
+	}
+
+	ThumbnailLoadRequest request;
+	request.index = (uint32_t)index;
+	request.generation = g_folderGeneration;
+	request.filePath = std::string(g_images.FilePath(index));
+	request.thumbnailPath = g_images.ThumbnailPath(index);
+	request.thumbnailWidth = g_images.thumbnailWidth[index];
+	request.thumbnailHeight = g_images.thumbnailHeight[index];
+	g_thumbnailLoader.Request(std::move(request));
+	g_images.thumbnailState[index] = ThumbnailState::Queued;
+	g_cacheStats.diskHits++;
 }
 
-static bool generateThumbnails(const char* inputImagePath, const char* outputImagePath, int newWidth, int newHeight) {
-	int width, height, channels;
-	unsigned char* imageData = stbi_load(inputImagePath, &width, &height, &channels, STBI_rgb_alpha); // Load as RGBA
+// Queues the large level of a resident thumbnail; the base level stays on
+// screen until it arrives
+static void requestLargeThumbnail(size_t index) {
+	uint8_t& flags = g_images.largeThumbnailFlags[index];
+	if (g_images.thumbnailState[index] != ThumbnailState::Resident || flags != 0) {
+		return;
+	}
+	ThumbnailLoadRequest request;
+	if (!largeThumbnailSizeFor(g_images.fullResWidth[index], g_images.fullResHeight[index], request.thumbnailWidth, request.thumbnailHeight)) {
+		flags = LargeThumbnailUnavailable;
+		return;
+	}
+	request.index = (uint32_t)index;
+	request.generation = g_folderGeneration;
+	request.filePath = std::string(g_images.FilePath(index));
+	request.thumbnailPath = g_images.LargeThumbnailPath(index);
+	request.large = true;
+	g_thumbnailLoader.Request(std::move(request));
+	flags = LargeThumbnailQueued;
+}
 
-	if (!imageData) {
-		std::cerr << "Error: Could not load image " << inputImagePath << std::endl;
-		return false;
+static void uploadLargeThumbnail(size_t index, const ThumbnailLoadResult& result) {
+	uint8_t& flags = g_images.largeThumbnailFlags[index];
+	flags &= ~LargeThumbnailQueued;
+	int width, height;
+	if (!result.ok || !largeThumbnailSizeFor(g_images.fullResWidth[index], g_images.fullResHeight[index], width, height) ||
+		result.thumbnail.width != width || result.thumbnail.height != height) {
+		flags |= LargeThumbnailUnavailable;
+		return;
 	}
+	// The base level was evicted or the tile scrolled away meanwhile
+	if (g_images.thumbnailState[index] != ThumbnailState::Resident || g_images.lastWantedFrame[index] + 1 < g_frameIndex) {
+		return;
+	}
+	TextureHandle texture = generateTexture(result.thumbnail.pixels.data(), width, height, result.thumbnail.channels, result.thumbnail.levels);
+	if (!texture) {
+		flags |= LargeThumbnailUnavailable;
+		return;
+	}
+	g_vramResidentBytes -= residentBytes(index);
+	g_images.thumbnailTexture[index] = std::move(texture);
+	g_images.thumbnailChannels[index] = (uint8_t)result.thumbnail.channels;
+	flags |= LargeThumbnailResident;
+	g_vramResidentBytes += residentBytes(index);
+	invalidateGridTile(index);
+}
 
-	// Resize to RGBA (4 channels) for consistency, even if original was RGB
-	int outputChannels = 4;
-	std::vector<unsigned char> resizedImageData(newWidth * newHeight * outputChannels);
+static void processLoadedThumbnails(size_t& uploadsThisFrame) {
+	std::vector<ThumbnailLoadResult> results;
+	g_thumbnailLoader.PollResults(results, g_uploadLimit - std::min(uploadsThisFrame, g_uploadLimit));
+	if (g_thumbnailLoader.GetCompletedCount() > 0) {
+		g_uploadBacklog = true;
+	}
+
+	for (auto& result : results) {
+		if (result.generation != g_folderGeneration || result.index >= g_images.Size()) {
+			continue; // Belongs to a folder that is no longer loaded
+		}
+		size_t index = result.index;
+		if (result.large) {
+			if (uploadsThisFrame + kLargeUploadCost > g_uploadLimit) {
+				// Over budget: requested again later, then read from the disk cache
+				g_images.largeThumbnailFlags[index] &= ~LargeThumbnailQueued;
+				g_uploadBacklog = true;
+				continue;
+			}
+			uploadLargeThumbnail(index, result);
+			uploadsThisFrame += kLargeUploadCost;
+			continue;
+		}
+		if (!result.ok) {
+			g_images.thumbnailState[index] = ThumbnailState::Failed;
+			g_layoutDirty = true;
+			continue;
+		}
+		if (result.generated) {
+			g_cacheStats.generated++;
+		}
+		if (!result.compressed.empty()) {
+			g_ramCache.Insert(result.index, std::move(result.compressed), result.thumbnail.width, result.thumbnail.height, result.thumbnail.channels, result.thumbnail.levels);
+		}
+
+		// Only spend an upload on tiles that are still near the viewport; the
+		// rest stays in the RAM tier until it is scrolled to again
+		if (g_images.lastWantedFrame[index] + 1 >= g_frameIndex) {
+			uploadThumbnail(index, result.thumbnail);
+			uploadsThisFrame++;
+		}
+		else {
+			g_images.thumbnailState[index] = ThumbnailState::NotLoaded;
+		}
+	}
+}
 
-	unsigned char* resized_pixels_ptr = stbir_resize_uint8_srgb(
-		imageData, width, height, 0,
-		resizedImageData.data(), newWidth, newHeight, 0,
-		(stbir_pixel_layout)outputChannels
-	);
+// Evicts least recently wanted textures that are not needed this frame until
+// the resident set fits in the VRAM budget.
+static void enforceVramBudget() {
+	if (g_vramResidentBytes <= g_vramBudgetBytes) {
+		return;
+	}
 
-	stbi_image_free(imageData); // Free the original image data
+	std::vector<uint32_t> candidates;
+	for (size_t i = 0; i < g_images.Size(); i++) {
+		if (g_images.thumbnailState[i] == ThumbnailState::Resident && g_images.lastWantedFrame[i] != g_frameIndex) {
+			candidates.push_back((uint32_t)i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](uint32_t a, uint32_t b) {
+		return g_images.lastWantedFrame[a] < g_images.lastWantedFrame[b];
+	});
 
-	if (resized_pixels_ptr == NULL) { // Check if resizing failed
-		std::cerr << "Error: Failed to resize image for thumbnail." << std::endl;
-		return false;
+	for (uint32_t index : candidates) {
+		if (g_vramResidentBytes <= g_vramBudgetBytes) {
+			break;
+		}
+		evictThumbnail(index);
 	}
+}
 
-	// Save the resized image as PNG
-	if (stbi_write_png(outputImagePath, newWidth, newHeight, outputChannels, resizedImageData.data(), newWidth * outputChannels)) {
-		return true;
+static void updateGridLayout(float width) {
+	GridItems items = GridItemsOf(g_images);
+	if (g_layoutDirty || width != g_layout->Width() || items.count < g_layout->Count()) {
+		GridItems batch = GridItemsPrefix(items, kGridLayoutItemsPerFrame);
+		g_layout->Relayout(batch, width);
+		g_layoutIndex.Build(batch, g_layout->ContentHeight());
+		GridRenderer::InvalidateAll();
+	}
+	else if (items.count > g_layout->Count()) {
+		GridItems batch = GridItemsPrefix(items, g_layout->Count() + kGridLayoutItemsPerFrame);
+		float previousHeight = g_layout->ContentHeight();
+		g_layout->Extend(batch);
+		g_layoutIndex.Update(batch, g_layout->FirstChanged(), g_layout->ChangedTop(), g_layout->ContentHeight());
+		GridRenderer::InvalidateRange(g_layout->ChangedTop(), std::max(previousHeight, g_layout->ContentHeight()));
 	}
 	else {
-		std::cerr << "Error: Could not save resized thumbnail to " << outputImagePath << std::endl;
-		return false;
+		return;
 	}
+	g_layoutDirty = false;
+	g_layoutBacklog = g_layout->Count() < items.count;
+	g_gridTilesDirty = true;
 }
 
-void LoadFolder() {
-	const char* folder_path = tinyfd_selectFolderDialog(
-		"Select a folder",
-		NULL   // default path, or NULL
-	);
+// Height of the whole grid. While images are still left to lay out it is
+// extrapolated from the ones placed, so the scroll range does not shrink
+// under the scroll position in the meantime.
+static float gridContentHeight() {
+	size_t laidOut = g_layout->Count();
+	if (laidOut == 0 || laidOut >= g_images.Size()) {
+		return g_layout->ContentHeight();
+	}
+	return kGridTopOffset + (g_layout->ContentHeight() - kGridTopOffset) * (float)g_images.Size() / (float)laidOut;
+}
+
+static void collectGridTiles(float scrollY, float viewHeight) {
+	// Whole strips of the retained grid are rendered at once, so the range
+	// is widened to strip boundaries (in either mode, for simplicity)
+	float top = std::floor(scrollY / kGridCacheBandHeight) * kGridCacheBandHeight;
+	float bottom = std::ceil((scrollY + viewHeight) / kGridCacheBandHeight) * kGridCacheBandHeight;
+	static std::vector<uint32_t> visible;
+	visible.clear();
+	g_layoutIndex.Query(GridItemsOf(g_images), top, bottom, visible);
+
+	g_gridTiles.clear();
+	for (uint32_t i : visible) {
+		GridTile tile;
+		tile.x = g_images.layoutX[i];
+		tile.y = g_images.layoutY[i];
+		tile.width = g_images.layoutWidth[i];
+		tile.height = g_images.layoutHeight[i];
+		if (g_images.thumbnailState[i] == ThumbnailState::Resident) {
+			tile.texture = g_images.thumbnailTexture[i].Get();
+		}
+		g_gridTiles.push_back(tile);
+	}
+	GridRenderer::SetTiles(g_gridTiles.data(), g_gridTiles.size());
 
+	g_gridScrollY = scrollY;
+	g_gridViewHeight = viewHeight;
+	g_gridTilesDirty = false;
+}
+
+// Tracks how fast the grid scrolls and switches between full quality and
+// the cheaper fling mode, with hysteresis so a slowing fling does not flicker
+static void updateScrollVelocity(float scrollY, float deltaTime) {
+	if (deltaTime > 0.0f) {
+		float instant = (scrollY - g_lastScrollY) / deltaTime;
+		float blend = 1.0f - std::exp(-deltaTime / kScrollSmoothingSeconds);
+		g_scrollVelocity += (instant - g_scrollVelocity) * blend;
+	}
+	g_lastScrollY = scrollY;
+
+	float speed = std::fabs(g_scrollVelocity);
+	g_flinging = g_flinging ? speed > kSettledSpeed : speed > kFlingSpeed;
+	g_uploadLimit = g_flinging ? kMaxFlingUploadsPerFrame : kMaxUploadsPerFrame;
+	GridRenderer::SetLodBias(g_flinging ? kFlingLodBias : 0.0f);
+	Perf::SetGauge(PerfGauge::ScrollSpeed, (uint64_t)speed);
+}
+
+// Requests the large level for the visible tiles that are drawn wide enough
+// to need it
+static void requestLargeThumbnails(float top, float bottom, float pixelScale) {
+	static std::vector<uint32_t> tiles;
+	tiles.clear();
+	g_layoutIndex.Query(GridItemsOf(g_images), top, bottom, tiles);
+	for (uint32_t i : tiles) {
+		if (g_images.layoutWidth[i] * pixelScale > kThumbnailMaxWidth * kLargeThumbnailThreshold) {
+			requestLargeThumbnail(i);
+		}
+	}
+}
+
+// Changes the tile size by `wheel` notches and lays the grid out again. The
+// point of the image under the mouse (`mouse` in content space) stays where
+// it is on screen; returns the scroll position that keeps it there.
+static float zoomGrid(float wheel, float width, ImVec2 mouse, float scrollY, float viewHeight) {
+	float size = std::clamp(g_layout->TargetSize() * std::pow(kZoomStep, wheel), kMinTileSize, kMaxTileSize);
+	if (size == g_layout->TargetSize()) {
+		return scrollY;
+	}
+
+	// Anchored on the image under the mouse, or on the same fraction of the
+	// content between tiles, or when the image is not laid out again yet
+	GridItems items = GridItemsOf(g_images);
+	int64_t anchor = g_layoutIndex.HitTest(items, mouse.x, mouse.y);
+	float imageFraction = anchor >= 0 ? (mouse.y - items.y[anchor]) / items.height[anchor] : 0.0f;
+	float contentFraction = mouse.y / gridContentHeight();
+	float screenY = mouse.y - scrollY;
+
+	g_gridTileSize = size;
+	g_layout->SetTargetSize(size);
+	g_layoutDirty = true;
+	updateGridLayout(width);
+
+	bool anchorPlaced = anchor >= 0 && (size_t)anchor < g_layout->Count();
+	float anchorY = anchorPlaced ? items.y[anchor] + imageFraction * items.height[anchor] : contentFraction * gridContentHeight();
+	float maxScrollY = std::max(0.0f, gridContentHeight() - viewHeight);
+	return std::clamp(anchorY - screenY, 0.0f, maxScrollY);
+}
+
+// Requests the thumbnails of the tiles overlapping content rows [top, bottom)
+static void requestRange(float top, float bottom, size_t& uploadsThisFrame) {
+	static std::vector<uint32_t> tiles;
+	tiles.clear();
+	g_layoutIndex.Query(GridItemsOf(g_images), top, bottom, tiles);
+	for (uint32_t i : tiles) {
+		requestThumbnail(i, uploadsThisFrame);
+	}
+}
+
+// Replaces the folder dialog, e.g. so a replayed click on "Load" opens the
+// benchmark corpus instead of blocking on a dialog
+static std::function<std::string()> g_folderPicker;
+
+void LoadFolder() {
+	std::string pickedFolder;
+	const char* folder_path;
+	if (g_folderPicker) {
+		pickedFolder = g_folderPicker();
+		folder_path = pickedFolder.empty() ? NULL : pickedFolder.c_str();
+	}
+	else {
+		folder_path = tinyfd_selectFolderDialog(
+			"Select a folder",
+			NULL   // default path, or NULL
+		);
+	}
 
     if (!folder_path) {
         std::cout << "No file selected." << std::endl;
 		g_selectedFolderPath.clear();
 		// Clear previous images
-		for (auto& img : g_images) {
-			deleteTexture(img.thumbnailTextureID);
-			deleteTexture(img.fullResTextureID);
-		}
-		g_images.clear();
+		releaseAllImages();
         return;
     }
+	VGS_TRACE_SCOPE("LoadFolder");
 	std::cout << "Selected folder: " << folder_path << std::endl;
 	g_selectedFolderPath = folder_path;
 
 	// Clear previous images
-	for (auto& img : g_images) {
-		deleteTexture(img.thumbnailTextureID);
-		deleteTexture(img.fullResTextureID);
-	}
-	g_images.clear();
+	releaseAllImages();
 
 	initializeThumbnailDir();
+	initializeCacheBudgets();
+	// hardware_concurrency() may be 0 when it cannot tell
+	unsigned hardwareThreads = std::thread::hardware_concurrency();
+	unsigned workerThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	g_thumbnailLoader.Start(workerThreads);
+	// Large resizes run on the calling thread plus these
+	ResizeService::Start(workerThreads);
 
 	// Create a thumbnail cache directory if it doesn't exist
 	if (!std::filesystem::exists(g_thumbnailCacheDir)) {
 		std::filesystem::create_directories(g_thumbnailCacheDir);
 	}
 
-	// Supported image extensions
-	std::vector<std::string> image_extensions = { ".png", ".jpg", ".jpeg", ".bmp" };
+	g_images.thumbnailDir = g_thumbnailCacheDir;
 
 	// Scan the selected folder for images
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(g_selectedFolderPath)) {
-
-		// Check if the entry is a regular file
-		if (entry.is_regular_file()) {
-			std::string file_path = entry.path().string();
-			std::string file_extension = entry.path().extension().string();
-			std::transform(file_extension.begin(), file_extension.end(), file_extension.begin(), ::tolower);
-			
-			bool isImage = false;
-			for (const auto& ext : image_extensions) {
-				if (file_extension == ext) {
-					isImage = true;
-					break;
-				}
-			}
+	std::vector<std::string> candidates = scanImageFolder(g_selectedFolderPath);
 
-			if (isImage) {
-				ImageData newImage;
-				newImage.filePath = file_path;
-				newImage.fileName = entry.path().filename().string();
-				
-				int fullres_width, fullres_height, channels;
-				if (stbi_info(newImage.filePath.c_str(), &fullres_width, &fullres_height, &channels)) {
-					newImage.fullResWidth = fullres_width;
-					newImage.fullResHeight = fullres_height;
-				}
-				int max_width = 300;
-				float aspect_ratio = (float)fullres_height / (float)fullres_width;
-				int thumbnailWidth = max_width;
-				int thumbnailHeight = (int)(max_width * aspect_ratio);
-
-				
-				// Generate thumbnail path
-				std::string thumbnailFileName = newImage.fileName + ".thumb.png";
-				newImage.thumbnailPath = g_thumbnailCacheDir + "/" + thumbnailFileName;
-
-				// Check if thumbnail already exists, otherwise generate it
-				if (!std::filesystem::exists(newImage.thumbnailPath)) {
-					std::cout << "Generating thumbnail for: " << newImage.fileName << std::endl;
-					if (!generateThumbnails(newImage.filePath.c_str(), newImage.thumbnailPath.c_str(), thumbnailWidth, thumbnailHeight)) {
-						std::cerr << "Failed to generate thumbnail for " << newImage.fileName << std::endl;
-						continue; 
-					}
-				}
+	// Probe each candidate for its dimensions
+	size_t pathBytes = 0;
+	for (const auto& file_path : candidates) {
+		pathBytes += file_path.size();
+	}
+	g_images.Reserve(candidates.size(), pathBytes);
 
-				// Load thumbnail into OpenGL texture immediately
-				int thumb_Width, thumb_Height, thumb_Channels;
-				unsigned char* thumbPixels = stbi_load(newImage.thumbnailPath.c_str(), &thumb_Width, &thumb_Height, &thumb_Channels, STBI_rgb_alpha);
-				if (thumbPixels) {
-					newImage.thumbnailTextureID = generateTexture(thumbPixels, thumb_Width, thumb_Height, STBI_rgb_alpha);
-					newImage.thumbnailWidth = thumb_Width;
-					newImage.thumbnailHeight = thumb_Height;
-					stbi_image_free(thumbPixels);
-				}
-				else {
-					std::cerr << "Error loading thumbnail for display: " << newImage.thumbnailPath << std::endl;
-					// TODO: Optionally, use a placeholder texture if thumbnail loading fails
-					continue;
-				}
+	for (const auto& file_path : candidates) {
+		// The file name is the tail of the path, so only its offset is stored
+		size_t fileNameLength = std::filesystem::path(file_path).filename().string().size();
+		size_t fileNameOffset = file_path.size() - fileNameLength;
 
-				g_images.push_back(std::move(newImage)); 
-			}
+		int fullres_width, fullres_height, channels;
+		if (!probeImage(file_path.c_str(), fullres_width, fullres_height, channels)) {
+			std::cerr << "Unsupported or unreadable image: " << file_path.substr(fileNameOffset) << std::endl;
+			continue;
 		}
+
+		int thumbnailWidth, thumbnailHeight;
+		thumbnailSizeFor(fullres_width, fullres_height, thumbnailWidth, thumbnailHeight);
+
+		// The thumbnail itself is read (or generated) by the loader
+		// threads once the tile scrolls near the viewport.
+		g_images.Add(file_path, fileNameOffset, fullres_width, fullres_height, thumbnailWidth, thumbnailHeight);
 	}
-	std::cout << "Folder loaded successfully. Found " << g_images.size() << " images. Thumbnails are stored in: " << g_thumbnailCacheDir << std::endl;
+	std::cout << "Folder loaded successfully. Found " << g_images.Size() << " images. Thumbnails are stored in: " << g_thumbnailCacheDir << std::endl;
 
 }
 
@@ -230,16 +576,95 @@ namespace App
 {
 	static bool showLoadWindow = true;
 	static bool showImageWindow = false;
+	static bool showPerfOverlay = false;
+
+	static void publishPerfGauges() {
+		TextureStats textureStats = GetTextureStats();
+		Perf::SetGauge(PerfGauge::LoaderPending, g_thumbnailLoader.GetPendingCount());
+		Perf::SetGauge(PerfGauge::LoaderCompleted, g_thumbnailLoader.GetCompletedCount());
+		Perf::SetGauge(PerfGauge::TextureCount, textureStats.liveCount);
+		Perf::SetGauge(PerfGauge::VramBytes, g_vramResidentBytes + textureStats.pooledBytes);
+		Perf::SetGauge(PerfGauge::RamCacheBytes, g_ramCache.GetUsedBytes());
+	}
 
 	void RenderUI() {
 		// Main controller - this is what gets called from your main loop
+		g_uploadBacklog = false;
+		g_layoutBacklog = false;
+
 		if (showLoadWindow) {
 			RenderLoadUI();
 		}
 
-		if (showImageWindow) {
+		// The viewer covers the grid, which is not drawn while it is open
+		if (showImageWindow && !ImageViewer::IsOpen()) {
 			RenderImageGridUI();
 		}
+		if (ImageViewer::IsOpen()) {
+			ImageViewer::Render();
+		}
+
+		// F1 toggles the performance overlay; nothing is gathered for it while hidden
+		if (ImGui::IsKeyPressed(ImGuiKey_F1, false)) {
+			showPerfOverlay = !showPerfOverlay;
+		}
+		// F2 writes everything traced so far to a Chrome trace file
+		if (ImGui::IsKeyPressed(ImGuiKey_F2, false)) {
+			Trace::Flush();
+		}
+		// F3 writes the per-frame GL call statistics gathered so far
+		if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) {
+			GLStats::Flush();
+		}
+		if (showPerfOverlay) {
+			publishPerfGauges();
+			Perf::RenderOverlay(&showPerfOverlay);
+		}
+	}
+
+	void SetBackgroundWakeCallback(std::function<void()> callback) {
+		g_thumbnailLoader.SetResultCallback(callback);
+		ImageViewer::SetResultCallback(std::move(callback));
+	}
+
+	bool IsAnimating() {
+		// A fling is only over once frames have seen the scroll come to rest
+		return g_uploadBacklog || g_layoutBacklog || g_flinging || ImageViewer::IsAnimating();
+	}
+
+	void SetFolderPicker(std::function<std::string()> picker) {
+		g_folderPicker = std::move(picker);
+	}
+
+	void DrainLoads() {
+		g_thumbnailLoader.Drain();
+		ImageViewer::Drain();
+	}
+
+	void SetGridLayout(GridLayoutKind kind) {
+		if (kind == g_layout->Kind()) {
+			return;
+		}
+		g_layout = CreateGridLayout(kind);
+		if (g_gridTileSize > 0.0f) {
+			g_layout->SetTargetSize(g_gridTileSize);
+		}
+		g_layoutDirty = true;
+	}
+
+	GridLayoutKind GetGridLayout() {
+		return g_layout->Kind();
+	}
+
+	void Shutdown() {
+		// Loader threads must be gone before the images they reference
+		g_thumbnailLoader.Stop();
+		ImageViewer::Shutdown();
+		ResizeService::Stop();
+		releaseAllImages();
+		GridRenderer::Shutdown();
+		ShutdownTextures();
+		GLStats::Shutdown();
 	}
 
 	void RenderLoadUI() {
@@ -266,7 +691,7 @@ namespace App
 			LoadFolder();
 
 			// Only switch windows if images were loaded
-			if (!g_images.empty()) {
+			if (!g_images.Empty()) {
 				showLoadWindow = false;
 				showImageWindow = true;
 			}
@@ -282,6 +707,7 @@ namespace App
 	}
 
 	void RenderImageGridUI() {
+		VGS_TRACE_SCOPE("RenderImageGridUI");
 		bool windowOpen = true;
 
 		// Center and size the image window
@@ -293,46 +719,125 @@ namespace App
 		ImGui::Begin("Image Grid", &windowOpen,
 			ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize);
 
+		g_frameIndex++;
+		updateScrollVelocity(ImGui::GetScrollY(), io.DeltaTime);
+		size_t uploadsThisFrame = 0;
+		processLoadedThumbnails(uploadsThisFrame);
+
+		uint64_t totalRequests = g_cacheStats.Total();
+		float rateScale = totalRequests ? 100.0f / (float)totalRequests : 0.0f;
+		TextureStats textureStats = GetTextureStats();
+		ImGui::Text("Hit rate  VRAM %.1f%%  RAM %.1f%%  Disk %.1f%% (%llu generated)  |  VRAM %.0f/%.0f MB  RAM cache %.1f/%.0f MB (%zu)  |  Textures %zu live, %zu pooled",
+			g_cacheStats.vramHits * rateScale, g_cacheStats.ramHits * rateScale, g_cacheStats.diskHits * rateScale,
+			(unsigned long long)g_cacheStats.generated,
+			g_vramResidentBytes / (1024.0 * 1024.0), g_vramBudgetBytes / (1024.0 * 1024.0),
+			g_ramCache.GetUsedBytes() / (1024.0 * 1024.0), g_ramCache.GetBudget() / (1024.0 * 1024.0),
+			g_ramCache.GetEntryCount(), textureStats.liveCount, textureStats.pooledCount);
 		ImGui::Separator();
 
-		if (g_images.empty()) {
+		if (g_images.Empty()) {
 			ImGui::Text("No images loaded.");
 		}
 		else {
-			// Calculate grid layout
-			float windowWidth = ImGui::GetWindowWidth();
-			int column_width = 310;
-			int columns = (int)(windowWidth / column_width);
-			if (columns < 1) columns = 1;
-			float column_memory[6];
-			std::fill(column_memory, column_memory + 6, 30.0);
-
-			for (int i = 0, j = 0; i < g_images.size(); i++, j++) {
-				const ImageData& imgData = g_images[i];
-				if (imgData.thumbnailTextureID != 0) {
-					ImGui::PushID(i); // Unique ID for each column
-
-					ImGui::SetCursorPos(ImVec2(j * column_width, column_memory[j]));
-
-					// Make image clickable
-					ImGui::Image((void*)(intptr_t)imgData.thumbnailTextureID,
-						ImVec2(imgData.thumbnailWidth, imgData.thumbnailHeight));
-
-					// Tooltip on hover
-					if (ImGui::IsItemHovered()) {
-						ImGui::BeginTooltip();
-						ImGui::Text("%s", imgData.fileName.c_str());
-						ImGui::EndTooltip();
+			// The tiles span the window up to the scrollbar
+			float layoutWidth = ImGui::GetWindowWidth() - ImGui::GetStyle().ScrollbarSize;
+			updateGridLayout(layoutWidth);
+
+			float scrollY = ImGui::GetScrollY();
+			float viewHeight = ImGui::GetWindowHeight();
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+			// Ctrl+wheel zooms; ImGui does not scroll while Ctrl is held
+			if (io.KeyCtrl && io.MouseWheel != 0.0f && ImGui::IsWindowHovered()) {
+				ImVec2 windowPos = ImGui::GetWindowPos();
+				ImVec2 mouse(io.MousePos.x - windowPos.x + ImGui::GetScrollX(), io.MousePos.y - windowPos.y + scrollY);
+				scrollY = zoomGrid(io.MouseWheel, layoutWidth, mouse, scrollY, viewHeight);
+				// ImGui applies it from the next frame on, this one is drawn
+				// at it already; the jump does not count as scrolling
+				ImGui::SetScrollY(scrollY);
+				g_lastScrollY = scrollY;
+			}
+
+			if (g_flinging) {
+				// Tiles flying past stay placeholders; loads go to where the
+				// fling is heading, and being requested last they are served first
+				float maxScrollY = std::max(0.0f, gridContentHeight() - viewHeight);
+				float landingY = std::clamp(scrollY + g_scrollVelocity * kFlingCarrySeconds, 0.0f, maxScrollY);
+				requestRange(landingY - 0.5f * viewHeight, landingY + 1.5f * viewHeight, uploadsThisFrame);
+			}
+			else {
+				// Tiles within one screen above or below the viewport are prefetched
+				requestRange(scrollY - viewHeight, scrollY + 2.0f * viewHeight, uploadsThisFrame);
+				requestLargeThumbnails(scrollY, scrollY + viewHeight, io.DisplayFramebufferScale.x);
+			}
+
+			const ThumbnailState* states = g_images.thumbnailState.data();
+			const float* tileX = g_images.layoutX.data();
+			const float* tileY = g_images.layoutY.data();
+			const float* tileWidth = g_images.layoutWidth.data();
+			const float* tileHeight = g_images.layoutHeight.data();
+
+			if (g_gridTilesDirty || scrollY != g_gridScrollY || viewHeight != g_gridViewHeight) {
+				collectGridTiles(scrollY, viewHeight);
+			}
+
+			// Tiles are drawn without submitting an item per tile: one
+			// instanced draw callback, or plain draw list quads without it
+			ImVec2 windowPos = ImGui::GetWindowPos();
+			ImVec2 origin(windowPos.x - ImGui::GetScrollX(), windowPos.y - scrollY);
+			if (!GridRenderer::Submit(drawList, origin.x, origin.y)) {
+				for (const GridTile& tile : g_gridTiles) {
+					ImVec2 tileMin(origin.x + tile.x, origin.y + tile.y);
+					ImVec2 tileMax(tileMin.x + tile.width, tileMin.y + tile.height);
+					if (tile.texture != 0) {
+						drawList->AddImage((ImTextureID)(intptr_t)tile.texture, tileMin, tileMax);
 					}
+					else {
+						// Placeholder until the thumbnail arrives from RAM or disk
+						drawList->AddRectFilled(tileMin, tileMax, IM_COL32(60, 60, 60, 255));
+					}
+				}
+			}
 
-					ImGui::PopID(); // Pop image ID
-					column_memory[j] += imgData.thumbnailHeight + 10.0f; // 10px padding
-					if (j >= columns - 1) {
-						j = -1; // Reset column index
-						//ImGui::NewLine(); Move to next row
+			// Hover and selection come from the layout index instead of per-tile
+			// items; no tooltips while flinging
+			int64_t hovered = -1;
+			if (ImGui::IsWindowHovered() && !ImGui::IsAnyItemActive() && !g_flinging) {
+				hovered = g_layoutIndex.HitTest(GridItemsOf(g_images), io.MousePos.x - origin.x, io.MousePos.y - origin.y);
+			}
+			if (ImGui::IsWindowHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+				g_selectedImage = hovered;
+			}
+			// Double-click opens the image in the viewer, which takes over from the grid
+			if (hovered >= 0 && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+				ImageViewer::Open((size_t)hovered);
+			}
+			if (g_selectedImage >= 0 && (size_t)g_selectedImage < g_layout->Count() && states[g_selectedImage] != ThumbnailState::Failed) {
+				ImVec2 tileMin(origin.x + tileX[g_selectedImage], origin.y + tileY[g_selectedImage]);
+				ImVec2 tileMax(tileMin.x + tileWidth[g_selectedImage], tileMin.y + tileHeight[g_selectedImage]);
+				drawList->AddRect(ImVec2(tileMin.x - 2.0f, tileMin.y - 2.0f), ImVec2(tileMax.x + 2.0f, tileMax.y + 2.0f), IM_COL32(255, 200, 0, 255), 0.0f, 0, 3.0f);
+			}
+			if (hovered >= 0) {
+				std::string_view fileName = g_images.FileName((size_t)hovered);
+				ImGui::BeginTooltip();
+				ImGui::Text("%.*s", (int)fileName.size(), fileName.data());
+				ImGui::EndTooltip();
+			}
+
+			if (ImGui::BeginPopupContextWindow("GridLayout")) {
+				for (int kind = 0; kind < (int)GridLayoutKind::Count; kind++) {
+					if (ImGui::MenuItem(GridLayoutName((GridLayoutKind)kind), nullptr, g_layout->Kind() == (GridLayoutKind)kind)) {
+						SetGridLayout((GridLayoutKind)kind);
 					}
 				}
+				ImGui::EndPopup();
 			}
+
+			// Extend the scroll region to the bottom of the layout
+			ImGui::SetCursorPos(ImVec2(0.0f, gridContentHeight()));
+			ImGui::Dummy(ImVec2(0.0f, 0.0f));
+
+			enforceVramBudget();
 		}
 			
 		ImGui::End();
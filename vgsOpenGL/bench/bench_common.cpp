@@ -0,0 +1,242 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "bench_common.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <intrin.h>
+#else
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#endif
+
+// --- JsonWriter ---
+
+static void appendEscaped(std::string& out, const std::string& text) {
+	out.push_back('"');
+	for (char c : text) {
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if ((unsigned char)c >= 0x20) {
+				out.push_back(c);
+			}
+		}
+	}
+	out.push_back('"');
+}
+
+void JsonWriter::Indent() {
+	out.push_back('\n');
+	out.append(hasItems.size() * 2, ' ');
+}
+
+void JsonWriter::Prefix(const char* key) {
+	if (!hasItems.empty()) {
+		if (hasItems.back()) {
+			out.push_back(',');
+		}
+		hasItems.back() = true;
+		Indent();
+	}
+	if (key) {
+		appendEscaped(out, key);
+		out += ": ";
+	}
+}
+
+void JsonWriter::BeginObject(const char* key) {
+	Prefix(key);
+	out.push_back('{');
+	hasItems.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+	bool items = hasItems.back();
+	hasItems.pop_back();
+	if (items) {
+		Indent();
+	}
+	out.push_back('}');
+	if (hasItems.empty()) {
+		out.push_back('\n');
+	}
+}
+
+void JsonWriter::BeginArray(const char* key) {
+	Prefix(key);
+	out.push_back('[');
+	hasItems.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+	bool items = hasItems.back();
+	hasItems.pop_back();
+	if (items) {
+		Indent();
+	}
+	out.push_back(']');
+}
+
+void JsonWriter::Field(const char* key, const std::string& value) {
+	Prefix(key);
+	appendEscaped(out, value);
+}
+
+void JsonWriter::Field(const char* key, const char* value) {
+	Field(key, std::string(value));
+}
+
+void JsonWriter::Field(const char* key, double value) {
+	Prefix(key);
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.6g", value);
+	out += buffer;
+}
+
+void JsonWriter::Field(const char* key, int64_t value) {
+	Prefix(key);
+	out += std::to_string(value);
+}
+
+void JsonWriter::Field(const char* key, uint64_t value) {
+	Prefix(key);
+	out += std::to_string(value);
+}
+
+void JsonWriter::Field(const char* key, bool value) {
+	Prefix(key);
+	out += value ? "true" : "false";
+}
+
+void JsonWriter::Value(double value) {
+	Field(nullptr, value);
+}
+
+// --- System information ---
+
+uint64_t peakRssKB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return (uint64_t)counters.PeakWorkingSetSize / 1024;
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t)usage.ru_maxrss; // KiB on Linux
+#endif
+}
+
+#if defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#ifdef _WIN32
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+	for (int i = 0; i < 4; i++) regs[i] = (unsigned)info[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+#define VGS_HAVE_CPUID 1
+#endif
+
+std::string cpuModelName() {
+#ifdef VGS_HAVE_CPUID
+	unsigned regs[4];
+	cpuid(0x80000000u, 0, regs);
+	if (regs[0] >= 0x80000004u) {
+		char brand[49] = {};
+		for (unsigned i = 0; i < 3; i++) {
+			cpuid(0x80000002u + i, 0, regs);
+			std::memcpy(brand + i * 16, regs, 16);
+		}
+		std::string name(brand);
+		size_t first = name.find_first_not_of(' ');
+		return first == std::string::npos ? name : name.substr(first);
+	}
+#endif
+	return "unknown";
+}
+
+std::vector<std::string> cpuFeatures() {
+	std::vector<std::string> features;
+#ifdef VGS_HAVE_CPUID
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	unsigned maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	unsigned ecx1 = regs[2], edx1 = regs[3];
+	if (edx1 & (1u << 26)) features.push_back("sse2");
+	if (ecx1 & (1u << 0)) features.push_back("sse3");
+	if (ecx1 & (1u << 9)) features.push_back("ssse3");
+	if (ecx1 & (1u << 19)) features.push_back("sse4.1");
+	if (ecx1 & (1u << 20)) features.push_back("sse4.2");
+	if (ecx1 & (1u << 23)) features.push_back("popcnt");
+	if (ecx1 & (1u << 28)) features.push_back("avx");
+	if (ecx1 & (1u << 12)) features.push_back("fma");
+	if (ecx1 & (1u << 29)) features.push_back("f16c");
+
+	if (maxLeaf >= 7) {
+		cpuid(7, 0, regs);
+		unsigned ebx7 = regs[1];
+		if (ebx7 & (1u << 3)) features.push_back("bmi1");
+		if (ebx7 & (1u << 5)) features.push_back("avx2");
+		if (ebx7 & (1u << 8)) features.push_back("bmi2");
+		if (ebx7 & (1u << 16)) features.push_back("avx512f");
+		if (ebx7 & (1u << 30)) features.push_back("avx512bw");
+	}
+#endif
+	return features;
+}
+
+bool writeTextFile(const std::string& path, const std::string& text) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	return file && (bool)file.write(text.data(), (std::streamsize)text.size());
+}
+
+// --- ArgParser ---
+
+bool ArgParser::Has(const char* name) const {
+	for (const auto& arg : args) {
+		if (arg == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string ArgParser::Get(const char* name, const std::string& fallback) const {
+	for (size_t i = 0; i + 1 < args.size(); i++) {
+		if (args[i] == name) {
+			return args[i + 1];
+		}
+	}
+	return fallback;
+}
+
+long long ArgParser::GetInt(const char* name, long long fallback) const {
+	std::string value = Get(name, "");
+	return value.empty() ? fallback : std::strtoll(value.c_str(), nullptr, 10);
+}
+
+double ArgParser::GetDouble(const char* name, double fallback) const {
+	std::string value = Get(name, "");
+	return value.empty() ? fallback : std::strtod(value.c_str(), nullptr);
+}
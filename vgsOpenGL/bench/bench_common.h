@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal streaming JSON writer for benchmark reports.
+class JsonWriter {
+public:
+    void BeginObject(const char* key = nullptr);
+    void EndObject();
+    void BeginArray(const char* key = nullptr);
+    void EndArray();
+
+    void Field(const char* key, const std::string& value);
+    void Field(const char* key, const char* value);
+    void Field(const char* key, double value);
+    void Field(const char* key, int64_t value);
+    void Field(const char* key, uint64_t value);
+    void Field(const char* key, int value) { Field(key, (int64_t)value); }
+    void Field(const char* key, bool value);
+
+    void Value(double value);
+
+    const std::string& Str() const { return out; }
+
+private:
+    void Prefix(const char* key);
+    void Indent();
+
+    std::string out;
+    std::vector<bool> hasItems;
+};
+
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+    void Restart() { start = std::chrono::steady_clock::now(); }
+    double ElapsedMs() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Peak resident set size of the process in KiB.
+uint64_t peakRssKB();
+
+// Human readable CPU model and the SIMD extensions the CPU supports.
+std::string cpuModelName();
+std::vector<std::string> cpuFeatures();
+
+bool writeTextFile(const std::string& path, const std::string& text);
+
+// Parses "--name value" / "--flag" style arguments.
+class ArgParser {
+public:
+    ArgParser(int argc, char** argv) : args(argv + 1, argv + argc) {}
+    bool Has(const char* name) const;
+    std::string Get(const char* name, const std::string& fallback) const;
+    long long GetInt(const char* name, long long fallback) const;
+    double GetDouble(const char* name, double fallback) const;
+
+private:
+    std::vector<std::string> args;
+};
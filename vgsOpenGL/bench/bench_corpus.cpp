@@ -0,0 +1,487 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "stb_image_write.h"
+
+namespace
+{
+	const char* const kManifestName = "corpus.txt";
+	const int kManifestVersion = 2;
+	// Colour JPEGs from this many pixels get restart markers, as camera
+	// files usually have, one interval per this many MCUs
+	const uint64_t kRestartMinPixels = 5u * 1000u * 1000u;
+	const int kRestartInterval = 64;
+
+	// Source sizes seen in typical photo folders: camera, phone portrait,
+	// screenshots and small web images.
+	const int kBaseSizes[][2] = {
+		{ 4000, 3000 }, { 3000, 2000 }, { 1920, 1080 }, { 1080, 1920 },
+		{ 2048, 1365 }, { 1024, 768 }, { 800, 800 }, { 640, 480 },
+	};
+
+	struct Rng {
+		uint32_t state;
+
+		explicit Rng(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
+
+		uint32_t Next() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		int Range(int count) { return (int)(Next() % (uint32_t)count); }
+	};
+
+	// The canonical codes of one JPEG Huffman table
+	struct HuffmanCodes {
+		int firstCode[17] = {};
+		int firstIndex[17] = {};
+		int count[17] = {};
+		uint8_t symbols[256] = {};
+		uint16_t codeOf[256] = {};
+		uint8_t lengthOf[256] = {};
+
+		void Build(const unsigned char* counts, const unsigned char* values) {
+			int code = 0, index = 0;
+			for (int length = 1; length <= 16; length++) {
+				firstCode[length] = code;
+				firstIndex[length] = index;
+				count[length] = counts[length - 1];
+				for (int i = 0; i < count[length]; i++, code++, index++) {
+					symbols[index] = values[index];
+					codeOf[values[index]] = (uint16_t)code;
+					lengthOf[values[index]] = (uint8_t)length;
+				}
+				code <<= 1;
+			}
+		}
+	};
+
+	// Entropy-coded bits with the stuffed zero bytes already taken out
+	struct BitSource {
+		const std::vector<unsigned char>& bytes;
+		size_t bit = 0;
+
+		int Bit() {
+			size_t byte = bit >> 3;
+			int value = byte < bytes.size() ? (bytes[byte] >> (7 - (bit & 7))) & 1 : 1;
+			bit++;
+			return value;
+		}
+
+		int Bits(int count) {
+			int value = 0;
+			for (int i = 0; i < count; i++) {
+				value = (value << 1) | Bit();
+			}
+			return value;
+		}
+
+		int Symbol(const HuffmanCodes& codes) {
+			int code = 0;
+			for (int length = 1; length <= 16; length++) {
+				code = (code << 1) | Bit();
+				if (code - codes.firstCode[length] < codes.count[length]) {
+					return codes.symbols[codes.firstIndex[length] + code - codes.firstCode[length]];
+				}
+			}
+			return -1;
+		}
+	};
+
+	struct BitSink {
+		std::vector<unsigned char>& out;
+		uint32_t buffer = 0;
+		int count = 0;
+
+		void Put(uint32_t bits, int length) {
+			for (int i = length - 1; i >= 0; i--) {
+				buffer = (buffer << 1) | ((bits >> i) & 1);
+				if (++count == 8) {
+					out.push_back((unsigned char)buffer);
+					if (buffer == 0xFF) {
+						out.push_back(0);
+					}
+					buffer = 0;
+					count = 0;
+				}
+			}
+		}
+
+		// Pads the last byte with 1 bits, as the standard asks before a marker
+		void Flush() {
+			while (count != 0) {
+				Put(1, 1);
+			}
+		}
+	};
+
+	// A coefficient value as its size category and the bits that follow it
+	void putValue(BitSink& sink, const HuffmanCodes& codes, int value) {
+		int magnitude = value < 0 ? -value : value;
+		int category = 0;
+		while (magnitude >> category) {
+			category++;
+		}
+		sink.Put(codes.codeOf[category], codes.lengthOf[category]);
+		if (category) {
+			sink.Put((uint32_t)(value < 0 ? value + (1 << category) - 1 : value), category);
+		}
+	}
+
+	std::string manifestHeader(const CorpusOptions& options) {
+		std::ostringstream header;
+		header << "vgs-bench-corpus " << kManifestVersion << " count=" << options.imageCount
+			<< " seed=" << options.seed << " scale=" << options.scale;
+		return header.str();
+	}
+
+	bool readManifest(const CorpusOptions& options, CorpusSummary& summary) {
+		std::ifstream file(std::filesystem::path(options.directory) / kManifestName);
+		std::string header;
+		if (!file || !std::getline(file, header) || header != manifestHeader(options)) {
+			return false;
+		}
+		file >> summary.files >> summary.png >> summary.jpeg >> summary.bmp
+			>> summary.withAlpha >> summary.grayscale >> summary.pixels >> summary.bytes;
+		return (bool)file && summary.files == options.imageCount;
+	}
+
+	bool writeManifest(const CorpusOptions& options, const CorpusSummary& summary) {
+		std::ofstream file(std::filesystem::path(options.directory) / kManifestName, std::ios::trunc);
+		file << manifestHeader(options) << "\n"
+			<< summary.files << " " << summary.png << " " << summary.jpeg << " " << summary.bmp << " "
+			<< summary.withAlpha << " " << summary.grayscale << " " << summary.pixels << " " << summary.bytes << "\n";
+		return (bool)file;
+	}
+}
+
+void fillSyntheticImage(unsigned char* pixels, int width, int height, int channels, uint32_t seed) {
+	Rng rng(seed);
+
+	// Smooth diagonal gradient as the background
+	int colorA[4], colorB[4];
+	for (int c = 0; c < 4; c++) {
+		colorA[c] = rng.Range(256);
+		colorB[c] = rng.Range(256);
+	}
+	int span = std::max(1, width + height - 2);
+	for (int y = 0; y < height; y++) {
+		unsigned char* row = pixels + (size_t)y * width * channels;
+		for (int x = 0; x < width; x++) {
+			int t = ((x + y) * 256) / span;
+			for (int c = 0; c < channels; c++) {
+				row[x * channels + c] = (unsigned char)((colorA[c] * (256 - t) + colorB[c] * t) >> 8);
+			}
+		}
+	}
+
+	// Hard-edged shapes give the resampler and the encoders edges to work on
+	int shapes = 6 + rng.Range(10);
+	for (int s = 0; s < shapes; s++) {
+		int x0 = rng.Range(width), y0 = rng.Range(height);
+		int x1 = std::min(width, x0 + 1 + rng.Range(std::max(1, width / 3)));
+		int y1 = std::min(height, y0 + 1 + rng.Range(std::max(1, height / 3)));
+		unsigned char color[4];
+		for (int c = 0; c < 4; c++) {
+			color[c] = (unsigned char)rng.Range(256);
+		}
+		for (int y = y0; y < y1; y++) {
+			unsigned char* row = pixels + ((size_t)y * width + x0) * channels;
+			for (int x = x0; x < x1; x++, row += channels) {
+				for (int c = 0; c < channels; c++) {
+					row[c] = color[c];
+				}
+			}
+		}
+	}
+
+	// Low amplitude sensor-like noise on the colour channels
+	size_t count = (size_t)width * height;
+	int colorChannels = (channels == 2 || channels == 4) ? channels - 1 : channels;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t noise = rng.Next();
+		unsigned char* pixel = pixels + i * channels;
+		for (int c = 0; c < colorChannels; c++) {
+			int value = pixel[c] + (int)((noise >> (c * 8)) & 15) - 8;
+			pixel[c] = (unsigned char)std::clamp(value, 0, 255);
+		}
+	}
+}
+
+bool encodeImage(const char* extension, const unsigned char* pixels, int width, int height, int channels,
+	std::vector<unsigned char>& out) {
+	out.clear();
+	auto append = [](void* context, void* data, int size) {
+		auto* buffer = (std::vector<unsigned char>*)context;
+		buffer->insert(buffer->end(), (unsigned char*)data, (unsigned char*)data + size);
+	};
+	std::string format(extension);
+	if (format == ".png") {
+		return stbi_write_png_to_func(append, &out, width, height, channels, pixels, width * channels) != 0;
+	}
+	if (format == ".jpg") {
+		return stbi_write_jpg_to_func(append, &out, width, height, channels, pixels, 90) != 0;
+	}
+	if (format == ".bmp") {
+		return stbi_write_bmp_to_func(append, &out, width, height, channels, pixels) != 0;
+	}
+	return false;
+}
+
+bool addJpegRestartMarkers(const std::vector<unsigned char>& jpeg, int interval, std::vector<unsigned char>& out) {
+	struct Component {
+		int id = 0, h = 1, v = 1, dcTable = 0, acTable = 0;
+	};
+	HuffmanCodes tables[2][4];
+	Component components[4];
+	int componentCount = 0;
+	int width = 0, height = 0;
+	int scanOrder[4] = {};
+	int scanCount = 0;
+
+	out.clear();
+	if (interval <= 0 || jpeg.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+		return false;
+	}
+	out.assign(jpeg.begin(), jpeg.begin() + 2);
+	size_t pos = 2;
+	for (;;) {
+		if (pos + 4 > jpeg.size() || jpeg[pos] != 0xFF) {
+			return false;
+		}
+		int marker = jpeg[pos + 1];
+		size_t length = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+		if (pos + 2 + length > jpeg.size()) {
+			return false;
+		}
+		const unsigned char* segment = &jpeg[pos + 4];
+		if (marker == 0xC4) {
+			for (size_t i = 0; i + 17 <= length - 2;) {
+				int symbols = 0;
+				for (int j = 0; j < 16; j++) {
+					symbols += segment[i + 1 + j];
+				}
+				tables[segment[i] >> 4][segment[i] & 3].Build(segment + i + 1, segment + i + 17);
+				i += 17 + symbols;
+			}
+		}
+		else if (marker == 0xC0) {
+			height = (segment[1] << 8) | segment[2];
+			width = (segment[3] << 8) | segment[4];
+			componentCount = std::min((int)segment[5], 4);
+			for (int i = 0; i < componentCount; i++) {
+				components[i].id = segment[6 + i * 3];
+				components[i].h = segment[7 + i * 3] >> 4;
+				components[i].v = segment[7 + i * 3] & 15;
+			}
+		}
+		else if (marker == 0xDD) {
+			return false; // Has restart markers already
+		}
+		else if (marker == 0xDA) {
+			scanCount = std::min((int)segment[0], 4);
+			for (int i = 0; i < scanCount; i++) {
+				for (int c = 0; c < componentCount; c++) {
+					if (components[c].id == segment[1 + i * 2]) {
+						components[c].dcTable = segment[2 + i * 2] >> 4;
+						components[c].acTable = segment[2 + i * 2] & 3;
+						scanOrder[i] = c;
+					}
+				}
+			}
+			const unsigned char restart[] = { 0xFF, 0xDD, 0, 4, (unsigned char)(interval >> 8), (unsigned char)interval };
+			out.insert(out.end(), restart, restart + sizeof(restart));
+			out.insert(out.end(), jpeg.begin() + pos, jpeg.begin() + pos + 2 + length);
+			pos += 2 + length;
+			break;
+		}
+		out.insert(out.end(), jpeg.begin() + pos, jpeg.begin() + pos + 2 + length);
+		pos += 2 + length;
+	}
+	if (componentCount == 0 || scanCount != componentCount) {
+		return false;
+	}
+
+	// The scan up to its end marker, unstuffed
+	std::vector<unsigned char> scan;
+	while (pos + 1 < jpeg.size() && !(jpeg[pos] == 0xFF && jpeg[pos + 1] != 0)) {
+		scan.push_back(jpeg[pos]);
+		pos += jpeg[pos] == 0xFF ? 2 : 1;
+	}
+	size_t tail = pos;
+
+	// Every symbol is copied as it is but for the first DC difference of
+	// each component in an interval, which restarts from zero
+	int maxH = 1, maxV = 1;
+	for (int c = 0; c < componentCount; c++) {
+		maxH = std::max(maxH, components[c].h);
+		maxV = std::max(maxV, components[c].v);
+	}
+	int mcus = ((width + maxH * 8 - 1) / (maxH * 8)) * ((height + maxV * 8 - 1) / (maxV * 8));
+	if (componentCount == 1) {
+		mcus = ((width + 7) / 8) * ((height + 7) / 8);
+		components[0].h = components[0].v = 1;
+	}
+	BitSource source{ scan };
+	BitSink sink{ out };
+	int inPrediction[4] = {}, outPrediction[4] = {};
+	for (int mcu = 0; mcu < mcus; mcu++) {
+		if (mcu > 0 && mcu % interval == 0) {
+			sink.Flush();
+			out.push_back(0xFF);
+			out.push_back((unsigned char)(0xD0 + (mcu / interval - 1) % 8));
+			std::fill(outPrediction, outPrediction + 4, 0);
+		}
+		for (int i = 0; i < scanCount; i++) {
+			int c = scanOrder[i];
+			const HuffmanCodes& dc = tables[0][components[c].dcTable];
+			const HuffmanCodes& ac = tables[1][components[c].acTable];
+			for (int block = 0; block < components[c].h * components[c].v; block++) {
+				int category = source.Symbol(dc);
+				if (category < 0) {
+					return false;
+				}
+				int bits = source.Bits(category);
+				int diff = category && bits < (1 << (category - 1)) ? bits - (1 << category) + 1 : bits;
+				inPrediction[c] += diff;
+				putValue(sink, dc, inPrediction[c] - outPrediction[c]);
+				outPrediction[c] = inPrediction[c];
+
+				for (int k = 1; k < 64;) {
+					int rs = source.Symbol(ac);
+					if (rs < 0) {
+						return false;
+					}
+					sink.Put(ac.codeOf[rs], ac.lengthOf[rs]);
+					if (rs == 0) {
+						break;
+					}
+					sink.Put((uint32_t)source.Bits(rs & 15), rs & 15);
+					k += rs == 0xF0 ? 16 : (rs >> 4) + 1;
+				}
+			}
+		}
+	}
+	sink.Flush();
+	out.insert(out.end(), jpeg.begin() + tail, jpeg.end());
+	return true;
+}
+
+bool prepareCorpus(const CorpusOptions& options, bool regenerate, CorpusSummary& summary) {
+	summary = CorpusSummary();
+	if (!regenerate && readManifest(options, summary)) {
+		summary.reused = true;
+		return true;
+	}
+	summary = CorpusSummary();
+
+	// Only ever wipe a directory that holds a previous corpus
+	std::error_code error;
+	if (std::filesystem::exists(options.directory, error)) {
+		if (!std::filesystem::is_empty(options.directory, error) &&
+			!std::filesystem::exists(std::filesystem::path(options.directory) / kManifestName, error)) {
+			std::cerr << "Error: " << options.directory << " is not empty and is not a benchmark corpus" << std::endl;
+			return false;
+		}
+		std::filesystem::remove_all(options.directory, error);
+	}
+	std::filesystem::create_directories(options.directory, error);
+	if (error) {
+		std::cerr << "Error: Could not create corpus directory " << options.directory << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	Rng rng(options.seed);
+	std::vector<unsigned char> pixels;
+	for (int i = 0; i < options.imageCount; i++) {
+		const int* base = kBaseSizes[rng.Range((int)(sizeof(kBaseSizes) / sizeof(kBaseSizes[0])))];
+		int width = std::max(16, (int)(base[0] * options.scale));
+		int height = std::max(16, (int)(base[1] * options.scale));
+
+		// Format and channel mix: mostly JPEG photos, PNGs with and without
+		// alpha, a few greyscale images and uncompressed BMPs.
+		int formatRoll = rng.Range(100);
+		int channelRoll = rng.Range(100);
+		const char* extension;
+		int channels = 3;
+		if (formatRoll < 45) {
+			extension = ".jpg";
+			channels = channelRoll < 10 ? 1 : 3;
+		}
+		else if (formatRoll < 80) {
+			extension = ".png";
+			channels = channelRoll < 40 ? 4 : (channelRoll < 55 ? 1 : 3);
+		}
+		else {
+			extension = ".bmp";
+		}
+
+		// Nest some images up to three folders deep to exercise the scan
+		std::filesystem::path directory(options.directory);
+		int depth = rng.Range(4);
+		for (int d = 0; d < depth; d++) {
+			char name[32];
+			snprintf(name, sizeof(name), "set_%02d", rng.Range(4));
+			directory /= name;
+		}
+		std::filesystem::create_directories(directory, error);
+
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "img_%05d%s", i, extension);
+		std::string path = (directory / fileName).string();
+
+		pixels.resize((size_t)width * height * channels);
+		fillSyntheticImage(pixels.data(), width, height, channels, rng.Next());
+
+		int written;
+		if (extension[1] == 'j' && channels == 3 && (uint64_t)width * height >= kRestartMinPixels) {
+			std::vector<unsigned char> plain, restarted;
+			written = encodeImage(".jpg", pixels.data(), width, height, channels, plain) &&
+				addJpegRestartMarkers(plain, kRestartInterval, restarted);
+			if (written) {
+				std::ofstream file(path, std::ios::binary | std::ios::trunc);
+				written = (bool)file.write((const char*)restarted.data(), (std::streamsize)restarted.size());
+			}
+			summary.jpeg++;
+		}
+		else if (extension[1] == 'j') {
+			written = stbi_write_jpg(path.c_str(), width, height, channels, pixels.data(), 90);
+			summary.jpeg++;
+		}
+		else if (extension[1] == 'p') {
+			written = stbi_write_png(path.c_str(), width, height, channels, pixels.data(), width * channels);
+			summary.png++;
+		}
+		else {
+			written = stbi_write_bmp(path.c_str(), width, height, channels, pixels.data());
+			summary.bmp++;
+		}
+		if (!written) {
+			std::cerr << "Error: Could not write corpus image " << path << std::endl;
+			return false;
+		}
+
+		summary.files++;
+		summary.withAlpha += channels == 4;
+		summary.grayscale += channels == 1;
+		summary.pixels += (uint64_t)width * height;
+		summary.bytes += std::filesystem::file_size(path, error);
+	}
+
+	if (!writeManifest(options, summary)) {
+		std::cerr << "Error: Could not write corpus manifest in " << options.directory << std::endl;
+		return false;
+	}
+	return true;
+}
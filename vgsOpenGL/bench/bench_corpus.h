@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parameters of the synthetic image set. The same parameters always produce
+// byte-identical files, so runs on different machines are comparable.
+struct CorpusOptions {
+    std::string directory = "vgs_bench_corpus";
+    int imageCount = 200;
+    uint32_t seed = 1;
+    double scale = 1.0;   // Multiplies every source dimension
+};
+
+struct CorpusSummary {
+    int files = 0;
+    int png = 0;
+    int jpeg = 0;
+    int bmp = 0;
+    int withAlpha = 0;
+    int grayscale = 0;
+    uint64_t pixels = 0;   // Total source pixels
+    uint64_t bytes = 0;    // Total encoded size on disk
+    bool reused = false;   // Existing corpus matched the parameters
+};
+
+// Creates the corpus under `options.directory` unless a corpus with the same
+// parameters is already there (or `regenerate` is set).
+bool prepareCorpus(const CorpusOptions& options, bool regenerate, CorpusSummary& summary);
+
+// Fills `pixels` (width * height * channels) with deterministic content that
+// has gradients, edges and noise, so codecs and filters do realistic work.
+void fillSyntheticImage(unsigned char* pixels, int width, int height, int channels, uint32_t seed);
+
+// Encodes pixels as ".png", ".jpg" (quality 90) or ".bmp" into `out`.
+bool encodeImage(const char* extension, const unsigned char* pixels, int width, int height, int channels,
+    std::vector<unsigned char>& out);
+
+// Rewrites a single-scan baseline JPEG with a restart marker every `interval`
+// MCUs, to the same pixels. False for anything else.
+bool addJpegRestartMarkers(const std::vector<unsigned char>& jpeg, int interval, std::vector<unsigned char>& out);
@@ -0,0 +1,554 @@
+// End-to-end benchmark of the thumbnail pipeline: folder scan, probe,
+// thumbnail generation/loading on the loader threads, the RAM tier and the
+// upload to GL. Runs without a window; GL uploads use a surfaceless EGL
+// context when the benchmark is built with one, otherwise a null sink.
+// The corpus PNGs are also decoded by stb_image and by PngDecoder alone, and
+// every corpus file by each image codec that handles its format.
+//
+//   vgs_bench_pipeline [--images N] [--seed S] [--scale F] [--threads T]
+//                      [--corpus DIR] [--cache DIR] [--sink gl|null]
+//                      [--resize fast|balanced|high] [--out FILE] [--regenerate]
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "bench_corpus.h"
+#include "folder_scan.h"
+#include "image_codec.h"
+#include "perf_stats.h"
+#include "png_decoder.h"
+#include "resize_service.h"
+#include "stb_image.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_loader.h"
+
+#ifdef VGS_BENCH_WITH_GL
+#include "gl_headless.h"
+#include "texture.h"
+#define GLEW_STATIC
+#include "GL/glew.h"
+#endif
+
+namespace
+{
+	// Same per-frame upload cap the app uses, so flushes happen as often
+	const int kUploadsPerFrame = 8;
+
+	// Receives every decoded thumbnail the way the render thread would.
+	class UploadSink {
+	public:
+		virtual ~UploadSink() = default;
+		virtual const char* Name() const = 0;
+		virtual void Upload(const ThumbnailPixels& thumbnail) = 0;
+		virtual void EndFrame() {}
+		// Waits for outstanding work so it is inside the measured time
+		virtual void Finish() {}
+		// Drops everything uploaded during the pass (not measured)
+		virtual void Release() {}
+	};
+
+	class NullUploadSink : public UploadSink {
+	public:
+		const char* Name() const override { return "null"; }
+		void Upload(const ThumbnailPixels& thumbnail) override {
+			Perf::AddUploadBytes(thumbnail.pixels.size());
+		}
+	};
+
+#ifdef VGS_BENCH_WITH_GL
+	class GlUploadSink : public UploadSink {
+	public:
+		const char* Name() const override { return "gl"; }
+		void Upload(const ThumbnailPixels& thumbnail) override {
+			textures.push_back(generateTexture(thumbnail.pixels.data(), thumbnail.width, thumbnail.height, thumbnail.channels, thumbnail.levels));
+		}
+		void EndFrame() override { FlushTextureDeletions(); }
+		void Finish() override { glFinish(); }
+		void Release() override {
+			textures.clear();
+			FlushTextureDeletions();
+		}
+
+	private:
+		std::vector<TextureHandle> textures;
+	};
+#endif
+
+	struct BenchImage {
+		std::string filePath;
+		std::string thumbnailPath;
+		int thumbnailWidth = 0;
+		int thumbnailHeight = 0;
+	};
+
+	struct PassResult {
+		const char* name = "";
+		double wallMs = 0.0;
+		int images = 0;
+		int failed = 0;
+		int generated = 0;
+		Perf::StageTotals stages;
+		uint64_t texturesCreated = 0;
+		uint64_t texturesReused = 0;
+		uint64_t peakRssKB = 0;
+	};
+
+	struct PipelineContext {
+		std::string corpusDir;
+		std::string cacheDir;
+		unsigned threads = 1;
+		UploadSink* sink = nullptr;
+		RamThumbnailCache ramCache;
+	};
+
+	// Snake-case JSON keys for the perf stages
+	const char* stageKey(PerfStage stage) {
+		switch (stage) {
+		case PerfStage::Scan: return "scan";
+		case PerfStage::Probe: return "probe";
+		case PerfStage::Decode: return "decode";
+		case PerfStage::Resize: return "resize";
+		case PerfStage::Encode: return "encode";
+		case PerfStage::CacheIO: return "cache_io";
+		case PerfStage::Upload: return "upload";
+		case PerfStage::Layout: return "layout";
+		case PerfStage::Render: return "render";
+		default: return "unknown";
+		}
+	}
+
+	// Mirrors LoadFolder(): scan, then probe every file for its thumbnail size.
+	std::vector<BenchImage> scanAndProbe(const PipelineContext& context) {
+		std::vector<BenchImage> images;
+		for (std::string& path : scanImageFolder(context.corpusDir)) {
+			int width, height, channels;
+			if (!probeImage(path.c_str(), width, height, channels)) {
+				continue;
+			}
+			BenchImage image;
+			thumbnailSizeFor(width, height, image.thumbnailWidth, image.thumbnailHeight);
+			image.thumbnailPath = context.cacheDir + "/" + std::filesystem::path(path).filename().string() + ".thumb.png";
+			image.filePath = std::move(path);
+			images.push_back(std::move(image));
+		}
+		return images;
+	}
+
+	// Disk tier pass: every thumbnail goes through the loader threads, is
+	// generated when missing and lands in the RAM tier and the upload sink.
+	void runLoaderPass(PipelineContext& context, PassResult& pass) {
+		std::vector<BenchImage> images = scanAndProbe(context);
+
+		ThumbnailLoader loader;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		loader.SetResultCallback([&] {
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			wake.notify_one();
+		});
+		loader.Start(context.threads);
+		ResizeService::Start(context.threads);
+
+		for (uint32_t i = 0; i < (uint32_t)images.size(); i++) {
+			ThumbnailLoadRequest request;
+			request.index = i;
+			request.filePath = images[i].filePath;
+			request.thumbnailPath = images[i].thumbnailPath;
+			request.thumbnailWidth = images[i].thumbnailWidth;
+			request.thumbnailHeight = images[i].thumbnailHeight;
+			loader.Request(std::move(request));
+		}
+
+		std::vector<ThumbnailLoadResult> results;
+		size_t remaining = images.size();
+		while (remaining > 0) {
+			results.clear();
+			if (loader.PollResults(results, kUploadsPerFrame) == 0) {
+				std::unique_lock<std::mutex> lock(wakeMutex);
+				wake.wait_for(lock, std::chrono::milliseconds(5));
+				continue;
+			}
+			for (ThumbnailLoadResult& result : results) {
+				remaining--;
+				pass.images++;
+				pass.generated += result.generated;
+				if (!result.ok) {
+					pass.failed++;
+					continue;
+				}
+				context.sink->Upload(result.thumbnail);
+				if (!result.compressed.empty()) {
+					context.ramCache.Insert(result.index, std::move(result.compressed),
+						result.thumbnail.width, result.thumbnail.height, result.thumbnail.channels, result.thumbnail.levels);
+				}
+			}
+			context.sink->EndFrame();
+		}
+		context.sink->Finish();
+		loader.Stop();
+		ResizeService::Stop();
+	}
+
+	// RAM tier pass: every thumbnail is decompressed from the LZ4 cache on
+	// the calling thread, exactly like a re-scroll over evicted tiles.
+	void runRamPass(PipelineContext& context, PassResult& pass, uint32_t imageCount) {
+		ThumbnailPixels thumbnail;
+		for (uint32_t i = 0; i < imageCount; i++) {
+			pass.images++;
+			if (!context.ramCache.Fetch(i, thumbnail)) {
+				pass.failed++;
+				continue;
+			}
+			context.sink->Upload(thumbnail);
+			if ((i + 1) % kUploadsPerFrame == 0) {
+				context.sink->EndFrame();
+			}
+		}
+		context.sink->EndFrame();
+		context.sink->Finish();
+	}
+
+	template <typename Body>
+	PassResult measurePass(const char* name, PipelineContext& context, Body body) {
+		PassResult pass;
+		pass.name = name;
+#ifdef VGS_BENCH_WITH_GL
+		TextureStats texturesBefore = GetTextureStats();
+#endif
+		Perf::ResetTotals();
+
+		Stopwatch timer;
+		body(pass);
+		pass.wallMs = timer.ElapsedMs();
+
+		pass.stages = Perf::GetTotals();
+		pass.peakRssKB = peakRssKB();
+#ifdef VGS_BENCH_WITH_GL
+		TextureStats texturesAfter = GetTextureStats();
+		pass.texturesCreated = texturesAfter.created - texturesBefore.created;
+		pass.texturesReused = texturesAfter.reused - texturesBefore.reused;
+#endif
+		context.sink->Release();
+
+		std::cerr << "  " << name << ": " << pass.images << " images in " << pass.wallMs << " ms" << std::endl;
+		return pass;
+	}
+
+	// Both decoders over the same in-memory files, with the files' own
+	// channels as the thumbnail path decodes them. Times are of the files
+	// PngDecoder takes; the rest it leaves to stb_image.
+	struct PngDecodeResult {
+		int files = 0;
+		int taken = 0;
+		int mismatched = 0;
+		double megapixels = 0.0;
+		double stbiMs = 0.0;
+		double decoderMs = 0.0;
+	};
+
+	PngDecodeResult comparePngDecode(const std::string& corpusDir) {
+		PngDecodeResult result;
+		for (const std::string& path : scanImageFolder(corpusDir)) {
+			if (std::filesystem::path(path).extension() != ".png") {
+				continue;
+			}
+			std::ifstream file(path, std::ios::binary);
+			std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			result.files++;
+
+			Stopwatch timer;
+			PngDecoder decoder;
+			std::vector<unsigned char> decoded;
+			bool taken = decoder.Open(data.data(), data.size());
+			if (taken) {
+				decoded.resize(decoder.GetBufferSize());
+				taken = decoder.Decode(decoded.data());
+			}
+			double decoderMs = timer.ElapsedMs();
+			if (!taken) {
+				continue;
+			}
+
+			timer.Restart();
+			int width, height, channels;
+			unsigned char* expected = stbi_load_from_memory(data.data(), (int)data.size(), &width, &height, &channels, 0);
+			double stbiMs = timer.ElapsedMs();
+			result.taken++;
+			result.decoderMs += decoderMs;
+			result.stbiMs += stbiMs;
+			result.megapixels += (double)decoder.GetWidth() * decoder.GetHeight() * 1e-6;
+			if (!expected || std::memcmp(decoded.data(), expected, (size_t)width * height * channels) != 0) {
+				result.mismatched++;
+			}
+			stbi_image_free(expected);
+		}
+		std::cerr << "  png decode: " << result.taken << " of " << result.files << " PNGs, stb_image " << result.stbiMs
+			<< " ms, PngDecoder " << result.decoderMs << " ms" << std::endl;
+		if (result.mismatched > 0) {
+			std::cerr << "Error: PngDecoder differs from stb_image on " << result.mismatched << " files" << std::endl;
+		}
+		return result;
+	}
+
+	// One codec on the corpus files of one format. Files it declines are
+	// counted but not timed.
+	struct CodecDecodeResult {
+		const ImageCodec* codec = nullptr;
+		ImageFormat format = ImageFormat::Unknown;
+		int files = 0;
+		int taken = 0;
+		double megapixels = 0.0;
+		double ms = 0.0;
+	};
+
+	std::vector<CodecDecodeResult> compareCodecs(const std::string& corpusDir) {
+		std::vector<CodecDecodeResult> results;
+		for (const ImageCodec* codec : ImageCodecs::GetCodecs()) {
+			for (int format = 1; format < (int)ImageFormat::Count; format++) {
+				if (codec->Handles((ImageFormat)format)) {
+					CodecDecodeResult result;
+					result.codec = codec;
+					result.format = (ImageFormat)format;
+					results.push_back(result);
+				}
+			}
+		}
+		for (const std::string& path : scanImageFolder(corpusDir)) {
+			std::ifstream file(path, std::ios::binary);
+			std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			ImageFormat format = ImageCodecs::Sniff(data.data(), data.size());
+			for (CodecDecodeResult& result : results) {
+				if (result.format != format) {
+					continue;
+				}
+				result.files++;
+				Stopwatch timer;
+				DecodedImage image;
+				bool taken = result.codec->Decode(data.data(), data.size(), image);
+				double ms = timer.ElapsedMs();
+				if (taken) {
+					result.taken++;
+					result.ms += ms;
+					result.megapixels += (double)image.width * image.height * 1e-6;
+				}
+			}
+		}
+		for (const CodecDecodeResult& result : results) {
+			if (result.files > 0) {
+				std::cerr << "  " << result.codec->Name() << " " << ImageFormatName(result.format) << ": " << result.taken << " of "
+					<< result.files << " files, " << result.ms << " ms" << std::endl;
+			}
+		}
+		return results;
+	}
+
+	void writePass(JsonWriter& json, const PassResult& pass) {
+		json.BeginObject();
+		json.Field("name", pass.name);
+		json.Field("wall_ms", pass.wallMs);
+		json.Field("images", pass.images);
+		json.Field("failed", pass.failed);
+		json.Field("generated", pass.generated);
+		json.Field("images_per_second", pass.wallMs > 0.0 ? pass.images * 1000.0 / pass.wallMs : 0.0);
+		json.Field("upload_bytes", pass.stages.uploadBytes);
+		json.Field("textures_created", pass.texturesCreated);
+		json.Field("textures_reused", pass.texturesReused);
+		json.Field("peak_rss_kb", pass.peakRssKB);
+		json.BeginObject("stages");
+		for (int i = 0; i < (int)PerfStage::Count; i++) {
+			json.BeginObject(stageKey((PerfStage)i));
+			json.Field("ms", pass.stages.nanoseconds[i] * 1e-6);
+			json.Field("calls", pass.stages.calls[i]);
+			json.EndObject();
+		}
+		json.EndObject();
+		json.EndObject();
+	}
+}
+
+int main(int argc, char** argv) {
+	ArgParser args(argc, argv);
+	if (args.Has("--help")) {
+		std::cout << "usage: vgs_bench_pipeline [--images N] [--seed S] [--scale F] [--threads T]\n"
+			"                          [--corpus DIR] [--cache DIR] [--sink gl|null]\n"
+			"                          [--resize fast|balanced|high] [--out FILE] [--regenerate]\n";
+		return 0;
+	}
+
+	CorpusOptions corpusOptions;
+	corpusOptions.directory = args.Get("--corpus", corpusOptions.directory);
+	corpusOptions.imageCount = (int)std::max(1LL, args.GetInt("--images", corpusOptions.imageCount));
+	corpusOptions.seed = (uint32_t)args.GetInt("--seed", corpusOptions.seed);
+	corpusOptions.scale = std::clamp(args.GetDouble("--scale", corpusOptions.scale), 0.01, 4.0);
+
+	// Same loader thread count as the app: leave one core for the render thread
+	unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	PipelineContext context;
+	context.corpusDir = corpusOptions.directory;
+	context.cacheDir = args.Get("--cache", "vgs_bench_cache");
+	context.threads = (unsigned)std::max(1LL, args.GetInt("--threads", std::max(1u, hardwareThreads - 1)));
+	std::string resizeName = args.Get("--resize", "balanced");
+	ResizeQuality resizeQuality;
+	if (!parseResizeQuality(resizeName.c_str(), resizeQuality)) {
+		std::cerr << "Error: Unknown resize quality " << resizeName << std::endl;
+		return 1;
+	}
+	setResizeQuality(resizeQuality);
+	// The RAM pass needs every thumbnail to stay cached
+	context.ramCache.SetBudget((size_t)4 << 30);
+
+	std::string sinkName = args.Get("--sink",
+#ifdef VGS_BENCH_WITH_GL
+		"gl"
+#else
+		"null"
+#endif
+	);
+
+	std::unique_ptr<UploadSink> sink;
+	std::string renderer = "none";
+#ifdef VGS_BENCH_WITH_GL
+	if (sinkName == "gl") {
+		if (!initHeadlessGL(renderer)) {
+			return 1;
+		}
+		sink = std::make_unique<GlUploadSink>();
+	}
+#endif
+	if (!sink) {
+		if (sinkName != "null") {
+			std::cerr << "Error: Upload sink '" << sinkName << "' is not available in this build" << std::endl;
+			return 1;
+		}
+		sink = std::make_unique<NullUploadSink>();
+	}
+	context.sink = sink.get();
+
+	std::cerr << "Preparing corpus in " << corpusOptions.directory << std::endl;
+	Stopwatch corpusTimer;
+	CorpusSummary corpus;
+	if (!prepareCorpus(corpusOptions, args.Has("--regenerate"), corpus)) {
+		return 1;
+	}
+	double corpusMs = corpusTimer.ElapsedMs();
+
+	std::error_code error;
+	std::filesystem::remove_all(context.cacheDir, error);
+	std::filesystem::create_directories(context.cacheDir, error);
+	if (error) {
+		std::cerr << "Error: Could not create cache directory " << context.cacheDir << ": " << error.message() << std::endl;
+		return 1;
+	}
+
+	std::cerr << "Running passes with " << context.threads << " loader threads, " << sink->Name() << " sink" << std::endl;
+	std::vector<PassResult> passes;
+	passes.push_back(measurePass("cold", context, [&](PassResult& pass) { runLoaderPass(context, pass); }));
+	context.ramCache.Clear();
+	passes.push_back(measurePass("warm", context, [&](PassResult& pass) { runLoaderPass(context, pass); }));
+	uint32_t imageCount = (uint32_t)passes.back().images;
+	passes.push_back(measurePass("ram", context, [&](PassResult& pass) { runRamPass(context, pass, imageCount); }));
+	PngDecodeResult pngDecode = comparePngDecode(context.corpusDir);
+	std::vector<CodecDecodeResult> codecDecodes = compareCodecs(context.corpusDir);
+
+	JsonWriter json;
+	json.BeginObject();
+	json.Field("benchmark", "pipeline");
+	json.Field("version", 1);
+
+	json.BeginObject("config");
+	json.Field("images", corpusOptions.imageCount);
+	json.Field("seed", (int64_t)corpusOptions.seed);
+	json.Field("scale", corpusOptions.scale);
+	json.Field("threads", (int)context.threads);
+	json.Field("sink", sink->Name());
+	json.Field("resize", resizeName);
+	json.EndObject();
+
+	json.BeginObject("system");
+	json.Field("cpu", cpuModelName());
+	json.Field("hardware_threads", (int)hardwareThreads);
+	json.BeginArray("cpu_features");
+	for (const std::string& feature : cpuFeatures()) {
+		json.Field(nullptr, feature);
+	}
+	json.EndArray();
+	json.Field("gl_renderer", renderer);
+	json.EndObject();
+
+	json.BeginObject("corpus");
+	json.Field("files", corpus.files);
+	json.Field("png", corpus.png);
+	json.Field("jpeg", corpus.jpeg);
+	json.Field("bmp", corpus.bmp);
+	json.Field("with_alpha", corpus.withAlpha);
+	json.Field("grayscale", corpus.grayscale);
+	json.Field("megapixels", corpus.pixels * 1e-6);
+	json.Field("bytes", corpus.bytes);
+	json.Field("reused", corpus.reused);
+	json.Field("prepare_ms", corpusMs);
+	json.EndObject();
+
+	json.BeginObject("ram_cache");
+	json.Field("entries", (uint64_t)context.ramCache.GetEntryCount());
+	json.Field("compressed_bytes", (uint64_t)context.ramCache.GetUsedBytes());
+	json.EndObject();
+
+	json.BeginObject("png_decode");
+	json.Field("files", pngDecode.files);
+	json.Field("taken", pngDecode.taken);
+	json.Field("mismatched", pngDecode.mismatched);
+	json.Field("megapixels", pngDecode.megapixels);
+	json.Field("stbi_ms", pngDecode.stbiMs);
+	json.Field("png_decoder_ms", pngDecode.decoderMs);
+	json.Field("speedup", pngDecode.decoderMs > 0.0 ? pngDecode.stbiMs / pngDecode.decoderMs : 0.0);
+	json.EndObject();
+
+	json.BeginArray("codecs");
+	for (const CodecDecodeResult& result : codecDecodes) {
+		json.BeginObject();
+		json.Field("codec", result.codec->Name());
+		json.Field("format", ImageFormatName(result.format));
+		json.Field("files", result.files);
+		json.Field("taken", result.taken);
+		json.Field("megapixels", result.megapixels);
+		json.Field("ms", result.ms);
+		json.Field("megapixels_per_second", result.ms > 0.0 ? result.megapixels * 1000.0 / result.ms : 0.0);
+		json.EndObject();
+	}
+	json.EndArray();
+
+	json.BeginArray("passes");
+	for (const PassResult& pass : passes) {
+		writePass(json, pass);
+	}
+	json.EndArray();
+	json.Field("peak_rss_kb", peakRssKB());
+	json.EndObject();
+
+	sink.reset();
+#ifdef VGS_BENCH_WITH_GL
+	if (sinkName == "gl") {
+		ShutdownTextures();
+		shutdownHeadlessGL();
+	}
+#endif
+
+	std::string outPath = args.Get("--out", "");
+	if (outPath.empty()) {
+		std::cout << json.Str();
+	}
+	else if (!writeTextFile(outPath, json.Str())) {
+		std::cerr << "Error: Could not write " << outPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,453 @@
+// Replays a recorded input session through App::RenderUI() and the ImGui
+// OpenGL3 renderer on a headless GL context, against a fixed corpus, and
+// reports per-frame costs. Record a session in the app with
+// VGS_RECORD_INPUT=<file>, or let --make-recording write a synthetic one
+// (click "Load", scroll down, resize, scroll back up, zoom out and in,
+// open an image in the viewer and close it again).
+//
+//   vgs_bench_replay --recording FILE [--make-recording] [--corpus DIR]
+//                    [--images N] [--seed S] [--scale F] [--cache DIR]
+//                    [--warm] [--async-loads] [--gpu-timers]
+//                    [--lean-ui] [--draw-list-grid] [--retained-grid]
+//                    [--layout masonry|justified|uniform]
+//                    [--gl-stats FILE] [--out FILE]
+//
+// By default the loader threads only run between frames and finish what the
+// previous frame requested, so two runs see exactly the same uploads per
+// frame. --async-loads lets the loaders race the replay like in the app.
+// GL calls are counted through GLStats; --gpu-timers adds GL_TIME_ELAPSED
+// queries around the upload pass and the grid's draw callback, so with
+// --draw-list-grid there is no grid time; --gl-stats writes the last
+// frames' full per-source breakdown in the app's F3 format. --lean-ui draws
+// with UIRenderer instead of the ImGui backend. --draw-list-grid draws the
+// grid tiles as draw list quads instead of GridRenderer's instanced callback;
+// --retained-grid composites cached strips of the grid instead. --layout
+// picks the grid layout (masonry by default).
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "application.h"
+#include "bench_common.h"
+#include "bench_corpus.h"
+#include "gl_headless.h"
+#include "gl_stats.h"
+#include "grid_renderer.h"
+#include "image_viewer.h"
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+#include "input_recording.h"
+#include "perf_stats.h"
+#include "texture.h"
+#include "ui_renderer.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#ifndef _WIN32
+#include <cstdlib> // setenv
+#endif
+
+namespace
+{
+	struct FrameSample {
+		double uiMs = 0.0;       // NewFrame + App::RenderUI + Render
+		double submitMs = 0.0;   // RenderDrawData + texture flush
+		double finishMs = 0.0;   // glFinish: GPU (or llvmpipe) completion
+		uint64_t glCalls = 0;
+		uint64_t drawCalls = 0;
+		uint64_t textureBinds = 0;
+		uint64_t stateChanges = 0;
+		uint64_t stateQueries = 0;
+		uint64_t uploadBytes = 0;   // Texture data
+		uint64_t geometryBytes = 0; // ImGui vertex and index buffers
+		float gpuUploadMs = -1.0f;  // With --gpu-timers
+		float gpuGridMs = -1.0f;
+	};
+
+	// Offscreen colour target standing in for the window's back buffer
+	class RenderTarget {
+	public:
+		~RenderTarget() { Destroy(); }
+
+		bool Resize(int newWidth, int newHeight) {
+			if (newWidth == width && newHeight == height) {
+				return true;
+			}
+			Destroy();
+			width = newWidth;
+			height = newHeight;
+			glGenTextures(1, &colorTexture);
+			glBindTexture(GL_TEXTURE_2D, colorTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glGenFramebuffers(1, &framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+			return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		void Destroy() {
+			if (framebuffer) {
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glDeleteFramebuffers(1, &framebuffer);
+				glDeleteTextures(1, &colorTexture);
+				framebuffer = colorTexture = 0;
+			}
+			width = height = 0;
+		}
+
+	private:
+		GLuint framebuffer = 0;
+		GLuint colorTexture = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	void takeGLCounts(const GLFrameStats& stats, FrameSample& sample) {
+		for (const GLCallCounts& counts : stats.sources) {
+			sample.glCalls += counts.TotalCalls();
+			sample.drawCalls += counts.calls[(int)GLCallKind::Draw];
+			sample.textureBinds += counts.calls[(int)GLCallKind::BindTexture];
+			sample.stateChanges += counts.calls[(int)GLCallKind::StateChange];
+			sample.stateQueries += counts.calls[(int)GLCallKind::StateQuery];
+		}
+		sample.geometryBytes = stats.sources[(int)GLSource::ImGui].bytes[(int)GLCallKind::BufferUpload];
+		sample.gpuUploadMs = stats.gpuMs[(int)GLPass::Upload];
+		sample.gpuGridMs = stats.gpuMs[(int)GLPass::Grid];
+	}
+
+	// Click "Load" in the middle of the screen, scroll the grid down, shrink
+	// and restore the window while scrolled, fling back up, zoom out and in,
+	// then open the image in the middle in the viewer and close it again.
+	InputRecording makeSyntheticRecording() {
+		const float width = 1920.0f, height = 1080.0f, dt = 1.0f / 60.0f;
+		InputRecording recording;
+		auto frame = [&](float w, float h) -> RecordedInputFrame& {
+			recording.frames.push_back({ dt, w, h, {} });
+			return recording.frames.back();
+		};
+		auto event = [](RecordedInputEvent::Type type, float x, float y, int code, bool down) {
+			RecordedInputEvent e;
+			e.type = type;
+			e.x = x;
+			e.y = y;
+			e.code = code;
+			e.down = down;
+			return e;
+		};
+
+		// A few idle frames first so the "Load folder" window exists and is hovered
+		frame(width, height).events.push_back(event(RecordedInputEvent::MousePos, width * 0.5f, height * 0.5f, 0, false));
+		for (int i = 0; i < 4; i++) {
+			frame(width, height);
+		}
+		frame(width, height).events.push_back(event(RecordedInputEvent::MouseButton, 0, 0, 0, true));
+		frame(width, height).events.push_back(event(RecordedInputEvent::MouseButton, 0, 0, 0, false));
+		for (int i = 0; i < 10; i++) {
+			frame(width, height);
+		}
+		for (int i = 0; i < 240; i++) {
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseWheel, 0.0f, -2.0f, 0, false));
+		}
+		for (int i = 0; i < 60; i++) {
+			frame(1280.0f, 720.0f).events.push_back(event(RecordedInputEvent::MouseWheel, 0.0f, -1.0f, 0, false));
+		}
+		for (int i = 0; i < 120; i++) {
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseWheel, 0.0f, 5.0f, 0, false));
+		}
+		// Ctrl+wheel zoom down to the smallest tiles, then up to the largest
+		frame(width, height).events.push_back(event(RecordedInputEvent::Key, 0, 0, ImGuiMod_Ctrl, true));
+		for (int i = 0; i < 12; i++) {
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseWheel, 0.0f, -1.0f, 0, false));
+		}
+		for (int i = 0; i < 24; i++) {
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseWheel, 0.0f, 1.0f, 0, false));
+		}
+		frame(width, height).events.push_back(event(RecordedInputEvent::Key, 0, 0, ImGuiMod_Ctrl, false));
+		for (int i = 0; i < 30; i++) {
+			frame(width, height);
+		}
+		// Double-click the tile in the middle, let the viewer upload, close it with Escape
+		for (int click = 0; click < 2; click++) {
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseButton, 0, 0, 0, true));
+			frame(width, height).events.push_back(event(RecordedInputEvent::MouseButton, 0, 0, 0, false));
+		}
+		for (int i = 0; i < 60; i++) {
+			frame(width, height);
+		}
+		frame(width, height).events.push_back(event(RecordedInputEvent::Key, 0, 0, ImGuiKey_Escape, true));
+		frame(width, height).events.push_back(event(RecordedInputEvent::Key, 0, 0, ImGuiKey_Escape, false));
+		for (int i = 0; i < 10; i++) {
+			frame(width, height);
+		}
+		return recording;
+	}
+
+	struct Distribution {
+		double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+	};
+
+	template <typename Getter>
+	Distribution distribution(const std::vector<FrameSample>& frames, Getter get) {
+		Distribution d;
+		if (frames.empty()) {
+			return d;
+		}
+		std::vector<double> values;
+		for (const FrameSample& frame : frames) {
+			values.push_back(get(frame));
+			d.mean += values.back();
+		}
+		d.mean /= values.size();
+		std::sort(values.begin(), values.end());
+		auto percentile = [&](double p) { return values[std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5))]; };
+		d.p50 = percentile(0.50);
+		d.p95 = percentile(0.95);
+		d.p99 = percentile(0.99);
+		d.max = values.back();
+		return d;
+	}
+
+	void writeDistribution(JsonWriter& json, const char* key, const Distribution& d) {
+		json.BeginObject(key);
+		json.Field("mean", d.mean);
+		json.Field("p50", d.p50);
+		json.Field("p95", d.p95);
+		json.Field("p99", d.p99);
+		json.Field("max", d.max);
+		json.EndObject();
+	}
+}
+
+int main(int argc, char** argv) {
+	ArgParser args(argc, argv);
+	std::string recordingPath = args.Get("--recording", "");
+	if (args.Has("--help") || recordingPath.empty()) {
+		std::cout << "usage: vgs_bench_replay --recording FILE [--make-recording] [--corpus DIR]\n"
+			"                        [--images N] [--seed S] [--scale F] [--cache DIR]\n"
+			"                        [--warm] [--async-loads] [--gpu-timers]\n"
+			"                        [--lean-ui] [--draw-list-grid] [--retained-grid]\n"
+			"                        [--layout masonry|justified|uniform]\n"
+			"                        [--gl-stats FILE] [--out FILE]\n";
+		return recordingPath.empty() && !args.Has("--help") ? 1 : 0;
+	}
+
+	if (args.Has("--make-recording") && !makeSyntheticRecording().Save(recordingPath)) {
+		return 1;
+	}
+	InputRecording recording;
+	if (!recording.Load(recordingPath) || recording.frames.empty()) {
+		std::cerr << "Error: No frames in " << recordingPath << std::endl;
+		return 1;
+	}
+
+	CorpusOptions corpusOptions;
+	corpusOptions.directory = args.Get("--corpus", corpusOptions.directory);
+	corpusOptions.imageCount = (int)std::max(1LL, args.GetInt("--images", corpusOptions.imageCount));
+	corpusOptions.seed = (uint32_t)args.GetInt("--seed", corpusOptions.seed);
+	corpusOptions.scale = std::clamp(args.GetDouble("--scale", corpusOptions.scale), 0.01, 4.0);
+	CorpusSummary corpus;
+	if (!prepareCorpus(corpusOptions, false, corpus)) {
+		return 1;
+	}
+
+	// The app reads its thumbnail location from the environment
+	std::string cacheDir = args.Get("--cache", "vgs_bench_cache");
+	std::error_code error;
+	if (!args.Has("--warm")) {
+		std::filesystem::remove_all(cacheDir, error);
+	}
+#ifdef _WIN32
+	_putenv_s("VGS_THUMBNAIL_DIR", cacheDir.c_str());
+#else
+	setenv("VGS_THUMBNAIL_DIR", cacheDir.c_str(), 1);
+#endif
+	std::string corpusDir = std::filesystem::absolute(corpusOptions.directory).string();
+	App::SetFolderPicker([corpusDir] { return corpusDir; });
+	const bool syncLoads = !args.Has("--async-loads");
+
+	std::string renderer;
+	if (!initHeadlessGL(renderer)) {
+		return 1;
+	}
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr; // Window positions must not leak between runs
+	ImGui::StyleColorsDark();
+	ImGui_ImplOpenGL3_Init("#version 450");
+	GLStats::HookImGuiBackend();
+	const bool gpuTimers = args.Has("--gpu-timers");
+	GLStats::SetMode(gpuTimers ? GLStatsMode::GpuTimers : GLStatsMode::Counters);
+	UIRenderer::SetEnabled(args.Has("--lean-ui"));
+	GridRenderer::SetEnabled(!args.Has("--draw-list-grid"));
+	GridRenderer::SetRetained(args.Has("--retained-grid"));
+	std::string layoutName = args.Get("--layout", "masonry");
+	GridLayoutKind layout;
+	if (!ParseGridLayout(layoutName.c_str(), layout)) {
+		std::cerr << "Error: Unknown layout " << layoutName << std::endl;
+		return 1;
+	}
+	App::SetGridLayout(layout);
+
+	RenderTarget target;
+	std::vector<FrameSample> frames;
+	frames.reserve(recording.frames.size());
+	uint64_t uploadTotal = Perf::GetTotals().uploadBytes;
+	Stopwatch replayTimer;
+
+	for (const RecordedInputFrame& input : recording.frames) {
+		if (syncLoads) {
+			App::DrainLoads();
+		}
+		FrameSample sample;
+		Stopwatch timer;
+
+		applyInputFrame(input);
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui::NewFrame();
+		{
+			VGS_GL_PASS(GLPass::Upload);
+			App::RenderUI();
+		}
+		ImGui::Render();
+		sample.uiMs = timer.ElapsedMs();
+
+		int width = std::max(1, (int)input.displayWidth);
+		int height = std::max(1, (int)input.displayHeight);
+		if (!target.Resize(width, height)) {
+			std::cerr << "Error: Could not create a " << width << "x" << height << " render target" << std::endl;
+			return 1;
+		}
+		timer.Restart();
+		glViewport(0, 0, width, height);
+		glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		{
+			VGS_PERF_SCOPE(PerfStage::Render);
+			UIRenderer::RenderDrawData(ImGui::GetDrawData());
+		}
+		FlushTextureDeletions();
+		sample.submitMs = timer.ElapsedMs();
+
+		timer.Restart();
+		glFinish();
+		sample.finishMs = timer.ElapsedMs();
+
+		// Timer queries are complete after glFinish(), so this frame's GPU
+		// times are already in
+		GLStats::EndFrame();
+		takeGLCounts(GLStats::GetLastFrame(), sample);
+		uint64_t uploaded = Perf::GetTotals().uploadBytes;
+		sample.uploadBytes = uploaded - uploadTotal;
+		uploadTotal = uploaded;
+		Perf::EndFrame((sample.uiMs + sample.submitMs) * 1e-3);
+		frames.push_back(sample);
+	}
+	double replayMs = replayTimer.ElapsedMs();
+
+	std::string glStatsPath = args.Get("--gl-stats", "");
+	if (!glStatsPath.empty()) {
+		GLStats::SetOutputPath(glStatsPath);
+		if (GLStats::Flush() < 0) {
+			return 1;
+		}
+	}
+
+	// Timings of the last image opened in the viewer, if any
+	ImageViewerStats viewerStats = ImageViewer::GetStats();
+
+	App::Shutdown();
+	UIRenderer::Shutdown();
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui::DestroyContext();
+	target.Destroy();
+	shutdownHeadlessGL();
+
+	JsonWriter json;
+	json.BeginObject();
+	json.Field("benchmark", "replay");
+	json.Field("version", 2);
+	json.Field("recording", recordingPath);
+	json.Field("gl_renderer", renderer);
+	json.Field("sync_loads", syncLoads);
+	json.Field("gpu_timers", gpuTimers);
+	json.Field("lean_ui_renderer", UIRenderer::IsEnabled());
+	json.Field("instanced_grid", GridRenderer::IsEnabled());
+	json.Field("retained_grid", GridRenderer::IsRetained());
+	json.Field("layout", layoutName);
+	json.Field("warm_cache", args.Has("--warm"));
+	json.Field("corpus_images", corpus.files);
+	json.Field("frames", (int)frames.size());
+	json.Field("replay_ms", replayMs);
+
+	json.BeginObject("summary");
+	writeDistribution(json, "cpu_ms", distribution(frames, [](const FrameSample& f) { return f.uiMs + f.submitMs; }));
+	writeDistribution(json, "ui_ms", distribution(frames, [](const FrameSample& f) { return f.uiMs; }));
+	writeDistribution(json, "submit_ms", distribution(frames, [](const FrameSample& f) { return f.submitMs; }));
+	writeDistribution(json, "finish_ms", distribution(frames, [](const FrameSample& f) { return f.finishMs; }));
+	writeDistribution(json, "draw_calls", distribution(frames, [](const FrameSample& f) { return (double)f.drawCalls; }));
+	writeDistribution(json, "texture_binds", distribution(frames, [](const FrameSample& f) { return (double)f.textureBinds; }));
+	writeDistribution(json, "gl_calls", distribution(frames, [](const FrameSample& f) { return (double)f.glCalls; }));
+	writeDistribution(json, "state_queries", distribution(frames, [](const FrameSample& f) { return (double)f.stateQueries; }));
+	writeDistribution(json, "upload_bytes", distribution(frames, [](const FrameSample& f) { return (double)f.uploadBytes; }));
+	int slowFrames = 0;
+	for (const FrameSample& f : frames) {
+		slowFrames += f.uiMs + f.submitMs > 1000.0 / 60.0;
+	}
+	json.Field("frames_over_16ms", slowFrames);
+	if (gpuTimers) {
+		writeDistribution(json, "gpu_upload_ms", distribution(frames, [](const FrameSample& f) { return (double)std::max(f.gpuUploadMs, 0.0f); }));
+		writeDistribution(json, "gpu_grid_ms", distribution(frames, [](const FrameSample& f) { return (double)std::max(f.gpuGridMs, 0.0f); }));
+	}
+	json.EndObject();
+
+	if (viewerStats.firstPixelMs >= 0.0) {
+		json.BeginObject("viewer");
+		json.Field("width", viewerStats.width);
+		json.Field("height", viewerStats.height);
+		json.Field("first_pixel_ms", viewerStats.firstPixelMs);
+		json.Field("preview_ms", viewerStats.previewMs);
+		json.Field("full_ms", viewerStats.fullMs);
+		json.Field("levels_uploaded", viewerStats.levelsUploaded);
+		json.Field("levels", viewerStats.levels);
+		json.EndObject();
+	}
+
+	json.BeginArray("per_frame");
+	for (const FrameSample& f : frames) {
+		json.BeginObject();
+		json.Field("cpu_ms", f.uiMs + f.submitMs);
+		json.Field("ui_ms", f.uiMs);
+		json.Field("submit_ms", f.submitMs);
+		json.Field("finish_ms", f.finishMs);
+		json.Field("gl_calls", f.glCalls);
+		json.Field("draw_calls", f.drawCalls);
+		json.Field("texture_binds", f.textureBinds);
+		json.Field("state_changes", f.stateChanges);
+		json.Field("state_queries", f.stateQueries);
+		json.Field("upload_bytes", f.uploadBytes);
+		json.Field("geometry_bytes", f.geometryBytes);
+		if (gpuTimers) {
+			json.Field("gpu_upload_ms", (double)f.gpuUploadMs);
+			json.Field("gpu_grid_ms", (double)f.gpuGridMs);
+		}
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+
+	std::string outPath = args.Get("--out", "");
+	if (outPath.empty()) {
+		std::cout << json.Str();
+	}
+	else if (!writeTextFile(outPath, json.Str())) {
+		std::cerr << "Error: Could not write " << outPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+
+#include "gl_headless.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// The app links GLEW, which owns these pointers and fills them in
+// glewInit(). GLEW needs a window system to initialise, so the benchmark
+// defines the ones the app and the benchmarks call and loads them through EGL.
+#define VGS_GL_ENTRY_POINTS(X) \
+	X(PFNGLGENERATEMIPMAPPROC, GenerateMipmap) \
+	X(PFNGLTEXSTORAGE2DPROC, TexStorage2D) \
+	X(PFNGLGENFRAMEBUFFERSPROC, GenFramebuffers) \
+	X(PFNGLDELETEFRAMEBUFFERSPROC, DeleteFramebuffers) \
+	X(PFNGLBINDFRAMEBUFFERPROC, BindFramebuffer) \
+	X(PFNGLFRAMEBUFFERTEXTURE2DPROC, FramebufferTexture2D) \
+	X(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus) \
+	X(PFNGLGENQUERIESPROC, GenQueries) \
+	X(PFNGLDELETEQUERIESPROC, DeleteQueries) \
+	X(PFNGLBEGINQUERYPROC, BeginQuery) \
+	X(PFNGLENDQUERYPROC, EndQuery) \
+	X(PFNGLGETQUERYOBJECTIVPROC, GetQueryObjectiv) \
+	X(PFNGLGETQUERYOBJECTUI64VPROC, GetQueryObjectui64v) \
+	X(PFNGLACTIVETEXTUREPROC, ActiveTexture) \
+	X(PFNGLBLENDEQUATIONPROC, BlendEquation) \
+	X(PFNGLBLENDFUNCSEPARATEPROC, BlendFuncSeparate) \
+	X(PFNGLCREATESHADERPROC, CreateShader) \
+	X(PFNGLSHADERSOURCEPROC, ShaderSource) \
+	X(PFNGLCOMPILESHADERPROC, CompileShader) \
+	X(PFNGLGETSHADERIVPROC, GetShaderiv) \
+	X(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog) \
+	X(PFNGLDELETESHADERPROC, DeleteShader) \
+	X(PFNGLCREATEPROGRAMPROC, CreateProgram) \
+	X(PFNGLATTACHSHADERPROC, AttachShader) \
+	X(PFNGLLINKPROGRAMPROC, LinkProgram) \
+	X(PFNGLGETPROGRAMIVPROC, GetProgramiv) \
+	X(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog) \
+	X(PFNGLDELETEPROGRAMPROC, DeleteProgram) \
+	X(PFNGLUSEPROGRAMPROC, UseProgram) \
+	X(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation) \
+	X(PFNGLUNIFORM1IPROC, Uniform1i) \
+	X(PFNGLUNIFORM1FPROC, Uniform1f) \
+	X(PFNGLUNIFORM1IVPROC, Uniform1iv) \
+	X(PFNGLUNIFORM2FPROC, Uniform2f) \
+	X(PFNGLUNIFORM4FPROC, Uniform4f) \
+	X(PFNGLUNIFORMMATRIX4FVPROC, UniformMatrix4fv) \
+	X(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays) \
+	X(PFNGLDELETEVERTEXARRAYSPROC, DeleteVertexArrays) \
+	X(PFNGLBINDVERTEXARRAYPROC, BindVertexArray) \
+	X(PFNGLENABLEVERTEXATTRIBARRAYPROC, EnableVertexAttribArray) \
+	X(PFNGLVERTEXATTRIBPOINTERPROC, VertexAttribPointer) \
+	X(PFNGLVERTEXATTRIBIPOINTERPROC, VertexAttribIPointer) \
+	X(PFNGLVERTEXATTRIBDIVISORPROC, VertexAttribDivisor) \
+	X(PFNGLDRAWARRAYSINSTANCEDPROC, DrawArraysInstanced) \
+	X(PFNGLGENBUFFERSPROC, GenBuffers) \
+	X(PFNGLDELETEBUFFERSPROC, DeleteBuffers) \
+	X(PFNGLBINDBUFFERPROC, BindBuffer) \
+	X(PFNGLBUFFERDATAPROC, BufferData) \
+	X(PFNGLBUFFERSUBDATAPROC, BufferSubData) \
+	X(PFNGLBUFFERSTORAGEPROC, BufferStorage) \
+	X(PFNGLMAPBUFFERRANGEPROC, MapBufferRange) \
+	X(PFNGLFENCESYNCPROC, FenceSync) \
+	X(PFNGLCLIENTWAITSYNCPROC, ClientWaitSync) \
+	X(PFNGLDELETESYNCPROC, DeleteSync) \
+	X(PFNGLDRAWELEMENTSBASEVERTEXPROC, DrawElementsBaseVertex)
+
+#define VGS_GL_DEFINE_POINTER(type, name) type __glew##name = nullptr;
+VGS_GL_ENTRY_POINTS(VGS_GL_DEFINE_POINTER)
+
+namespace
+{
+	struct GlEntryPoint {
+		const char* name;
+		void** slot;
+	};
+
+#define VGS_GL_ENTRY(type, name) { "gl" #name, (void**)&__glew##name },
+	const GlEntryPoint kEntryPoints[] = {
+		VGS_GL_ENTRY_POINTS(VGS_GL_ENTRY)
+	};
+#undef VGS_GL_ENTRY
+
+	EGLDisplay g_display = EGL_NO_DISPLAY;
+	EGLContext g_context = EGL_NO_CONTEXT;
+
+	EGLDisplay openDisplay() {
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY) {
+				return display;
+			}
+		}
+		return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+}
+
+bool initHeadlessGL(std::string& renderer) {
+	g_display = openDisplay();
+	EGLint major = 0, minor = 0;
+	if (g_display == EGL_NO_DISPLAY || !eglInitialize(g_display, &major, &minor)) {
+		std::cerr << "Error: Could not initialize an EGL display" << std::endl;
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(g_display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		// Surfaceless displays may not expose any config; contexts still work
+		config = nullptr;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "Error: EGL does not support desktop OpenGL" << std::endl;
+		shutdownHeadlessGL();
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	g_context = eglCreateContext(g_display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (g_context == EGL_NO_CONTEXT || !eglMakeCurrent(g_display, EGL_NO_SURFACE, EGL_NO_SURFACE, g_context)) {
+		std::cerr << "Error: Could not create a surfaceless OpenGL 4.5 context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		shutdownHeadlessGL();
+		return false;
+	}
+
+	for (const GlEntryPoint& entry : kEntryPoints) {
+		*entry.slot = (void*)eglGetProcAddress(entry.name);
+		if (!*entry.slot) {
+			std::cerr << "Error: Missing GL entry point " << entry.name << std::endl;
+			shutdownHeadlessGL();
+			return false;
+		}
+	}
+
+	const GLubyte* name = glGetString(GL_RENDERER);
+	const GLubyte* version = glGetString(GL_VERSION);
+	renderer = std::string(name ? (const char*)name : "?") + " / " + (version ? (const char*)version : "?");
+	return true;
+}
+
+void shutdownHeadlessGL() {
+	if (g_display == EGL_NO_DISPLAY) {
+		return;
+	}
+	eglMakeCurrent(g_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (g_context != EGL_NO_CONTEXT) {
+		eglDestroyContext(g_display, g_context);
+		g_context = EGL_NO_CONTEXT;
+	}
+	eglTerminate(g_display);
+	g_display = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Creates an offscreen OpenGL 4.5 core context through EGL without any
+// window system (EGL_MESA_platform_surfaceless), so the app's GL code can be
+// benchmarked on machines with no display. Software rasterisers such as
+// llvmpipe work too. Also resolves the GLEW entry points the app uses.
+bool initHeadlessGL(std::string& renderer);
+void shutdownHeadlessGL();
@@ -0,0 +1,369 @@
+// Microbenchmarks for the pixel kernels, codecs and layout.
+//
+//   vgs_bench_micro [--filter TEXT] [--samples N] [--min-sample-ms MS]
+//                   [--out FILE] [--baseline FILE] [--threshold PCT] [--list]
+//   vgs_bench_micro --verify [--filter TEXT]
+//
+// Every case reports the median time per iteration over N samples together
+// with its spread. With --baseline, medians are compared against an earlier
+// report and the run fails (exit code 2) when a case got slower by more than
+// the threshold and by more than the noise of both runs. --verify runs the
+// correctness checks instead and fails (exit code 1) when one does.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#include "bench_common.h"
+#include "micro_bench.h"
+
+static uint64_t nowNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<MicroCase>& microCases() {
+	static std::vector<MicroCase> cases;
+	return cases;
+}
+
+std::vector<MicroCheck>& microChecks() {
+	static std::vector<MicroCheck> checks;
+	return checks;
+}
+
+static int runChecks(const std::string& filter) {
+	int failed = 0, run = 0;
+	for (const MicroCheck& check : microChecks()) {
+		if (check.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		bool passed = check.run();
+		std::cerr << (passed ? "ok      " : "FAILED  ") << check.name << std::endl;
+		failed += !passed;
+		run++;
+	}
+	std::cerr << run - failed << " of " << run << " check(s) passed" << std::endl;
+	return failed > 0 ? 1 : 0;
+}
+
+bool MicroState::NextBatch() {
+	uint64_t now = nowNs();
+	double elapsed = (double)(now - batchStart);
+
+	switch (phase) {
+	case Phase::Start:
+		phase = Phase::Calibrate;
+		break;
+	case Phase::Calibrate:
+		// The first batch long enough to be a sample doubles as the warm-up
+		if (elapsed >= minSampleNs) {
+			phase = Phase::Measure;
+		}
+		else {
+			double scale = minSampleNs / std::max(elapsed, 1.0) * 1.2;
+			batchSize = (uint64_t)(batchSize * std::clamp(scale, 2.0, 100.0));
+		}
+		break;
+	case Phase::Measure:
+		samplesNs.push_back(elapsed / (double)batchSize);
+		if ((int)samplesNs.size() >= sampleCount) {
+			phase = Phase::Done;
+			return false;
+		}
+		break;
+	default:
+		return false;
+	}
+
+	remaining = batchSize - 1;
+	batchStart = nowNs();
+	return true;
+}
+
+namespace
+{
+	struct CaseResult {
+		std::string name;
+		int samples = 0;
+		uint64_t batchSize = 0;
+		double minNs = 0.0;
+		double medianNs = 0.0;
+		double meanNs = 0.0;
+		double stddevNs = 0.0;
+		double madNs = 0.0;        // Median absolute deviation
+		double ci95Ns = 0.0;       // Half width of the 95% interval of the mean
+		double bytesPerSecond = 0.0;
+		double itemsPerSecond = 0.0;
+		std::vector<std::pair<std::string, double>> metrics;
+		// Baseline comparison
+		bool hasBaseline = false;
+		double baselineMedianNs = 0.0;
+		double baselineMadNs = 0.0;
+		bool regression = false;
+	};
+
+	double median(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t n = values.size();
+		return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+	}
+
+	// Two-sided 97.5% quantile of Student's t for small sample counts
+	double studentT975(int degreesOfFreedom) {
+		static const double table[] = {
+			12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+			2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+			2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+		};
+		if (degreesOfFreedom < 1) {
+			return 0.0;
+		}
+		if (degreesOfFreedom <= 30) {
+			return table[degreesOfFreedom - 1];
+		}
+		return 1.96;
+	}
+
+	CaseResult summarize(const std::string& name, const MicroState& state) {
+		CaseResult result;
+		result.name = name;
+		const std::vector<double>& samples = state.Samples();
+		result.samples = (int)samples.size();
+		result.batchSize = state.BatchSize();
+		result.metrics = state.Metrics();
+		if (samples.empty()) {
+			return result;
+		}
+
+		result.minNs = *std::min_element(samples.begin(), samples.end());
+		result.medianNs = median(samples);
+		double sum = 0.0;
+		for (double sample : samples) {
+			sum += sample;
+		}
+		result.meanNs = sum / samples.size();
+		double squares = 0.0;
+		std::vector<double> deviations;
+		for (double sample : samples) {
+			squares += (sample - result.meanNs) * (sample - result.meanNs);
+			deviations.push_back(std::fabs(sample - result.medianNs));
+		}
+		int n = (int)samples.size();
+		result.stddevNs = n > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+		result.madNs = median(deviations);
+		result.ci95Ns = n > 1 ? studentT975(n - 1) * result.stddevNs / std::sqrt((double)n) : 0.0;
+
+		double seconds = result.medianNs * 1e-9;
+		if (seconds > 0.0) {
+			result.bytesPerSecond = state.BytesPerIteration() / seconds;
+			result.itemsPerSecond = state.ItemsPerIteration() / seconds;
+		}
+		return result;
+	}
+
+	// Reads the name/median pairs back from a report written by writeReport()
+	bool readBaseline(const std::string& path, std::unordered_map<std::string, std::pair<double, double>>& out) {
+		std::ifstream file(path);
+		if (!file) {
+			return false;
+		}
+		std::string line, name;
+		double medianNs = 0.0;
+		auto numberAfter = [&](const char* key, double& value) {
+			size_t at = line.find(key);
+			if (at == std::string::npos) {
+				return false;
+			}
+			value = std::strtod(line.c_str() + at + std::strlen(key), nullptr);
+			return true;
+		};
+		while (std::getline(file, line)) {
+			size_t at = line.find("\"name\": \"");
+			if (at != std::string::npos) {
+				size_t start = at + 9;
+				name = line.substr(start, line.find('"', start) - start);
+				continue;
+			}
+			double value;
+			if (numberAfter("\"median_ns\": ", value)) {
+				medianNs = value;
+			}
+			else if (numberAfter("\"mad_ns\": ", value) && !name.empty()) {
+				out[name] = { medianNs, value };
+				name.clear();
+			}
+		}
+		return true;
+	}
+
+	std::string formatTime(double ns) {
+		char buffer[32];
+		if (ns >= 1e9) snprintf(buffer, sizeof(buffer), "%.3f s", ns * 1e-9);
+		else if (ns >= 1e6) snprintf(buffer, sizeof(buffer), "%.3f ms", ns * 1e-6);
+		else if (ns >= 1e3) snprintf(buffer, sizeof(buffer), "%.3f us", ns * 1e-3);
+		else snprintf(buffer, sizeof(buffer), "%.1f ns", ns);
+		return buffer;
+	}
+
+	void printResult(const CaseResult& result) {
+		char line[256];
+		int length = snprintf(line, sizeof(line), "%-44s %12s  +-%5.1f%%", result.name.c_str(),
+			formatTime(result.medianNs).c_str(), result.medianNs > 0.0 ? 100.0 * result.madNs / result.medianNs : 0.0);
+		if (result.bytesPerSecond > 0.0) {
+			length += snprintf(line + length, sizeof(line) - length, "  %9.1f MB/s", result.bytesPerSecond / (1024.0 * 1024.0));
+		}
+		else if (result.itemsPerSecond > 0.0) {
+			length += snprintf(line + length, sizeof(line) - length, "  %9.2f M/s", result.itemsPerSecond * 1e-6);
+		}
+		for (const auto& metric : result.metrics) {
+			length += snprintf(line + length, sizeof(line) - length, "  %s %.2f", metric.first.c_str(), metric.second);
+			length = std::min(length, (int)sizeof(line) - 1);
+		}
+		if (result.hasBaseline) {
+			double change = 100.0 * (result.medianNs - result.baselineMedianNs) / result.baselineMedianNs;
+			snprintf(line + length, sizeof(line) - length, "  %+6.1f%%%s", change, result.regression ? "  REGRESSION" : "");
+		}
+		std::cerr << line << std::endl;
+	}
+
+	void writeReport(JsonWriter& json, const std::vector<CaseResult>& results, int samples, double minSampleMs, double threshold) {
+		json.BeginObject();
+		json.Field("benchmark", "micro");
+		json.Field("version", 1);
+
+		json.BeginObject("system");
+		json.Field("cpu", cpuModelName());
+		json.Field("hardware_threads", (int)std::thread::hardware_concurrency());
+		json.BeginArray("cpu_features");
+		for (const std::string& feature : cpuFeatures()) {
+			json.Field(nullptr, feature);
+		}
+		json.EndArray();
+		json.EndObject();
+
+		json.BeginObject("config");
+		json.Field("samples", samples);
+		json.Field("min_sample_ms", minSampleMs);
+		json.Field("threshold_percent", threshold);
+		json.EndObject();
+
+		json.BeginArray("results");
+		for (const CaseResult& result : results) {
+			json.BeginObject();
+			json.Field("name", result.name);
+			json.Field("samples", result.samples);
+			json.Field("batch_size", result.batchSize);
+			json.Field("min_ns", result.minNs);
+			json.Field("median_ns", result.medianNs);
+			json.Field("mean_ns", result.meanNs);
+			json.Field("stddev_ns", result.stddevNs);
+			json.Field("ci95_ns", result.ci95Ns);
+			json.Field("mad_ns", result.madNs);
+			json.Field("bytes_per_second", result.bytesPerSecond);
+			json.Field("items_per_second", result.itemsPerSecond);
+			for (const auto& metric : result.metrics) {
+				json.Field(metric.first.c_str(), metric.second);
+			}
+			if (result.hasBaseline) {
+				json.Field("baseline_median_ns", result.baselineMedianNs);
+				json.Field("change_percent", 100.0 * (result.medianNs - result.baselineMedianNs) / result.baselineMedianNs);
+				json.Field("regression", result.regression);
+			}
+			json.EndObject();
+		}
+		json.EndArray();
+		json.EndObject();
+	}
+}
+
+int main(int argc, char** argv) {
+	ArgParser args(argc, argv);
+	if (args.Has("--help")) {
+		std::cout << "usage: vgs_bench_micro [--filter TEXT] [--samples N] [--min-sample-ms MS]\n"
+			"                       [--out FILE] [--baseline FILE] [--threshold PCT] [--list]\n"
+			"       vgs_bench_micro --verify [--filter TEXT]\n";
+		return 0;
+	}
+	if (args.Has("--verify")) {
+		return runChecks(args.Get("--filter", ""));
+	}
+
+	std::vector<MicroCase> cases = microCases();
+	std::sort(cases.begin(), cases.end(), [](const MicroCase& a, const MicroCase& b) { return a.name < b.name; });
+	std::string filter = args.Get("--filter", "");
+	if (!filter.empty()) {
+		cases.erase(std::remove_if(cases.begin(), cases.end(),
+			[&](const MicroCase& c) { return c.name.find(filter) == std::string::npos; }), cases.end());
+	}
+	if (args.Has("--list")) {
+		for (const MicroCase& c : cases) {
+			std::cout << c.name << "\n";
+		}
+		return 0;
+	}
+
+	int samples = (int)std::clamp(args.GetInt("--samples", 15), 3LL, 1000LL);
+	double minSampleMs = std::max(0.1, args.GetDouble("--min-sample-ms", 20.0));
+	double threshold = std::max(0.0, args.GetDouble("--threshold", 5.0));
+
+	std::unordered_map<std::string, std::pair<double, double>> baseline;
+	std::string baselinePath = args.Get("--baseline", "");
+	if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+		std::cerr << "Error: Could not read baseline " << baselinePath << std::endl;
+		return 1;
+	}
+
+	std::cerr << "CPU: " << cpuModelName() << " (";
+	std::vector<std::string> features = cpuFeatures();
+	for (size_t i = 0; i < features.size(); i++) {
+		std::cerr << (i ? " " : "") << features[i];
+	}
+	std::cerr << ")" << std::endl;
+
+	std::vector<CaseResult> results;
+	int regressions = 0;
+	for (const MicroCase& c : cases) {
+		MicroState state(samples, minSampleMs * 1e6);
+		c.run(state);
+		CaseResult result = summarize(c.name, state);
+
+		auto it = baseline.find(c.name);
+		if (it != baseline.end() && it->second.first > 0.0) {
+			result.hasBaseline = true;
+			result.baselineMedianNs = it->second.first;
+			result.baselineMadNs = it->second.second;
+			// Slower by more than the threshold and outside both runs' noise
+			double slowdown = result.medianNs - result.baselineMedianNs;
+			result.regression = slowdown > result.baselineMedianNs * threshold / 100.0 &&
+				slowdown > 2.0 * (result.madNs + result.baselineMadNs);
+			regressions += result.regression;
+		}
+		printResult(result);
+		results.push_back(std::move(result));
+	}
+
+	JsonWriter json;
+	writeReport(json, results, samples, minSampleMs, threshold);
+	std::string outPath = args.Get("--out", "");
+	if (outPath.empty()) {
+		std::cout << json.Str();
+	}
+	else if (!writeTextFile(outPath, json.Str())) {
+		std::cerr << "Error: Could not write " << outPath << std::endl;
+		return 1;
+	}
+
+	if (regressions > 0) {
+		std::cerr << regressions << " case(s) regressed by more than " << threshold << "%" << std::endl;
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Tiny microbenchmark harness. A case does its setup, then runs the code
+// under test inside `while (state.KeepRunning())`. The harness calibrates a
+// batch size so each sample lasts at least the minimum sample time, then
+// records a fixed number of samples after one warm-up batch.
+class MicroState {
+public:
+    MicroState(int sampleCount, double minSampleNs) : sampleCount(sampleCount), minSampleNs(minSampleNs) {}
+
+    bool KeepRunning() {
+        if (remaining > 0) {
+            remaining--;
+            return true;
+        }
+        return NextBatch();
+    }
+
+    // Work done per iteration, used for throughput figures
+    void SetBytesProcessed(uint64_t bytes) { bytesPerIteration = bytes; }
+    void SetItemsProcessed(uint64_t items) { itemsPerIteration = items; }
+    // A figure reported next to the timing, e.g. the PSNR of a lossy kernel
+    void SetMetric(const std::string& name, double value) { metrics.push_back({ name, value }); }
+
+    const std::vector<double>& Samples() const { return samplesNs; }
+    uint64_t BatchSize() const { return batchSize; }
+    uint64_t BytesPerIteration() const { return bytesPerIteration; }
+    uint64_t ItemsPerIteration() const { return itemsPerIteration; }
+    const std::vector<std::pair<std::string, double>>& Metrics() const { return metrics; }
+
+private:
+    enum class Phase { Start, Calibrate, Warmup, Measure, Done };
+
+    bool NextBatch();
+
+    int sampleCount;
+    double minSampleNs;
+    Phase phase = Phase::Start;
+    uint64_t batchSize = 1;
+    uint64_t remaining = 0;
+    uint64_t batchStart = 0;
+    uint64_t bytesPerIteration = 0;
+    uint64_t itemsPerIteration = 0;
+    std::vector<double> samplesNs; // Nanoseconds per iteration of each sample
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+using MicroFunction = std::function<void(MicroState&)>;
+
+struct MicroCase {
+    std::string name;   // "group/case", e.g. "resize/4000x3000_to_thumb"
+    MicroFunction run;
+};
+
+std::vector<MicroCase>& microCases();
+
+struct MicroRegistrar {
+    MicroRegistrar(const char* name, MicroFunction run) { microCases().push_back({ name, std::move(run) }); }
+};
+
+// Registers `body` (a lambda taking MicroState&) under `name`
+#define VGS_MICRO_CONCAT_INNER(a, b) a##b
+#define VGS_MICRO_CONCAT(a, b) VGS_MICRO_CONCAT_INNER(a, b)
+#define VGS_MICRO_BENCH(name, body) static MicroRegistrar VGS_MICRO_CONCAT(microRegistrar_, __LINE__)(name, body)
+
+// Correctness checks that --verify runs instead of the timings, e.g. a SIMD
+// kernel against its scalar reference. A check prints what went wrong to
+// stderr and returns false.
+struct MicroCheck {
+    std::string name;
+    std::function<bool()> run;
+};
+
+std::vector<MicroCheck>& microChecks();
+
+struct MicroCheckRegistrar {
+    MicroCheckRegistrar(const char* name, std::function<bool()> run) { microChecks().push_back({ name, std::move(run) }); }
+};
+
+#define VGS_MICRO_CHECK(name, body) static MicroCheckRegistrar VGS_MICRO_CONCAT(microCheckRegistrar_, __LINE__)(name, body)
+
+// Keeps the compiler from optimising away a result the benchmark ignores.
+inline void benchKeep(const void* pointer) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(pointer) : "memory");
+#else
+    static const void* volatile sink;
+    sink = pointer;
+#endif
+}
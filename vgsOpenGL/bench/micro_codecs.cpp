@@ -0,0 +1,267 @@
+// Every image codec compiled in, on the samples of the formats it handles:
+// a full decode, for JPEGs also a DCT-scaled decode for a thumbnail and a
+// band of rows as the viewer decodes them. A codec that declines a sample
+// reports declined = 1 and times only the declining. The restart-marker
+// JPEG decoder runs on a ResizeService pool of 4 threads in all.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "folder_scan.h"
+#include "image_codec.h"
+#include "micro_bench.h"
+#include "resize_service.h"
+#include "stb_image.h"
+
+namespace
+{
+	enum class CodecCall { Decode, Scaled, Rows };
+
+	struct CodecSample {
+		const char* name;
+		ImageFormat format;
+		const char* extension;
+		int width;
+		int height;
+		int channels;
+		bool restartMarkers;
+	};
+
+	const CodecSample kSamples[] = {
+		{ "jpeg_1920x1080", ImageFormat::Jpeg, ".jpg", 1920, 1080, 3, false },
+		{ "jpeg_restart_6000x4000", ImageFormat::Jpeg, ".jpg", 6000, 4000, 3, true },
+		{ "png_rgb_1920x1080", ImageFormat::Png, ".png", 1920, 1080, 3, false },
+		{ "png_rgba_1920x1080", ImageFormat::Png, ".png", 1920, 1080, 4, false },
+		{ "bmp_1920x1080", ImageFormat::Bmp, ".bmp", 1920, 1080, 3, false },
+	};
+
+	std::vector<unsigned char> encodeSample(const CodecSample& sample) {
+		std::vector<unsigned char> pixels((size_t)sample.width * sample.height * sample.channels);
+		fillSyntheticImage(pixels.data(), sample.width, sample.height, sample.channels, (uint32_t)(sample.width * 31 + sample.height * 7));
+		std::vector<unsigned char> encoded, restarted;
+		encodeImage(sample.extension, pixels.data(), sample.width, sample.height, sample.channels, encoded);
+		if (sample.restartMarkers && addJpegRestartMarkers(encoded, 64, restarted)) {
+			return restarted;
+		}
+		return encoded;
+	}
+
+	// The size DecodeScaled() is asked for by generateThumbnails()
+	void scaledMinimum(int width, int height, int& minWidth, int& minHeight) {
+		int thumbnailWidth, thumbnailHeight;
+		thumbnailSizeFor(width, height, thumbnailWidth, thumbnailHeight);
+		minWidth = thumbnailWidth * 2;
+		minHeight = thumbnailHeight * 2;
+	}
+
+	MicroFunction codecCase(const ImageCodec* codec, const CodecSample& sample, CodecCall call) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> file = encodeSample(sample);
+			int minWidth, minHeight;
+			scaledMinimum(sample.width, sample.height, minWidth, minHeight);
+			int rows = std::min(500, sample.height);
+			int firstRow = (sample.height - rows) / 2;
+			ResizeService::Start(3);
+
+			DecodedImage image;
+			bool taken = call == CodecCall::Rows ? codec->DecodeRows(file.data(), file.size(), firstRow, rows, image) :
+				call == CodecCall::Scaled ? codec->DecodeScaled(file.data(), file.size(), minWidth, minHeight, image) :
+				codec->Decode(file.data(), file.size(), image);
+			if (!taken) {
+				state.SetMetric("declined", 1.0);
+			}
+			else if (call == CodecCall::Scaled) {
+				state.SetMetric("decoded_width", image.width);
+			}
+			state.SetBytesProcessed((uint64_t)sample.width * (call == CodecCall::Rows ? rows : sample.height) * sample.channels);
+			while (state.KeepRunning()) {
+				if (call == CodecCall::Rows) {
+					codec->DecodeRows(file.data(), file.size(), firstRow, rows, image);
+				}
+				else if (call == CodecCall::Scaled) {
+					codec->DecodeScaled(file.data(), file.size(), minWidth, minHeight, image);
+				}
+				else {
+					codec->Decode(file.data(), file.size(), image);
+				}
+				benchKeep(image.pixels.get());
+			}
+			ResizeService::Stop();
+		};
+	}
+
+	const bool kCodecCasesRegistered = [] {
+		for (const ImageCodec* codec : ImageCodecs::GetCodecs()) {
+			for (const CodecSample& sample : kSamples) {
+				if (!codec->Handles(sample.format)) {
+					continue;
+				}
+				std::string name = std::string("codec/") + codec->Name() + "/" + sample.name;
+				microCases().push_back({ name, codecCase(codec, sample, CodecCall::Decode) });
+				if (sample.format == ImageFormat::Jpeg) {
+					microCases().push_back({ name + "_scaled_to_thumb", codecCase(codec, sample, CodecCall::Scaled) });
+					microCases().push_back({ name + "_rows500", codecCase(codec, sample, CodecCall::Rows) });
+				}
+			}
+		}
+		return true;
+	}();
+
+	double psnr(const unsigned char* a, const unsigned char* b, size_t size) {
+		double squares = 0.0;
+		for (size_t i = 0; i < size; i++) {
+			double difference = (double)a[i] - b[i];
+			squares += difference * difference;
+		}
+		double mse = std::max(squares / (double)size, 1e-10);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+}
+
+// Codecs that promise stb_image's pixels must give them bit for bit; others
+// must agree on the size and channels and come close. Info() must match
+// Decode(), DecodeRows() the same rows of Decode() and DecodeScaled() must
+// stay within the minimum and the full size.
+static bool checkCodecs() {
+	const CodecSample samples[] = {
+		{ "jpeg_33x17", ImageFormat::Jpeg, ".jpg", 33, 17, 3, false },
+		{ "jpeg_restart_1001x757", ImageFormat::Jpeg, ".jpg", 1001, 757, 3, true },
+		{ "png_grey_7x300", ImageFormat::Png, ".png", 7, 300, 1, false },
+		{ "png_rgba_301x41", ImageFormat::Png, ".png", 301, 41, 4, false },
+		{ "bmp_33x17", ImageFormat::Bmp, ".bmp", 33, 17, 3, false },
+	};
+	ResizeService::Start(3);
+	bool ok = true;
+	for (const CodecSample& sample : samples) {
+		std::vector<unsigned char> file = encodeSample(sample);
+		if (ImageCodecs::Sniff(file.data(), file.size()) != sample.format) {
+			std::cerr << "ImageCodecs::Sniff() misses the format of " << sample.name << std::endl;
+			ok = false;
+		}
+		int w, h, c;
+		unsigned char* expected = stbi_load_from_memory(file.data(), (int)file.size(), &w, &h, &c, 0);
+		DecodedImage any;
+		if (!expected || !ImageCodecs::Decode(file.data(), file.size(), any)) {
+			std::cerr << "No codec decodes " << sample.name << std::endl;
+			ok = false;
+		}
+
+		for (const ImageCodec* codec : ImageCodecs::GetCodecs()) {
+			DecodedImage image;
+			if (!expected || !codec->Handles(sample.format) || !codec->Decode(file.data(), file.size(), image)) {
+				continue;
+			}
+			std::string what = std::string(codec->Name()) + " on " + sample.name;
+			size_t stride = (size_t)w * c;
+			bool exact = codec->Name() == std::string("jpeg-restart") || codec->Name() == std::string("png") ||
+				codec->Name() == std::string("stb_image");
+			if (image.width != w || image.height != h || image.channels != c) {
+				std::cerr << "Size or channels of stb_image differ from " << what << std::endl;
+				ok = false;
+				continue;
+			}
+			double quality = psnr(image.pixels.get(), expected, stride * h);
+			if (exact ? std::memcmp(image.pixels.get(), expected, stride * h) != 0 : quality < 30.0) {
+				std::cerr << "Pixels of stb_image differ from " << what << " (" << quality << " dB)" << std::endl;
+				ok = false;
+			}
+
+			ImageInfo info;
+			if (codec->Info(file.data(), file.size(), info) && (info.width != w || info.height != h || info.channels != c)) {
+				std::cerr << "Info() disagrees with Decode() for " << what << std::endl;
+				ok = false;
+			}
+
+			int firstRow = h / 3, rows = std::max(1, h / 4);
+			DecodedImage band;
+			if (!codec->DecodeRows(file.data(), file.size(), firstRow, rows, band) || band.height != rows ||
+				std::memcmp(band.pixels.get(), image.pixels.get() + firstRow * stride, rows * stride) != 0) {
+				std::cerr << "DecodeRows() differs from Decode() for " << what << std::endl;
+				ok = false;
+			}
+
+			DecodedImage scaled;
+			int minWidth = (w + 3) / 4, minHeight = (h + 3) / 4;
+			if (!codec->DecodeScaled(file.data(), file.size(), minWidth, minHeight, scaled) ||
+				scaled.width < minWidth || scaled.height < minHeight || scaled.width > w || scaled.height > h) {
+				std::cerr << "DecodeScaled() gives a wrong size for " << what << std::endl;
+				ok = false;
+			}
+		}
+		stbi_image_free(expected);
+	}
+	ResizeService::Stop();
+
+	const unsigned char garbage[] = { 'G', 'I', 'F', '8', '9', 'a', 0, 0, 0, 0, 0, 0 };
+	DecodedImage none;
+	if (ImageCodecs::Sniff(garbage, sizeof(garbage)) != ImageFormat::Unknown || ImageCodecs::Decode(garbage, sizeof(garbage), none)) {
+		std::cerr << "ImageCodecs take a GIF header" << std::endl;
+		ok = false;
+	}
+	if (!ImageCodecs::IsSupportedExtension(".JPG") || !ImageCodecs::IsSupportedExtension(".png") ||
+		ImageCodecs::IsSupportedExtension(".gif") || ImageCodecs::IsSupportedExtension(".webp") != ImageCodecs::IsSupported(ImageFormat::WebP)) {
+		std::cerr << "ImageCodecs::IsSupportedExtension() is wrong" << std::endl;
+		ok = false;
+	}
+	return ok;
+}
+
+// probeImage() must find the frame header of a JPEG behind an Exif block
+// larger than the first read
+static bool checkProbeBehindExif() {
+	const CodecSample sample = { "jpeg_640x480", ImageFormat::Jpeg, ".jpg", 640, 480, 3, false };
+	std::vector<unsigned char> plain = encodeSample(sample);
+	std::vector<unsigned char> jpeg(plain.begin(), plain.begin() + 2);
+	const size_t exifLength = 30000;
+	jpeg.insert(jpeg.end(), { 0xFF, 0xE1, (unsigned char)(exifLength >> 8), (unsigned char)exifLength });
+	jpeg.insert(jpeg.end(), exifLength - 2, 0);
+	jpeg.insert(jpeg.end(), plain.begin() + 2, plain.end());
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "vgs_codec_probe.jpg";
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write((const char*)jpeg.data(), (std::streamsize)jpeg.size());
+	}
+	int width = 0, height = 0, channels = 0;
+	bool ok = probeImage(path.string().c_str(), width, height, channels) && width == 640 && height == 480 && channels == 3;
+	std::error_code error;
+	std::filesystem::remove(path, error);
+	if (!ok) {
+		std::cerr << "probeImage() gives " << width << "x" << height << "x" << channels << " behind a large Exif block" << std::endl;
+	}
+	return ok;
+}
+
+// A scaled decode of a restart-marker JPEG must reach a codec that scales,
+// when one is compiled in, rather than the restart decoder ahead of it
+static bool checkScaledRouting() {
+	bool scales = false;
+	for (const ImageCodec* codec : ImageCodecs::GetCodecs()) {
+		scales = scales || (codec->Scales() && codec->Handles(ImageFormat::Jpeg));
+	}
+	const CodecSample sample = { "jpeg_restart_1001x757", ImageFormat::Jpeg, ".jpg", 1001, 757, 3, true };
+	std::vector<unsigned char> file = encodeSample(sample);
+	int minWidth = (sample.width + 3) / 4, minHeight = (sample.height + 3) / 4;
+	ResizeService::Start(3);
+	DecodedImage scaled;
+	bool taken = ImageCodecs::DecodeScaled(file.data(), file.size(), minWidth, minHeight, scaled);
+	ResizeService::Stop();
+	bool ok = taken && scaled.width >= minWidth && scaled.height >= minHeight &&
+		(scales ? scaled.width < sample.width : scaled.width == sample.width);
+	if (!ok) {
+		std::cerr << "ImageCodecs::DecodeScaled() gives " << scaled.width << "x" << scaled.height << " for " << sample.name <<
+			(scales ? " with a codec that scales" : "") << std::endl;
+	}
+	return ok;
+}
+
+VGS_MICRO_CHECK("image_codec/codecs_match_stb_image", checkCodecs);
+VGS_MICRO_CHECK("image_codec/scaled_prefers_scaling_codec", checkScaledRouting);
+VGS_MICRO_CHECK("image_codec/probe_behind_exif", checkProbeBehindExif);
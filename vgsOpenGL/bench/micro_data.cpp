@@ -0,0 +1,77 @@
+// Byte-level kernels: content hashing and the LZ4 RAM tier.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "lz4_block.h"
+#include "micro_bench.h"
+
+namespace
+{
+	// One RGBA thumbnail, the unit every cache tier works on
+	std::vector<unsigned char> thumbnailPixels() {
+		std::vector<unsigned char> pixels(300 * 225 * 4);
+		fillSyntheticImage(pixels.data(), 300, 225, 4, 42);
+		return pixels;
+	}
+
+	uint64_t fnv1a64(const unsigned char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// 8 bytes per step multiply-xorshift mix, the usual fast alternative
+	uint64_t mix64(const unsigned char* data, size_t size) {
+		uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+			hash ^= hash >> 31;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ data[i]) * 0x94D049BB133111EBull;
+		}
+		return hash ^ (hash >> 29);
+	}
+
+	template <uint64_t (*Hash)(const unsigned char*, size_t)>
+	void hashCase(MicroState& state) {
+		std::vector<unsigned char> data = thumbnailPixels();
+		state.SetBytesProcessed(data.size());
+		while (state.KeepRunning()) {
+			uint64_t hash = Hash(data.data(), data.size());
+			benchKeep(&hash);
+		}
+	}
+}
+
+VGS_MICRO_BENCH("hash/fnv1a64_thumb", hashCase<fnv1a64>);
+VGS_MICRO_BENCH("hash/mix64_thumb", hashCase<mix64>);
+
+VGS_MICRO_BENCH("lz4/compress_thumb", [](MicroState& state) {
+	std::vector<unsigned char> data = thumbnailPixels();
+	std::vector<unsigned char> compressed(LZ4Block::CompressBound(data.size()));
+	state.SetBytesProcessed(data.size());
+	while (state.KeepRunning()) {
+		size_t size = LZ4Block::Compress(data.data(), data.size(), compressed.data(), compressed.size());
+		benchKeep(&size);
+	}
+});
+
+VGS_MICRO_BENCH("lz4/decompress_thumb", [](MicroState& state) {
+	std::vector<unsigned char> data = thumbnailPixels();
+	std::vector<unsigned char> compressed(LZ4Block::CompressBound(data.size()));
+	compressed.resize(LZ4Block::Compress(data.data(), data.size(), compressed.data(), compressed.size()));
+	std::vector<unsigned char> restored(data.size());
+	state.SetBytesProcessed(data.size());
+	while (state.KeepRunning()) {
+		benchKeep(LZ4Block::Decompress(compressed.data(), compressed.size(), restored.data(), restored.size()) ? restored.data() : nullptr);
+	}
+});
@@ -0,0 +1,571 @@
+// Image kernels on the thumbnail path: resize (with the PSNR of each quality
+// preset against a single stbir pass), PNG encode, decode per format,
+// the RGB to RGBA expansion every decode does for GL upload and the CPU mip
+// chain built for every loaded thumbnail. Large resizes run on the
+// ResizeService pool at 1, 2 and 4 threads, as do JPEGs with restart
+// markers, which JpegDecoder splits by restart interval. PNGs are decoded
+// with their own channels by stb_image and by PngDecoder.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "folder_scan.h"
+#include "jpeg_decoder.h"
+#include "micro_bench.h"
+#include "png_decoder.h"
+#include "resize_service.h"
+#include "stb_image.h"
+#include "stb_image_resize2.h"
+#include "stb_image_write.h"
+#include "thumbnail.h"
+
+// Only declared inside the stb_image_write implementation (thumbnail.cpp)
+STBIWDEF unsigned char* stbi_write_png_to_mem(const unsigned char* pixels, int strideBytes, int x, int y, int n, int* outLength);
+
+namespace
+{
+	std::vector<unsigned char> syntheticPixels(int width, int height, int channels) {
+		std::vector<unsigned char> pixels((size_t)width * height * channels);
+		fillSyntheticImage(pixels.data(), width, height, channels, (uint32_t)(width * 31 + height * 7 + channels));
+		return pixels;
+	}
+
+	// The same RGBA sRGB downscale generateThumbnails() does
+	MicroFunction resizeCase(int width, int height) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> source = syntheticPixels(width, height, 4);
+			int thumbnailWidth, thumbnailHeight;
+			thumbnailSizeFor(width, height, thumbnailWidth, thumbnailHeight);
+			std::vector<unsigned char> thumbnail((size_t)thumbnailWidth * thumbnailHeight * 4);
+			state.SetBytesProcessed(source.size());
+			while (state.KeepRunning()) {
+				benchKeep(stbir_resize_uint8_srgb(source.data(), width, height, 0,
+					thumbnail.data(), thumbnailWidth, thumbnailHeight, 0, STBIR_RGBA));
+			}
+		};
+	}
+
+	double psnr(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+		double squares = 0.0;
+		for (size_t i = 0; i < a.size(); i++) {
+			double difference = (double)a[i] - b[i];
+			squares += difference * difference;
+		}
+		double mse = std::max(squares / (double)a.size(), 1e-10);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	// generateThumbnails() at one quality preset. Fast and Balanced report
+	// the PSNR of their thumbnail against High, the single stbir pass.
+	MicroFunction resizeQualityCase(int width, int height, int channels, ResizeQuality quality) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> source = syntheticPixels(width, height, channels);
+			int thumbnailWidth, thumbnailHeight;
+			thumbnailSizeFor(width, height, thumbnailWidth, thumbnailHeight);
+			std::vector<unsigned char> thumbnail((size_t)thumbnailWidth * thumbnailHeight * channels);
+			if (quality != ResizeQuality::High) {
+				std::vector<unsigned char> reference(thumbnail.size());
+				resizePixels(source.data(), width, height, channels, reference.data(), thumbnailWidth, thumbnailHeight, ResizeQuality::High);
+				resizePixels(source.data(), width, height, channels, thumbnail.data(), thumbnailWidth, thumbnailHeight, quality);
+				state.SetMetric("psnr_db", psnr(thumbnail, reference));
+			}
+			state.SetBytesProcessed(source.size());
+			while (state.KeepRunning()) {
+				resizePixels(source.data(), width, height, channels, thumbnail.data(), thumbnailWidth, thumbnailHeight, quality);
+				benchKeep(thumbnail.data());
+			}
+		};
+	}
+
+	void registerResizeQualityCases(const char* source, int width, int height, int channels) {
+		for (int quality = 0; quality < (int)ResizeQuality::Count; quality++) {
+			std::string name = std::string("resize/") + source + "_to_thumb_" + resizeQualityName((ResizeQuality)quality);
+			std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+			microCases().push_back({ name, resizeQualityCase(width, height, channels, (ResizeQuality)quality) });
+		}
+	}
+
+	const bool kResizeQualityCasesRegistered = [] {
+		registerResizeQualityCases("6000x4000_rgb", 6000, 4000, 3);
+		registerResizeQualityCases("4000x3000_rgb", 4000, 3000, 3);
+		registerResizeQualityCases("4000x3000_rgba", 4000, 3000, 4);
+		registerResizeQualityCases("1920x1080_rgb", 1920, 1080, 3);
+		return true;
+	}();
+
+	// A viewer-sized resize on the pool with `threads` threads in all, the
+	// calling one included. The first call builds the samplers; the timed
+	// ones reuse them.
+	MicroFunction splitResizeCase(int width, int height, int newWidth, int newHeight, unsigned threads) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> source = syntheticPixels(width, height, 3);
+			std::vector<unsigned char> resized((size_t)newWidth * newHeight * 3);
+			ResizeService::Start(threads - 1);
+			state.SetBytesProcessed(source.size());
+			while (state.KeepRunning()) {
+				ResizeService::Resize(source.data(), width, height, 3, resized.data(), newWidth, newHeight, STBIR_FILTER_DEFAULT);
+				benchKeep(resized.data());
+			}
+			ResizeService::Stop();
+		};
+	}
+
+	// The viewer's first mip level of a large image, halved in bands
+	MicroFunction bandedHalveCase(int width, int height, int channels, unsigned threads) {
+		return [=](MicroState& state) {
+			ThumbnailPixels level;
+			level.width = width;
+			level.height = height;
+			level.channels = channels;
+			level.pixels = syntheticPixels(width, height, channels);
+			ThumbnailPixels half;
+			ResizeService::Start(threads - 1);
+			state.SetBytesProcessed(level.pixels.size());
+			while (state.KeepRunning()) {
+				downsampleHalf(level, half);
+				benchKeep(half.pixels.data());
+			}
+			ResizeService::Stop();
+		};
+	}
+
+	// A colour JPEG as cameras write them, with a restart marker every
+	// `interval` MCUs. stbiw subsamples chroma 2x2 up to quality 90 and not
+	// above.
+	std::vector<unsigned char> restartJpeg(int width, int height, int quality, int interval) {
+		std::vector<unsigned char> pixels = syntheticPixels(width, height, 3);
+		std::vector<unsigned char> plain, restarted;
+		auto append = [](void* context, void* data, int size) {
+			auto* buffer = (std::vector<unsigned char>*)context;
+			buffer->insert(buffer->end(), (unsigned char*)data, (unsigned char*)data + size);
+		};
+		stbi_write_jpg_to_func(append, &plain, width, height, 3, pixels.data(), quality);
+		addJpegRestartMarkers(plain, interval, restarted);
+		return restarted;
+	}
+
+	// `rows` rows from the middle, or the whole image, with `threads`
+	// threads in all; 0 threads is stb_image
+	MicroFunction restartDecodeCase(int width, int height, int rows, unsigned threads) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> jpeg = restartJpeg(width, height, 90, 64);
+			std::vector<unsigned char> decoded((size_t)width * height * 3);
+			JpegDecoder decoder;
+			decoder.Open(jpeg.data(), jpeg.size());
+			state.SetMetric("intervals", (double)decoder.GetIntervalCount());
+			ResizeService::Start(threads > 0 ? threads - 1 : 0);
+			state.SetBytesProcessed((uint64_t)width * rows * 3);
+			while (state.KeepRunning()) {
+				if (threads == 0) {
+					int w, h, c;
+					unsigned char* pixels = stbi_load_from_memory(jpeg.data(), (int)jpeg.size(), &w, &h, &c, 3);
+					benchKeep(pixels);
+					stbi_image_free(pixels);
+				}
+				else {
+					decoder.DecodeRows((height - rows) / 2, rows, decoded.data());
+					benchKeep(decoded.data());
+				}
+			}
+			ResizeService::Stop();
+		};
+	}
+
+	// A PNG as stbiw writes it, with its own choice of filters per row or
+	// `filter` on every row
+	std::vector<unsigned char> encodePng(const std::vector<unsigned char>& pixels, int width, int height, int channels, int filter) {
+		int previousFilter = stbi_write_force_png_filter;
+		stbi_write_force_png_filter = filter;
+		int size = 0;
+		unsigned char* png = stbi_write_png_to_mem(pixels.data(), width * channels, width, height, channels, &size);
+		stbi_write_force_png_filter = previousFilter;
+		std::vector<unsigned char> encoded(png, png + size);
+		std::free(png);
+		return encoded;
+	}
+
+	// Decodes with the file's own channels, as the thumbnail path does
+	MicroFunction nativePngCase(int width, int height, int channels, bool pngDecoder) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> png = encodePng(syntheticPixels(width, height, channels), width, height, channels, -1);
+			PngDecoder decoder;
+			decoder.Open(png.data(), png.size());
+			std::vector<unsigned char> buffer(decoder.GetBufferSize());
+			state.SetBytesProcessed((uint64_t)width * height * channels);
+			while (state.KeepRunning()) {
+				if (pngDecoder) {
+					decoder.Decode(buffer.data());
+					benchKeep(buffer.data());
+				}
+				else {
+					int w, h, c;
+					unsigned char* pixels = stbi_load_from_memory(png.data(), (int)png.size(), &w, &h, &c, 0);
+					benchKeep(pixels);
+					stbi_image_free(pixels);
+				}
+			}
+		};
+	}
+
+	// What the loader threads do after decoding a thumbnail
+	MicroFunction mipChainCase(int width, int height, int channels) {
+		return [=](MicroState& state) {
+			ThumbnailPixels thumbnail;
+			thumbnail.width = width;
+			thumbnail.height = height;
+			thumbnail.channels = channels;
+			std::vector<unsigned char> source = syntheticPixels(width, height, channels);
+			state.SetBytesProcessed(source.size());
+			while (state.KeepRunning()) {
+				thumbnail.pixels = source;
+				thumbnail.levels = 1;
+				buildMipChain(thumbnail);
+				benchKeep(thumbnail.pixels.data());
+			}
+		};
+	}
+
+	MicroFunction decodeCase(const char* extension, int width, int height, int channels) {
+		return [=](MicroState& state) {
+			std::vector<unsigned char> pixels = syntheticPixels(width, height, channels);
+			std::vector<unsigned char> encoded;
+			encodeImage(extension, pixels.data(), width, height, channels, encoded);
+			state.SetBytesProcessed((uint64_t)width * height * 4);
+			while (state.KeepRunning()) {
+				int w, h, c;
+				unsigned char* decoded = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &w, &h, &c, STBI_rgb_alpha);
+				benchKeep(decoded);
+				stbi_image_free(decoded);
+			}
+		};
+	}
+}
+
+VGS_MICRO_BENCH("resize/split_6000x4000_rgb_to_1500x1000_t1", splitResizeCase(6000, 4000, 1500, 1000, 1));
+VGS_MICRO_BENCH("resize/split_6000x4000_rgb_to_1500x1000_t2", splitResizeCase(6000, 4000, 1500, 1000, 2));
+VGS_MICRO_BENCH("resize/split_6000x4000_rgb_to_1500x1000_t4", splitResizeCase(6000, 4000, 1500, 1000, 4));
+VGS_MICRO_BENCH("mip/halve_rgb_6000x4000_t1", bandedHalveCase(6000, 4000, 3, 1));
+VGS_MICRO_BENCH("mip/halve_rgb_6000x4000_t4", bandedHalveCase(6000, 4000, 3, 4));
+VGS_MICRO_BENCH("mip/halve_rgba_6000x4000_t4", bandedHalveCase(6000, 4000, 4, 4));
+
+// Split work must not change a pixel: the pool against one stbir pass, and
+// banded halving against the whole level
+static bool checkSplitResize() {
+	const int width = 3001, height = 2001, newWidth = 701, newHeight = 467;
+	std::vector<unsigned char> source = syntheticPixels(width, height, 4);
+	std::vector<unsigned char> expected((size_t)newWidth * newHeight * 4);
+	std::vector<unsigned char> actual(expected.size());
+	stbir_resize(source.data(), width, height, 0, expected.data(), newWidth, newHeight, 0,
+		STBIR_RGBA, STBIR_TYPE_UINT8_SRGB, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT);
+	ResizeService::Start(3);
+	ResizeServiceStats before = ResizeService::GetStats();
+	bool ok = true;
+	// Twice, so the second run goes through cached samplers
+	for (int run = 0; run < 2 && ok; run++) {
+		std::fill(actual.begin(), actual.end(), 0);
+		ok = ResizeService::Resize(source.data(), width, height, 4, actual.data(), newWidth, newHeight, STBIR_FILTER_DEFAULT) && actual == expected;
+	}
+	ResizeServiceStats stats = ResizeService::GetStats();
+	ResizeService::Stop();
+	if (!ok || stats.splitJobs - before.splitJobs != 2 || stats.samplerReuses == before.samplerReuses) {
+		std::cerr << "split resize differs from a single stbir pass or did not split" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool checkBandedHalve() {
+	for (int channels : { 1, 3, 4 }) {
+		ThumbnailPixels level;
+		level.width = 2601;
+		level.height = 2001;
+		level.channels = channels;
+		level.pixels = syntheticPixels(level.width, level.height, channels);
+		ThumbnailPixels whole, banded;
+		downsampleHalf(level, whole);
+		ResizeService::Start(3);
+		downsampleHalf(level, banded);
+		ResizeService::Stop();
+		if (whole.pixels != banded.pixels || whole.height != banded.height) {
+			std::cerr << "banded halving of " << channels << " channels differs from the whole level" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Fast and Balanced decimate large sources in bands before stbir
+static bool checkBandedDecimate() {
+	const int width = 3001, height = 2003, newWidth = 300, newHeight = 200;
+	for (int channels : { 3, 4 }) {
+		std::vector<unsigned char> source = syntheticPixels(width, height, channels);
+		for (ResizeQuality quality : { ResizeQuality::Fast, ResizeQuality::Balanced }) {
+			std::vector<unsigned char> whole((size_t)newWidth * newHeight * channels);
+			std::vector<unsigned char> banded(whole.size());
+			resizePixels(source.data(), width, height, channels, whole.data(), newWidth, newHeight, quality);
+			ResizeService::Start(3);
+			resizePixels(source.data(), width, height, channels, banded.data(), newWidth, newHeight, quality);
+			ResizeService::Stop();
+			if (whole != banded) {
+				std::cerr << resizeQualityName(quality) << " resize of " << channels << " channels differs when decimated in bands" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// JpegDecoder must give stb_image's pixels: 4:2:0 and 4:4:4 at odd sizes,
+// whole and by row ranges, and the restart markers themselves must not
+// change what stb_image decodes
+static bool checkRestartJpeg() {
+	const int sizes[][2] = { { 1001, 757 }, { 33, 17 }, { 640, 8 }, { 7, 300 } };
+	ResizeService::Start(3);
+	bool ok = true;
+	for (const auto& size : sizes) {
+		int width = size[0], height = size[1];
+		for (int quality : { 90, 95 }) {
+			std::vector<unsigned char> pixels = syntheticPixels(width, height, 3);
+			std::vector<unsigned char> plain;
+			stbi_write_jpg_to_func([](void* context, void* data, int length) {
+				auto* buffer = (std::vector<unsigned char>*)context;
+				buffer->insert(buffer->end(), (unsigned char*)data, (unsigned char*)data + length);
+			}, &plain, width, height, 3, pixels.data(), quality);
+			std::vector<unsigned char> jpeg = restartJpeg(width, height, quality, 3);
+
+			int w, h, c;
+			unsigned char* expected = stbi_load_from_memory(plain.data(), (int)plain.size(), &w, &h, &c, 3);
+			unsigned char* restarted = stbi_load_from_memory(jpeg.data(), (int)jpeg.size(), &w, &h, &c, 3);
+			size_t bytes = (size_t)width * height * 3;
+			std::string what = std::to_string(width) + "x" + std::to_string(height) + " at quality " + std::to_string(quality);
+			if (!expected || !restarted || std::memcmp(expected, restarted, bytes) != 0) {
+				std::cerr << "restart markers change the pixels of " << what << std::endl;
+				ok = false;
+			}
+
+			JpegDecoder decoder;
+			std::vector<unsigned char> decoded(bytes);
+			if (!decoder.Open(jpeg.data(), jpeg.size()) || !decoder.Decode(decoded.data()) ||
+				!expected || std::memcmp(decoded.data(), expected, bytes) != 0) {
+				std::cerr << "JpegDecoder differs from stb_image on " << what << std::endl;
+				ok = false;
+			}
+			for (int firstRow : { 0, 1, height / 3, height - 1 }) {
+				int rows = std::min(height - firstRow, 1 + height / 5);
+				std::vector<unsigned char> band((size_t)width * rows * 3);
+				if (expected && (!decoder.DecodeRows(firstRow, rows, band.data()) ||
+					std::memcmp(band.data(), expected + (size_t)firstRow * width * 3, band.size()) != 0)) {
+					std::cerr << "JpegDecoder rows " << firstRow << " to " << firstRow + rows << " differ on " << what << std::endl;
+					ok = false;
+				}
+			}
+			stbi_image_free(expected);
+			stbi_image_free(restarted);
+		}
+	}
+	ResizeService::Stop();
+	return ok;
+}
+
+// stbiw only writes fixed Huffman codes; this 8x5 RGBA image has filters
+// 0 to 4 on its rows, dynamic codes and two IDAT chunks, as zlib writes them
+static const unsigned char kDynamicPng[] = {
+	0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x05, 0x08, 0x06, 0x00, 0x00, 0x00, 0x78, 0x91, 0xAD,
+	0x55, 0x00, 0x00, 0x00, 0x24, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x65, 0x8C, 0xD1, 0x09, 0x00,
+	0x31, 0x0C, 0x42, 0x35, 0x57, 0xC8, 0x2A, 0xEE, 0x3F, 0x45, 0xC7, 0xBA, 0x6A, 0xA1, 0xE5, 0x38,
+	0x3F, 0x82, 0x49, 0x9E, 0x02, 0x11, 0xE9, 0xD9, 0xC5, 0xBD, 0x41, 0xBD, 0x9D, 0x73, 0xCE, 0xC4,
+	0x07, 0x00, 0x00, 0x00, 0x24, 0x49, 0x44, 0x41, 0x54, 0xFD, 0x4F, 0x05, 0x4C, 0xE6, 0xC3, 0x6C,
+	0x3A, 0x10, 0x4B, 0xBE, 0xCC, 0x0F, 0xFE, 0xC8, 0x47, 0xE1, 0x24, 0x22, 0x37, 0x54, 0x27, 0x34,
+	0x2E, 0x6B, 0x62, 0xD5, 0xB7, 0xF9, 0xDB, 0xF2, 0x02, 0x27, 0x03, 0x04, 0x7B, 0xAB, 0xF7, 0x6D,
+	0x03, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82
+};
+
+static void appendChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, size_t size) {
+	size_t start = png.size();
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		png.push_back((unsigned char)(size >> shift));
+	}
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data, data + size);
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = start + 4; i < png.size(); i++) {
+		crc ^= png[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	crc = ~crc;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		png.push_back((unsigned char)(crc >> shift));
+	}
+}
+
+// Unfiltered rows in stored blocks of at most 1000 bytes, the stream split
+// over two IDAT chunks
+static std::vector<unsigned char> storedPng(const std::vector<unsigned char>& pixels, int width, int height, int channels) {
+	std::vector<unsigned char> rows;
+	for (int y = 0; y < height; y++) {
+		rows.push_back(0);
+		const unsigned char* row = &pixels[(size_t)y * width * channels];
+		rows.insert(rows.end(), row, row + (size_t)width * channels);
+	}
+	std::vector<unsigned char> stream = { 0x78, 0x01 };
+	for (size_t pos = 0; pos < rows.size(); pos += 1000) {
+		size_t length = std::min<size_t>(rows.size() - pos, 1000);
+		stream.push_back(pos + length == rows.size() ? 1 : 0);
+		unsigned char lengths[4] = { (unsigned char)length, (unsigned char)(length >> 8), (unsigned char)~length, (unsigned char)(~length >> 8) };
+		stream.insert(stream.end(), lengths, lengths + 4);
+		stream.insert(stream.end(), rows.begin() + pos, rows.begin() + pos + length);
+	}
+	uint32_t a = 1, b = 0;
+	for (unsigned char byte : rows) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		stream.push_back((unsigned char)((b << 16 | a) >> shift));
+	}
+
+	static const unsigned char colourTypes[5] = { 0, 0, 4, 2, 6 };
+	unsigned char header[13] = {
+		(unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+		(unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+		8, colourTypes[channels], 0, 0, 0
+	};
+	std::vector<unsigned char> png = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	appendChunk(png, "IHDR", header, sizeof(header));
+	size_t half = stream.size() / 2;
+	appendChunk(png, "IDAT", stream.data(), half);
+	appendChunk(png, "IDAT", stream.data() + half, stream.size() - half);
+	appendChunk(png, "IEND", nullptr, 0);
+	return png;
+}
+
+static bool samePngPixels(const std::vector<unsigned char>& png, const std::string& what) {
+	int w, h, c;
+	unsigned char* expected = stbi_load_from_memory(png.data(), (int)png.size(), &w, &h, &c, 0);
+	PngDecoder decoder;
+	std::vector<unsigned char> decoded;
+	bool ok = expected && decoder.Open(png.data(), png.size());
+	if (ok) {
+		decoded.resize(decoder.GetBufferSize());
+		ok = decoder.Decode(decoded.data()) && decoder.GetWidth() == w && decoder.GetHeight() == h &&
+			decoder.GetChannels() == c && std::memcmp(decoded.data(), expected, (size_t)w * h * c) == 0;
+	}
+	stbi_image_free(expected);
+	if (!ok) {
+		std::cerr << "PngDecoder differs from stb_image on " << what << std::endl;
+	}
+	return ok;
+}
+
+// PngDecoder must give stb_image's pixels with every filter, channel count
+// and block type
+static bool checkPngDecoder() {
+	const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 33, 17 }, { 300, 41 } };
+	bool ok = true;
+	for (int channels = 1; channels <= 4; channels++) {
+		for (const auto& size : sizes) {
+			int width = size[0], height = size[1];
+			std::vector<unsigned char> pixels = syntheticPixels(width, height, channels);
+			std::string what = std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels);
+			for (int filter = -1; filter <= 4; filter++) {
+				ok &= samePngPixels(encodePng(pixels, width, height, channels, filter), what + " with filter " + std::to_string(filter));
+			}
+			ok &= samePngPixels(storedPng(pixels, width, height, channels), what + " in stored blocks");
+		}
+	}
+	ok &= samePngPixels(std::vector<unsigned char>(kDynamicPng, kDynamicPng + sizeof(kDynamicPng)), "dynamic Huffman codes");
+	return ok;
+}
+
+VGS_MICRO_CHECK("jpeg_decoder/matches_stb_image", checkRestartJpeg);
+VGS_MICRO_CHECK("png_decoder/matches_stb_image", checkPngDecoder);
+VGS_MICRO_CHECK("resize_service/split_matches_single_pass", checkSplitResize);
+VGS_MICRO_CHECK("resize_service/banded_halve_matches_whole", checkBandedHalve);
+VGS_MICRO_CHECK("resize_service/banded_decimate_matches_whole", checkBandedDecimate);
+
+VGS_MICRO_BENCH("resize/4000x3000_to_thumb", resizeCase(4000, 3000));
+VGS_MICRO_BENCH("resize/1920x1080_to_thumb", resizeCase(1920, 1080));
+VGS_MICRO_BENCH("resize/1080x1920_to_thumb", resizeCase(1080, 1920));
+VGS_MICRO_BENCH("resize/640x480_to_thumb", resizeCase(640, 480));
+
+// Thumbnail write in generateThumbnails()
+VGS_MICRO_BENCH("encode/png_thumb_300x225", [](MicroState& state) {
+	std::vector<unsigned char> pixels = syntheticPixels(kThumbnailMaxWidth, 225, 4);
+	state.SetBytesProcessed(pixels.size());
+	while (state.KeepRunning()) {
+		int size = 0;
+		unsigned char* png = stbi_write_png_to_mem(pixels.data(), kThumbnailMaxWidth * 4, kThumbnailMaxWidth, 225, 4, &size);
+		benchKeep(png);
+		std::free(png);
+	}
+});
+
+// Source decodes on a cold load, all expanded to RGBA like the app
+VGS_MICRO_BENCH("decode/jpeg_1920x1080", decodeCase(".jpg", 1920, 1080, 3));
+VGS_MICRO_BENCH("decode/png_rgb_1920x1080", decodeCase(".png", 1920, 1080, 3));
+// A camera-sized JPEG with restart markers, as the viewer decodes it
+VGS_MICRO_BENCH("decode/jpeg_restart_6000x4000_stbi", restartDecodeCase(6000, 4000, 4000, 0));
+VGS_MICRO_BENCH("decode/jpeg_restart_6000x4000_t1", restartDecodeCase(6000, 4000, 4000, 1));
+VGS_MICRO_BENCH("decode/jpeg_restart_6000x4000_t4", restartDecodeCase(6000, 4000, 4000, 4));
+VGS_MICRO_BENCH("decode/jpeg_restart_6000x4000_rows500_t4", restartDecodeCase(6000, 4000, 500, 4));
+VGS_MICRO_BENCH("decode/png_rgba_1920x1080", decodeCase(".png", 1920, 1080, 4));
+// Native channels, by stb_image and by PngDecoder
+VGS_MICRO_BENCH("decode/png_native_rgb_1920x1080_stbi", nativePngCase(1920, 1080, 3, false));
+VGS_MICRO_BENCH("decode/png_native_rgb_1920x1080_decoder", nativePngCase(1920, 1080, 3, true));
+VGS_MICRO_BENCH("decode/png_native_rgba_1920x1080_stbi", nativePngCase(1920, 1080, 4, false));
+VGS_MICRO_BENCH("decode/png_native_rgba_1920x1080_decoder", nativePngCase(1920, 1080, 4, true));
+VGS_MICRO_BENCH("decode/bmp_1920x1080", decodeCase(".bmp", 1920, 1080, 3));
+// Warm load: thumbnail PNG from the disk cache
+VGS_MICRO_BENCH("decode/png_thumb_300x225", decodeCase(".png", kThumbnailMaxWidth, 225, 4));
+VGS_MICRO_BENCH("decode/png_native_thumb_300x225_stbi", nativePngCase(kThumbnailMaxWidth, 225, 4, false));
+VGS_MICRO_BENCH("decode/png_native_thumb_300x225_decoder", nativePngCase(kThumbnailMaxWidth, 225, 4, true));
+
+// Channel expansion to RGBA, as stbi does for STBI_rgb_alpha
+VGS_MICRO_BENCH("expand/rgb_to_rgba_1920x1080", [](MicroState& state) {
+	const size_t count = 1920 * 1080;
+	std::vector<unsigned char> rgb = syntheticPixels(1920, 1080, 3);
+	std::vector<unsigned char> rgba(count * 4);
+	state.SetBytesProcessed(count * 4);
+	while (state.KeepRunning()) {
+		const unsigned char* in = rgb.data();
+		unsigned char* out = rgba.data();
+		for (size_t i = 0; i < count; i++, in += 3, out += 4) {
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+			out[3] = 255;
+		}
+		benchKeep(rgba.data());
+	}
+});
+
+VGS_MICRO_BENCH("expand/gray_to_rgba_1920x1080", [](MicroState& state) {
+	const size_t count = 1920 * 1080;
+	std::vector<unsigned char> gray = syntheticPixels(1920, 1080, 1);
+	std::vector<unsigned char> rgba(count * 4);
+	state.SetBytesProcessed(count * 4);
+	while (state.KeepRunning()) {
+		const unsigned char* in = gray.data();
+		unsigned char* out = rgba.data();
+		for (size_t i = 0; i < count; i++, out += 4) {
+			out[0] = out[1] = out[2] = in[i];
+			out[3] = 255;
+		}
+		benchKeep(rgba.data());
+	}
+});
+
+VGS_MICRO_BENCH("mip/chain_rgb_300x225", mipChainCase(kThumbnailMaxWidth, 225, 3));
+VGS_MICRO_BENCH("mip/chain_rgba_300x225", mipChainCase(kThumbnailMaxWidth, 225, 4));
+VGS_MICRO_BENCH("mip/chain_rgb_1024x768", mipChainCase(1024, 768, 3));
+VGS_MICRO_BENCH("mip/chain_rgba_1024x768", mipChainCase(1024, 768, 4));
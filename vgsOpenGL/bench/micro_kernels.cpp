@@ -0,0 +1,603 @@
+// The pixel kernels at every instruction set level the CPU supports, and the
+// checks (--verify) that each level matches the scalar reference exactly.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "micro_bench.h"
+#include "pixel_kernels.h"
+
+namespace
+{
+	// Odd sizes around every vector width, so the tails get checked too
+	const size_t kCheckCounts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 129, 255, 1000, 4097, 9001 };
+
+	std::vector<uint8_t> randomBytes(size_t count, uint32_t seed) {
+		std::mt19937 rng(seed);
+		std::vector<uint8_t> bytes(count);
+		for (uint8_t& b : bytes) {
+			b = (uint8_t)rng();
+		}
+		return bytes;
+	}
+
+	// Runs `check` at every level above scalar that the CPU supports
+	template <typename Check>
+	bool forEachSimdLevel(Check check) {
+		bool passed = true;
+		CpuLevel supported = PixelKernels::SupportedLevel();
+		for (int level = (int)CpuLevel::SSE2; level <= (int)supported; level++) {
+			PixelKernels::SetActiveLevel((CpuLevel)level);
+			passed &= check((CpuLevel)level);
+		}
+		PixelKernels::SetActiveLevel(supported);
+		return passed;
+	}
+
+	template <typename T>
+	bool sameOutput(const std::vector<T>& output, const std::vector<T>& expected, const std::string& what) {
+		if (output.size() != expected.size()) {
+			std::cerr << "  " << what << ": " << output.size() << " values, expected " << expected.size() << std::endl;
+			return false;
+		}
+		for (size_t i = 0; i < expected.size(); i++) {
+			if (output[i] != expected[i]) {
+				std::cerr << "  " << what << ": value " << i << " is " << (int)output[i] << ", expected " << (int)expected[i] << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string describe(const char* kernel, CpuLevel level, size_t count) {
+		return std::string(kernel) + " at " + CpuLevelName(level) + " with " + std::to_string(count) + " pixels";
+	}
+
+	// Output of `run` at the scalar level, the reference for the others
+	template <typename Run>
+	auto atScalar(Run run) {
+		CpuLevel active = PixelKernels::SetActiveLevel(CpuLevel::Scalar);
+		auto result = run();
+		PixelKernels::SetActiveLevel(active);
+		return result;
+	}
+
+	bool checkConvert(PixelFormat from, PixelFormat to, const char* name) {
+		return forEachSimdLevel([&](CpuLevel level) {
+			for (size_t count : kCheckCounts) {
+				std::vector<uint8_t> src = randomBytes(count * (int)from, (uint32_t)count);
+				auto convert = [&] {
+					std::vector<uint8_t> out(count * (int)to);
+					PixelKernels::Convert(from, to, src.data(), out.data(), count);
+					return out;
+				};
+				std::vector<uint8_t> expected = atScalar(convert);
+				if (!sameOutput(convert(), expected, describe(name, level, count))) {
+					return false;
+				}
+				if (from == PixelFormat::RGBA && to == PixelFormat::RGB) {
+					std::vector<uint8_t> inPlace = src;
+					PixelKernels::Convert(from, to, inPlace.data(), inPlace.data(), count);
+					inPlace.resize(count * 3);
+					if (!sameOutput(inPlace, expected, describe("rgba_to_rgb in place", level, count))) {
+						return false;
+					}
+				}
+			}
+			return true;
+		});
+	}
+
+	const char* const kFilterNames[5] = { "none", "sub", "up", "average", "paeth" };
+
+	// Each filter with 1 to 4 bytes per pixel, from a separate buffer and in
+	// place, with the output one byte ahead of the input as PngDecoder has it
+	bool checkUnfilter(CpuLevel level) {
+		for (int filter = 0; filter < 5; filter++) {
+			for (int bpp = 1; bpp <= 4; bpp++) {
+				for (size_t count : kCheckCounts) {
+					size_t length = count * bpp;
+					std::vector<uint8_t> raw = randomBytes(length, (uint32_t)(count * 20 + filter * 4 + bpp));
+					std::vector<uint8_t> previous = randomBytes(length, (uint32_t)count + 77);
+					auto unfilter = [&] {
+						std::vector<uint8_t> out(length);
+						PixelKernels::UnfilterPngRow(filter, bpp, raw.data(), previous.data(), out.data(), length);
+						return out;
+					};
+					std::vector<uint8_t> expected = atScalar(unfilter);
+					std::string what = describe(kFilterNames[filter], level, count) + " of " + std::to_string(bpp) + " bytes";
+					if (!sameOutput(unfilter(), expected, what)) {
+						return false;
+					}
+					std::vector<uint8_t> inPlace(length + 1);
+					std::copy(raw.begin(), raw.end(), inPlace.begin() + 1);
+					PixelKernels::UnfilterPngRow(filter, bpp, inPlace.data() + 1, previous.data(), inPlace.data(), length);
+					inPlace.resize(length);
+					if (!sameOutput(inPlace, expected, what + " in place")) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Every colour and alpha pair, as 65536 RGBA pixels
+	std::vector<uint8_t> everyColourAndAlpha() {
+		std::vector<uint8_t> pixels(256 * 256 * 4);
+		for (int alpha = 0; alpha < 256; alpha++) {
+			for (int colour = 0; colour < 256; colour++) {
+				uint8_t* pixel = &pixels[(alpha * 256 + colour) * 4];
+				pixel[0] = (uint8_t)colour;
+				pixel[1] = (uint8_t)(255 - colour);
+				pixel[2] = (uint8_t)(colour * 7);
+				pixel[3] = (uint8_t)alpha;
+			}
+		}
+		return pixels;
+	}
+
+	bool checkBoxHalve(bool linear) {
+		const int widths[] = { 1, 2, 3, 5, 16, 17, 31, 33, 64, 65, 100, 129, 300 };
+		const int heights[] = { 1, 2, 3, 7 };
+		return forEachSimdLevel([&](CpuLevel level) {
+			for (int channels = 1; channels <= 4; channels++) {
+				for (int width : widths) {
+					for (int height : heights) {
+						std::vector<uint8_t> src = randomBytes((size_t)width * height * channels, (uint32_t)(width * 131 + height));
+						auto halve = [&] {
+							std::vector<uint8_t> out((size_t)std::max(1, width / 2) * std::max(1, height / 2) * channels);
+							if (linear) {
+								PixelKernels::BoxHalveLinear(PixelFormatOf(channels), src.data(), width, height, out.data());
+							}
+							else {
+								PixelKernels::BoxHalve(PixelFormatOf(channels), src.data(), width, height, out.data());
+							}
+							return out;
+						};
+						std::string what = describe(linear ? "box_halve_linear" : "box_halve", level, (size_t)width * height) +
+							" (" + std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels) + ")";
+						if (!sameOutput(halve(), atScalar(halve), what)) {
+							return false;
+						}
+					}
+				}
+			}
+			return true;
+		});
+	}
+
+	bool checkBoxDecimate(bool linear) {
+		const int widths[] = { 1, 3, 8, 17, 33, 64, 100, 129, 300 };
+		const int heights[] = { 1, 4, 9 };
+		const int factors[] = { 1, 2, 4, 8, 32 };
+		return forEachSimdLevel([&](CpuLevel level) {
+			for (int channels = 1; channels <= 4; channels++) {
+				for (int width : widths) {
+					for (int height : heights) {
+						for (int factor : factors) {
+							std::vector<uint8_t> src = randomBytes((size_t)width * height * channels, (uint32_t)(width * 131 + height * 7 + factor));
+							auto decimate = [&] {
+								std::vector<uint8_t> out((size_t)std::max(1, width / factor) * std::max(1, height / factor) * channels);
+								if (linear) {
+									PixelKernels::BoxDecimateLinear(PixelFormatOf(channels), src.data(), width, height, factor, out.data());
+								}
+								else {
+									PixelKernels::BoxDecimate(PixelFormatOf(channels), src.data(), width, height, factor, out.data());
+								}
+								return out;
+							};
+							std::string what = describe(linear ? "box_decimate_linear" : "box_decimate", level, (size_t)width * height) +
+								" (" + std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels) +
+								" by " + std::to_string(factor) + ")";
+							if (!sameOutput(decimate(), atScalar(decimate), what)) {
+								return false;
+							}
+						}
+					}
+				}
+			}
+			return true;
+		});
+	}
+
+	// Blocks of dequantised coefficients as JPEG files have them: mostly
+	// low frequencies, some blocks with only a DC value, some full of noise
+	std::vector<int16_t> randomCoefficientBlocks(size_t blocks, uint32_t seed) {
+		std::mt19937 rng(seed);
+		std::vector<int16_t> coefficients(blocks * 64);
+		for (size_t block = 0; block < blocks; block++) {
+			int16_t* c = &coefficients[block * 64];
+			int kind = (int)(rng() % 3);
+			for (int i = 0; i < 64; i++) {
+				int range = kind == 0 ? (i == 0 ? 4096 : 0) : kind == 1 ? 4096 >> std::min(i / 4, 12) : 4096;
+				c[i] = range ? (int16_t)((int)(rng() % (2 * range)) - range) : 0;
+			}
+		}
+		return coefficients;
+	}
+
+	// A kernel timed at one level
+	template <typename Setup>
+	void addCase(const std::string& name, CpuLevel level, Setup setup) {
+		microCases().push_back({ name + "_" + CpuLevelName(level), [=](MicroState& state) {
+			PixelKernels::SetActiveLevel(level);
+			setup(state);
+			PixelKernels::SetActiveLevel(PixelKernels::SupportedLevel());
+		} });
+	}
+
+	bool registerKernelCases() {
+		const int width = 1920, height = 1080;
+		const size_t count = (size_t)width * height;
+		for (int l = 0; l <= (int)PixelKernels::SupportedLevel(); l++) {
+			CpuLevel level = (CpuLevel)l;
+			auto convertCase = [=](PixelFormat from, PixelFormat to) {
+				return [=](MicroState& state) {
+					std::vector<uint8_t> src(count * (int)from);
+					fillSyntheticImage(src.data(), width, height, (int)from, 7);
+					std::vector<uint8_t> dst(count * (int)to);
+					state.SetBytesProcessed(dst.size());
+					while (state.KeepRunning()) {
+						PixelKernels::Convert(from, to, src.data(), dst.data(), count);
+						benchKeep(dst.data());
+					}
+				};
+			};
+			addCase("kernels/grey_to_rgba_1920x1080", level, convertCase(PixelFormat::Grey, PixelFormat::RGBA));
+			addCase("kernels/rgb_to_rgba_1920x1080", level, convertCase(PixelFormat::RGB, PixelFormat::RGBA));
+			addCase("kernels/rgba_to_rgb_1920x1080", level, convertCase(PixelFormat::RGBA, PixelFormat::RGB));
+
+			addCase("kernels/is_opaque_1920x1080", level, [=](MicroState& state) {
+				std::vector<uint8_t> rgba(count * 4, 255);
+				state.SetBytesProcessed(rgba.size());
+				while (state.KeepRunning()) {
+					bool opaque = PixelKernels::IsOpaque(rgba.data(), count);
+					benchKeep(&opaque);
+				}
+			});
+
+			// Premultiplies a copy, as the RGBA mip chain does
+			addCase("kernels/premultiply_1920x1080", level, [=](MicroState& state) {
+				std::vector<uint8_t> src(count * 4);
+				fillSyntheticImage(src.data(), width, height, 4, 11);
+				std::vector<uint8_t> rgba(src.size());
+				state.SetBytesProcessed(rgba.size());
+				while (state.KeepRunning()) {
+					rgba = src;
+					PixelKernels::Premultiply(rgba.data(), count);
+					benchKeep(rgba.data());
+				}
+			});
+			addCase("kernels/unpremultiply_1920x1080", level, [=](MicroState& state) {
+				std::vector<uint8_t> src(count * 4);
+				fillSyntheticImage(src.data(), width, height, 4, 11);
+				PixelKernels::Premultiply(src.data(), count);
+				std::vector<uint8_t> rgba(src.size());
+				state.SetBytesProcessed(rgba.size());
+				while (state.KeepRunning()) {
+					rgba = src;
+					PixelKernels::Unpremultiply(rgba.data(), count);
+					benchKeep(rgba.data());
+				}
+			});
+
+			addCase("kernels/srgb_to_linear_1920x1080", level, [=](MicroState& state) {
+				std::vector<uint8_t> src(count * 3);
+				fillSyntheticImage(src.data(), width, height, 3, 13);
+				std::vector<uint16_t> linear(src.size());
+				state.SetBytesProcessed(src.size());
+				while (state.KeepRunning()) {
+					PixelKernels::SrgbToLinear(src.data(), linear.data(), src.size());
+					benchKeep(linear.data());
+				}
+			});
+
+			auto boxCase = [=](int channels, bool linear) {
+				return [=](MicroState& state) {
+					std::vector<uint8_t> src(count * channels);
+					fillSyntheticImage(src.data(), width, height, channels, 17);
+					std::vector<uint8_t> dst(count * channels / 4);
+					state.SetBytesProcessed(src.size());
+					while (state.KeepRunning()) {
+						if (linear) {
+							PixelKernels::BoxHalveLinear(PixelFormatOf(channels), src.data(), width, height, dst.data());
+						}
+						else {
+							PixelKernels::BoxHalve(PixelFormatOf(channels), src.data(), width, height, dst.data());
+						}
+						benchKeep(dst.data());
+					}
+				};
+			};
+			addCase("kernels/box_rgba_1920x1080", level, boxCase(4, false));
+			addCase("kernels/box_grey_1920x1080", level, boxCase(1, false));
+			addCase("kernels/box_linear_rgb_1920x1080", level, boxCase(3, true));
+
+			auto decimateCase = [=](int channels, int factor, bool linear) {
+				return [=](MicroState& state) {
+					std::vector<uint8_t> src(count * channels);
+					fillSyntheticImage(src.data(), width, height, channels, 19);
+					std::vector<uint8_t> dst((size_t)(width / factor) * (height / factor) * channels);
+					state.SetBytesProcessed(src.size());
+					while (state.KeepRunning()) {
+						if (linear) {
+							PixelKernels::BoxDecimateLinear(PixelFormatOf(channels), src.data(), width, height, factor, dst.data());
+						}
+						else {
+							PixelKernels::BoxDecimate(PixelFormatOf(channels), src.data(), width, height, factor, dst.data());
+						}
+						benchKeep(dst.data());
+					}
+				};
+			};
+			addCase("kernels/box_decimate8_rgb_1920x1080", level, decimateCase(3, 8, false));
+			addCase("kernels/box_decimate8_linear_rgb_1920x1080", level, decimateCase(3, 8, true));
+
+			// The blocks of one 8-bit plane
+			addCase("kernels/idct_1920x1080", level, [=](MicroState& state) {
+				const size_t blocks = count / 64;
+				std::vector<int16_t> coefficients = randomCoefficientBlocks(blocks, 23);
+				std::vector<uint8_t> plane(count);
+				state.SetBytesProcessed(plane.size());
+				while (state.KeepRunning()) {
+					for (size_t block = 0; block < blocks; block++) {
+						size_t x = block % (width / 8) * 8, y = block / (width / 8) * 8;
+						PixelKernels::IdctBlock(&coefficients[block * 64], &plane[y * width + x], width);
+					}
+					benchKeep(plane.data());
+				}
+			});
+			addCase("kernels/ycbcr_to_rgb_1920x1080", level, [=](MicroState& state) {
+				std::vector<uint8_t> planes(count * 3);
+				fillSyntheticImage(planes.data(), width, height, 3, 29);
+				std::vector<uint8_t> rgb(count * 3);
+				state.SetBytesProcessed(rgb.size());
+				while (state.KeepRunning()) {
+					PixelKernels::YCbCrToRgb(planes.data(), planes.data() + count, planes.data() + 2 * count, rgb.data(), count);
+					benchKeep(rgb.data());
+				}
+			});
+
+			// Rows of an RGB or RGBA image, each unfiltered against the one above
+			auto unfilterCase = [=](int filter, int bpp) {
+				return [=](MicroState& state) {
+					std::vector<uint8_t> raw(count * bpp);
+					fillSyntheticImage(raw.data(), width, height, bpp, 31);
+					std::vector<uint8_t> out(raw.size());
+					size_t stride = (size_t)width * bpp;
+					std::vector<uint8_t> zeros(stride, 0);
+					state.SetBytesProcessed(out.size());
+					while (state.KeepRunning()) {
+						for (int y = 0; y < height; y++) {
+							const uint8_t* previous = y > 0 ? &out[(y - 1) * stride] : zeros.data();
+							PixelKernels::UnfilterPngRow(filter, bpp, &raw[y * stride], previous, &out[y * stride], stride);
+						}
+						benchKeep(out.data());
+					}
+				};
+			};
+			addCase("kernels/png_sub_rgb_1920x1080", level, unfilterCase(1, 3));
+			addCase("kernels/png_up_rgb_1920x1080", level, unfilterCase(2, 3));
+			addCase("kernels/png_average_rgb_1920x1080", level, unfilterCase(3, 3));
+			addCase("kernels/png_paeth_rgb_1920x1080", level, unfilterCase(4, 3));
+			addCase("kernels/png_paeth_rgba_1920x1080", level, unfilterCase(4, 4));
+			addCase("kernels/png_sub_rgba_1920x1080", level, unfilterCase(1, 4));
+			addCase("kernels/png_average_rgba_1920x1080", level, unfilterCase(3, 4));
+		}
+		return true;
+	}
+
+	const bool kKernelCasesRegistered = registerKernelCases();
+}
+
+VGS_MICRO_CHECK("kernels/convert", [] {
+	return checkConvert(PixelFormat::Grey, PixelFormat::RGBA, "grey_to_rgba") &
+		checkConvert(PixelFormat::GreyAlpha, PixelFormat::RGBA, "grey_alpha_to_rgba") &
+		checkConvert(PixelFormat::RGB, PixelFormat::RGBA, "rgb_to_rgba") &
+		checkConvert(PixelFormat::RGBA, PixelFormat::RGB, "rgba_to_rgb");
+});
+
+VGS_MICRO_CHECK("kernels/is_opaque", [] {
+	return forEachSimdLevel([](CpuLevel level) {
+		for (size_t count : kCheckCounts) {
+			std::vector<uint8_t> rgba = randomBytes(count * 4, (uint32_t)count);
+			for (size_t i = 0; i < count; i++) {
+				rgba[i * 4 + 3] = 255;
+			}
+			if (!PixelKernels::IsOpaque(rgba.data(), count)) {
+				std::cerr << "  " << describe("is_opaque", level, count) << ": opaque pixels reported transparent" << std::endl;
+				return false;
+			}
+			// One translucent pixel anywhere, the last one included
+			for (size_t i = 0; i < count; i += std::max<size_t>(1, count / 7)) {
+				for (size_t pixel : { i, count - 1 }) {
+					rgba[pixel * 4 + 3] = 254;
+					bool opaque = PixelKernels::IsOpaque(rgba.data(), count);
+					rgba[pixel * 4 + 3] = 255;
+					if (opaque) {
+						std::cerr << "  " << describe("is_opaque", level, count) << ": missed alpha 254 at pixel " << pixel << std::endl;
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	});
+});
+
+VGS_MICRO_CHECK("kernels/premultiply", [] {
+	// The reference is c * a / 255 rounded
+	std::vector<uint8_t> pixels = everyColourAndAlpha();
+	std::vector<uint8_t> expected = pixels;
+	for (size_t i = 0; i < expected.size(); i += 4) {
+		for (int c = 0; c < 3; c++) {
+			expected[i + c] = (uint8_t)std::lround(pixels[i + c] * pixels[i + 3] / 255.0);
+		}
+	}
+	CpuLevel active = PixelKernels::SetActiveLevel(CpuLevel::Scalar);
+	std::vector<uint8_t> scalar = pixels;
+	PixelKernels::Premultiply(scalar.data(), scalar.size() / 4);
+	PixelKernels::SetActiveLevel(active);
+	bool passed = sameOutput(scalar, expected, "premultiply at scalar");
+	return passed && forEachSimdLevel([&](CpuLevel level) {
+		for (size_t count : kCheckCounts) {
+			size_t size = std::min(pixels.size(), count * 4);
+			std::vector<uint8_t> out(pixels.begin(), pixels.begin() + size);
+			PixelKernels::Premultiply(out.data(), out.size() / 4);
+			std::vector<uint8_t> expected(scalar.begin(), scalar.begin() + size);
+			if (!sameOutput(out, expected, describe("premultiply", level, out.size() / 4))) {
+				return false;
+			}
+		}
+		std::vector<uint8_t> out = pixels;
+		PixelKernels::Premultiply(out.data(), out.size() / 4);
+		return sameOutput(out, scalar, describe("premultiply", level, out.size() / 4));
+	});
+});
+
+VGS_MICRO_CHECK("kernels/unpremultiply", [] {
+	std::vector<uint8_t> pixels = everyColourAndAlpha();
+	std::vector<uint8_t> scalar = atScalar([&] {
+		std::vector<uint8_t> out = pixels;
+		PixelKernels::Unpremultiply(out.data(), out.size() / 4);
+		return out;
+	});
+	// Premultiplying what Unpremultiply() made of premultiplied colour gives
+	// that colour back, so a chain of premultiplied averages loses nothing
+	std::vector<uint8_t> premultiplied = pixels;
+	PixelKernels::Premultiply(premultiplied.data(), premultiplied.size() / 4);
+	std::vector<uint8_t> roundTrip = premultiplied;
+	PixelKernels::Unpremultiply(roundTrip.data(), roundTrip.size() / 4);
+	PixelKernels::Premultiply(roundTrip.data(), roundTrip.size() / 4);
+	bool passed = sameOutput(roundTrip, premultiplied, "premultiply after unpremultiply");
+	return passed && forEachSimdLevel([&](CpuLevel level) {
+		for (size_t count : kCheckCounts) {
+			size_t size = std::min(pixels.size(), count * 4);
+			std::vector<uint8_t> out(pixels.begin(), pixels.begin() + size);
+			PixelKernels::Unpremultiply(out.data(), out.size() / 4);
+			std::vector<uint8_t> expected(scalar.begin(), scalar.begin() + size);
+			if (!sameOutput(out, expected, describe("unpremultiply", level, out.size() / 4))) {
+				return false;
+			}
+		}
+		std::vector<uint8_t> out = pixels;
+		PixelKernels::Unpremultiply(out.data(), out.size() / 4);
+		return sameOutput(out, scalar, describe("unpremultiply", level, out.size() / 4));
+	});
+});
+
+VGS_MICRO_CHECK("kernels/srgb", [] {
+	std::vector<uint8_t> bytes(256);
+	for (int i = 0; i < 256; i++) {
+		bytes[i] = (uint8_t)i;
+	}
+	std::vector<uint16_t> everyLinear(4200);
+	for (size_t i = 0; i < everyLinear.size(); i++) {
+		everyLinear[i] = (uint16_t)i; // Past 4095 too, which is clamped
+	}
+	auto toSrgb = [&] {
+		std::vector<uint8_t> out(everyLinear.size());
+		PixelKernels::LinearToSrgb(everyLinear.data(), out.data(), out.size());
+		return out;
+	};
+	std::vector<uint8_t> scalar = atScalar(toSrgb);
+	bool passed = true;
+	for (int l = 0; l <= (int)PixelKernels::SupportedLevel(); l++) {
+		CpuLevel level = PixelKernels::SetActiveLevel((CpuLevel)l);
+		std::vector<uint16_t> linear(256);
+		std::vector<uint8_t> back(256);
+		PixelKernels::SrgbToLinear(bytes.data(), linear.data(), bytes.size());
+		PixelKernels::LinearToSrgb(linear.data(), back.data(), linear.size());
+		passed &= sameOutput(back, bytes, describe("sRGB round trip", level, 256));
+		passed &= sameOutput(toSrgb(), scalar, describe("linear_to_srgb", level, everyLinear.size()));
+	}
+	PixelKernels::SetActiveLevel(PixelKernels::SupportedLevel());
+	return passed;
+});
+
+VGS_MICRO_CHECK("kernels/box_halve", [] {
+	return checkBoxHalve(false);
+});
+
+VGS_MICRO_CHECK("kernels/box_halve_linear", [] {
+	// A flat image stays the same colour in linear light
+	bool passed = true;
+	for (int value = 0; value < 256; value++) {
+		std::vector<uint8_t> flat(6 * 4 * 3, (uint8_t)value);
+		std::vector<uint8_t> out(3 * 2 * 3);
+		PixelKernels::BoxHalveLinear(PixelFormat::RGB, flat.data(), 6, 4, out.data());
+		passed &= sameOutput(out, std::vector<uint8_t>(out.size(), (uint8_t)value), "box_halve_linear of a flat image");
+	}
+	return passed && checkBoxHalve(true);
+});
+
+VGS_MICRO_CHECK("kernels/box_decimate", [] {
+	// By 2 it rounds as BoxHalve() does, which averages RGBA as it is
+	bool passed = true;
+	for (int channels = 1; channels <= 3; channels++) {
+		std::vector<uint8_t> src = randomBytes((size_t)37 * 11 * channels, (uint32_t)channels);
+		std::vector<uint8_t> halved((size_t)18 * 5 * channels);
+		std::vector<uint8_t> decimated(halved.size());
+		PixelKernels::BoxHalve(PixelFormatOf(channels), src.data(), 37, 11, halved.data());
+		PixelKernels::BoxDecimate(PixelFormatOf(channels), src.data(), 37, 11, 2, decimated.data());
+		passed &= sameOutput(decimated, halved, "box_decimate by 2 against box_halve");
+	}
+	return passed && checkBoxDecimate(false);
+});
+
+VGS_MICRO_CHECK("kernels/box_decimate_linear", [] {
+	bool passed = true;
+	for (int value = 0; value < 256; value++) {
+		std::vector<uint8_t> flat(16 * 8 * 3, (uint8_t)value);
+		std::vector<uint8_t> out(2 * 1 * 3);
+		PixelKernels::BoxDecimateLinear(PixelFormat::RGB, flat.data(), 16, 8, 8, out.data());
+		passed &= sameOutput(out, std::vector<uint8_t>(out.size(), (uint8_t)value), "box_decimate_linear of a flat image");
+	}
+	return passed && checkBoxDecimate(true);
+});
+
+VGS_MICRO_CHECK("kernels/idct", [] {
+	const size_t blocks = 3000;
+	std::vector<int16_t> coefficients = randomCoefficientBlocks(blocks, 31);
+	// Every block into an 8-wide column with a gap, so a store past the
+	// end of a row would show
+	const size_t stride = 11;
+	auto transform = [&] {
+		std::vector<uint8_t> out(blocks * 8 * stride, 0xCD);
+		for (size_t block = 0; block < blocks; block++) {
+			PixelKernels::IdctBlock(&coefficients[block * 64], &out[block * 8 * stride], stride);
+		}
+		return out;
+	};
+	std::vector<uint8_t> expected = atScalar(transform);
+	return forEachSimdLevel([&](CpuLevel level) {
+		return sameOutput(transform(), expected, describe("idct", level, blocks * 64));
+	});
+});
+
+VGS_MICRO_CHECK("kernels/ycbcr_to_rgb", [] {
+	return forEachSimdLevel([&](CpuLevel level) {
+		for (size_t count : kCheckCounts) {
+			std::vector<uint8_t> planes = randomBytes(count * 3, (uint32_t)count + 5);
+			auto convert = [&] {
+				std::vector<uint8_t> rgb(count * 3);
+				PixelKernels::YCbCrToRgb(planes.data(), planes.data() + count, planes.data() + 2 * count, rgb.data(), count);
+				return rgb;
+			};
+			if (!sameOutput(convert(), atScalar(convert), describe("ycbcr_to_rgb", level, count))) {
+				return false;
+			}
+		}
+		return true;
+	});
+});
+
+VGS_MICRO_CHECK("kernels/png_unfilter", [] {
+	return forEachSimdLevel(checkUnfilter);
+});
@@ -0,0 +1,206 @@
+// Grid layout for catalogues of different sizes.
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "grid_layout.h"
+#include "micro_bench.h"
+#include "trace.h"
+
+namespace
+{
+	// Layout arrays of a catalogue of `count` thumbnails
+	struct LayoutData {
+		explicit LayoutData(size_t count) : widths(count, 300), heights(count), states(count, ThumbnailState::Resident),
+			x(count), y(count), width(count), height(count) {
+			// Thumbnail heights of a typical mix of landscape and portrait photos
+			for (size_t i = 0; i < count; i++) {
+				heights[i] = (uint16_t)(150 + (i * 2654435761u >> 7) % 400);
+			}
+		}
+
+		GridItems Items(size_t count) {
+			GridItems items;
+			items.count = count;
+			items.thumbnailWidth = widths.data();
+			items.thumbnailHeight = heights.data();
+			items.states = states.data();
+			items.x = x.data();
+			items.y = y.data();
+			items.width = width.data();
+			items.height = height.data();
+			return items;
+		}
+
+		std::vector<uint16_t> widths, heights;
+		std::vector<ThumbnailState> states;
+		std::vector<float> x, y, width, height;
+	};
+
+	// Full relayout, as after a window resize: alternates between two widths
+	MicroFunction relayoutCase(GridLayoutKind kind, size_t count) {
+		return [=](MicroState& state) {
+			LayoutData data(count);
+			GridItems items = data.Items(count);
+			std::unique_ptr<GridLayout> layout = CreateGridLayout(kind);
+			bool wide = false;
+			state.SetItemsProcessed(count);
+			while (state.KeepRunning()) {
+				wide = !wide;
+				layout->Relayout(items, wide ? 1906.0f : 1880.0f);
+				float contentHeight = layout->ContentHeight();
+				benchKeep(&contentHeight);
+			}
+		};
+	}
+
+	// A folder streaming in `chunk` images at a time, with the spatial index
+	// kept up to date after every chunk
+	MicroFunction streamCase(GridLayoutKind kind, size_t count, size_t chunk) {
+		return [=](MicroState& state) {
+			LayoutData data(count);
+			std::unique_ptr<GridLayout> layout = CreateGridLayout(kind);
+			GridSpatialIndex index;
+			state.SetItemsProcessed(count);
+			while (state.KeepRunning()) {
+				layout->Relayout(data.Items(0), 1906.0f);
+				index.Build(data.Items(0), layout->ContentHeight());
+				for (size_t loaded = chunk; loaded <= count; loaded += chunk) {
+					GridItems items = data.Items(loaded);
+					layout->Extend(items);
+					index.Update(items, layout->FirstChanged(), layout->ChangedTop(), layout->ContentHeight());
+				}
+				benchKeep(&index);
+			}
+		};
+	}
+
+	// A width change as the app spreads it over frames: the first batch laid
+	// out and indexed from scratch, then a batch more per frame. Reports the
+	// frames it takes, the median frame and the slowest, cold ones included.
+	MicroFunction resizeCase(GridLayoutKind kind, size_t count) {
+		return [=](MicroState& state) {
+			LayoutData data(count);
+			std::unique_ptr<GridLayout> layout = CreateGridLayout(kind);
+			GridSpatialIndex index;
+			bool wide = false;
+			int frames = 0;
+			std::vector<uint64_t> frameNs;
+			state.SetItemsProcessed(count);
+			while (state.KeepRunning()) {
+				wide = !wide;
+				uint64_t start = Trace::Now();
+				GridItems batch = data.Items(std::min(count, kGridLayoutItemsPerFrame));
+				layout->Relayout(batch, wide ? 1906.0f : 1880.0f);
+				index.Build(batch, layout->ContentHeight());
+				frames = 1;
+				frameNs.push_back(Trace::Now() - start);
+				while (layout->Count() < count) {
+					start = Trace::Now();
+					batch = data.Items(std::min(count, layout->Count() + kGridLayoutItemsPerFrame));
+					layout->Extend(batch);
+					index.Update(batch, layout->FirstChanged(), layout->ChangedTop(), layout->ContentHeight());
+					frames++;
+					frameNs.push_back(Trace::Now() - start);
+				}
+				benchKeep(&index);
+			}
+			std::sort(frameNs.begin(), frameNs.end());
+			state.SetMetric("frames", frames);
+			state.SetMetric("median_frame_ms", frameNs[frameNs.size() / 2] * 1e-6);
+			state.SetMetric("slowest_frame_ms", frameNs.back() * 1e-6);
+		};
+	}
+
+	MicroFunction indexBuildCase(size_t count) {
+		return [=](MicroState& state) {
+			LayoutData data(count);
+			GridItems items = data.Items(count);
+			std::unique_ptr<GridLayout> layout = CreateGridLayout(GridLayoutKind::Masonry);
+			layout->Relayout(items, 1906.0f);
+			GridSpatialIndex index;
+			state.SetItemsProcessed(count);
+			while (state.KeepRunning()) {
+				index.Build(items, layout->ContentHeight());
+				benchKeep(&index);
+			}
+		};
+	}
+}
+
+VGS_MICRO_BENCH("layout/masonry_1k", relayoutCase(GridLayoutKind::Masonry, 1000));
+VGS_MICRO_BENCH("layout/masonry_100k", relayoutCase(GridLayoutKind::Masonry, 100000));
+VGS_MICRO_BENCH("layout/masonry_1m", relayoutCase(GridLayoutKind::Masonry, 1000000));
+VGS_MICRO_BENCH("layout/justified_1k", relayoutCase(GridLayoutKind::JustifiedRows, 1000));
+VGS_MICRO_BENCH("layout/justified_100k", relayoutCase(GridLayoutKind::JustifiedRows, 100000));
+VGS_MICRO_BENCH("layout/justified_1m", relayoutCase(GridLayoutKind::JustifiedRows, 1000000));
+VGS_MICRO_BENCH("layout/uniform_1k", relayoutCase(GridLayoutKind::UniformGrid, 1000));
+VGS_MICRO_BENCH("layout/uniform_100k", relayoutCase(GridLayoutKind::UniformGrid, 100000));
+VGS_MICRO_BENCH("layout/uniform_1m", relayoutCase(GridLayoutKind::UniformGrid, 1000000));
+VGS_MICRO_BENCH("layout/masonry_stream_1m_by_1k", streamCase(GridLayoutKind::Masonry, 1000000, 1000));
+VGS_MICRO_BENCH("layout/justified_stream_1m_by_1k", streamCase(GridLayoutKind::JustifiedRows, 1000000, 1000));
+VGS_MICRO_BENCH("layout/uniform_stream_1m_by_1k", streamCase(GridLayoutKind::UniformGrid, 1000000, 1000));
+VGS_MICRO_BENCH("layout/index_build_1m", indexBuildCase(1000000));
+VGS_MICRO_BENCH("layout/masonry_resize_by_frames_1m", resizeCase(GridLayoutKind::Masonry, 1000000));
+VGS_MICRO_BENCH("layout/justified_resize_by_frames_1m", resizeCase(GridLayoutKind::JustifiedRows, 1000000));
+VGS_MICRO_BENCH("layout/uniform_resize_by_frames_1m", resizeCase(GridLayoutKind::UniformGrid, 1000000));
+
+// Laying out a batch at a time, as the app does after a width change, must
+// place every tile where a single Relayout() does, and the index updated
+// along the way must find the same tiles as one built at the end
+static bool checkLayoutByBatches() {
+	const size_t count = 1000;
+	const size_t batchSize = 77;
+	bool ok = true;
+	for (int kind = 0; kind < (int)GridLayoutKind::Count; kind++) {
+		LayoutData whole(count), batched(count);
+		for (size_t i = 0; i < count; i += 13) {
+			whole.states[i] = batched.states[i] = ThumbnailState::Failed;
+		}
+		std::unique_ptr<GridLayout> wholeLayout = CreateGridLayout((GridLayoutKind)kind);
+		std::unique_ptr<GridLayout> batchedLayout = CreateGridLayout((GridLayoutKind)kind);
+		wholeLayout->Relayout(whole.Items(count), 1906.0f);
+		GridSpatialIndex wholeIndex, batchedIndex;
+		wholeIndex.Build(whole.Items(count), wholeLayout->ContentHeight());
+
+		batchedLayout->Relayout(batched.Items(batchSize), 1906.0f);
+		batchedIndex.Build(batched.Items(batchSize), batchedLayout->ContentHeight());
+		while (batchedLayout->Count() < count) {
+			GridItems batch = batched.Items(std::min(count, batchedLayout->Count() + batchSize));
+			batchedLayout->Extend(batch);
+			batchedIndex.Update(batch, batchedLayout->FirstChanged(), batchedLayout->ChangedTop(), batchedLayout->ContentHeight());
+		}
+
+		const char* name = GridLayoutName((GridLayoutKind)kind);
+		for (size_t i = 0; i < count; i++) {
+			if (whole.states[i] != ThumbnailState::Failed && (whole.x[i] != batched.x[i] || whole.y[i] != batched.y[i] ||
+				whole.width[i] != batched.width[i] || whole.height[i] != batched.height[i])) {
+				std::cerr << name << " places tile " << i << " elsewhere when laid out in batches" << std::endl;
+				ok = false;
+				break;
+			}
+		}
+		if (wholeLayout->ContentHeight() != batchedLayout->ContentHeight()) {
+			std::cerr << name << " ends at another height when laid out in batches" << std::endl;
+			ok = false;
+		}
+		std::vector<uint32_t> expected, found;
+		for (float top = 0.0f; top < wholeLayout->ContentHeight(); top += 700.0f) {
+			expected.clear();
+			found.clear();
+			wholeIndex.Query(whole.Items(count), top, top + 1000.0f, expected);
+			batchedIndex.Query(batched.Items(count), top, top + 1000.0f, found);
+			std::sort(expected.begin(), expected.end());
+			std::sort(found.begin(), found.end());
+			if (expected != found) {
+				std::cerr << name << " index finds other tiles in [" << top << ", " << top + 1000.0f << ") when updated in batches" << std::endl;
+				ok = false;
+				break;
+			}
+		}
+	}
+	return ok;
+}
+
+VGS_MICRO_CHECK("grid_layout/batches_match_relayout", checkLayoutByBatches);
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <iostream>
+
+#include "folder_scan.h"
+#include "image_codec.h"
+#include "perf_stats.h"
+
+bool isSupportedImageFile(const std::filesystem::path& path) {
+	return ImageCodecs::IsSupportedExtension(path.extension().string());
+}
+
+std::vector<std::string> scanImageFolder(const std::string& folder) {
+	VGS_PERF_SCOPE(PerfStage::Scan);
+	std::vector<std::string> files;
+
+	std::error_code error;
+	std::filesystem::recursive_directory_iterator it(folder, std::filesystem::directory_options::skip_permission_denied, error);
+	if (error) {
+		std::cerr << "Error: Could not scan " << folder << ": " << error.message() << std::endl;
+		return files;
+	}
+
+	for (const auto& entry : it) {
+		// Check if the entry is a regular file
+		if (entry.is_regular_file(error) && isSupportedImageFile(entry.path())) {
+			files.push_back(entry.path().string());
+		}
+	}
+	return files;
+}
+
+bool probeImage(const char* path, int& width, int& height, int& channels) {
+	VGS_PERF_SCOPE(PerfStage::Probe);
+	ImageInfo info;
+	if (!ImageCodecs::InfoFromFile(path, info)) {
+		return false;
+	}
+	width = info.width;
+	height = info.height;
+	channels = info.channels;
+	return true;
+}
+
+void thumbnailSizeFor(int fullWidth, int fullHeight, int& thumbnailWidth, int& thumbnailHeight) {
+	float aspect_ratio = (float)fullHeight / (float)fullWidth;
+	thumbnailWidth = kThumbnailMaxWidth;
+	thumbnailHeight = std::clamp((int)(kThumbnailMaxWidth * aspect_ratio), 1, 65535);
+}
+
+bool largeThumbnailSizeFor(int fullWidth, int fullHeight, int& thumbnailWidth, int& thumbnailHeight) {
+	if (fullWidth <= kThumbnailMaxWidth) {
+		return false;
+	}
+	float aspect_ratio = (float)fullHeight / (float)fullWidth;
+	thumbnailWidth = std::min(fullWidth, kThumbnailLargeWidth);
+	thumbnailHeight = std::clamp((int)(thumbnailWidth * aspect_ratio), 1, 65535);
+	return true;
+}
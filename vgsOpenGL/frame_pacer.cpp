@@ -0,0 +1,73 @@
+#include "frame_pacer.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+void FramePacer::RequestFrames(int count) {
+	int pending = pendingFrames.load(std::memory_order_relaxed);
+	while (pending < count && !pendingFrames.compare_exchange_weak(pending, count, std::memory_order_relaxed)) {
+	}
+}
+
+bool FramePacer::CanSleep(bool animating) const {
+	return !animating && pendingFrames.load(std::memory_order_relaxed) == 0;
+}
+
+bool FramePacer::BeginFrame(bool animating) {
+	int pending = pendingFrames.load(std::memory_order_relaxed);
+	while (pending > 0 && !pendingFrames.compare_exchange_weak(pending, pending - 1, std::memory_order_relaxed)) {
+	}
+
+	if (pending > 0 || animating) {
+		current.framesRendered++;
+		return true;
+	}
+	current.framesSkipped++;
+	return false;
+}
+
+bool FramePacer::UpdateStats(double nowSeconds, double intervalSeconds) {
+	if (intervalStart < 0.0) {
+		intervalStart = nowSeconds;
+		intervalCpuStart = GetProcessCpuSeconds();
+		return false;
+	}
+
+	double elapsed = nowSeconds - intervalStart;
+	if (elapsed < intervalSeconds) {
+		return false;
+	}
+
+	double cpuNow = GetProcessCpuSeconds();
+	current.intervalSeconds = elapsed;
+	current.cpuPercent = 100.0 * (cpuNow - intervalCpuStart) / elapsed;
+	last = current;
+	current = FrameLoopStats();
+	intervalStart = nowSeconds;
+	intervalCpuStart = cpuNow;
+	return true;
+}
+
+double GetProcessCpuSeconds() {
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return 0.0;
+	}
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+	return (double)(kernel.QuadPart + user.QuadPart) * 1e-7; // 100 ns units
+#else
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
@@ -0,0 +1,272 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#include "gl_stats.h"
+#include "perf_stats.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+namespace GLStats
+{
+	bool g_counting = false;
+	GLCallCounts g_current[(int)GLSource::Count];
+
+	static const int kPassCount = (int)GLPass::Count;
+
+	// Timer results are picked up this many frames later at the earliest;
+	// a pass is skipped rather than waited for when its slot is still busy
+	static const int kTimerFrames = 4;
+
+	namespace
+	{
+		struct TimerQuery {
+			GLuint id = 0;
+			uint64_t frame = 0;
+			bool pending = false;
+		};
+	}
+
+	static GLStatsMode g_mode = GLStatsMode::Off;
+	static std::string g_outputPath = "vgs_gl_stats.json";
+
+	static GLFrameStats g_history[Perf::kHistorySize];
+	static int g_historyCount = 0;
+	static uint64_t g_frameNumber = 0; // Frame the counters are currently collected for
+
+	static TimerQuery g_timers[kTimerFrames][kPassCount];
+	static int g_activePass = -1;
+	static float g_latestGpuMs[kPassCount] = { -1.0f, -1.0f };
+	static uint64_t g_latestGpuFrame[kPassCount] = {};
+
+	const char* SourceName(GLSource source) {
+		switch (source) {
+		case GLSource::App: return "App";
+		case GLSource::ImGui: return "ImGui";
+		default: return "?";
+		}
+	}
+
+	const char* KindName(GLCallKind kind) {
+		switch (kind) {
+		case GLCallKind::Draw: return "Draw";
+		case GLCallKind::BindTexture: return "Bind texture";
+		case GLCallKind::TextureUpload: return "Texture upload";
+		case GLCallKind::BufferUpload: return "Buffer upload";
+		case GLCallKind::Mipmap: return "Mipmap";
+		case GLCallKind::StateChange: return "State change";
+		case GLCallKind::StateQuery: return "State query";
+		case GLCallKind::Object: return "Gen/delete";
+		default: return "?";
+		}
+	}
+
+	const char* PassName(GLPass pass) {
+		switch (pass) {
+		case GLPass::Upload: return "Upload";
+		case GLPass::Grid: return "Grid";
+		default: return "?";
+		}
+	}
+
+	const char* ModeName(GLStatsMode mode) {
+		switch (mode) {
+		case GLStatsMode::Off: return "Off";
+		case GLStatsMode::Counters: return "Counters";
+		case GLStatsMode::GpuTimers: return "Counters + GPU timers";
+		default: return "?";
+		}
+	}
+
+	// Keys used in the JSON dump
+	static const char* kindKey(GLCallKind kind) {
+		switch (kind) {
+		case GLCallKind::Draw: return "draw";
+		case GLCallKind::BindTexture: return "bind_texture";
+		case GLCallKind::TextureUpload: return "texture_upload";
+		case GLCallKind::BufferUpload: return "buffer_upload";
+		case GLCallKind::Mipmap: return "mipmap";
+		case GLCallKind::StateChange: return "state_change";
+		case GLCallKind::StateQuery: return "state_query";
+		case GLCallKind::Object: return "object";
+		default: return "unknown";
+		}
+	}
+
+	void SetMode(GLStatsMode mode) {
+		g_mode = mode;
+		g_counting = mode != GLStatsMode::Off;
+	}
+
+	GLStatsMode GetMode() {
+		return g_mode;
+	}
+
+	void BeginPass(GLPass pass) {
+		if (g_mode != GLStatsMode::GpuTimers || g_activePass >= 0) {
+			return;
+		}
+		TimerQuery& query = g_timers[g_frameNumber % kTimerFrames][(int)pass];
+		if (query.pending) {
+			return; // The GPU is more than kTimerFrames behind
+		}
+		if (query.id == 0) {
+			glGenQueries(1, &query.id);
+		}
+		glBeginQuery(GL_TIME_ELAPSED, query.id);
+		query.frame = g_frameNumber;
+		g_activePass = (int)pass;
+	}
+
+	void EndPass(GLPass pass) {
+		// Not gated on the mode: it may have been switched inside the pass
+		if (g_activePass != (int)pass) {
+			return;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		g_timers[g_frameNumber % kTimerFrames][(int)pass].pending = true;
+		g_activePass = -1;
+	}
+
+	static void collectTimers() {
+		for (auto& slot : g_timers) {
+			for (int pass = 0; pass < kPassCount; pass++) {
+				TimerQuery& query = slot[pass];
+				if (!query.pending) {
+					continue;
+				}
+				GLint available = 0;
+				glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available) {
+					continue;
+				}
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+				query.pending = false;
+
+				float ms = (float)(nanoseconds * 1e-6);
+				GLFrameStats& entry = g_history[query.frame % Perf::kHistorySize];
+				if (entry.frame == query.frame) {
+					entry.gpuMs[pass] = ms;
+				}
+				if (query.frame >= g_latestGpuFrame[pass]) {
+					g_latestGpuFrame[pass] = query.frame;
+					g_latestGpuMs[pass] = ms;
+				}
+			}
+		}
+	}
+
+	void EndFrame() {
+		// Queries still in flight when the mode was switched off are collected anyway
+		if (g_mode == GLStatsMode::Off) {
+			collectTimers();
+			return;
+		}
+		GLFrameStats& entry = g_history[g_frameNumber % Perf::kHistorySize];
+		entry = GLFrameStats();
+		entry.frame = g_frameNumber;
+		for (int source = 0; source < (int)GLSource::Count; source++) {
+			entry.sources[source] = g_current[source];
+			g_current[source] = GLCallCounts();
+		}
+		g_historyCount = std::min(g_historyCount + 1, Perf::kHistorySize);
+		g_frameNumber++;
+
+		collectTimers();
+	}
+
+	const GLFrameStats& GetLastFrame() {
+		static const GLFrameStats empty;
+		if (g_historyCount == 0) {
+			return empty;
+		}
+		return g_history[(g_frameNumber - 1) % Perf::kHistorySize];
+	}
+
+	float GetLatestGpuMs(GLPass pass) {
+		return g_latestGpuMs[(int)pass];
+	}
+
+	void SetOutputPath(const std::string& path) {
+		g_outputPath = path;
+	}
+
+	const std::string& GetOutputPath() {
+		return g_outputPath;
+	}
+
+	static void writeCounts(FILE* file, const GLCallCounts& counts) {
+		fputs("{\"calls\":{", file);
+		for (int kind = 0; kind < (int)GLCallKind::Count; kind++) {
+			fprintf(file, "%s\"%s\":%llu", kind ? "," : "", kindKey((GLCallKind)kind), (unsigned long long)counts.calls[kind]);
+		}
+		fprintf(file, "},\"texture_upload_bytes\":%llu,\"buffer_upload_bytes\":%llu}",
+			(unsigned long long)counts.bytes[(int)GLCallKind::TextureUpload],
+			(unsigned long long)counts.bytes[(int)GLCallKind::BufferUpload]);
+	}
+
+	long long WriteJson(const std::string& path) {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			return -1;
+		}
+
+		fprintf(file, "{\"mode\":\"%s\",\"frames\":[\n", ModeName(g_mode));
+		uint64_t first = g_frameNumber - (uint64_t)g_historyCount;
+		for (uint64_t frame = first; frame < g_frameNumber; frame++) {
+			const GLFrameStats& entry = g_history[frame % Perf::kHistorySize];
+			fprintf(file, "%s{\"frame\":%llu", frame > first ? ",\n" : "", (unsigned long long)entry.frame);
+			for (int source = 0; source < (int)GLSource::Count; source++) {
+				fprintf(file, ",\"%s\":", source == (int)GLSource::App ? "app" : "imgui");
+				writeCounts(file, entry.sources[source]);
+			}
+			fputs(",\"gpu_ms\":{", file);
+			for (int pass = 0; pass < kPassCount; pass++) {
+				// Unmeasured passes are written as null
+				fprintf(file, "%s\"%s\":", pass ? "," : "", pass == (int)GLPass::Upload ? "upload" : "grid");
+				if (entry.gpuMs[pass] < 0.0f) {
+					fputs("null", file);
+				}
+				else {
+					fprintf(file, "%.4f", entry.gpuMs[pass]);
+				}
+			}
+			fputs("}}", file);
+		}
+		fputs("\n]}\n", file);
+
+		bool ok = ferror(file) == 0;
+		fclose(file);
+		return ok ? g_historyCount : -1;
+	}
+
+	long long Flush() {
+		long long written = WriteJson(g_outputPath);
+		if (written < 0) {
+			std::cerr << "Error: Could not write GL statistics to " << g_outputPath << std::endl;
+		}
+		else {
+			std::cout << "GL statistics written to " << g_outputPath << " (" << written << " frames)" << std::endl;
+		}
+		return written;
+	}
+
+	void Shutdown() {
+		if (g_activePass >= 0) {
+			glEndQuery(GL_TIME_ELAPSED);
+			g_activePass = -1;
+		}
+		for (auto& slot : g_timers) {
+			for (TimerQuery& query : slot) {
+				if (query.id != 0) {
+					glDeleteQueries(1, &query.id);
+				}
+				query = TimerQuery();
+			}
+		}
+	}
+}
@@ -0,0 +1,124 @@
+#include <type_traits>
+#include <utility>
+
+#include "gl_stats.h"
+
+// The backend calls GL through the function table of its bundled loader;
+// swapping entries of that table is enough to see every call it makes.
+#include "imgui_impl_opengl3_loader.h"
+
+namespace
+{
+	using BackendProcs = decltype(ImGL3WProcs::gl);
+
+	template <auto Member>
+	using ProcType = std::remove_reference_t<decltype(std::declval<BackendProcs&>().*Member)>;
+
+	// Counts a call of `Kind` and forwards it to the loader's original entry
+	template <auto Member, GLCallKind Kind, typename Proc = ProcType<Member>>
+	struct CountedProc;
+
+	template <auto Member, GLCallKind Kind, typename R, typename... Args>
+	struct CountedProc<Member, Kind, R(APIENTRY*)(Args...)> {
+		static inline R(APIENTRY* original)(Args...) = nullptr;
+
+		static R APIENTRY Call(Args... args) {
+			GLStats::CountCall(GLSource::ImGui, Kind);
+			return original(args...);
+		}
+
+		static void Install() {
+			original = imgl3wProcs.gl.*Member;
+			imgl3wProcs.gl.*Member = &Call;
+		}
+	};
+
+	// Uploads are sized, so they get hand-written wrappers
+	PFNGLBUFFERDATAPROC g_bufferData = nullptr;
+	PFNGLBUFFERSUBDATAPROC g_bufferSubData = nullptr;
+	PFNGLTEXIMAGE2DPROC g_texImage2D = nullptr;
+	PFNGLTEXSUBIMAGE2DPROC g_texSubImage2D = nullptr;
+
+	void APIENTRY countedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+		// A null pointer only (re)allocates storage
+		GLStats::CountCall(GLSource::ImGui, GLCallKind::BufferUpload, data ? (uint64_t)size : 0);
+		g_bufferData(target, size, data, usage);
+	}
+
+	void APIENTRY countedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+		GLStats::CountCall(GLSource::ImGui, GLCallKind::BufferUpload, (uint64_t)size);
+		g_bufferSubData(target, offset, size, data);
+	}
+
+	// The backend only uploads RGBA8 font and user textures
+	void APIENTRY countedTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+		GLStats::CountCall(GLSource::ImGui, GLCallKind::TextureUpload, pixels ? (uint64_t)width * height * 4 : 0);
+		g_texImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+	}
+
+	void APIENTRY countedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) {
+		GLStats::CountCall(GLSource::ImGui, GLCallKind::TextureUpload, (uint64_t)width * height * 4);
+		g_texSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+	}
+
+	template <auto Member, GLCallKind Kind>
+	void hook() {
+		CountedProc<Member, Kind>::Install();
+	}
+}
+
+namespace GLStats
+{
+	void HookImGuiBackend() {
+		static bool hooked = false;
+		if (hooked || !imgl3wProcs.gl.DrawElements) {
+			return; // Already wrapped, or the backend has not loaded GL yet
+		}
+		hooked = true;
+
+		using P = BackendProcs;
+		hook<&P::DrawElements, GLCallKind::Draw>();
+		hook<&P::DrawElementsBaseVertex, GLCallKind::Draw>();
+		hook<&P::BindTexture, GLCallKind::BindTexture>();
+
+		g_bufferData = std::exchange(imgl3wProcs.gl.BufferData, &countedBufferData);
+		g_bufferSubData = std::exchange(imgl3wProcs.gl.BufferSubData, &countedBufferSubData);
+		g_texImage2D = std::exchange(imgl3wProcs.gl.TexImage2D, &countedTexImage2D);
+		g_texSubImage2D = std::exchange(imgl3wProcs.gl.TexSubImage2D, &countedTexSubImage2D);
+
+		hook<&P::ActiveTexture, GLCallKind::StateChange>();
+		hook<&P::BindBuffer, GLCallKind::StateChange>();
+		hook<&P::BindSampler, GLCallKind::StateChange>();
+		hook<&P::BindVertexArray, GLCallKind::StateChange>();
+		hook<&P::BlendEquation, GLCallKind::StateChange>();
+		hook<&P::BlendEquationSeparate, GLCallKind::StateChange>();
+		hook<&P::BlendFuncSeparate, GLCallKind::StateChange>();
+		hook<&P::Disable, GLCallKind::StateChange>();
+		hook<&P::DisableVertexAttribArray, GLCallKind::StateChange>();
+		hook<&P::Enable, GLCallKind::StateChange>();
+		hook<&P::EnableVertexAttribArray, GLCallKind::StateChange>();
+		hook<&P::PixelStorei, GLCallKind::StateChange>();
+		hook<&P::PolygonMode, GLCallKind::StateChange>();
+		hook<&P::Scissor, GLCallKind::StateChange>();
+		hook<&P::TexParameteri, GLCallKind::StateChange>();
+		hook<&P::Uniform1i, GLCallKind::StateChange>();
+		hook<&P::UniformMatrix4fv, GLCallKind::StateChange>();
+		hook<&P::UseProgram, GLCallKind::StateChange>();
+		hook<&P::VertexAttribPointer, GLCallKind::StateChange>();
+		hook<&P::Viewport, GLCallKind::StateChange>();
+
+		hook<&P::GetError, GLCallKind::StateQuery>();
+		hook<&P::GetIntegerv, GLCallKind::StateQuery>();
+		hook<&P::GetVertexAttribPointerv, GLCallKind::StateQuery>();
+		hook<&P::GetVertexAttribiv, GLCallKind::StateQuery>();
+		hook<&P::IsEnabled, GLCallKind::StateQuery>();
+		hook<&P::IsProgram, GLCallKind::StateQuery>();
+
+		hook<&P::DeleteBuffers, GLCallKind::Object>();
+		hook<&P::DeleteTextures, GLCallKind::Object>();
+		hook<&P::DeleteVertexArrays, GLCallKind::Object>();
+		hook<&P::GenBuffers, GLCallKind::Object>();
+		hook<&P::GenTextures, GLCallKind::Object>();
+		hook<&P::GenVertexArrays, GLCallKind::Object>();
+	}
+}
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "grid_layout.h"
+#include "perf_stats.h"
+
+const char* GridLayoutName(GridLayoutKind kind) {
+	switch (kind) {
+	case GridLayoutKind::Masonry: return "Masonry";
+	case GridLayoutKind::JustifiedRows: return "Justified rows";
+	case GridLayoutKind::UniformGrid: return "Uniform grid";
+	default: return "?";
+	}
+}
+
+bool ParseGridLayout(const char* name, GridLayoutKind& kind) {
+	if (std::strcmp(name, "masonry") == 0) {
+		kind = GridLayoutKind::Masonry;
+	}
+	else if (std::strcmp(name, "justified") == 0) {
+		kind = GridLayoutKind::JustifiedRows;
+	}
+	else if (std::strcmp(name, "uniform") == 0) {
+		kind = GridLayoutKind::UniformGrid;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void GridLayout::Relayout(const GridItems& items, float newWidth) {
+	VGS_PERF_SCOPE(PerfStage::Layout);
+	width = std::max(newWidth, 1.0f);
+	contentHeight = kGridTopOffset;
+	reset();
+	placeFrom(items, 0);
+}
+
+void GridLayout::Extend(const GridItems& items) {
+	if (items.count < laidOut) {
+		Relayout(items, width);
+		return;
+	}
+	VGS_PERF_SCOPE(PerfStage::Layout);
+	placeFrom(items, laidOut);
+}
+
+void GridLayout::placeFrom(const GridItems& items, size_t first) {
+	firstChanged = place(items, first);
+	laidOut = items.count;
+
+	// A relayout may have moved anything
+	changedTop = firstChanged == 0 ? 0.0f : contentHeight;
+	for (size_t i = firstChanged; i > 0 && i < items.count; i++) {
+		if (items.states[i] != ThumbnailState::Failed) {
+			changedTop = std::min(changedTop, items.y[i]);
+		}
+	}
+}
+
+namespace
+{
+	float aspectOf(const GridItems& items, size_t i) {
+		uint16_t width = items.thumbnailWidth[i];
+		uint16_t height = items.thumbnailHeight[i];
+		return width && height ? (float)width / height : 1.0f;
+	}
+
+	// As many columns of about `targetSize` as fit, widened to fill `width`
+	int columnsFor(float width, float targetSize, float& columnWidth) {
+		int columns = std::max(1, (int)((width + kGridTilePadding) / (targetSize + kGridTilePadding)));
+		columnWidth = std::max((width + kGridTilePadding) / columns - kGridTilePadding, 1.0f);
+		return columns;
+	}
+
+	// Each image goes into the next column in turn, below the previous image
+	// of that column
+	class MasonryLayout final : public GridLayout {
+	public:
+		MasonryLayout() : GridLayout(300.0f) {}
+
+		GridLayoutKind Kind() const override { return GridLayoutKind::Masonry; }
+
+	protected:
+		void reset() override {
+			int columns = columnsFor(width, targetSize, columnWidth);
+			columnHeights.assign(columns, kGridTopOffset);
+			nextColumn = 0;
+		}
+
+		size_t place(const GridItems& items, size_t first) override {
+			float pitch = columnWidth + kGridTilePadding;
+			size_t column = nextColumn;
+			for (size_t i = first; i < items.count; i++) {
+				if (items.states[i] == ThumbnailState::Failed) {
+					continue;
+				}
+				float height = columnWidth / aspectOf(items, i);
+				items.x[i] = column * pitch;
+				items.y[i] = columnHeights[column];
+				items.width[i] = columnWidth;
+				items.height[i] = height;
+				columnHeights[column] += height + kGridTilePadding;
+				if (++column == columnHeights.size()) {
+					column = 0;
+				}
+			}
+			nextColumn = column;
+			contentHeight = *std::max_element(columnHeights.begin(), columnHeights.end());
+			return first;
+		}
+
+	private:
+		std::vector<float> columnHeights;
+		size_t nextColumn = 0;
+		float columnWidth = 0.0f;
+	};
+
+	// Flickr-style rows: images are added to a row at the target height until
+	// it is full, then the row is scaled to span the width exactly. A row ends
+	// before or after the image that overflows it, whichever keeps its height
+	// closer to the target. The last row stays at the target height and is
+	// laid out again when more images arrive.
+	class JustifiedRowsLayout final : public GridLayout {
+	public:
+		JustifiedRowsLayout() : GridLayout(200.0f) {}
+
+		GridLayoutKind Kind() const override { return GridLayoutKind::JustifiedRows; }
+
+	protected:
+		void reset() override {
+			rowStart = 0;
+			rowTop = kGridTopOffset;
+		}
+
+		size_t place(const GridItems& items, size_t first) override {
+			size_t start = std::min(first, rowStart);
+			float aspectSum = 0.0f;
+			int rowCount = 0;
+			for (size_t i = rowStart; i < items.count; i++) {
+				if (items.states[i] == ThumbnailState::Failed) {
+					continue;
+				}
+				float aspect = aspectOf(items, i);
+				if (rowCount > 0) {
+					float heightWith = (width - kGridTilePadding * rowCount) / (aspectSum + aspect);
+					if (heightWith < targetSize) {
+						float heightWithout = (width - kGridTilePadding * (rowCount - 1)) / aspectSum;
+						if (heightWithout - targetSize < targetSize - heightWith) {
+							closeRow(items, i, heightWithout);
+						}
+						else {
+							closeRow(items, i + 1, heightWith);
+							aspectSum = 0.0f;
+							rowCount = 0;
+							continue;
+						}
+						aspectSum = 0.0f;
+						rowCount = 0;
+					}
+				}
+				aspectSum += aspect;
+				rowCount++;
+			}
+
+			contentHeight = rowTop;
+			if (rowCount > 0) {
+				// A lone panorama may be too wide for the target height
+				float height = std::min(targetSize, (width - kGridTilePadding * (rowCount - 1)) / aspectSum);
+				placeRow(items, rowStart, items.count, height);
+				contentHeight += height + kGridTilePadding;
+			}
+			return start;
+		}
+
+	private:
+		void placeRow(const GridItems& items, size_t begin, size_t end, float height) {
+			float x = 0.0f;
+			for (size_t i = begin; i < end; i++) {
+				if (items.states[i] == ThumbnailState::Failed) {
+					continue;
+				}
+				float tileWidth = aspectOf(items, i) * height;
+				items.x[i] = x;
+				items.y[i] = rowTop;
+				items.width[i] = tileWidth;
+				items.height[i] = height;
+				x += tileWidth + kGridTilePadding;
+			}
+		}
+
+		// Places the row [rowStart, end) and starts the next one at `end`
+		void closeRow(const GridItems& items, size_t end, float height) {
+			placeRow(items, rowStart, end, height);
+			rowTop += height + kGridTilePadding;
+			rowStart = end;
+		}
+
+		size_t rowStart = 0;  // First image of the unfinished last row
+		float rowTop = kGridTopOffset;
+	};
+
+	// Square cells in rows, each thumbnail scaled to fit its cell and centred
+	class UniformGridLayout final : public GridLayout {
+	public:
+		UniformGridLayout() : GridLayout(300.0f) {}
+
+		GridLayoutKind Kind() const override { return GridLayoutKind::UniformGrid; }
+
+	protected:
+		void reset() override {
+			columns = columnsFor(width, targetSize, cellSize);
+			column = 0;
+			rowTop = kGridTopOffset;
+		}
+
+		size_t place(const GridItems& items, size_t first) override {
+			float pitch = cellSize + kGridTilePadding;
+			for (size_t i = first; i < items.count; i++) {
+				if (items.states[i] == ThumbnailState::Failed) {
+					continue;
+				}
+				float aspect = aspectOf(items, i);
+				float tileWidth = aspect >= 1.0f ? cellSize : cellSize * aspect;
+				float tileHeight = aspect >= 1.0f ? cellSize / aspect : cellSize;
+				items.x[i] = column * pitch + (cellSize - tileWidth) * 0.5f;
+				items.y[i] = rowTop + (cellSize - tileHeight) * 0.5f;
+				items.width[i] = tileWidth;
+				items.height[i] = tileHeight;
+				if (++column == columns) {
+					column = 0;
+					rowTop += pitch;
+				}
+			}
+			contentHeight = column > 0 ? rowTop + pitch : rowTop;
+			return first;
+		}
+
+	private:
+		int columns = 1;
+		int column = 0;  // Next free cell of the row at rowTop
+		float rowTop = kGridTopOffset;
+		float cellSize = 0.0f;
+	};
+}
+
+std::unique_ptr<GridLayout> CreateGridLayout(GridLayoutKind kind) {
+	switch (kind) {
+	case GridLayoutKind::JustifiedRows: return std::make_unique<JustifiedRowsLayout>();
+	case GridLayoutKind::UniformGrid: return std::make_unique<UniformGridLayout>();
+	default: return std::make_unique<MasonryLayout>();
+	}
+}
+
+int GridSpatialIndex::bandOf(float y) const {
+	int band = (int)std::floor(y / kBandHeight);
+	return std::clamp(band, 0, (int)bandStart.size() - 2);
+}
+
+static size_t bandCountFor(float contentHeight) {
+	return (size_t)std::max(contentHeight, 0.0f) / (size_t)GridSpatialIndex::kBandHeight + 1;
+}
+
+// Counting sort of the pending tiles into bands [firstBand, bandCount) by
+// their top edge: tally the tiles per band, then place them in pending
+// order. The bands above firstBand are kept as they are.
+void GridSpatialIndex::fill(const GridItems& tiles, int firstBand, size_t bandCount) {
+	bandStart.resize(bandCount + 1);
+	std::fill(bandStart.begin() + firstBand + 1, bandStart.end(), 0);
+	// Laid out tiles never start above the content, so the band is a plain
+	// truncation; the last band takes anything past the content height
+	const float bandScale = 1.0f / kBandHeight;
+	const uint32_t lastBand = (uint32_t)bandCount - 1;
+	for (uint32_t i : pending) {
+		bandStart[std::min((uint32_t)(tiles.y[i] * bandScale), lastBand) + 1]++;
+		maxTileHeight = std::max(maxTileHeight, tiles.height[i]);
+	}
+	for (size_t band = firstBand; band < bandCount; band++) {
+		bandStart[band + 1] += bandStart[band];
+	}
+	items.resize(bandStart[bandCount]);
+
+	std::vector<uint32_t> cursor(bandStart.begin() + firstBand, bandStart.end() - 1);
+	for (uint32_t i : pending) {
+		items[cursor[std::min((uint32_t)(tiles.y[i] * bandScale), lastBand) - firstBand]++] = i;
+	}
+}
+
+void GridSpatialIndex::Build(const GridItems& tiles, float contentHeight) {
+	VGS_PERF_SCOPE(PerfStage::Layout);
+	pending.clear();
+	for (size_t i = 0; i < tiles.count; i++) {
+		if (tiles.states[i] != ThumbnailState::Failed) {
+			pending.push_back((uint32_t)i);
+		}
+	}
+	bandStart.assign(1, 0);
+	maxTileHeight = 0.0f;
+	fill(tiles, 0, bandCountFor(contentHeight));
+}
+
+void GridSpatialIndex::Update(const GridItems& tiles, size_t firstChanged, float changedTop, float contentHeight) {
+	if (bandStart.empty()) {
+		Build(tiles, contentHeight);
+		return;
+	}
+	VGS_PERF_SCOPE(PerfStage::Layout);
+	int firstBand = bandOf(changedTop);
+
+	// Unchanged tiles in the rebuilt bands are sorted in again
+	pending.clear();
+	for (uint32_t k = bandStart[firstBand]; k < bandStart.back(); k++) {
+		if (items[k] < firstChanged) {
+			pending.push_back(items[k]);
+		}
+	}
+	for (size_t i = firstChanged; i < tiles.count; i++) {
+		if (tiles.states[i] != ThumbnailState::Failed) {
+			pending.push_back((uint32_t)i);
+		}
+	}
+
+	size_t bandCount = bandCountFor(contentHeight);
+	fill(tiles, std::min(firstBand, (int)bandCount - 1), bandCount);
+}
+
+void GridSpatialIndex::Clear() {
+	bandStart.clear();
+	items.clear();
+	pending.clear();
+	maxTileHeight = 0.0f;
+}
+
+void GridSpatialIndex::Query(const GridItems& tiles, float top, float bottom, std::vector<uint32_t>& out) const {
+	if (bandStart.empty() || bottom <= top) {
+		return;
+	}
+	// Tiles are filed under the band of their top edge, so the bands above
+	// `top` hold tiles reaching down into the range
+	int first = bandOf(top - maxTileHeight);
+	int last = bandOf(bottom);
+	for (uint32_t k = bandStart[first]; k < bandStart[last + 1]; k++) {
+		uint32_t i = items[k];
+		float tileTop = tiles.y[i];
+		if (tileTop + tiles.height[i] > top && tileTop < bottom) {
+			out.push_back(i);
+		}
+	}
+}
+
+int64_t GridSpatialIndex::HitTest(const GridItems& tiles, float x, float y) const {
+	if (bandStart.empty() || y < 0.0f) {
+		return -1;
+	}
+	int first = bandOf(y - maxTileHeight);
+	int last = bandOf(y);
+	for (uint32_t k = bandStart[first]; k < bandStart[last + 1]; k++) {
+		uint32_t i = items[k];
+		float tileX = tiles.x[i];
+		float tileY = tiles.y[i];
+		if (x >= tileX && x < tileX + tiles.width[i] && y >= tileY && y < tileY + tiles.height[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,659 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "grid_renderer.h"
+#include "gl_stats.h"
+#include "imgui.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+namespace GridRenderer
+{
+	// Upper bound on the samplers of the fragment shader; every desktop
+	// driver offers at least 16 and usually 32
+	static const int kMaxTextureUnits = 32;
+
+	// Same grey as the draw list placeholder
+	static const float kPlaceholderColor[4] = { 60.0f / 255.0f, 60.0f / 255.0f, 60.0f / 255.0f, 1.0f };
+
+	static const char* const kVertexShader =
+		"#version 330 core\n"
+		"layout (location = 0) in vec4 Rect;\n"
+		"layout (location = 1) in vec4 UVRect;\n"
+		"layout (location = 2) in int Layer;\n"
+		"uniform mat4 ProjMtx;\n"
+		"uniform vec2 Origin;\n"
+		"out vec2 Frag_UV;\n"
+		"flat out int Frag_Layer;\n"
+		"void main() {\n"
+		"    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+		"    Frag_UV = mix(UVRect.xy, UVRect.zw, corner);\n"
+		"    Frag_Layer = Layer;\n"
+		"    gl_Position = ProjMtx * vec4(Origin + Rect.xy + corner * Rect.zw, 0, 1);\n"
+		"}\n";
+
+	namespace
+	{
+		struct Instance {
+			float rect[4];   // x, y, width, height in content space
+			float uvRect[4]; // u0, v0, u1, v1
+			int32_t layer;   // Texture unit of the batch, or -1 for the placeholder
+		};
+
+		struct Batch {
+			size_t firstInstance = 0;
+			size_t instanceCount = 0;
+			GLuint textures[kMaxTextureUnits] = {};
+			int textureCount = 0;
+		};
+
+		// Where the grid window is this frame; the callback runs after
+		// ImGui::Render(), when the window is no longer current
+		struct FrameState {
+			float originX = 0.0f;
+			float originY = 0.0f;
+			ImVec2 displayPos;
+			ImVec2 displaySize;
+			ImVec2 framebufferScale;
+		};
+
+		// Consecutive batches drawn with the same projection
+		struct Run {
+			size_t firstBatch = 0;
+			size_t batchCount = 0;
+		};
+
+		// A strip of the grid content rendered into its own texture
+		struct CachedBand {
+			int band = -1;          // Covers content rows from band * kGridCacheBandHeight
+			bool valid = false;
+			float lodBias = 0.0f;   // Mip bias the strip was rendered with
+			uint32_t lastUsedFrame = 0;
+			GLuint texture = 0;
+			GLuint framebuffer = 0; // Created on the first render
+		};
+	}
+
+	static bool g_enabled = true;
+	static bool g_initialized = false;
+	static bool g_failed = false; // GL objects could not be created; the caller draws the tiles
+
+	static GLuint g_program = 0;
+	static GLint g_projectionLocation = -1;
+	static GLint g_originLocation = -1;
+	static GLint g_gradScaleLocation = -1;
+	static float g_lodBias = 0.0f;
+	static GLuint g_vertexArray = 0;
+	static GLuint g_buffer = 0;
+	static size_t g_capacity = 0;
+	static int g_textureUnits = 0;
+
+	static std::vector<GridTile> g_tiles;
+	static bool g_tilesDirty = false;
+	static std::vector<Instance> g_instances;
+	static std::vector<Batch> g_batches;
+	static bool g_builtRetained = false; // Mode the instance buffer was last written for
+	static Run g_tileRun;                // Immediate mode: every tile
+	static FrameState g_frame;
+	static GridRendererStats g_stats;
+	static uint32_t g_frameCounter = 0;
+
+	static bool g_retained = false;
+	static std::vector<CachedBand> g_bands;
+	static float g_bandLeft = 0.0f;        // Content columns every strip covers
+	static float g_bandWidth = 0.0f;
+	static int g_bandPixelWidth = 0;
+	static int g_bandPixelHeight = 0;
+	static std::vector<int> g_compositeSlots; // Strips the instance buffer composites, top to bottom
+	static std::vector<int> g_renderSlots;    // Strips rendered this frame
+	static std::vector<Run> g_bandRuns;       // Tiles of each strip in g_renderSlots
+	static Run g_compositeRun;
+
+	void SetEnabled(bool enabled) {
+		g_enabled = enabled;
+	}
+
+	bool IsEnabled() {
+		return g_enabled;
+	}
+
+	static void releaseBands() {
+		for (CachedBand& cached : g_bands) {
+			if (cached.framebuffer) {
+				glDeleteFramebuffers(1, &cached.framebuffer);
+			}
+			if (cached.texture) {
+				glDeleteTextures(1, &cached.texture);
+			}
+		}
+		GLStats::CountCalls(GLSource::App, GLCallKind::Object, g_bands.size() * 2);
+		g_bands.clear();
+		g_compositeSlots.clear();
+		g_builtRetained = false;
+	}
+
+	void SetRetained(bool retained) {
+		if (!retained && g_retained) {
+			releaseBands();
+		}
+		g_retained = retained;
+	}
+
+	bool IsRetained() {
+		return g_retained;
+	}
+
+	void InvalidateRange(float top, float bottom) {
+		for (CachedBand& cached : g_bands) {
+			float bandTop = cached.band * kGridCacheBandHeight;
+			if (bandTop < bottom && bandTop + kGridCacheBandHeight > top) {
+				cached.valid = false;
+			}
+		}
+	}
+
+	void InvalidateAll() {
+		for (CachedBand& cached : g_bands) {
+			cached.valid = false;
+		}
+	}
+
+	void SetLodBias(float bias) {
+		g_lodBias = bias;
+	}
+
+	// One case per unit: a sampler array may only be indexed by a value that
+	// is uniform across the draw, which the layer of an instance is not
+	static std::string fragmentShaderSource(int textureUnits) {
+		std::string source =
+			"#version 330 core\n"
+			"in vec2 Frag_UV;\n"
+			"flat in int Frag_Layer;\n"
+			"uniform sampler2D Textures[" + std::to_string(textureUnits) + "];\n"
+			"uniform vec4 PlaceholderColor;\n"
+			"uniform float GradScale;\n"
+			"layout (location = 0) out vec4 Out_Color;\n"
+			"void main() {\n"
+			"    vec2 dx = dFdx(Frag_UV) * GradScale;\n"
+			"    vec2 dy = dFdy(Frag_UV) * GradScale;\n"
+			"    vec4 color = PlaceholderColor;\n"
+			"    switch (Frag_Layer) {\n";
+		for (int unit = 0; unit < textureUnits; unit++) {
+			std::string index = std::to_string(unit);
+			source += "    case " + index + ": color = textureGrad(Textures[" + index + "], Frag_UV, dx, dy); break;\n";
+		}
+		source +=
+			"    }\n"
+			"    Out_Color = color;\n"
+			"}\n";
+		return source;
+	}
+
+	static GLuint compileShader(GLenum type, const char* source) {
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		GLint status = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if (!status) {
+			char log[512] = {};
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			std::cerr << "Error: Grid renderer shader failed to compile: " << log << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	static bool createProgram() {
+		std::string fragmentSource = fragmentShaderSource(g_textureUnits);
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, kVertexShader);
+		GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+		if (!vertexShader || !fragmentShader) {
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return false;
+		}
+		g_program = glCreateProgram();
+		glAttachShader(g_program, vertexShader);
+		glAttachShader(g_program, fragmentShader);
+		glLinkProgram(g_program);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		GLint status = 0;
+		glGetProgramiv(g_program, GL_LINK_STATUS, &status);
+		if (!status) {
+			char log[512] = {};
+			glGetProgramInfoLog(g_program, sizeof(log), nullptr, log);
+			std::cerr << "Error: Grid renderer program failed to link: " << log << std::endl;
+			return false;
+		}
+		g_projectionLocation = glGetUniformLocation(g_program, "ProjMtx");
+		g_originLocation = glGetUniformLocation(g_program, "Origin");
+		g_gradScaleLocation = glGetUniformLocation(g_program, "GradScale");
+
+		GLint units[kMaxTextureUnits];
+		for (int unit = 0; unit < g_textureUnits; unit++) {
+			units[unit] = unit;
+		}
+		glUseProgram(g_program);
+		glUniform1iv(glGetUniformLocation(g_program, "Textures"), g_textureUnits, units);
+		glUniform4f(glGetUniformLocation(g_program, "PlaceholderColor"),
+			kPlaceholderColor[0], kPlaceholderColor[1], kPlaceholderColor[2], kPlaceholderColor[3]);
+		glUniform1f(g_gradScaleLocation, 1.0f);
+		return true;
+	}
+
+	static bool initialize() {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major * 10 + minor < 33) {
+			std::cerr << "Error: The instanced grid renderer needs OpenGL 3.3" << std::endl;
+			return false;
+		}
+		GLint maxUnits = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+		g_textureUnits = std::clamp((int)maxUnits, 1, kMaxTextureUnits);
+		if (!createProgram()) {
+			return false;
+		}
+
+		glGenVertexArrays(1, &g_vertexArray);
+		glGenBuffers(1, &g_buffer);
+		glBindVertexArray(g_vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffer);
+		for (GLuint location = 0; location < 3; location++) {
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+		glBindVertexArray(0);
+		return true;
+	}
+
+	static Instance tileInstance(const GridTile& tile) {
+		return { { tile.x, tile.y, tile.width, tile.height }, { 0.0f, 0.0f, 1.0f, 1.0f }, -1 };
+	}
+
+	// Appends an instance to the last batch of `run`, opening a new batch
+	// when that one has no free texture unit left
+	static void addInstance(Run& run, Instance instance, GLuint texture) {
+		if (run.batchCount == 0) {
+			run.firstBatch = g_batches.size();
+			run.batchCount = 1;
+			g_batches.emplace_back().firstInstance = g_instances.size();
+		}
+		Batch* batch = &g_batches.back();
+		if (texture != 0) {
+			for (int unit = 0; unit < batch->textureCount; unit++) {
+				if (batch->textures[unit] == texture) {
+					instance.layer = unit;
+					break;
+				}
+			}
+			if (instance.layer < 0) {
+				if (batch->textureCount == g_textureUnits) {
+					run.batchCount++;
+					batch = &g_batches.emplace_back();
+					batch->firstInstance = g_instances.size();
+				}
+				instance.layer = batch->textureCount++;
+				batch->textures[instance.layer] = texture;
+			}
+		}
+		g_instances.push_back(instance);
+		batch->instanceCount++;
+	}
+
+	static void uploadInstances() {
+		size_t bytes = g_instances.size() * sizeof(Instance);
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffer);
+		if (bytes > g_capacity) {
+			g_capacity = std::max(bytes + bytes / 2, (size_t)64 * sizeof(Instance));
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)g_capacity, nullptr, GL_DYNAMIC_DRAW);
+			GLStats::CountCall(GLSource::App, GLCallKind::BufferUpload);
+		}
+		if (bytes > 0) {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, g_instances.data());
+			GLStats::CountCall(GLSource::App, GLCallKind::BufferUpload, bytes);
+		}
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+		g_stats.instanceUploads++;
+		g_stats.lastUploadBytes = bytes;
+	}
+
+	static void pointAttributesAt(size_t firstInstance) {
+		const size_t base = firstInstance * sizeof(Instance);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, rect)));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, uvRect)));
+		glVertexAttribIPointer(2, 1, GL_INT, sizeof(Instance), (void*)(base + offsetof(Instance, layer)));
+		GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 3);
+	}
+
+	static void setProjection(float L, float R, float T, float B) {
+		const float projection[4][4] = {
+			{ 2.0f / (R - L), 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 2.0f / (T - B), 0.0f, 0.0f },
+			{ 0.0f, 0.0f, -1.0f, 0.0f },
+			{ (R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f },
+		};
+		glUniformMatrix4fv(g_projectionLocation, 1, GL_FALSE, &projection[0][0]);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+	}
+
+	static void setScreenProjection() {
+		const FrameState& frame = g_frame;
+		setProjection(frame.displayPos.x, frame.displayPos.x + frame.displaySize.x, frame.displayPos.y, frame.displayPos.y + frame.displaySize.y);
+		glUniform2f(g_originLocation, frame.originX, frame.originY);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+	}
+
+	static void drawRun(const Run& run) {
+		for (size_t k = run.firstBatch; k < run.firstBatch + run.batchCount; k++) {
+			const Batch& batch = g_batches[k];
+			// Every unit gets a thumbnail, even past the last one the batch uses:
+			// drivers key compiled shader variants on what the samplers see
+			// (llvmpipe recompiles for ~200 ms per new combination)
+			for (int unit = 0; unit < g_textureUnits; unit++) {
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(GL_TEXTURE_2D, unit < batch.textureCount ? batch.textures[unit] : batch.textures[0]);
+			}
+			GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, g_textureUnits);
+			GLStats::CountCalls(GLSource::App, GLCallKind::BindTexture, g_textureUnits);
+
+			pointAttributesAt(batch.firstInstance);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch.instanceCount);
+			GLStats::CountCall(GLSource::App, GLCallKind::Draw);
+			g_stats.batches++;
+		}
+	}
+
+	static void renderImmediate() {
+		if (g_tilesDirty || g_builtRetained) {
+			g_instances.clear();
+			g_batches.clear();
+			g_tileRun = Run();
+			for (const GridTile& tile : g_tiles) {
+				addInstance(g_tileRun, tileInstance(tile), tile.texture);
+			}
+			uploadInstances();
+			g_tilesDirty = false;
+			g_builtRetained = false;
+		}
+		setScreenProjection();
+		glUniform1f(g_gradScaleLocation, std::exp2(g_lodBias));
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+		drawRun(g_tileRun);
+	}
+
+	// Finds the slot caching `band`, or recycles the least recently used one
+	// that is not on screen this frame.
+	static int acquireBand(int band, size_t maxBands) {
+		int victim = -1;
+		for (int slot = 0; slot < (int)g_bands.size(); slot++) {
+			CachedBand& cached = g_bands[slot];
+			if (cached.band == band) {
+				cached.lastUsedFrame = g_frameCounter;
+				return slot;
+			}
+			if (cached.lastUsedFrame != g_frameCounter && (victim < 0 || cached.lastUsedFrame < g_bands[victim].lastUsedFrame)) {
+				victim = slot;
+			}
+		}
+
+		if (victim < 0 || g_bands.size() < maxBands) {
+			CachedBand cached;
+			glGenTextures(1, &cached.texture);
+			glBindTexture(GL_TEXTURE_2D, cached.texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, g_bandPixelWidth, g_bandPixelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			GLStats::CountCall(GLSource::App, GLCallKind::Object);
+			GLStats::CountCall(GLSource::App, GLCallKind::BindTexture);
+			GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 4);
+			GLStats::CountCall(GLSource::App, GLCallKind::TextureUpload);
+			g_bands.push_back(cached);
+			victim = (int)g_bands.size() - 1;
+		}
+
+		CachedBand& cached = g_bands[victim];
+		cached.band = band;
+		cached.valid = false;
+		cached.lastUsedFrame = g_frameCounter;
+		return victim;
+	}
+
+	static bool renderBands() {
+		// Strips go to their own framebuffers; the frame's target comes back after
+		GLint frameTarget = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &frameTarget);
+		glDisable(GL_SCISSOR_TEST);
+		glViewport(0, 0, g_bandPixelWidth, g_bandPixelHeight);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glUniform2f(g_originLocation, 0.0f, 0.0f);
+		glUniform1f(g_gradScaleLocation, std::exp2(g_lodBias));
+		GLStats::CountCall(GLSource::App, GLCallKind::StateQuery);
+		GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 5);
+
+		bool ok = true;
+		for (size_t k = 0; k < g_renderSlots.size(); k++) {
+			CachedBand& cached = g_bands[g_renderSlots[k]];
+			if (!cached.framebuffer) {
+				glGenFramebuffers(1, &cached.framebuffer);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cached.framebuffer);
+				glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cached.texture, 0);
+				GLStats::CountCall(GLSource::App, GLCallKind::Object);
+				GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+				if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+					std::cerr << "Error: Grid strip framebuffer is incomplete" << std::endl;
+					ok = false;
+					break;
+				}
+			}
+			else {
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cached.framebuffer);
+			}
+			glClear(GL_COLOR_BUFFER_BIT);
+			GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 2);
+
+			float top = cached.band * kGridCacheBandHeight;
+			setProjection(g_bandLeft, g_bandLeft + g_bandWidth, top, top + kGridCacheBandHeight);
+			drawRun(g_bandRuns[k]);
+			cached.valid = true;
+			cached.lodBias = g_lodBias;
+		}
+
+		const FrameState& frame = g_frame;
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)frameTarget);
+		glViewport(0, 0, (GLsizei)(frame.displaySize.x * frame.framebufferScale.x), (GLsizei)(frame.displaySize.y * frame.framebufferScale.y));
+		glEnable(GL_SCISSOR_TEST);
+		GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 3);
+		g_stats.bandsRendered = (int)g_renderSlots.size();
+		return ok;
+	}
+
+	static bool renderRetained(const ImVec4& clipRect) {
+		const FrameState& frame = g_frame;
+
+		// Strips span the visible columns of the window, snapped to whole pixels
+		float left = std::floor(clipRect.x - frame.originX);
+		float width = std::ceil(clipRect.z - frame.originX) - left;
+		int pixelWidth = (int)std::ceil(width * frame.framebufferScale.x);
+		int pixelHeight = (int)std::ceil(kGridCacheBandHeight * frame.framebufferScale.y);
+		if (left != g_bandLeft || width != g_bandWidth || pixelWidth != g_bandPixelWidth || pixelHeight != g_bandPixelHeight) {
+			releaseBands();
+			g_bandLeft = left;
+			g_bandWidth = width;
+			g_bandPixelWidth = pixelWidth;
+			g_bandPixelHeight = pixelHeight;
+		}
+
+		int firstBand = std::max(0, (int)std::floor((clipRect.y - frame.originY) / kGridCacheBandHeight));
+		int lastBand = (int)std::floor((clipRect.w - frame.originY - 1.0f) / kGridCacheBandHeight);
+		if (lastBand < firstBand) {
+			return true;
+		}
+
+		// About three screens stay cached: the visible strips and one screen either side
+		size_t maxBands = (size_t)(lastBand - firstBand + 1) * 3;
+		static std::vector<int> visibleSlots;
+		visibleSlots.clear();
+		g_renderSlots.clear();
+		for (int band = firstBand; band <= lastBand; band++) {
+			int slot = acquireBand(band, maxBands);
+			visibleSlots.push_back(slot);
+			// Strips drawn at a coarser mip level than wanted now are redone
+			if (!g_bands[slot].valid || g_bands[slot].lodBias > g_lodBias) {
+				g_renderSlots.push_back(slot);
+			}
+		}
+
+		if (!g_builtRetained || !g_renderSlots.empty() || visibleSlots != g_compositeSlots) {
+			g_instances.clear();
+			g_batches.clear();
+			g_bandRuns.clear();
+			for (int slot : g_renderSlots) {
+				float top = g_bands[slot].band * kGridCacheBandHeight;
+				Run run;
+				for (const GridTile& tile : g_tiles) {
+					if (tile.y < top + kGridCacheBandHeight && tile.y + tile.height > top) {
+						addInstance(run, tileInstance(tile), tile.texture);
+					}
+				}
+				g_bandRuns.push_back(run);
+			}
+			g_compositeRun = Run();
+			for (int slot : visibleSlots) {
+				const CachedBand& cached = g_bands[slot];
+				// Texture rows run bottom-up, so the strip is sampled flipped
+				Instance strip = { { g_bandLeft, cached.band * kGridCacheBandHeight, g_bandWidth, kGridCacheBandHeight }, { 0.0f, 1.0f, 1.0f, 0.0f }, -1 };
+				addInstance(g_compositeRun, strip, cached.texture);
+			}
+			uploadInstances();
+			g_compositeSlots = visibleSlots;
+			g_builtRetained = true;
+			g_tilesDirty = false;
+		}
+
+		if (!g_renderSlots.empty() && !renderBands()) {
+			return false;
+		}
+
+		// Strips hold premultiplied colour: cleared to transparent, then
+		// blended with the usual alpha
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+		setScreenProjection();
+		drawRun(g_compositeRun);
+		return true;
+	}
+
+	static void drawCallback(const ImDrawList*, const ImDrawCmd* cmd) {
+		if (!g_initialized) {
+			g_initialized = true;
+			g_failed = !initialize();
+			if (g_failed) {
+				std::cerr << "Warning: Falling back to drawing the grid through ImGui" << std::endl;
+				Shutdown();
+				g_failed = true;
+				return;
+			}
+		}
+		if (g_failed) {
+			return;
+		}
+		g_frameCounter++;
+		g_stats.batches = 0;
+		g_stats.bandsRendered = 0;
+
+		const FrameState& frame = g_frame;
+		float framebufferHeight = frame.displaySize.y * frame.framebufferScale.y;
+		ImVec2 clipMin((cmd->ClipRect.x - frame.displayPos.x) * frame.framebufferScale.x, (cmd->ClipRect.y - frame.displayPos.y) * frame.framebufferScale.y);
+		ImVec2 clipMax((cmd->ClipRect.z - frame.displayPos.x) * frame.framebufferScale.x, (cmd->ClipRect.w - frame.displayPos.y) * frame.framebufferScale.y);
+		if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) {
+			return;
+		}
+
+		VGS_GL_PASS(GLPass::Grid);
+		glUseProgram(g_program);
+		glBindVertexArray(g_vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffer);
+		glScissor((int)clipMin.x, (int)(framebufferHeight - clipMax.y), (int)(clipMax.x - clipMin.x), (int)(clipMax.y - clipMin.y));
+		GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 4);
+
+		if (g_retained && !renderRetained(cmd->ClipRect)) {
+			std::cerr << "Warning: Turning the retained grid off" << std::endl;
+			SetRetained(false);
+		}
+		if (!g_retained) {
+			renderImmediate();
+		}
+
+		// The renderer resets its own state after the callback; unit 0 is the
+		// one it expects to be active
+		glActiveTexture(GL_TEXTURE0);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+	}
+
+	void SetTiles(const GridTile* tiles, size_t count) {
+		g_tiles.assign(tiles, tiles + count);
+		g_tilesDirty = true;
+		g_stats.tiles = count;
+	}
+
+	bool Submit(ImDrawList* drawList, float originX, float originY) {
+		if (!g_enabled || g_failed) {
+			return false;
+		}
+		const ImGuiViewport* viewport = ImGui::GetWindowViewport();
+		g_frame.originX = originX;
+		g_frame.originY = originY;
+		g_frame.displayPos = viewport->Pos;
+		g_frame.displaySize = viewport->Size;
+		// Same fallback ImGui uses for ImDrawData::FramebufferScale
+		g_frame.framebufferScale = viewport->FramebufferScale.x != 0.0f ? viewport->FramebufferScale : ImGui::GetIO().DisplayFramebufferScale;
+
+		drawList->AddCallback(drawCallback, nullptr);
+		drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+		return true;
+	}
+
+	GridRendererStats GetStats() {
+		GridRendererStats stats = g_stats;
+		stats.active = g_enabled && g_initialized && !g_failed;
+		stats.textureUnits = g_textureUnits;
+		stats.retained = g_retained;
+		for (const CachedBand& cached : g_bands) {
+			stats.cachedBands += cached.valid ? 1 : 0;
+		}
+		stats.cacheBytes = g_bands.size() * (size_t)g_bandPixelWidth * g_bandPixelHeight * 4;
+		return stats;
+	}
+
+	void Shutdown() {
+		releaseBands();
+		if (g_buffer) {
+			glDeleteBuffers(1, &g_buffer);
+			g_buffer = 0;
+		}
+		if (g_vertexArray) {
+			glDeleteVertexArrays(1, &g_vertexArray);
+			g_vertexArray = 0;
+		}
+		if (g_program) {
+			glDeleteProgram(g_program);
+			g_program = 0;
+		}
+		g_capacity = 0;
+		g_initialized = false;
+		// The buffer is gone, so the next draw has to upload again
+		g_tilesDirty = true;
+	}
+}
@@ -0,0 +1,73 @@
+#include "image_catalog.h"
+
+uint32_t ImageCatalog::Add(std::string_view filePath, size_t fileNameOffset, int fullWidth, int fullHeight, int thumbWidth, int thumbHeight) {
+	uint32_t index = (uint32_t)Size();
+
+	thumbnailTexture.emplace_back();
+	thumbnailWidth.push_back((uint16_t)thumbWidth);
+	thumbnailHeight.push_back((uint16_t)thumbHeight);
+	layoutX.push_back(0.0f);
+	layoutY.push_back(0.0f);
+	layoutWidth.push_back(0.0f);
+	layoutHeight.push_back(0.0f);
+	thumbnailState.push_back(ThumbnailState::NotLoaded);
+	lastWantedFrame.push_back(0);
+
+	pathOffset.push_back((uint32_t)pathArena.size());
+	pathLength.push_back((uint32_t)filePath.size());
+	nameOffset.push_back((uint16_t)fileNameOffset);
+	pathArena.append(filePath);
+	fullResWidth.push_back((uint32_t)fullWidth);
+	fullResHeight.push_back((uint32_t)fullHeight);
+	fullResTexture.emplace_back();
+	fullResFlags.push_back(0);
+	largeThumbnailFlags.push_back(0);
+	thumbnailChannels.push_back(4);
+
+	return index;
+}
+
+std::string ImageCatalog::ThumbnailPath(size_t index) const {
+	std::string path;
+	std::string_view fileName = FileName(index);
+	path.reserve(thumbnailDir.size() + 1 + fileName.size() + 10);
+	path.append(thumbnailDir);
+	path.push_back('/');
+	path.append(fileName);
+	path.append(".thumb.png");
+	return path;
+}
+
+std::string ImageCatalog::LargeThumbnailPath(size_t index) const {
+	std::string path = ThumbnailPath(index);
+	path.replace(path.size() - 4, 4, ".large.png");
+	return path;
+}
+
+void ImageCatalog::Reserve(size_t count, size_t pathBytes) {
+	thumbnailTexture.reserve(count);
+	thumbnailWidth.reserve(count);
+	thumbnailHeight.reserve(count);
+	layoutX.reserve(count);
+	layoutY.reserve(count);
+	layoutWidth.reserve(count);
+	layoutHeight.reserve(count);
+	thumbnailState.reserve(count);
+	lastWantedFrame.reserve(count);
+	pathOffset.reserve(count);
+	pathLength.reserve(count);
+	nameOffset.reserve(count);
+	fullResWidth.reserve(count);
+	fullResHeight.reserve(count);
+	fullResTexture.reserve(count);
+	fullResFlags.reserve(count);
+	largeThumbnailFlags.reserve(count);
+	thumbnailChannels.reserve(count);
+	pathArena.reserve(pathBytes);
+}
+
+void ImageCatalog::Clear() {
+	// Swap with empty containers so a large previous folder releases its
+	// memory. Texture handles queue their names for deletion on the way out.
+	*this = ImageCatalog();
+}
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "image_codec.h"
+#include "jpeg_decoder.h"
+#include "png_decoder.h"
+#include "stb_image.h"
+
+namespace
+{
+	// Enough for the header of most files; JPEGs with a large Exif block
+	// ahead of the frame header are read again, 16 times as far
+	const size_t kInfoFirstRead = 4096;
+
+	// A malloc'd buffer for `width` x `height` x `channels` pixels in `out`
+	unsigned char* allocatePixels(DecodedImage& out, int width, int height, int channels) {
+		out.pixels = { (unsigned char*)std::malloc((size_t)width * height * channels), std::free };
+		out.width = width;
+		out.height = height;
+		out.channels = channels;
+		return out.pixels.get();
+	}
+
+	// JPEGs with restart markers, split over the ResizeService pool
+	class RestartJpegCodec : public ImageCodec {
+	public:
+		const char* Name() const override { return "jpeg-restart"; }
+
+		bool Handles(ImageFormat format) const override { return format == ImageFormat::Jpeg; }
+
+		bool Info(const unsigned char* data, size_t size, ImageInfo& info) const override {
+			JpegDecoder decoder;
+			if (!decoder.Open(data, size)) {
+				return false;
+			}
+			info.width = decoder.GetWidth();
+			info.height = decoder.GetHeight();
+			info.channels = 3;
+			return true;
+		}
+
+		bool Decode(const unsigned char* data, size_t size, DecodedImage& out) const override {
+			JpegDecoder decoder;
+			if (!decoder.Open(data, size)) {
+				return false;
+			}
+			return DecodeRows(decoder, 0, decoder.GetHeight(), out);
+		}
+
+		bool DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out) const override {
+			JpegDecoder decoder;
+			if (!decoder.Open(data, size)) {
+				return false;
+			}
+			return DecodeRows(decoder, firstRow, rowCount, out);
+		}
+
+	private:
+		static bool DecodeRows(const JpegDecoder& decoder, int firstRow, int rowCount, DecodedImage& out) {
+			if (firstRow < 0 || rowCount <= 0 || rowCount > decoder.GetHeight() - firstRow) {
+				return false;
+			}
+			unsigned char* pixels = allocatePixels(out, decoder.GetWidth(), rowCount, 3);
+			return pixels && decoder.DecodeRows(firstRow, rowCount, pixels);
+		}
+	};
+
+	// Non-interlaced 8-bit PNGs without palette or transparency chunk
+	class PngCodec : public ImageCodec {
+	public:
+		const char* Name() const override { return "png"; }
+
+		bool Handles(ImageFormat format) const override { return format == ImageFormat::Png; }
+
+		bool Info(const unsigned char* data, size_t size, ImageInfo& info) const override {
+			PngDecoder decoder;
+			if (!decoder.Open(data, size)) {
+				return false;
+			}
+			info.width = decoder.GetWidth();
+			info.height = decoder.GetHeight();
+			info.channels = decoder.GetChannels();
+			return true;
+		}
+
+		bool Decode(const unsigned char* data, size_t size, DecodedImage& out) const override {
+			PngDecoder decoder;
+			if (!decoder.Open(data, size)) {
+				return false;
+			}
+			// The pixels end up at the start of the buffer, ahead of a filter
+			// byte per row that is not worth a reallocation
+			out.pixels = { (unsigned char*)std::malloc(decoder.GetBufferSize()), std::free };
+			out.width = decoder.GetWidth();
+			out.height = decoder.GetHeight();
+			out.channels = decoder.GetChannels();
+			return out.pixels && decoder.Decode(out.pixels.get());
+		}
+	};
+
+	// Whatever stb_image makes of a file, corrupt ones included
+	class StbImageCodec : public ImageCodec {
+	public:
+		const char* Name() const override { return "stb_image"; }
+
+		bool Handles(ImageFormat format) const override {
+			return format == ImageFormat::Png || format == ImageFormat::Jpeg || format == ImageFormat::Bmp;
+		}
+
+		bool Info(const unsigned char* data, size_t size, ImageInfo& info) const override {
+			return size <= INT_MAX && stbi_info_from_memory(data, (int)size, &info.width, &info.height, &info.channels) != 0 &&
+				info.width > 0 && info.height > 0;
+		}
+
+		bool Decode(const unsigned char* data, size_t size, DecodedImage& out) const override {
+			if (size > INT_MAX) {
+				return false;
+			}
+			out.pixels = { stbi_load_from_memory(data, (int)size, &out.width, &out.height, &out.channels, 0), stbi_image_free };
+			return out.pixels != nullptr;
+		}
+	};
+
+	const char* const kFormatNames[] = { "unknown", "png", "jpeg", "bmp", "webp" };
+	static_assert(sizeof(kFormatNames) / sizeof(kFormatNames[0]) == (size_t)ImageFormat::Count);
+
+	struct FormatExtension {
+		const char* extension;
+		ImageFormat format;
+	};
+
+	const FormatExtension kExtensions[] = {
+		{ ".png", ImageFormat::Png },
+		{ ".jpg", ImageFormat::Jpeg },
+		{ ".jpeg", ImageFormat::Jpeg },
+		{ ".bmp", ImageFormat::Bmp },
+		{ ".webp", ImageFormat::WebP },
+	};
+}
+
+const char* ImageFormatName(ImageFormat format) {
+	return (size_t)format < (size_t)ImageFormat::Count ? kFormatNames[(size_t)format] : "unknown";
+}
+
+bool ImageCodec::DecodeScaled(const unsigned char* data, size_t size, int /*minWidth*/, int /*minHeight*/, DecodedImage& out) const {
+	return Decode(data, size, out);
+}
+
+bool ImageCodec::DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out) const {
+	DecodedImage whole;
+	if (!Decode(data, size, whole) || firstRow < 0 || rowCount <= 0 || rowCount > whole.height - firstRow) {
+		return false;
+	}
+	size_t stride = (size_t)whole.width * whole.channels;
+	unsigned char* pixels = allocatePixels(out, whole.width, rowCount, whole.channels);
+	if (!pixels) {
+		return false;
+	}
+	std::memcpy(pixels, whole.pixels.get() + firstRow * stride, rowCount * stride);
+	return true;
+}
+
+namespace ImageCodecs
+{
+	static std::vector<ImageCodec*> createCodecs() {
+		static RestartJpegCodec restartJpeg;
+		static PngCodec png;
+		static StbImageCodec stbImage;
+		std::vector<ImageCodec*> codecs;
+		codecs.push_back(&restartJpeg);
+#ifdef VGS_WITH_LIBJPEG_TURBO
+		static std::unique_ptr<ImageCodec> libjpegTurbo = CreateLibjpegTurboCodec();
+		codecs.push_back(libjpegTurbo.get());
+#endif
+		codecs.push_back(&png);
+		codecs.push_back(&stbImage);
+		return codecs;
+	}
+
+	static std::vector<ImageCodec*>& codecs() {
+		static std::vector<ImageCodec*> list = createCodecs();
+		return list;
+	}
+
+	const std::vector<ImageCodec*>& GetCodecs() {
+		return codecs();
+	}
+
+	ImageCodec* Find(const char* name) {
+		for (ImageCodec* codec : codecs()) {
+			if (std::strcmp(codec->Name(), name) == 0) {
+				return codec;
+			}
+		}
+		return nullptr;
+	}
+
+	bool SetPreferred(const std::string& names) {
+		std::vector<ImageCodec*> order;
+		size_t start = 0;
+		while (start <= names.size()) {
+			size_t end = std::min(names.find(',', start), names.size());
+			std::string name = names.substr(start, end - start);
+			start = end + 1;
+			if (name.empty()) {
+				continue;
+			}
+			ImageCodec* codec = Find(name.c_str());
+			if (!codec) {
+				std::cerr << "Error: Unknown image codec " << name << std::endl;
+				return false;
+			}
+			if (std::find(order.begin(), order.end(), codec) == order.end()) {
+				order.push_back(codec);
+			}
+		}
+		for (ImageCodec* codec : codecs()) {
+			if (std::find(order.begin(), order.end(), codec) == order.end()) {
+				order.push_back(codec);
+			}
+		}
+		codecs() = order;
+		return true;
+	}
+
+	ImageFormat Sniff(const unsigned char* data, size_t size) {
+		static const unsigned char pngSignature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+		if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0) {
+			return ImageFormat::Png;
+		}
+		if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+			return ImageFormat::Jpeg;
+		}
+		if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+			return ImageFormat::Bmp;
+		}
+		if (size >= 12 && std::memcmp(data, "RIFF", 4) == 0 && std::memcmp(data + 8, "WEBP", 4) == 0) {
+			return ImageFormat::WebP;
+		}
+		return ImageFormat::Unknown;
+	}
+
+	bool IsSupported(ImageFormat format) {
+		for (ImageCodec* codec : codecs()) {
+			if (codec->Handles(format)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IsSupportedExtension(const std::string& extension) {
+		std::string lower = extension;
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		for (const FormatExtension& entry : kExtensions) {
+			if (lower == entry.extension) {
+				return IsSupported(entry.format);
+			}
+		}
+		return false;
+	}
+
+	// Offers the file to each codec of its format in turn, until `call`
+	// succeeds with one. With `scalingFirst` the codecs that scale go ahead
+	// of the others, in the same order among themselves.
+	template <typename Call>
+	static bool firstTaker(const unsigned char* data, size_t size, Call call, bool scalingFirst = false) {
+		ImageFormat format = Sniff(data, size);
+		if (format == ImageFormat::Unknown) {
+			return false;
+		}
+		for (int pass = scalingFirst ? 0 : 1; pass < 2; pass++) {
+			for (ImageCodec* codec : codecs()) {
+				bool inPass = !scalingFirst || codec->Scales() == (pass == 0);
+				if (inPass && codec->Handles(format) && call(*codec)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool Info(const unsigned char* data, size_t size, ImageInfo& info) {
+		info.format = Sniff(data, size);
+		return firstTaker(data, size, [&](const ImageCodec& codec) {
+			return codec.Info(data, size, info);
+		});
+	}
+
+	bool Decode(const unsigned char* data, size_t size, DecodedImage& out) {
+		return firstTaker(data, size, [&](const ImageCodec& codec) {
+			return codec.Decode(data, size, out);
+		});
+	}
+
+	bool DecodeScaled(const unsigned char* data, size_t size, int minWidth, int minHeight, DecodedImage& out) {
+		return firstTaker(data, size, [&](const ImageCodec& codec) {
+			return codec.DecodeScaled(data, size, minWidth, minHeight, out);
+		}, true);
+	}
+
+	bool DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out) {
+		return firstTaker(data, size, [&](const ImageCodec& codec) {
+			return codec.DecodeRows(data, size, firstRow, rowCount, out);
+		});
+	}
+
+	bool InfoFromFile(const char* path, ImageInfo& info) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			return false;
+		}
+		std::streamsize fileSize = file.tellg();
+		if (fileSize <= 0) {
+			return false;
+		}
+		file.seekg(0, std::ios::beg);
+
+		std::vector<unsigned char> head;
+		for (size_t limit = kInfoFirstRead;; limit *= 16) {
+			size_t have = head.size();
+			head.resize(std::min(limit, (size_t)fileSize));
+			if (!file.read((char*)head.data() + have, (std::streamsize)(head.size() - have))) {
+				return false;
+			}
+			if (Info(head.data(), head.size(), info)) {
+				return true;
+			}
+			if (head.size() == (size_t)fileSize) {
+				return false;
+			}
+		}
+	}
+}
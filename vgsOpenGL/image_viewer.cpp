@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_viewer.h"
+#include "application.h"
+#include "folder_scan.h"
+#include "gl_stats.h"
+#include "imgui.h"
+#include "texture.h"
+#include "thumbnail.h"
+#include "trace.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+namespace ImageViewer
+{
+	// Pixel rows uploaded per frame, in bytes; at least one row always goes
+	static const uint64_t kUploadBytesPerFrame = 4u * 1024u * 1024u;
+
+	using Clock = std::chrono::steady_clock;
+
+	enum class Stage {
+		Thumbnail,  // Only decoded when the grid has none resident
+		Preview,    // The cached large thumbnail, or else a downscale of the source
+		Full        // Every level of the mip chain, full size first
+	};
+
+	struct DecodeJob {
+		uint64_t id = 0;
+		std::string filePath;
+		std::string thumbnailPath;
+		std::string largeThumbnailPath;  // Empty to skip the cached preview
+		int previewWidth = 0;            // Of a preview made from the source instead, 0 for none
+		int previewHeight = 0;
+		bool needThumbnail = false;
+	};
+
+	struct DecodedStage {
+		uint64_t job = 0;
+		Stage stage = Stage::Full;
+		std::vector<ThumbnailPixels> levels;
+	};
+
+	// Decode thread, guarded by g_mutex
+	static std::thread g_worker;
+	static std::mutex g_mutex;
+	static std::condition_variable g_wakeWorker;
+	static std::condition_variable g_becameIdle;   // Also when a stage is posted
+	static std::condition_variable g_stageTaken;
+	static DecodeJob g_job;
+	static bool g_jobPending = false;
+	static bool g_busy = false;
+	static bool g_stopping = false;
+	static bool g_stepped = false;  // Each stage waits for a frame to take it (Drain())
+	static std::vector<DecodedStage> g_decoded;
+	static std::function<void()> g_onResultReady;
+
+	// Render thread
+	struct ViewerState {
+		bool open = false;
+		size_t index = 0;
+		uint64_t job = 0;
+		Clock::time_point openedAt;
+
+		TextureHandle thumbnail;      // Only when the grid had none resident
+		int thumbnailWidth = 0;
+		TextureHandle preview;
+		int previewWidth = 0;
+
+		// Levels [skippedLevels, levels.size()) make up the full texture.
+		// They are uploaded from the last (smallest) one up, and levels
+		// [completeLevel, levels.size()) are on the GPU already; their
+		// pixels are freed, only the sizes are kept.
+		std::vector<ThumbnailPixels> levels;
+		TextureHandle full;
+		int skippedLevels = 0;        // Larger than GL_MAX_TEXTURE_SIZE
+		int completeLevel = 0;
+		int uploadRow = 0;            // Next row of level completeLevel - 1
+	};
+
+	static ViewerState g_viewer;
+	static ImageViewerStats g_stats;
+	static uint64_t g_nextJob = 0;
+	static GLint g_maxTextureSize = 0;
+
+	static double msSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	static void post(DecodedStage&& stage) {
+		uint64_t job = stage.job;
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			if (job != g_job.id) {
+				return; // The viewer moved on to another image meanwhile
+			}
+			g_decoded.push_back(std::move(stage));
+		}
+		g_becameIdle.notify_all();
+		if (g_onResultReady) {
+			g_onResultReady();
+		}
+		std::unique_lock<std::mutex> lock(g_mutex);
+		g_stageTaken.wait(lock, [job] { return !g_stepped || g_decoded.empty() || job != g_job.id || g_stopping; });
+	}
+
+	static bool cancelled(uint64_t job) {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		return job != g_job.id || g_stopping;
+	}
+
+	static void decode(const DecodeJob& job) {
+		if (job.needThumbnail) {
+			DecodedStage stage{ job.id, Stage::Thumbnail, std::vector<ThumbnailPixels>(1) };
+			if (loadThumbnailPixels(job.thumbnailPath.c_str(), stage.levels[0])) {
+				buildMipChain(stage.levels[0]);
+				post(std::move(stage));
+			}
+		}
+		if (!job.largeThumbnailPath.empty() && !cancelled(job.id)) {
+			DecodedStage stage{ job.id, Stage::Preview, std::vector<ThumbnailPixels>(1) };
+			if (loadThumbnailPixels(job.largeThumbnailPath.c_str(), stage.levels[0])) {
+				buildMipChain(stage.levels[0]);
+				post(std::move(stage));
+			}
+		}
+
+		if (cancelled(job.id)) {
+			return;
+		}
+		// Without a cached preview, one is made while decoding the source,
+		// ahead of the full image's mip chain
+		auto postPreview = [&job](ThumbnailPixels&& pixels) {
+			if (cancelled(job.id)) {
+				return;
+			}
+			DecodedStage stage{ job.id, Stage::Preview, std::vector<ThumbnailPixels>(1) };
+			stage.levels[0] = std::move(pixels);
+			buildMipChain(stage.levels[0]);
+			post(std::move(stage));
+		};
+		DecodedStage stage{ job.id, Stage::Full, std::vector<ThumbnailPixels>(1) };
+		bool loaded = job.previewWidth > 0 ?
+			loadImagePixels(job.filePath.c_str(), stage.levels[0], job.previewWidth, job.previewHeight, postPreview) :
+			loadImagePixels(job.filePath.c_str(), stage.levels[0]);
+		if (!loaded) {
+			return;
+		}
+		{
+			VGS_TRACE_SCOPE("Viewer mip chain");
+			while (stage.levels.back().width > 1 || stage.levels.back().height > 1) {
+				if (cancelled(job.id)) {
+					return;
+				}
+				ThumbnailPixels next;
+				downsampleHalf(stage.levels.back(), next);
+				stage.levels.push_back(std::move(next));
+			}
+		}
+		post(std::move(stage));
+	}
+
+	static void workerMain() {
+		Trace::SetThreadName("Viewer decode");
+		for (;;) {
+			DecodeJob job;
+			{
+				std::unique_lock<std::mutex> lock(g_mutex);
+				g_wakeWorker.wait(lock, [] { return g_stopping || g_jobPending; });
+				if (g_stopping) {
+					return;
+				}
+				job = g_job;
+				g_jobPending = false;
+				g_busy = true;
+			}
+
+			{
+				VGS_TRACE_SCOPE("Viewer decode");
+				decode(job);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(g_mutex);
+				g_busy = false;
+				if (!g_jobPending) {
+					g_becameIdle.notify_all();
+				}
+			}
+		}
+	}
+
+	// Hands out the stages decoded for the open image since the last frame
+	static void takeDecoded(std::vector<DecodedStage>& out) {
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			out.swap(g_decoded);
+			g_decoded.clear();
+		}
+		g_stageTaken.notify_all();
+	}
+
+	static void startFullTexture(std::vector<ThumbnailPixels>&& levels) {
+		if (g_maxTextureSize == 0) {
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &g_maxTextureSize);
+			GLStats::CountCall(GLSource::App, GLCallKind::StateQuery);
+		}
+
+		// Levels too large for GL are left out; the next one down becomes level 0
+		int skipped = 0;
+		while (skipped + 1 < (int)levels.size() &&
+			std::max(levels[skipped].width, levels[skipped].height) > g_maxTextureSize) {
+			skipped++;
+		}
+		g_viewer.full = allocateTexture(levels[skipped].width, levels[skipped].height, levels[skipped].channels, (int)levels.size() - skipped);
+		if (!g_viewer.full) {
+			return;
+		}
+		for (int level = 0; level < skipped; level++) {
+			levels[level].pixels = std::vector<unsigned char>();
+		}
+		g_viewer.levels = std::move(levels);
+		g_viewer.skippedLevels = skipped;
+		g_viewer.completeLevel = (int)g_viewer.levels.size();
+		g_viewer.uploadRow = 0;
+		g_stats.levels = g_viewer.completeLevel - skipped;
+	}
+
+	// Uploads rows of the full image, coarsest level first, until this
+	// frame's byte budget is used up
+	static void uploadFullLevels() {
+		VGS_TRACE_SCOPE("Viewer upload");
+		uint64_t budget = kUploadBytesPerFrame;
+		while (budget > 0 && g_viewer.completeLevel > g_viewer.skippedLevels) {
+			int level = g_viewer.completeLevel - 1;
+			ThumbnailPixels& pixels = g_viewer.levels[level];
+			uint64_t rowBytes = (uint64_t)pixels.width * pixels.channels;
+			int rows = (int)std::clamp<uint64_t>(budget / rowBytes, 1, (uint64_t)(pixels.height - g_viewer.uploadRow));
+			uploadTextureRows(g_viewer.full.Get(), level - g_viewer.skippedLevels, pixels.width, pixels.channels, g_viewer.uploadRow, rows,
+				pixels.pixels.data() + g_viewer.uploadRow * rowBytes);
+			budget -= std::min(budget, rows * rowBytes);
+			g_viewer.uploadRow += rows;
+
+			if (g_viewer.uploadRow == pixels.height) {
+				// The finished level becomes the sharpest one sampled
+				int lastLevel = (int)g_viewer.levels.size() - 1 - g_viewer.skippedLevels;
+				setTextureLevels(g_viewer.full.Get(), level - g_viewer.skippedLevels, lastLevel);
+				pixels.pixels = std::vector<unsigned char>();
+				g_viewer.completeLevel = level;
+				g_viewer.uploadRow = 0;
+				g_stats.levelsUploaded++;
+			}
+		}
+	}
+
+	static void applyDecoded() {
+		static std::vector<DecodedStage> decoded;
+		takeDecoded(decoded);
+		for (DecodedStage& stage : decoded) {
+			if (stage.job != g_viewer.job) {
+				continue;
+			}
+			if (stage.stage == Stage::Full) {
+				startFullTexture(std::move(stage.levels));
+				continue;
+			}
+			const ThumbnailPixels& pixels = stage.levels[0];
+			TextureHandle texture = generateTexture(pixels.pixels.data(), pixels.width, pixels.height, pixels.channels, pixels.levels);
+			if (stage.stage == Stage::Thumbnail) {
+				g_viewer.thumbnail = std::move(texture);
+				g_viewer.thumbnailWidth = pixels.width;
+			}
+			else {
+				g_viewer.preview = std::move(texture);
+				g_viewer.previewWidth = pixels.width;
+			}
+		}
+		decoded.clear();
+	}
+
+	void Open(size_t index) {
+		Close();
+		if (index >= g_images.Size()) {
+			return;
+		}
+
+		g_viewer.open = true;
+		g_viewer.index = index;
+		g_viewer.job = ++g_nextJob;
+		g_viewer.openedAt = Clock::now();
+		g_stats = ImageViewerStats();
+		g_stats.open = true;
+		g_stats.width = (int)g_images.fullResWidth[index];
+		g_stats.height = (int)g_images.fullResHeight[index];
+
+		DecodeJob job;
+		job.id = g_viewer.job;
+		job.filePath = std::string(g_images.FilePath(index));
+		job.thumbnailPath = g_images.ThumbnailPath(index);
+		job.needThumbnail = g_images.thumbnailState[index] != ThumbnailState::Resident;
+		// No preview when the grid shows the large level already. Without a
+		// cached large thumbnail the preview, at the same size, comes from
+		// the source.
+		std::string largePath = g_images.LargeThumbnailPath(index);
+		if (!(g_images.largeThumbnailFlags[index] & LargeThumbnailResident)) {
+			if (std::filesystem::exists(largePath)) {
+				job.largeThumbnailPath = std::move(largePath);
+			}
+			else {
+				largeThumbnailSizeFor(g_stats.width, g_stats.height, job.previewWidth, job.previewHeight);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			g_job = std::move(job);
+			g_jobPending = true;
+			g_decoded.clear();
+			if (!g_worker.joinable()) {
+				g_stopping = false;
+				g_worker = std::thread(workerMain);
+			}
+		}
+		g_wakeWorker.notify_one();
+		g_stageTaken.notify_all();
+	}
+
+	void Close() {
+		if (!g_viewer.open) {
+			return;
+		}
+		{
+			// Whatever the decode thread is doing for this image is dropped
+			std::lock_guard<std::mutex> lock(g_mutex);
+			g_job.id = 0;
+			g_jobPending = false;
+			g_decoded.clear();
+		}
+		g_stageTaken.notify_all();
+		g_viewer = ViewerState();
+		g_stats.open = false;
+	}
+
+	bool IsOpen() {
+		return g_viewer.open;
+	}
+
+	bool IsAnimating() {
+		return g_viewer.open && g_viewer.full && g_viewer.completeLevel > g_viewer.skippedLevels;
+	}
+
+	void SetResultCallback(std::function<void()> callback) {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		g_onResultReady = std::move(callback);
+	}
+
+	void Drain() {
+		std::unique_lock<std::mutex> lock(g_mutex);
+		g_stepped = true;
+		g_becameIdle.wait(lock, [] { return g_stopping || !g_worker.joinable() || !g_decoded.empty() || (!g_jobPending && !g_busy); });
+	}
+
+	ImageViewerStats GetStats() {
+		return g_stats;
+	}
+
+	void Render() {
+		if (!g_viewer.open) {
+			return;
+		}
+		VGS_TRACE_SCOPE("ImageViewer::Render");
+		applyDecoded();
+		if (g_viewer.full && g_viewer.completeLevel > g_viewer.skippedLevels) {
+			uploadFullLevels();
+		}
+
+		// The sharpest of what is ready: the full texture from its finest
+		// uploaded level, the preview, or a thumbnail
+		size_t index = g_viewer.index;
+		GLuint texture = 0;
+		int textureWidth = 0;
+		int thumbnailWidth = 0;       // The grid's level, the preview is anything sharper
+		if (g_images.thumbnailState[index] == ThumbnailState::Resident) {
+			texture = g_images.thumbnailTexture[index].Get();
+			textureWidth = g_images.thumbnailWidth[index];
+			thumbnailWidth = textureWidth;
+			int largeWidth = 0, largeHeight = 0;
+			if ((g_images.largeThumbnailFlags[index] & LargeThumbnailResident) &&
+				largeThumbnailSizeFor(g_images.fullResWidth[index], g_images.fullResHeight[index], largeWidth, largeHeight)) {
+				textureWidth = largeWidth;
+			}
+		}
+		else if (g_viewer.thumbnail) {
+			texture = g_viewer.thumbnail.Get();
+			textureWidth = g_viewer.thumbnailWidth;
+			thumbnailWidth = textureWidth;
+		}
+		if (g_viewer.preview && g_viewer.previewWidth > textureWidth) {
+			texture = g_viewer.preview.Get();
+			textureWidth = g_viewer.previewWidth;
+		}
+		bool fullComplete = false;
+		if (g_viewer.full && g_viewer.completeLevel < (int)g_viewer.levels.size()) {
+			int fullWidth = g_viewer.levels[g_viewer.completeLevel].width;
+			fullComplete = g_viewer.completeLevel == g_viewer.skippedLevels;
+			if (fullWidth > textureWidth || fullComplete) {
+				texture = g_viewer.full.Get();
+				textureWidth = fullWidth;
+			}
+		}
+
+		if (texture != 0) {
+			if (g_stats.firstPixelMs < 0.0) {
+				g_stats.firstPixelMs = msSince(g_viewer.openedAt);
+			}
+			if (g_stats.previewMs < 0.0 && textureWidth > thumbnailWidth) {
+				g_stats.previewMs = msSince(g_viewer.openedAt);
+			}
+			if (g_stats.fullMs < 0.0 && fullComplete) {
+				g_stats.fullMs = msSince(g_viewer.openedAt);
+			}
+		}
+
+		ImGuiIO& io = ImGui::GetIO();
+		ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+		ImGui::SetNextWindowSize(io.DisplaySize);
+		bool windowOpen = true;
+		std::string_view fileName = g_images.FileName(index);
+		std::string title = std::string(fileName) + "###Viewer";
+		ImGui::Begin(title.c_str(), &windowOpen,
+			ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_NoResize |
+			ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoSavedSettings);
+
+		auto stageText = [](double ms, char* buffer, size_t size) {
+			if (ms < 0.0) {
+				snprintf(buffer, size, "-");
+			}
+			else {
+				snprintf(buffer, size, "%.1f ms", ms);
+			}
+			return buffer;
+		};
+		char firstPixel[32], preview[32], full[32];
+		ImGui::Text("%d x %d  |  first pixel %s  preview %s  full %s  |  levels %d/%d",
+			g_stats.width, g_stats.height,
+			stageText(g_stats.firstPixelMs, firstPixel, sizeof(firstPixel)),
+			stageText(g_stats.previewMs, preview, sizeof(preview)),
+			stageText(g_stats.fullMs, full, sizeof(full)),
+			g_stats.levelsUploaded, g_stats.levels);
+
+		// Fit the image into the rest of the window, keeping its aspect ratio
+		ImVec2 avail = ImGui::GetContentRegionAvail();
+		ImVec2 cursor = ImGui::GetCursorScreenPos();
+		float imageWidth = (float)std::max(1, g_stats.width);
+		float imageHeight = (float)std::max(1, g_stats.height);
+		float scale = std::min(avail.x / imageWidth, avail.y / imageHeight);
+		ImVec2 size(imageWidth * scale, imageHeight * scale);
+		ImVec2 imageMin(cursor.x + (avail.x - size.x) * 0.5f, cursor.y + (avail.y - size.y) * 0.5f);
+		ImVec2 imageMax(imageMin.x + size.x, imageMin.y + size.y);
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		if (texture != 0) {
+			drawList->AddImage((ImTextureID)(intptr_t)texture, imageMin, imageMax);
+		}
+		else {
+			drawList->AddRectFilled(imageMin, imageMax, IM_COL32(60, 60, 60, 255));
+		}
+
+		ImGui::End();
+
+		if (!windowOpen || ImGui::IsKeyPressed(ImGuiKey_Escape, false)) {
+			Close();
+		}
+	}
+
+	void Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			g_stopping = true;
+			g_job.id = 0;
+		}
+		g_wakeWorker.notify_all();
+		g_becameIdle.notify_all();
+		g_stageTaken.notify_all();
+		if (g_worker.joinable()) {
+			g_worker.join();
+		}
+		g_decoded.clear();
+		g_viewer = ViewerState();
+		g_stats = ImageViewerStats();
+	}
+}
@@ -9,103 +9,47 @@
 #include <cctype>
 #include <memory>
 #include <cstdlib>
+#include <functional>
 
-// Forward declarations for OpenGL types to avoid including GL/glew.h here
-// This is good practice for headers to reduce compilation dependencies.
-typedef unsigned int GLuint;
+#include "grid_layout.h"
+#include "image_catalog.h"
 
-// Structure to hold image information
-// This needs to be declared in the header so other files can use it.
-// Estructura para almacenar informacin de la imagen
-struct ImageData {
-    std::string filePath;
-    std::string thumbnailPath;
-    std::string fileName;
-
-    GLuint thumbnailTextureID = 0;
-    int thumbnailWidth = 0;
-    int thumbnailHeight = 0;
-
-    GLuint fullResTextureID = 0;
-    int fullResWidth = 0;
-    int fullResHeight = 0;
-
-    std::atomic<bool> isLoadingFullRes = false;
-    std::atomic<bool> fullResLoaded = false;
-
-    // --- Add a custom move constructor ---
-    ImageData(ImageData&& other) noexcept
-        : filePath(std::move(other.filePath)),
-        thumbnailPath(std::move(other.thumbnailPath)),
-        fileName(std::move(other.fileName)),
-        thumbnailTextureID(other.thumbnailTextureID),
-        thumbnailWidth(other.thumbnailWidth),
-        thumbnailHeight(other.thumbnailHeight),
-        fullResTextureID(other.fullResTextureID),
-        fullResWidth(other.fullResWidth),
-        fullResHeight(other.fullResHeight),
-        isLoadingFullRes(other.isLoadingFullRes.load()), // Atomically load value
-        fullResLoaded(other.fullResLoaded.load())         // Atomically load value
-    {
-        // Reset other's texture IDs to prevent double deletion
-        other.thumbnailTextureID = 0;
-        other.fullResTextureID = 0;
-    }
+extern std::string g_thumbnailCacheDir;
+extern std::string g_selectedFolderPath;
+extern ImageCatalog g_images; 
 
-    // --- Add a custom move assignment operator ---
-    ImageData& operator=(ImageData&& other) noexcept {
-        if (this != &other) {
-            // Clean up current resources before moving
-            // If you had textures loaded here, you'd delete them
-            // deleteTexture(thumbnailTextureID); // Assuming deleteTexture is available
-            // deleteTexture(fullResTextureID);
+// Budgets for the VRAM (resident textures) and RAM (LZ4-compressed) thumbnail tiers.
+// Defaults can be overridden with VGS_VRAM_BUDGET_MB and VGS_RAM_CACHE_MB.
+extern size_t g_vramBudgetBytes;
+extern size_t g_ramCacheBudgetBytes;
 
-            filePath = std::move(other.filePath);
-            thumbnailPath = std::move(other.thumbnailPath);
-            fileName = std::move(other.fileName);
-            thumbnailTextureID = other.thumbnailTextureID;
-            thumbnailWidth = other.thumbnailWidth;
-            thumbnailHeight = other.thumbnailHeight;
-            fullResTextureID = other.fullResTextureID;
-            fullResWidth = other.fullResWidth;
-            fullResHeight = other.fullResHeight;
-            isLoadingFullRes = other.isLoadingFullRes.load();
-            fullResLoaded = other.fullResLoaded.load();
+void LoadFolder(); 
 
-            // Reset other's texture IDs to prevent double deletion
-            other.thumbnailTextureID = 0;
-            other.fullResTextureID = 0;
-        }
-        return *this;
-    }
+namespace App
+{
+    void RenderUI();
+    void Shutdown();
 
-    // --- Delete copy constructor and copy assignment operator ---
-    // This explicitly tells the compiler that ImageData cannot be copied.
-    ImageData(const ImageData&) = delete;
-    ImageData& operator=(const ImageData&) = delete;
+    // Called from loader threads whenever a background result is ready, so an
+    // idle main loop can wake up and consume it.
+    void SetBackgroundWakeCallback(std::function<void()> callback);
 
-    // --- Default constructor is still needed ---
-    ImageData() = default;
+    // True while work is queued for upcoming frames (e.g. deferred uploads)
+    // and the main loop must keep producing frames without new input.
+    bool IsAnimating();
 
-    // --- Destructor to clean up OpenGL textures ---
-    // This is important when ImageData objects are destroyed (e.g., when g_images is cleared)
-    // You'll need to define deleteTexture in your .cpp or ensure it's linked.
-    ~ImageData() {
-        // Assuming deleteTexture is defined in your .cpp or globally accessible
-        // deleteTexture(thumbnailTextureID);
-        // deleteTexture(fullResTextureID);
-    }
-};
+    // Replaces the folder dialog of LoadFolder(). The picker returns the
+    // folder to load, or an empty string for "cancelled".
+    void SetFolderPicker(std::function<std::string()> picker);
 
-extern std::string g_thumbnailCacheDir;
-extern std::string g_selectedFolderPath;
-extern std::vector<ImageData> g_images; 
+    // Finishes every queued thumbnail load and viewer decode, and holds new
+    // loads back until the next call. Replays call it once per frame for a deterministic workload.
+    void DrainLoads();
 
-void LoadFolder(); 
+    // Masonry by default; VGS_GRID_LAYOUT or the grid's context menu switch it.
+    void SetGridLayout(GridLayoutKind kind);
+    GridLayoutKind GetGridLayout();
 
-namespace App
-{
-    void RenderUI();
     void RenderLoadUI();
 	void RenderImageGridUI();
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Width every thumbnail is generated at; heights follow the aspect ratio.
+static const int kThumbnailMaxWidth = 300;
+
+// Width of the sharper thumbnail level that is loaded for tiles zoomed
+// larger than kThumbnailMaxWidth.
+static const int kThumbnailLargeWidth = 1024;
+
+// True for the file extensions of formats some image codec decodes.
+bool isSupportedImageFile(const std::filesystem::path& path);
+
+// Recursively collects the supported image files under `folder`.
+std::vector<std::string> scanImageFolder(const std::string& folder);
+
+// Reads the image dimensions from the file header without decoding it.
+bool probeImage(const char* path, int& width, int& height, int& channels);
+
+// Thumbnail size for an image of the given dimensions.
+void thumbnailSizeFor(int fullWidth, int fullHeight, int& thumbnailWidth, int& thumbnailHeight);
+
+// Size of the large thumbnail level, never wider than the image itself.
+// False when the image is not wider than the base thumbnail.
+bool largeThumbnailSizeFor(int fullWidth, int fullHeight, int& thumbnailWidth, int& thumbnailHeight);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Counters for one reporting interval of the main loop
+struct FrameLoopStats {
+    uint64_t wakeups = 0;          // Returns from glfwWaitEventsTimeout
+    uint64_t framesRendered = 0;
+    uint64_t framesSkipped = 0;    // Loop iterations with nothing to redraw
+    double cpuPercent = 0.0;       // Process CPU time / wall time
+    double intervalSeconds = 0.0;
+};
+
+// Decides when the main loop has to produce a frame. Input callbacks and
+// background threads request frames; when nothing is pending and nothing is
+// animating the loop blocks in glfwWaitEventsTimeout instead of redrawing an
+// unchanged UI.
+class FramePacer {
+public:
+    // ImGui needs a couple of frames after an event to settle hover state,
+    // tooltips and window sizes.
+    static const int kSettleFrames = 3;
+
+    // Safe to call from any thread.
+    void RequestFrames(int count = kSettleFrames);
+
+    // True if the loop may block waiting for events this iteration.
+    bool CanSleep(bool animating) const;
+
+    // Consumes one pending frame. Returns false if this iteration can be skipped.
+    bool BeginFrame(bool animating);
+
+    void CountWakeup() { current.wakeups++; }
+
+    // Rolls the reporting interval once `intervalSeconds` have passed and
+    // returns true when a new completed interval is available.
+    bool UpdateStats(double nowSeconds, double intervalSeconds);
+    const FrameLoopStats& GetLastStats() const { return last; }
+
+private:
+    std::atomic<int> pendingFrames{ kSettleFrames };
+    FrameLoopStats current;
+    FrameLoopStats last;
+    double intervalStart = -1.0;
+    double intervalCpuStart = 0.0;
+};
+
+// CPU time (user + kernel) consumed by the whole process so far.
+double GetProcessCpuSeconds();
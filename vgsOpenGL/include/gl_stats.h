@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Who issued a GL call: the app's own texture code or the ImGui backend
+enum class GLSource : int {
+    App,
+    ImGui,
+    Count
+};
+
+enum class GLCallKind : int {
+    Draw,           // glDrawElements*
+    BindTexture,
+    TextureUpload,  // glTexImage2D / glTexSubImage2D; bytes of pixel data
+    BufferUpload,   // glBufferData / glBufferSubData; bytes of client data
+    Mipmap,         // glGenerateMipmap
+    StateChange,    // Other binds, enables, blend/scissor/viewport, uniforms
+    StateQuery,     // glGet* / glIs*, which can stall the pipeline
+    Object,         // glGen* / glDelete*
+    Count
+};
+
+// GPU work measured with GL_TIME_ELAPSED queries in GLStatsMode::GpuTimers
+enum class GLPass : int {
+    Upload,  // App::RenderUI(): texture uploads and mip generation
+    Grid,    // GridRenderer's draw callback; not measured with VGS_INSTANCED_GRID=0
+    Count
+};
+
+enum class GLStatsMode : int {
+    Off,
+    Counters,   // Count and size GL calls
+    GpuTimers,  // Counters plus GPU time per pass
+};
+
+struct GLCallCounts {
+    uint64_t calls[(int)GLCallKind::Count] = {};
+    uint64_t bytes[(int)GLCallKind::Count] = {};
+
+    uint64_t TotalCalls() const {
+        uint64_t total = 0;
+        for (uint64_t c : calls) {
+            total += c;
+        }
+        return total;
+    }
+};
+
+struct GLFrameStats {
+    uint64_t frame = 0;
+    GLCallCounts sources[(int)GLSource::Count];
+    float gpuMs[(int)GLPass::Count] = { -1.0f, -1.0f };  // -1 until the query result arrives, or not measured
+};
+
+// Per-frame accounting of the GL calls made by texture.cpp and the ImGui
+// OpenGL3 backend. Everything here runs on the GL thread only. While off, a
+// counted call costs one branch.
+namespace GLStats
+{
+    extern bool g_counting;
+    extern GLCallCounts g_current[(int)GLSource::Count];
+
+    inline void CountCalls(GLSource source, GLCallKind kind, uint64_t calls, uint64_t bytes = 0) {
+        if (g_counting) {
+            GLCallCounts& counts = g_current[(int)source];
+            counts.calls[(int)kind] += calls;
+            counts.bytes[(int)kind] += bytes;
+        }
+    }
+
+    inline void CountCall(GLSource source, GLCallKind kind, uint64_t bytes = 0) {
+        CountCalls(source, kind, 1, bytes);
+    }
+
+    const char* SourceName(GLSource source);
+    const char* KindName(GLCallKind kind);
+    const char* PassName(GLPass pass);
+    const char* ModeName(GLStatsMode mode);
+
+    void SetMode(GLStatsMode mode);
+    GLStatsMode GetMode();
+
+    // Routes the ImGui backend's GL calls through counting wrappers. Call
+    // once after ImGui_ImplOpenGL3_Init(); lives in gl_stats_imgui.cpp so
+    // code without the ImGui backend can still link the counters.
+    void HookImGuiBackend();
+
+    // Brackets a pass with a GL_TIME_ELAPSED query. Passes must not nest.
+    // Results are read back a few frames later without stalling.
+    void BeginPass(GLPass pass);
+    void EndPass(GLPass pass);
+
+    class PassScope {
+    public:
+        explicit PassScope(GLPass pass) : pass(pass) { BeginPass(pass); }
+        ~PassScope() { EndPass(pass); }
+
+        PassScope(const PassScope&) = delete;
+        PassScope& operator=(const PassScope&) = delete;
+
+    private:
+        GLPass pass;
+    };
+
+    // Closes the frame's counters and collects finished GPU timers. Call
+    // once per frame after the last GL call before the swap.
+    void EndFrame();
+
+    // Most recently closed frame. Its GPU times are filled in as soon as the
+    // queries finish, which is immediately after a glFinish().
+    const GLFrameStats& GetLastFrame();
+
+    // Latest GPU time of `pass` that has arrived, or -1.
+    float GetLatestGpuMs(GLPass pass);
+
+    // Destination used by Flush(); "vgs_gl_stats.json" in the working directory by default.
+    void SetOutputPath(const std::string& path);
+    const std::string& GetOutputPath();
+
+    // Writes the retained frame history (up to Perf::kHistorySize frames)
+    // as JSON. Returns the number of frames written, or -1.
+    long long WriteJson(const std::string& path);
+
+    // WriteJson() to the configured output path, logging the result.
+    long long Flush();
+
+    // Deletes the timer queries. Call before destroying the context.
+    void Shutdown();
+}
+
+#define VGS_GL_CONCAT_INNER(a, b) a##b
+#define VGS_GL_CONCAT(a, b) VGS_GL_CONCAT_INNER(a, b)
+#define VGS_GL_PASS(pass) GLStats::PassScope VGS_GL_CONCAT(glPass_, __LINE__)(pass)
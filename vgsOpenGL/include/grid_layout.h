@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "image_catalog.h"
+
+// Space above the first row of tiles and between tiles, in pixels
+static const float kGridTopOffset = 30.0f;
+static const float kGridTilePadding = 10.0f;
+
+// The per-image arrays the layouts read and write, as raw pointers so the
+// layout code does not need a whole ImageCatalog (and its GL textures).
+// Take a fresh view whenever images were added, the arrays may have moved.
+struct GridItems {
+    size_t count = 0;
+    const uint16_t* thumbnailWidth = nullptr;
+    const uint16_t* thumbnailHeight = nullptr;
+    const ThumbnailState* states = nullptr;
+    float* x = nullptr;       // Tile rectangles in content space, written by the layout
+    float* y = nullptr;
+    float* width = nullptr;
+    float* height = nullptr;
+};
+
+inline GridItems GridItemsOf(ImageCatalog& images) {
+    GridItems items;
+    items.count = images.Size();
+    items.thumbnailWidth = images.thumbnailWidth.data();
+    items.thumbnailHeight = images.thumbnailHeight.data();
+    items.states = images.thumbnailState.data();
+    items.x = images.layoutX.data();
+    items.y = images.layoutY.data();
+    items.width = images.layoutWidth.data();
+    items.height = images.layoutHeight.data();
+    return items;
+}
+
+// The first `count` items, or all of them if there are fewer
+inline GridItems GridItemsPrefix(GridItems items, size_t count) {
+    items.count = count < items.count ? count : items.count;
+    return items;
+}
+
+// Items a relayout places and indexes in one frame. The app lays out the
+// first of them for a new width and Extend()s by as many each frame after,
+// so a resize over a million images costs about as much per frame as a
+// relayout of this many.
+static const size_t kGridLayoutItemsPerFrame = 1u << 17;
+
+enum class GridLayoutKind : uint8_t {
+    Masonry,        // Equal width columns, filled in turn
+    JustifiedRows,  // Rows of a common height that span the whole width
+    UniformGrid,    // Square cells, each thumbnail fitted into its cell
+    Count
+};
+
+const char* GridLayoutName(GridLayoutKind kind);
+
+// Accepts "masonry", "justified" and "uniform"
+bool ParseGridLayout(const char* name, GridLayoutKind& kind);
+
+// Places the tiles of the image grid. Failed images are left out of the
+// layout. Layouts are append-only incremental: Extend() places the images
+// added since the last call after the ones already laid out, so streaming
+// in a folder does not reflow the catalogue. Only the unfinished last row
+// of the justified layout is laid out again. Anything else (a new width or
+// target size, an image that failed) needs Relayout().
+class GridLayout {
+public:
+    virtual ~GridLayout() = default;
+
+    virtual GridLayoutKind Kind() const = 0;
+
+    // Lays out every item for a grid `width` pixels wide
+    void Relayout(const GridItems& items, float width);
+
+    // Lays out the items past Count(), or everything when there are fewer
+    // items than before
+    void Extend(const GridItems& items);
+
+    // Column width of the masonry, row height of the justified rows, cell
+    // size of the uniform grid; the tiles are stretched a little to fill
+    // the width. Takes effect on the next Relayout().
+    void SetTargetSize(float size) { targetSize = size; }
+    float TargetSize() const { return targetSize; }
+
+    float Width() const { return width; }
+    size_t Count() const { return laidOut; }
+    float ContentHeight() const { return contentHeight; }
+
+    // Items from FirstChanged() on were placed by the last call, and none of
+    // their tiles starts above ChangedTop()
+    size_t FirstChanged() const { return firstChanged; }
+    float ChangedTop() const { return changedTop; }
+
+protected:
+    explicit GridLayout(float targetSize) : targetSize(targetSize) {}
+
+    // Forgets the placed items, ready to lay out from the first at `width`
+    virtual void reset() = 0;
+
+    // Places items [first, items.count), updates contentHeight and returns
+    // the first item it placed, which may be before `first`
+    virtual size_t place(const GridItems& items, size_t first) = 0;
+
+    float width = 0.0f;
+    float targetSize;
+    float contentHeight = kGridTopOffset;
+
+private:
+    void placeFrom(const GridItems& items, size_t first);
+
+    size_t laidOut = 0;
+    size_t firstChanged = 0;
+    float changedTop = 0.0f;
+};
+
+std::unique_ptr<GridLayout> CreateGridLayout(GridLayoutKind kind);
+
+// Buckets laid out tiles into horizontal bands of the content by their top
+// edge, so the tiles under the mouse or inside the viewport are found by
+// looking at a few bands instead of every image. Rebuild it whenever the layout changes, or update
+// it after GridLayout::Extend().
+class GridSpatialIndex {
+public:
+    static constexpr float kBandHeight = 256.0f;
+
+    // Indexes every tile that is not Failed, by its rectangle.
+    void Build(const GridItems& tiles, float contentHeight);
+    void Clear();
+
+    // Re-indexes tiles [firstChanged, tiles.count), which all start at or
+    // below `changedTop`. Only the bands from there down are rebuilt.
+    void Update(const GridItems& tiles, size_t firstChanged, float changedTop, float contentHeight);
+
+    // Appends the tiles that overlap [top, bottom) to `out`, each once.
+    void Query(const GridItems& tiles, float top, float bottom, std::vector<uint32_t>& out) const;
+
+    // Tile that contains the point, or -1.
+    int64_t HitTest(const GridItems& tiles, float x, float y) const;
+
+private:
+    int bandOf(float y) const;
+    void fill(const GridItems& tiles, int firstBand, size_t bandCount);
+
+    std::vector<uint32_t> bandStart; // Items of band b are items[bandStart[b]..bandStart[b + 1])
+    std::vector<uint32_t> items;
+    std::vector<uint32_t> pending;   // Tiles fill() sorts into bands
+    float maxTileHeight = 0.0f;      // How far above a range its tiles can start
+};
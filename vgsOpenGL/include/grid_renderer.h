@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct ImDrawList;
+
+// Forward declarations for OpenGL types to avoid including GL/glew.h here
+typedef unsigned int GLuint;
+
+// Height of one cached strip of the retained mode, in content pixels. Tiles
+// handed to SetTiles() must cover whole strips.
+static const float kGridCacheBandHeight = 256.0f;
+
+// A visible tile of the image grid, in the grid's content space (the layout
+// coordinates before scrolling)
+struct GridTile {
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
+    GLuint texture = 0;  // 0 draws the placeholder
+};
+
+struct GridRendererStats {
+    bool active = false;         // Instanced path initialised and in use
+    int textureUnits = 0;        // Thumbnails one instanced draw can sample
+    size_t tiles = 0;
+    int batches = 0;             // Instanced draws of the last grid frame
+    uint64_t instanceUploads = 0;
+    size_t lastUploadBytes = 0;
+    bool retained = false;
+    int cachedBands = 0;         // Strips holding valid pixels
+    int bandsRendered = 0;       // Strips (re)rendered in the last grid frame
+    size_t cacheBytes = 0;
+};
+
+// Draws the thumbnail grid from a draw callback inside the grid window
+// instead of one ImGui::Image per tile. The tiles live in a per-instance
+// buffer (position, size, texture layer, UV rect) that is only rewritten
+// when SetTiles() is called, and all of them are drawn with one instanced
+// draw per group of textureUnits thumbnails; the "layer" of an instance is
+// the texture unit its thumbnail is bound to for that draw.
+//
+// In retained mode the content is rendered into strips of
+// kGridCacheBandHeight pixels, each with its own texture and framebuffer,
+// and a frame only composites the visible strips. A strip is rendered again
+// when it scrolls into view uncached or after it has been invalidated, so
+// a still or scrolling grid costs a few textured quads plus the newly
+// exposed strips.
+namespace GridRenderer
+{
+    // On by default; VGS_INSTANCED_GRID=0 or the perf overlay turn it off.
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+
+    // Off by default; VGS_RETAINED_GRID=1 or the perf overlay turn it on.
+    // Turning it off frees the cached strips.
+    void SetRetained(bool retained);
+    bool IsRetained();
+
+    // Marks the cached strips overlapping content rows [top, bottom) for
+    // re-rendering, e.g. when a thumbnail there changes residency.
+    void InvalidateRange(float top, float bottom);
+
+    // Marks every cached strip for re-rendering, e.g. after a relayout.
+    void InvalidateAll();
+
+    // Samples the thumbnails `bias` mip levels coarser than their on-screen
+    // size asks for, e.g. 2 for quarter resolution during a fast scroll.
+    // Cached strips drawn with a larger bias are redrawn once it drops.
+    void SetLodBias(float bias);
+
+    // Replaces the tiles drawn by Submit(). The instance buffer is
+    // rewritten on the next draw, so only call this when they change.
+    void SetTiles(const GridTile* tiles, size_t count);
+
+    // Adds the draw callback for the current tiles to `drawList`, with the
+    // content origin at (originX, originY) in screen space. Returns false
+    // when the instanced path is off or its GL objects could not be
+    // created; the caller then draws the tiles itself.
+    bool Submit(ImDrawList* drawList, float originX, float originY);
+
+    GridRendererStats GetStats();
+
+    // Deletes the GL objects. Call before destroying the context.
+    void Shutdown();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "texture.h"
+
+// Where the thumbnail of an image currently lives
+enum class ThumbnailState : uint8_t {
+    NotLoaded,  // Only the layout size is known
+    Queued,     // Waiting on a loader thread (disk tier)
+    Resident,   // Uploaded as a GL texture (VRAM tier)
+    Failed      // Could not be generated or decoded
+};
+
+// Bits of ImageCatalog::largeThumbnailFlags
+enum LargeThumbnailFlags : uint8_t {
+    LargeThumbnailQueued = 1 << 0,
+    LargeThumbnailResident = 1 << 1,     // thumbnailTexture holds the large level
+    LargeThumbnailUnavailable = 1 << 2   // Failed, or the image is too small to need one
+};
+
+// Bits of ImageCatalog::fullResFlags
+enum FullResFlags : uint8_t {
+    FullResLoading = 1 << 0,
+    FullResLoaded = 1 << 1
+};
+
+// The images of the loaded folder, stored as parallel arrays. The hot arrays
+// are the only ones the grid walks every frame, so scanning them streams
+// through a few bytes per image instead of a whole struct with strings.
+// Paths live in one shared arena; an image only stores offsets into it.
+struct ImageCatalog {
+    // --- Hot: touched by the per-frame grid loop ---
+    std::vector<TextureHandle> thumbnailTexture;
+    std::vector<uint16_t> thumbnailWidth;
+    std::vector<uint16_t> thumbnailHeight;
+    std::vector<float> layoutX;
+    std::vector<float> layoutY;
+    std::vector<float> layoutWidth;        // Tile size in the grid, may differ from the thumbnail's
+    std::vector<float> layoutHeight;
+    std::vector<ThumbnailState> thumbnailState;
+    std::vector<uint32_t> lastWantedFrame; // Last frame the tile was inside the prefetch window
+
+    // --- Cold: only needed when loading or inspecting a single image ---
+    std::vector<uint32_t> pathOffset;      // Start of filePath in pathArena
+    std::vector<uint32_t> pathLength;
+    std::vector<uint16_t> nameOffset;      // Start of fileName within filePath
+    std::vector<uint32_t> fullResWidth;
+    std::vector<uint32_t> fullResHeight;
+    std::vector<TextureHandle> fullResTexture;
+    std::vector<uint8_t> fullResFlags;
+    std::vector<uint8_t> largeThumbnailFlags;
+    std::vector<uint8_t> thumbnailChannels;  // Of the resident texture: 1, 3 or 4
+
+    std::string pathArena;
+    std::string thumbnailDir;              // Cache directory the thumbnails were generated into
+
+    size_t Size() const { return thumbnailState.size(); }
+    bool Empty() const { return thumbnailState.empty(); }
+
+    // Appends an image and returns its index. `fileNameOffset` is where the
+    // file name starts inside `filePath`.
+    uint32_t Add(std::string_view filePath, size_t fileNameOffset, int fullWidth, int fullHeight, int thumbWidth, int thumbHeight);
+
+    std::string_view FilePath(size_t index) const {
+        return std::string_view(pathArena.data() + pathOffset[index], pathLength[index]);
+    }
+    std::string_view FileName(size_t index) const {
+        return FilePath(index).substr(nameOffset[index]);
+    }
+    std::string ThumbnailPath(size_t index) const;
+    std::string LargeThumbnailPath(size_t index) const;
+
+    void Reserve(size_t count, size_t pathBytes);
+    void Clear();
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// File formats, told apart by their leading bytes rather than by extension
+enum class ImageFormat : uint8_t {
+    Unknown,
+    Png,
+    Jpeg,
+    Bmp,
+    WebP,
+    Count
+};
+
+const char* ImageFormatName(ImageFormat format);
+
+struct ImageInfo {
+    ImageFormat format = ImageFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    int channels = 0;   // As Decode() gives them
+};
+
+// 8-bit pixels as a codec decoded them, rows of width * channels bytes
+// back to back. Each codec frees its buffers with its own allocator.
+struct DecodedImage {
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels{ nullptr, std::free };
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+// One decoding backend. Every call takes the whole file in memory, except
+// Info(), which may be given only the start of it. A codec declines a file
+// it does not take by returning false, and ImageCodecs offers the file to
+// the next codec of that format.
+class ImageCodec {
+public:
+    virtual ~ImageCodec() = default;
+
+    virtual const char* Name() const = 0;
+
+    // Whether the codec decodes `format` at all
+    virtual bool Handles(ImageFormat format) const = 0;
+
+    // The size and channels of the image. False if the codec does not take
+    // the file, or needs more of it than `size` bytes to tell.
+    virtual bool Info(const unsigned char* data, size_t size, ImageInfo& info) const = 0;
+
+    // The whole image with its own channels
+    virtual bool Decode(const unsigned char* data, size_t size, DecodedImage& out) const = 0;
+
+    // The image at the smallest size the codec produces directly that is
+    // still at least `minWidth` x `minHeight`, e.g. by scaling in the DCT.
+    // By default the full size.
+    virtual bool DecodeScaled(const unsigned char* data, size_t size, int minWidth, int minHeight, DecodedImage& out) const;
+
+    // Whether DecodeScaled() gives less than the full size. ImageCodecs
+    // offers scaled decodes to these codecs first.
+    virtual bool Scales() const { return false; }
+
+    // Rows [firstRow, firstRow + rowCount) at full width. By default the
+    // whole image is decoded and the rows copied out.
+    virtual bool DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out) const;
+};
+
+// The codecs compiled in, in the order they are tried for a format: the
+// restart-marker JPEG decoder, optional backends, PngDecoder, then
+// stb_image, which takes every PNG, JPEG and BMP the others decline.
+// Optional backends are compiled in with their define:
+//   VGS_WITH_LIBJPEG_TURBO    JPEG through libjpeg-turbo's libjpeg API
+namespace ImageCodecs
+{
+    const std::vector<ImageCodec*>& GetCodecs();
+    ImageCodec* Find(const char* name);
+
+    // Moves the codecs named in a comma separated list to the front, in
+    // that order, e.g. "libjpeg-turbo,png". Call it before any decoding.
+    // False, with the order unchanged, if a name is unknown.
+    bool SetPreferred(const std::string& names);
+
+    ImageFormat Sniff(const unsigned char* data, size_t size);
+
+    // Formats some codec decodes. Extensions include the dot and are
+    // compared without case.
+    bool IsSupported(ImageFormat format);
+    bool IsSupportedExtension(const std::string& extension);
+
+    // As ImageCodec, from the first codec of the sniffed format that takes
+    // the file. DecodeScaled() tries the codecs that scale before the rest.
+    bool Info(const unsigned char* data, size_t size, ImageInfo& info);
+    bool Decode(const unsigned char* data, size_t size, DecodedImage& out);
+    bool DecodeScaled(const unsigned char* data, size_t size, int minWidth, int minHeight, DecodedImage& out);
+    bool DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out);
+
+    // Info() of a file on disk, reading no more of it than the header needs
+    bool InfoFromFile(const char* path, ImageInfo& info);
+}
+
+#ifdef VGS_WITH_LIBJPEG_TURBO
+std::unique_ptr<ImageCodec> CreateLibjpegTurboCodec();
+#endif
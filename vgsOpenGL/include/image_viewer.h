@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+struct ImageViewerStats {
+    bool open = false;
+    int width = 0;               // Full resolution of the open image
+    int height = 0;
+    double firstPixelMs = -1.0;  // From Open() to each stage first drawn, -1 until then
+    double previewMs = -1.0;
+    double fullMs = -1.0;
+    int levelsUploaded = 0;      // Mip levels of the full image on the GPU so far
+    int levels = 0;
+};
+
+// Shows one image of g_images at full resolution, coarse to fine: the grid
+// thumbnail right away, then a preview at the large thumbnail size (the
+// cached one, or else a downscale made while the source decodes), then the
+// full image. A background thread decodes the image and builds its mip
+// chain on the CPU; the levels are uploaded smallest first, a few rows per
+// frame under a fixed byte budget, and each level is drawn as soon as it is
+// complete, so opening a huge image never stalls a frame on one big upload.
+namespace ImageViewer
+{
+    // Starts showing image `index`, cancelling the one shown before.
+    void Open(size_t index);
+    void Close();
+    bool IsOpen();
+
+    // Draws the viewer over the whole display. Escape or the close button
+    // close it.
+    void Render();
+
+    // True while decoded levels wait for upload in upcoming frames.
+    bool IsAnimating();
+
+    // Called from the decode thread whenever a stage is ready.
+    void SetResultCallback(std::function<void()> callback);
+
+    // Waits for the decode thread's next stage of the open image, or for it
+    // to finish. Once called, the decode thread also waits after each stage
+    // until a frame takes it, so replays that call it once per frame apply
+    // one stage per frame, for a deterministic workload.
+    void Drain();
+
+    ImageViewerStats GetStats();
+
+    // Stops the decode thread and frees the textures. Call before
+    // destroying the context.
+    void Shutdown();
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// zlib stream decompressor (RFC 1950/1951) for data whose decompressed size
+// is known up front, such as PNG image data. Huffman codes are decoded from
+// one table lookup per symbol, two literals at a time where both codes are
+// short, with bits refilled 64 at a time.
+namespace Inflate
+{
+    // Decompresses the zlib stream `src` into `dst`. False on malformed input
+    // or if the stream does not hold exactly `dstSize` bytes. As in
+    // stb_image, the Adler-32 checksum is not verified.
+    bool Zlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One ImGui input event as the platform backend queued it
+struct RecordedInputEvent {
+    enum Type : uint8_t { MousePos, MouseButton, MouseWheel, Key, Char, Focus };
+
+    Type type = MousePos;
+    float x = 0.0f;      // Position or wheel delta
+    float y = 0.0f;
+    int code = 0;        // Mouse button, ImGuiKey or character
+    bool down = false;   // Button/key state or focus gained
+};
+
+// Everything ImGui received for one rendered frame
+struct RecordedInputFrame {
+    float deltaTime = 0.0f;
+    float displayWidth = 0.0f;
+    float displayHeight = 0.0f;
+    std::vector<RecordedInputEvent> events;
+};
+
+// Input of a whole session, replayable frame by frame through the normal
+// App::RenderUI() path. Stored as a line based text file so recordings can
+// be read and diffed; ImGuiKey values are tied to the ImGui version.
+struct InputRecording {
+    std::vector<RecordedInputFrame> frames;
+
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+};
+
+// Copies the events the platform backend queued this frame, plus the frame
+// time and display size. Call after the backend's NewFrame() and before
+// ImGui::NewFrame().
+void captureInputFrame(RecordedInputFrame& out);
+
+// Feeds a recorded frame to ImGui in place of a platform backend. Call
+// before ImGui::NewFrame().
+void applyInputFrame(const RecordedInputFrame& frame);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decodes large JPEGs on several threads. A file written with restart
+// markers is cut into intervals whose entropy-coded data can be decoded
+// independently of each other: Open() indexes where every interval starts,
+// then DecodeRows() Huffman decodes and inverse transforms the intervals on
+// the ResizeService pool and upsamples and colour converts the rows in
+// bands. The pixels are those stbi_load() gives with 3 channels, bit for
+// bit. Files this decoder does not take are left to stb_image.
+class JpegDecoder {
+public:
+    // Reads the headers of an in-memory JPEG, which must outlive the
+    // decoder. False unless it is an 8-bit baseline (or extended Huffman)
+    // colour image with three components in a single scan that has a
+    // restart interval.
+    bool Open(const unsigned char* data, size_t size);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    size_t GetIntervalCount() const { return intervals.size(); }
+
+    // Decodes rows [firstRow, firstRow + rowCount) as packed RGB into `dst`.
+    // Only the intervals that hold those rows, and the chroma rows either
+    // side of them, are decoded. False on corrupt data.
+    bool DecodeRows(int firstRow, int rowCount, unsigned char* dst) const;
+
+    // The whole image as packed RGB
+    bool Decode(unsigned char* dst) const { return DecodeRows(0, height, dst); }
+
+private:
+    struct HuffmanTable {
+        bool defined = false;
+        uint16_t fast[1 << 9] = {};     // Next 9 bits to symbol index + 1, 0 for longer codes
+        uint16_t codes[256] = {};
+        uint8_t values[256] = {};
+        uint8_t sizes[257] = {};
+        uint32_t maxCode[18] = {};      // Per length, left aligned in 16 bits
+        int delta[17] = {};             // Symbol index minus code, per length
+        int16_t fastAc[1 << 9] = {};    // AC run, size and value of short codes
+    };
+
+    struct Component {
+        int id = 0;
+        int h = 1;                      // Sampling factors
+        int v = 1;
+        int quantTable = 0;
+        int dcTable = 0;
+        int acTable = 0;
+        int width = 0;                  // Samples that cover the image
+        int height = 0;
+    };
+
+    // Entropy-coded bytes of one restart interval, markers excluded
+    struct Interval {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    // Component planes of the MCU rows [firstMcuRow, endMcuRow)
+    struct Planes;
+
+    bool ReadTables(int marker, const unsigned char* segment, size_t length);
+    bool ReadFrame(const unsigned char* segment, size_t length);
+    bool ReadScan(const unsigned char* segment, size_t length);
+    bool IndexIntervals(size_t scanStart);
+    bool DecodeInterval(size_t index, Planes& planes) const;
+    void ConvertRows(const Planes& planes, int firstRow, int rowCount, unsigned char* dst) const;
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    int width = 0;
+    int height = 0;
+    int maxH = 1;
+    int maxV = 1;
+    int mcusX = 0;
+    int mcusY = 0;
+    int restartInterval = 0;
+    bool jfif = false;
+    int adobeTransform = -1;            // Of an Adobe APP14 segment, -1 without one
+    bool rgb = false;                   // Components are R, G and B rather than YCbCr
+    Component components[3];
+    int scanOrder[3] = {};              // Components in the order the scan interleaves them
+    uint16_t quant[4][64] = {};         // Natural order
+    bool quantDefined[4] = {};
+    HuffmanTable dc[4];
+    HuffmanTable ac[4];
+    std::vector<Interval> intervals;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal LZ4 block-format codec used by the in-memory thumbnail cache.
+// Output is compatible with the reference LZ4 block decoder, so the RAM tier
+// can be switched to liblz4 without changing the stored data.
+namespace LZ4Block
+{
+    // Worst-case compressed size for `srcSize` input bytes.
+    size_t CompressBound(size_t srcSize);
+
+    // Compresses `src` into `dst`. Returns the number of bytes written, or 0
+    // if `dstCapacity` is too small.
+    size_t Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+    // Decompresses a block produced by Compress(). `dstSize` must be the exact
+    // uncompressed size. Returns false on malformed input.
+    bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+}
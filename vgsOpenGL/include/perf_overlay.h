@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Perf
+{
+    // Draws the "Performance" window: frame-time graph and histogram with
+    // percentiles, per-stage timings, queue depths and memory gauges.
+    void RenderOverlay(bool* open);
+}
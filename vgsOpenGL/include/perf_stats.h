@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "trace.h"
+
+// Pipeline stages timed by Perf::ScopedTimer. Stages that run on loader
+// threads (decode, resize, encode, cache I/O) accumulate from all threads.
+enum class PerfStage : int {
+    Scan,       // Walking the folder for image files
+    Probe,      // Image header of each candidate
+    Decode,     // Source and thumbnail decoding
+    Resize,     // Thumbnail downscaling
+    Encode,     // Thumbnail PNG encoding
+    CacheIO,    // Thumbnail file reads/writes and RAM tier (de)compression
+    Upload,     // Texture creation and glTexImage2D
+    Layout,     // Grid layout
+    Render,     // ImGui draw data submission to GL
+    Count
+};
+
+// Instantaneous values published by the app every frame
+enum class PerfGauge : int {
+    LoaderPending,    // Requests waiting for a loader thread
+    LoaderCompleted,  // Finished loads waiting for upload
+    TextureCount,
+    VramBytes,        // Resident thumbnails plus pooled texture storage
+    RamCacheBytes,
+    ScrollSpeed,      // Grid scroll speed in pixels per second, smoothed
+    Count
+};
+
+namespace Perf
+{
+    const char* StageName(PerfStage stage);
+    const char* GaugeName(PerfGauge gauge);
+
+    // Relaxed atomic adds, cheap enough to stay enabled in release builds.
+    void AddStageTime(PerfStage stage, uint64_t nanoseconds);
+    void AddUploadBytes(uint64_t bytes);
+    void SetGauge(PerfGauge gauge, uint64_t value);
+
+    // Times a stage; also shows up as a trace zone while tracing is enabled.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(PerfStage stage) : stage(stage), start(Trace::Now()) {}
+        ~ScopedTimer() {
+            uint64_t end = Trace::Now();
+            AddStageTime(stage, end - start);
+            if (Trace::IsEnabled()) {
+                Trace::RecordZone(StageName(stage), start, end);
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        PerfStage stage;
+        uint64_t start;
+    };
+
+    // Number of frames kept for graphs and percentiles
+    static const int kHistorySize = 512;
+
+    // Per-frame history, only written by EndFrame() on the main thread.
+    struct FrameHistory {
+        float frameMs[kHistorySize] = {};
+        float stageMs[(int)PerfStage::Count][kHistorySize] = {};
+        float uploadKB[kHistorySize] = {};
+        int next = 0;     // Index the next frame is written to
+        int count = 0;    // Valid entries (up to kHistorySize)
+    };
+
+    struct StageTotals {
+        uint64_t nanoseconds[(int)PerfStage::Count] = {};
+        uint64_t calls[(int)PerfStage::Count] = {};
+        uint64_t uploadBytes = 0;
+    };
+
+    // Moves the stage time accumulated since the previous call into the
+    // history as one frame. `frameSeconds` is the CPU time of the frame.
+    void EndFrame(double frameSeconds);
+
+    const FrameHistory& GetHistory();
+    StageTotals GetTotals();      // Since start or the last ResetTotals()
+    uint64_t GetGauge(PerfGauge gauge);
+    void ResetTotals();
+
+    // Fills p50/p95/p99 of the frame history in milliseconds.
+    void FramePercentiles(float& p50, float& p95, float& p99);
+}
+
+#define VGS_PERF_CONCAT_INNER(a, b) a##b
+#define VGS_PERF_CONCAT(a, b) VGS_PERF_CONCAT_INNER(a, b)
+#define VGS_PERF_SCOPE(stage) Perf::ScopedTimer VGS_PERF_CONCAT(perfScope_, __LINE__)(stage)
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte layouts of 8-bit pixels; the value is the channel count
+enum class PixelFormat : uint8_t {
+    Grey = 1,
+    GreyAlpha = 2,
+    RGB = 3,
+    RGBA = 4
+};
+
+inline PixelFormat PixelFormatOf(int channels) {
+    return (PixelFormat)(channels < 1 ? 1 : channels > 4 ? 4 : channels);
+}
+
+// Instruction sets the kernels have variants for, slowest first
+enum class CpuLevel : uint8_t {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512,     // AVX-512 F and BW
+    Count
+};
+
+const char* CpuLevelName(CpuLevel level);
+
+// The per-pixel loops of the decode, thumbnail, mip and upload paths. Each kernel is
+// a template specialised for its source and destination format and compiled
+// once per instruction set; calls go to the variants of the best level the
+// CPU supports, or of the level set with SetActiveLevel(). A level without
+// its own variant of a kernel uses the one of the level below. The scalar
+// variants are the reference the others must match bit for bit.
+namespace PixelKernels
+{
+    // Best level this CPU (and OS) supports
+    CpuLevel SupportedLevel();
+
+    CpuLevel ActiveLevel();
+
+    // Runs the kernels at `level`, limited to SupportedLevel(), and returns
+    // the level now in use. For benchmarks and checks: call it while no
+    // other thread runs kernels.
+    CpuLevel SetActiveLevel(CpuLevel level);
+
+    // Converts `count` pixels: Grey, GreyAlpha and RGB to RGBA (opaque when
+    // there is no alpha), and RGBA to RGB dropping alpha. For RGBA to RGB
+    // `dst` may be `src`. False for any other pair.
+    bool Convert(PixelFormat from, PixelFormat to, const uint8_t* src, uint8_t* dst, size_t count);
+
+    // Whether all `count` RGBA pixels have an alpha of 255
+    bool IsOpaque(const uint8_t* rgba, size_t count);
+
+    // Scales the colour of RGBA pixels by their alpha, rounded, in place
+    void Premultiply(uint8_t* rgba, size_t count);
+
+    // Undoes Premultiply(), in place. Colour above alpha is clamped to 255
+    // and fully transparent pixels become black.
+    void Unpremultiply(uint8_t* rgba, size_t count);
+
+    // sRGB-encoded bytes to linear light as 12-bit values (0-4095) and
+    // back. The round trip gives every byte back unchanged.
+    void SrgbToLinear(const uint8_t* src, uint16_t* dst, size_t count);
+    void LinearToSrgb(const uint16_t* src, uint8_t* dst, size_t count);
+
+    // The inverse DCT of one 8x8 block of dequantised JPEG coefficients in
+    // natural order, written as bytes `stride` apart row to row. It is the
+    // integer transform of stb_image, rounded and clamped the same way.
+    void IdctBlock(const int16_t* coefficients, uint8_t* dst, size_t stride);
+
+    // JPEG's YCbCr to packed RGB for `count` pixels, from one plane per
+    // component, with stb_image's fixed-point constants.
+    void YCbCrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count);
+
+    // Undoes PNG filter `filter` (0 None, 1 Sub, 2 Up, 3 Average, 4 Paeth)
+    // on one row of `length` bytes with 1 to 4 bytes per pixel. `previous`
+    // is the row above, already unfiltered, or zeros for the first row.
+    // `out` may overlap `raw` as long as it does not start after it, so rows
+    // can be unfiltered in place. False for any other filter.
+    bool UnfilterPngRow(int filter, int bytesPerPixel, const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length);
+
+    // Averages 2x2 blocks of a `width` x `height` image into `dst`, half the
+    // size rounded down as in a GL mip chain (an odd last row or column is
+    // dropped, a side of 1 stays 1). BoxHalve() averages the bytes as they
+    // are; BoxHalveLinear() averages Grey or RGB in linear light, which keeps
+    // fine detail from getting darker at every level.
+    void BoxHalve(PixelFormat format, const uint8_t* src, int width, int height, uint8_t* dst);
+    void BoxHalveLinear(PixelFormat format, const uint8_t* src, int width, int height, uint8_t* dst);
+
+    // Averages `factor` x `factor` blocks in a single pass, `factor` being a
+    // power of two up to 256; `dst` is width / factor by height / factor,
+    // the size as many BoxHalve() calls give, with one rounding instead of
+    // one per halving. RGBA is averaged with premultiplied alpha so the
+    // colour of transparent pixels does not bleed into the block.
+    // BoxDecimateLinear() averages Grey or RGB in linear light like
+    // BoxHalveLinear().
+    void BoxDecimate(PixelFormat format, const uint8_t* src, int width, int height, int factor, uint8_t* dst);
+    void BoxDecimateLinear(PixelFormat format, const uint8_t* src, int width, int height, int factor, uint8_t* dst);
+}
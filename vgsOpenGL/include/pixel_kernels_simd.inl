@@ -0,0 +1,224 @@
+// SIMD variants of the pixel kernels, written once against the vector traits
+// `V` of an instruction set. pixel_kernels.cpp includes this file once per
+// instruction set, inside a namespace of its own and with the compiler
+// targeting that instruction set, so it deliberately has no include guard.
+// VGS_KERNELS_BYTE_SHUFFLE says whether V has the byte shuffle the RGB
+// conversions need, which SSE2 lacks.
+//
+// Every kernel works on whole vectors and leaves the remaining pixels to the
+// reference kernel, so the results match it exactly.
+
+template <PixelFormat From, PixelFormat To>
+static void convert(const uint8_t* src, uint8_t* dst, size_t count);
+
+template <>
+void convert<PixelFormat::Grey, PixelFormat::RGBA>(const uint8_t* src, uint8_t* dst, size_t count) {
+	const V::Vec alpha = V::set32((int)0xFF000000);
+	size_t i = 0;
+	for (; i + V::kBytes <= count; i += V::kBytes) {
+		V::Vec grey = V::spread(V::load(src + i));
+		V::Vec pairs[2] = { V::spread(V::unpacklo8(grey, grey)), V::spread(V::unpackhi8(grey, grey)) };
+		uint8_t* out = dst + i * 4;
+		for (V::Vec pair : pairs) {
+			V::store(out, V::or_(V::unpacklo16(pair, pair), alpha));
+			V::store(out + V::kBytes, V::or_(V::unpackhi16(pair, pair), alpha));
+			out += 2 * V::kBytes;
+		}
+	}
+	reference::convert<PixelFormat::Grey, PixelFormat::RGBA>(src + i, dst + i * 4, count - i);
+}
+
+template <>
+void convert<PixelFormat::GreyAlpha, PixelFormat::RGBA>(const uint8_t* src, uint8_t* dst, size_t count) {
+	const V::Vec low = V::set16(0x00FF);
+	size_t i = 0;
+	for (; i + V::kBytes / 2 <= count; i += V::kBytes / 2) {
+		// A grey and alpha pair is one 16-bit lane; grey twice is another,
+		// and the two interleaved make the RGBA pixel
+		V::Vec greyAlpha = V::load(src + i * 2);
+		V::Vec grey = V::and_(greyAlpha, low);
+		V::Vec greyGrey = V::spread(V::or_(grey, V::slli16<8>(grey)));
+		greyAlpha = V::spread(greyAlpha);
+		V::store(dst + i * 4, V::unpacklo16(greyGrey, greyAlpha));
+		V::store(dst + i * 4 + V::kBytes, V::unpackhi16(greyGrey, greyAlpha));
+	}
+	reference::convert<PixelFormat::GreyAlpha, PixelFormat::RGBA>(src + i * 2, dst + i * 4, count - i);
+}
+
+#if VGS_KERNELS_BYTE_SHUFFLE
+template <>
+void convert<PixelFormat::RGB, PixelFormat::RGBA>(const uint8_t* src, uint8_t* dst, size_t count) {
+	const V::Vec control = V::lanes(_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+	const V::Vec alpha = V::set32((int)0xFF000000);
+	const size_t step = V::kBytes / 4;
+	size_t i = 0;
+	// The last lane loads 4 bytes past its pixels
+	for (; (i + step) * 3 + 4 <= count * 3; i += step) {
+		V::store(dst + i * 4, V::or_(V::shuffle8(V::loadLanes12(src + i * 3), control), alpha));
+	}
+	reference::convert<PixelFormat::RGB, PixelFormat::RGBA>(src + i * 3, dst + i * 4, count - i);
+}
+
+// In place too: each step stores below the bytes the next one loads
+template <>
+void convert<PixelFormat::RGBA, PixelFormat::RGB>(const uint8_t* src, uint8_t* dst, size_t count) {
+	const V::Vec control = V::lanes(_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	const size_t step = V::kBytes / 4;
+	size_t i = 0;
+	for (; (i + step) * 3 + 4 <= count * 3; i += step) {
+		V::storeLanes12(dst + i * 3, V::shuffle8(V::load(src + i * 4), control));
+	}
+	reference::convert<PixelFormat::RGBA, PixelFormat::RGB>(src + i * 4, dst + i * 3, count - i);
+}
+#endif
+
+static bool isOpaque(const uint8_t* rgba, size_t count) {
+	const V::Vec alpha = V::set32((int)0xFF000000);
+	const size_t step = V::kBytes / 4;
+	size_t i = 0;
+	while (i + step <= count) {
+		// Checked every few thousand pixels so transparency shows up early
+		size_t end = std::min(count, i + 4096);
+		V::Vec all = alpha;
+		for (; i + step <= end; i += step) {
+			all = V::and_(all, V::load(rgba + i * 4));
+		}
+		if (!V::allSet(all, alpha)) {
+			return false;
+		}
+	}
+	return reference::isOpaque(rgba + i * 4, count - i);
+}
+
+// RGBA widened to 16-bit lanes
+static V::Vec premultiplyWide(V::Vec pixels) {
+	const V::Vec alphaMask = V::set64((long long)0xFFFF000000000000ull);
+	V::Vec t = V::add16(V::mullo16(pixels, V::broadcastAlpha16(pixels)), V::set16(128));
+	V::Vec scaled = V::srli16<8>(V::add16(t, V::srli16<8>(t)));
+	return V::or_(V::andnot(alphaMask, scaled), V::and_(alphaMask, pixels));
+}
+
+static void premultiply(uint8_t* rgba, size_t count) {
+	const V::Vec zero = V::zero();
+	size_t i = 0;
+	for (; i + V::kBytes / 4 <= count; i += V::kBytes / 4) {
+		V::Vec pixels = V::load(rgba + i * 4);
+		V::Vec low = premultiplyWide(V::unpacklo8(pixels, zero));
+		V::Vec high = premultiplyWide(V::unpackhi8(pixels, zero));
+		V::store(rgba + i * 4, V::packus16(low, high));
+	}
+	reference::premultiply(rgba + i * 4, count - i);
+}
+
+// One RGBA pixel per 128-bit lane in 32-bit lanes. The float quotient of
+// these small integers is never within rounding of the next integer, so
+// truncating it is the exact integer division of the reference.
+static V::Vec unpremultiplyWide(V::Vec pixel) {
+	const V::Vec alphaMask = V::lanes(_mm_setr_epi32(0, 0, 0, -1));
+	V::Vec alpha = V::broadcastAlpha32(pixel);
+	V::Float numerator = V::addf(V::mulf(V::toFloat(pixel), V::setf(255.0f)), V::toFloat(V::srli32<1>(alpha)));
+	V::Vec colour = V::truncate(V::minf(V::divf(numerator, V::toFloat(alpha)), V::setf(255.0f)));
+	colour = V::keepWhereNonZero(alpha, colour);
+	return V::or_(V::andnot(alphaMask, colour), V::and_(alphaMask, pixel));
+}
+
+static void unpremultiply(uint8_t* rgba, size_t count) {
+	const V::Vec zero = V::zero();
+	size_t i = 0;
+	for (; i + V::kBytes / 4 <= count; i += V::kBytes / 4) {
+		V::Vec pixels = V::load(rgba + i * 4);
+		V::Vec low = V::unpacklo8(pixels, zero);
+		V::Vec high = V::unpackhi8(pixels, zero);
+		V::Vec low16 = V::packs32(unpremultiplyWide(V::unpacklo16(low, zero)), unpremultiplyWide(V::unpackhi16(low, zero)));
+		V::Vec high16 = V::packs32(unpremultiplyWide(V::unpacklo16(high, zero)), unpremultiplyWide(V::unpackhi16(high, zero)));
+		V::store(rgba + i * 4, V::packus16(low16, high16));
+	}
+	reference::unpremultiply(rgba + i * 4, count - i);
+}
+
+template <PixelFormat Format>
+static void boxRows(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int outWidth);
+
+// Horizontal neighbours share a 16-bit lane
+template <>
+void boxRows<PixelFormat::Grey>(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int outWidth) {
+	const V::Vec low = V::set16(0x00FF);
+	const V::Vec two = V::set16(2);
+	const int step = (int)V::kBytes;
+	int x = 0;
+	for (; 2 * (x + step) <= width; x += step) {
+		V::Vec sums[2];
+		for (int half = 0; half < 2; half++) {
+			V::Vec top = V::load(row0 + 2 * x + half * step);
+			V::Vec bottom = V::load(row1 + 2 * x + half * step);
+			V::Vec sum = V::add16(V::add16(V::and_(top, low), V::srli16<8>(top)), V::add16(V::and_(bottom, low), V::srli16<8>(bottom)));
+			sums[half] = V::srli16<2>(V::add16(sum, two));
+		}
+		V::store(dst + x, V::unspread(V::packus16(sums[0], sums[1])));
+	}
+	reference::boxRowsFrom<PixelFormat::Grey>(row0, row1, width, dst, x, outWidth);
+}
+
+// Horizontal neighbours are the two halves of a 128-bit lane
+template <>
+void boxRows<PixelFormat::RGBA>(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int outWidth) {
+	const V::Vec zero = V::zero();
+	const V::Vec two = V::set16(2);
+	const int step = (int)V::kBytes / 4;
+	int x = 0;
+	for (; 2 * (x + step) <= width; x += step) {
+		V::Vec sums[2];
+		for (int half = 0; half < 2; half++) {
+			V::Vec top = V::load(row0 + 8 * x + half * V::kBytes);
+			V::Vec bottom = V::load(row1 + 8 * x + half * V::kBytes);
+			V::Vec low = V::add16(V::unpacklo8(top, zero), V::unpacklo8(bottom, zero));
+			V::Vec high = V::add16(V::unpackhi8(top, zero), V::unpackhi8(bottom, zero));
+			V::Vec sum = V::add16(V::unpacklo64(low, high), V::unpackhi64(low, high));
+			sums[half] = V::srli16<2>(V::add16(sum, two));
+		}
+		V::store(dst + 4 * x, V::unspread(V::packus16(sums[0], sums[1])));
+	}
+	reference::boxRowsFrom<PixelFormat::RGBA>(row0, row1, width, dst, x, outWidth);
+}
+
+// Widened to the sums' lanes in order: spread() first, as for the converts
+static void accumulate8(const uint8_t* src, uint16_t* sums, size_t count) {
+	const V::Vec zero = V::zero();
+	const size_t half = V::kBytes / 2;
+	size_t i = 0;
+	for (; i + V::kBytes <= count; i += V::kBytes) {
+		V::Vec bytes = V::spread(V::load(src + i));
+		V::store(sums + i, V::add16(V::load(sums + i), V::unpacklo8(bytes, zero)));
+		V::store(sums + i + half, V::add16(V::load(sums + i + half), V::unpackhi8(bytes, zero)));
+	}
+	reference::accumulate8(src + i, sums + i, count - i);
+}
+
+static void accumulate16(const uint16_t* src, uint32_t* sums, size_t count) {
+	const V::Vec zero = V::zero();
+	const size_t step = V::kBytes / 2;
+	const size_t quarter = V::kBytes / 4;
+	size_t i = 0;
+	for (; i + step <= count; i += step) {
+		V::Vec words = V::spread(V::load(src + i));
+		V::store(sums + i, V::add32(V::load(sums + i), V::unpacklo16(words, zero)));
+		V::store(sums + i + quarter, V::add32(V::load(sums + i + quarter), V::unpackhi16(words, zero)));
+	}
+	reference::accumulate16(src + i, sums + i, count - i);
+}
+
+static void fill(KernelTable& table) {
+	table.convert[1][4] = convert<PixelFormat::Grey, PixelFormat::RGBA>;
+	table.convert[2][4] = convert<PixelFormat::GreyAlpha, PixelFormat::RGBA>;
+#if VGS_KERNELS_BYTE_SHUFFLE
+	table.convert[3][4] = convert<PixelFormat::RGB, PixelFormat::RGBA>;
+	table.convert[4][3] = convert<PixelFormat::RGBA, PixelFormat::RGB>;
+#endif
+	table.isOpaque = isOpaque;
+	table.premultiply = premultiply;
+	table.unpremultiply = unpremultiply;
+	table.boxRows[1] = boxRows<PixelFormat::Grey>;
+	table.boxRows[4] = boxRows<PixelFormat::RGBA>;
+	table.accumulate8 = accumulate8;
+	table.accumulate16 = accumulate16;
+}
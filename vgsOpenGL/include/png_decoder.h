@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decodes common PNGs faster than stb_image: the image data is inflated
+// straight into the caller's buffer and the rows are unfiltered in place
+// with the PixelKernels, leaving the pixels packed at its start. The pixels
+// are those stbi_load() gives with the file's own channels, bit for bit.
+// Files this decoder does not take are left to stb_image.
+class PngDecoder {
+public:
+    // Reads the chunks of an in-memory PNG, which must outlive the decoder.
+    // False unless it is a non-interlaced 8-bit grey, grey and alpha, RGB or
+    // RGBA image without a palette or transparency chunk.
+    bool Open(const unsigned char* data, size_t size);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetChannels() const { return channels; }
+
+    // Bytes Decode() needs: every row with its filter byte
+    size_t GetBufferSize() const { return (size_t)height * ((size_t)width * channels + 1); }
+
+    // Decodes into `buffer`, which must hold GetBufferSize() bytes. On
+    // success its first width * height * channels bytes are the pixels.
+    // False on corrupt data.
+    bool Decode(unsigned char* buffer) const;
+
+private:
+    // Data of one IDAT chunk
+    struct Chunk {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<Chunk> imageData;
+};
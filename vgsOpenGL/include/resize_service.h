@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "stb_image_resize2.h"
+
+struct ResizeServiceStats {
+    uint64_t inlineJobs = 0;      // Ran whole on the calling thread
+    uint64_t splitJobs = 0;       // Spread over the pool
+    uint64_t samplerBuilds = 0;
+    uint64_t samplerReuses = 0;   // Jobs that found samplers of their geometry cached
+};
+
+// Resizes of very large images, split across a pool of worker threads.
+// stbir cuts the output into bands of scanlines that share one set of
+// samplers; the calling thread runs a band itself and, while it waits, any
+// other queued band, so a pool busy with another image never stalls it.
+// Jobs below a few megapixels, like most thumbnails, are not worth the hand
+// off and run whole on the calling thread, which keeps the loader threads
+// one job each. Samplers are kept for the last few geometries, so a folder
+// of same-sized photos builds them once.
+namespace ResizeService
+{
+    // Starts `threadCount` workers; without them every job runs inline.
+    void Start(unsigned threadCount);
+    void Stop();
+
+    // Threads a split job runs on, the calling one included.
+    unsigned GetParallelism();
+
+    // Resizes tightly packed `channels`-channel sRGB pixels, alpha weighted
+    // as stbir_resize_uint8_srgb weights it.
+    bool Resize(const unsigned char* src, int width, int height, int channels,
+        unsigned char* dst, int newWidth, int newHeight, stbir_filter filter);
+
+    // Calls `task` with every index in [0, count), spread over the pool and
+    // the calling thread, and returns once all calls have.
+    void ParallelFor(int count, const std::function<void(int)>& task);
+
+    ResizeServiceStats GetStats();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Forward declarations for OpenGL types to avoid including GL/glew.h here
+typedef unsigned int GLuint;
+
+// Queues a texture name for release. Safe to call from any thread; no GL
+// call happens until FlushTextureDeletions() runs on the GL thread.
+void releaseTextureName(GLuint textureID);
+
+// Owning handle for a GL texture name. Destroying or overwriting a handle
+// never touches GL directly, so handles can live in containers that are
+// cleared or reallocated anywhere in the program.
+class TextureHandle {
+public:
+    TextureHandle() = default;
+    explicit TextureHandle(GLuint textureID) : id(textureID) {}
+    ~TextureHandle() { Reset(); }
+
+    TextureHandle(TextureHandle&& other) noexcept : id(other.id) { other.id = 0; }
+    TextureHandle& operator=(TextureHandle&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    TextureHandle(const TextureHandle&) = delete;
+    TextureHandle& operator=(const TextureHandle&) = delete;
+
+    GLuint Get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    void Reset() {
+        if (id != 0) {
+            releaseTextureName(id);
+            id = 0;
+        }
+    }
+
+private:
+    GLuint id = 0;
+};
+
+struct TextureStats {
+    uint64_t created = 0;        // Fresh glGenTextures + storage allocations
+    uint64_t reused = 0;         // Allocations served from the recycle pool
+    uint64_t deleted = 0;        // Names actually passed to glDeleteTextures
+    uint64_t deleteBatches = 0;  // glDeleteTextures calls
+    size_t liveCount = 0;
+    size_t pooledCount = 0;
+    size_t pooledBytes = 0;
+};
+
+// Budget for texture storage kept alive in the recycle pool (default 128 MB).
+extern size_t g_texturePoolBudgetBytes;
+
+// Creates a mipmapped texture from `pixels`, which holds the first `levels`
+// mip levels back to back (see buildMipChain()); any further levels are
+// generated by the driver. One channel is grey (stored as R8 and sampled as
+// grey), three RGB and four RGBA (both stored as RGBA8). Storage is immutable
+// where the driver allows it and reused from the pool when one of the same
+// size and format is free.
+// Must be called on the GL thread.
+TextureHandle generateTexture(const unsigned char* pixels, int width, int height, int channels, int levels);
+
+// Creates a texture with storage for `levels` mip levels but no pixels yet,
+// to be filled a few rows at a time with uploadTextureRows(). Sampling is
+// limited to the coarsest level until setTextureLevels() says otherwise.
+// These textures are deleted, not pooled, when released.
+TextureHandle allocateTexture(int width, int height, int channels, int levels);
+
+// Uploads `rowCount` tightly packed rows of mip `level`, which is
+// `levelWidth` pixels wide, starting at row `firstRow`.
+void uploadTextureRows(GLuint textureID, int level, int levelWidth, int channels, int firstRow, int rowCount, const unsigned char* pixels);
+
+// Samples only mip levels [baseLevel, maxLevel], e.g. the ones uploaded so far.
+void setTextureLevels(GLuint textureID, int baseLevel, int maxLevel);
+
+// Recycles or deletes every name released since the last call, with a
+// single glDeleteTextures for the ones that do not fit in the pool. Call
+// once per frame on the GL thread.
+void FlushTextureDeletions();
+
+// Deletes pooled and pending textures. Call before destroying the context.
+void ShutdownTextures();
+
+TextureStats GetTextureStats();
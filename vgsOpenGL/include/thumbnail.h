@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Decoded pixels of a thumbnail, independent of any GL state so they can be
+// produced on loader threads and handed to the render thread. `channels` is
+// 1 (grey), 3 (RGB) or 4 (RGBA with real transparency).
+struct ThumbnailPixels {
+    std::vector<unsigned char> pixels; // Level 0, then each smaller mip level, back to back
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int levels = 1;                    // Mip levels in `pixels`
+};
+
+// Levels of a full mip chain down to 1x1
+int mipLevelCount(int width, int height);
+
+// Bytes of the first `levels` levels of a mip chain
+size_t mipChainBytes(int width, int height, int channels, int levels);
+
+// Appends every mip level below level 0 to `thumbnail.pixels`, each one a
+// 2x2 box average of the level above, so uploads need no glGenerateMipmap.
+// Colour is averaged in linear light, RGBA with premultiplied alpha.
+void buildMipChain(ThumbnailPixels& thumbnail);
+
+// How thumbnails are downscaled. Fast and Balanced first average boxes of
+// the source by the largest power of two that leaves at least twice the
+// thumbnail size, so stbir's filter only runs over a few source pixels per
+// thumbnail pixel. Balanced averages in linear light and keeps stbir's
+// default filter; Fast averages the sRGB bytes and uses a triangle filter.
+// High is a single stbir pass over the source.
+enum class ResizeQuality : uint8_t {
+    Fast,
+    Balanced,
+    High,
+    Count
+};
+
+const char* resizeQualityName(ResizeQuality quality);
+
+// Accepts "fast", "balanced" and "high"
+bool parseResizeQuality(const char* name, ResizeQuality& quality);
+
+// Used by generateThumbnails() on the loader threads; Balanced by default.
+// Thumbnails already in the disk cache keep the quality they were made with.
+void setResizeQuality(ResizeQuality quality);
+ResizeQuality getResizeQuality();
+
+// Downscales `channels`-channel sRGB pixels to `newWidth` x `newHeight`
+// into `dst` (tightly packed). Alpha is weighted as stbir_resize_uint8_srgb
+// weights it. Large sources are reduced on the ResizeService pool.
+bool resizePixels(const unsigned char* src, int width, int height, int channels,
+    unsigned char* dst, int newWidth, int newHeight, ResizeQuality quality);
+
+// Decodes `inputImagePath`, resizes it and writes the thumbnail as PNG with
+// the source's channels (without alpha when the source is opaque). Below
+// High quality a codec may decode at a reduced size down to twice the
+// thumbnail's (ImageCodec::DecodeScaled()).
+bool generateThumbnails(const char* inputImagePath, const char* outputImagePath, int newWidth, int newHeight);
+
+// Loads a cached thumbnail from disk with the channels its content needs,
+// through the ImageCodecs.
+bool loadThumbnailPixels(const char* thumbnailPath, ThumbnailPixels& out);
+
+// Decodes a full-size source image with the channels its content needs,
+// through the first of the ImageCodecs that takes it. With `onPreview`, a
+// `previewWidth` x `previewHeight` downscale goes to it before `out` is
+// filled: from a codec that scales in the DCT ahead of the full decode,
+// otherwise resized from the full pixels as soon as they are decoded.
+bool loadImagePixels(const char* imagePath, ThumbnailPixels& out,
+    int previewWidth = 0, int previewHeight = 0, const std::function<void(ThumbnailPixels&&)>& onPreview = nullptr);
+
+// Averages 2x2 blocks of a single-level image into the next mip level the
+// way buildMipChain() does, half the size rounded down as in a GL mip chain
+// (an odd last row or column is dropped). Large levels are halved in bands
+// of rows on the ResizeService pool.
+void downsampleHalf(const ThumbnailPixels& in, ThumbnailPixels& out);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "thumbnail.h"
+
+// Hit counters for the three places a thumbnail can come from when a tile
+// scrolls into view: an already resident GL texture, the compressed RAM
+// cache, or the .thumb.png file on disk (generated first if missing).
+struct CacheTierStats {
+    uint64_t vramHits = 0;
+    uint64_t ramHits = 0;
+    uint64_t diskHits = 0;
+    uint64_t generated = 0;
+
+    uint64_t Total() const { return vramHits + ramHits + diskHits; }
+};
+
+// LZ4-compresses thumbnail pixels, with their mip chain, into `out`. Safe to call from any thread.
+bool compressThumbnail(const ThumbnailPixels& thumbnail, std::vector<unsigned char>& out);
+
+// LRU cache of LZ4-compressed thumbnails kept in system memory, bounded by a
+// byte budget on the compressed size. Keys are catalogue indices of the
+// currently loaded folder. Only used from the render thread.
+class RamThumbnailCache {
+public:
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const { return budgetBytes; }
+    size_t GetUsedBytes() const { return usedBytes; }
+    size_t GetEntryCount() const { return entries.size(); }
+
+    void Insert(uint32_t key, std::vector<unsigned char>&& compressed, int width, int height, int channels, int levels);
+    bool Contains(uint32_t key) const;
+
+    // Decompresses the entry into `out` and marks it most recently used.
+    bool Fetch(uint32_t key, ThumbnailPixels& out);
+
+    void Clear();
+
+private:
+    struct Entry {
+        std::vector<unsigned char> compressed;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        int levels = 1;
+        std::list<uint32_t>::iterator lruPosition;
+    };
+
+    void EvictToBudget();
+
+    std::unordered_map<uint32_t, Entry> entries;
+    std::list<uint32_t> lru; // Front is most recently used
+    size_t budgetBytes = 256u * 1024u * 1024u;
+    size_t usedBytes = 0;
+};
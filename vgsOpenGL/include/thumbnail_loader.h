@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thumbnail.h"
+
+// A request to bring one thumbnail in from the disk tier.
+struct ThumbnailLoadRequest {
+    uint32_t index = 0;        // Catalogue index of the image
+    uint32_t generation = 0;   // Folder load the request belongs to
+    std::string filePath;
+    std::string thumbnailPath;
+    int thumbnailWidth = 0;
+    int thumbnailHeight = 0;
+    bool large = false;        // The large level; skips the RAM tier copy
+    uint64_t sequence = 0;     // Assigned by ThumbnailLoader::Request()
+};
+
+struct ThumbnailLoadResult {
+    uint32_t index = 0;
+    uint32_t generation = 0;
+    uint64_t sequence = 0;
+    bool large = false;
+    bool ok = false;
+    bool generated = false;    // The .thumb.png had to be created first
+    ThumbnailPixels thumbnail;
+    std::vector<unsigned char> compressed; // LZ4 copy for the RAM tier
+};
+
+// Background workers that read (or generate) thumbnails from disk. Requests
+// are served newest first so the region the user is looking at right now
+// wins over tiles that were requested while scrolling past.
+class ThumbnailLoader {
+public:
+    ~ThumbnailLoader();
+
+    void Start(unsigned threadCount);
+    void Stop();
+
+    void Request(ThumbnailLoadRequest&& request);
+    void CancelPending();
+
+    // Moves up to `maxResults` finished loads into `out`.
+    size_t PollResults(std::vector<ThumbnailLoadResult>& out, size_t maxResults);
+
+    size_t GetPendingCount();
+    size_t GetCompletedCount();
+
+    // Runs every queued request to completion, then holds back new requests
+    // until the next Drain(). The new results are ordered as a single worker
+    // would have produced them, so a replay that drains once per frame sees
+    // the same uploads in every run regardless of thread timing.
+    void Drain();
+
+    // Called from a worker thread every time a result becomes available.
+    void SetResultCallback(std::function<void()> callback) { onResultReady = std::move(callback); }
+
+private:
+    void WorkerMain(unsigned workerIndex);
+    static ThumbnailLoadResult Execute(const ThumbnailLoadRequest& request);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable becameIdle;
+    std::vector<ThumbnailLoadRequest> pending;
+    std::vector<ThumbnailLoadResult> completed;
+    unsigned activeJobs = 0;
+    uint64_t nextSequence = 0;
+    bool paused = false;       // Set by Drain(): requests wait for the next Drain()
+    std::function<void()> onResultReady;
+    bool stopping = false;
+};
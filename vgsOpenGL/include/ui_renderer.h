@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct ImDrawData;
+
+struct UIRendererStats {
+    bool active = false;          // Lean path initialised and in use
+    bool persistent = false;      // Persistent-mapped ring, else one glBufferSubData per frame
+    size_t capacityBytes = 0;     // Per frame region of the shared vertex+index buffer
+    size_t lastFrameBytes = 0;
+    uint64_t reallocations = 0;   // Buffer grows and shrinks
+    uint64_t fenceWaits = 0;      // Frames that found their ring region still in use by the GPU
+};
+
+// Lean replacement for ImGui_ImplOpenGL3_RenderDrawData() for a context the
+// app owns. It does not back up or restore GL state (only the scissor test is
+// switched off again so the next glClear covers the whole target), keeps one
+// VAO and one buffer for the lifetime of the context, and writes all draw
+// lists of a frame with a single upload. The ImGui backend still owns the
+// font and other ImGui textures, so it must stay initialised.
+namespace UIRenderer
+{
+    // Off by default; VGS_LEAN_UI_RENDERER=1 or the perf overlay turn it on.
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+
+    // Renders with the lean path when enabled, otherwise (or if its GL
+    // objects could not be created) with the ImGui backend.
+    void RenderDrawData(ImDrawData* drawData);
+
+    UIRendererStats GetStats();
+
+    // Deletes the GL objects. Call before destroying the context.
+    void Shutdown();
+}
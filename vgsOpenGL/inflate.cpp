@@ -0,0 +1,466 @@
+#include "inflate.h"
+
+#include <cstring>
+
+namespace Inflate
+{
+	static const int kFastBits = 11;
+	static const int kMaxCodeLength = 15;
+
+	// Table entries pack the code length in bits 0-4 (both codes of a
+	// literal pair), the kind in bits 5-7, the count of extra bits that
+	// follow the code in bits 8-11 and the value in bits 16-31.
+	enum EntryKind : uint32_t {
+		kLiteral,
+		kLiteralPair,   // First literal in bits 16-23, second in 24-31
+		kLength,        // Value is the base match length
+		kEndOfBlock,
+		kDistance,      // Value is the base match distance
+		kSlow,          // Code longer than kFastBits
+		kInvalid
+	};
+
+	static const uint16_t kLengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+	static const uint8_t kLengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+	static const uint16_t kDistanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+	static const uint8_t kDistanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+	static const uint8_t kCodeLengthOrder[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+	};
+
+	static uint32_t makeEntry(uint32_t kind, uint32_t extra, uint32_t value) {
+		return kind << 5 | extra << 8 | value << 16;
+	}
+
+	static uint32_t kindOf(uint32_t entry) {
+		return entry >> 5 & 7;
+	}
+
+	static uint32_t literalLengthEntry(int symbol) {
+		if (symbol < 256) {
+			return makeEntry(kLiteral, 0, symbol);
+		}
+		if (symbol == 256) {
+			return makeEntry(kEndOfBlock, 0, 0);
+		}
+		if (symbol <= 285) {
+			return makeEntry(kLength, kLengthExtra[symbol - 257], kLengthBase[symbol - 257]);
+		}
+		return makeEntry(kInvalid, 0, 0);
+	}
+
+	static uint32_t distanceEntry(int symbol) {
+		if (symbol < 30) {
+			return makeEntry(kDistance, kDistanceExtra[symbol], kDistanceBase[symbol]);
+		}
+		return makeEntry(kInvalid, 0, 0);
+	}
+
+	// Code length alphabet symbols decode as literals of their own value
+	static uint32_t codeLengthEntry(int symbol) {
+		return makeEntry(kLiteral, 0, symbol);
+	}
+
+	// Reads the stream from the least significant bit up. Past the end of
+	// the input it reads zeros and counts them, so a stream that needed them
+	// can be told apart once decoding stops.
+	struct BitReader {
+		const uint8_t* next;
+		const uint8_t* end;
+		uint64_t buffer = 0;
+		int count = 0;
+		size_t overrun = 0;     // Zero bytes read past the end
+
+		BitReader(const uint8_t* begin, const uint8_t* end) : next(begin), end(end) {}
+
+		// Leaves at least 56 bits in the buffer
+		void Refill() {
+			if (end - next >= 8) {
+				// Bits at `count` and above may be set again with the same values
+				uint64_t word;
+				std::memcpy(&word, next, sizeof(word));
+				buffer |= word << count;
+				next += (63 - count) >> 3;
+				count |= 56;
+				return;
+			}
+			while (count <= 56) {
+				uint64_t byte = 0;
+				if (next < end) {
+					byte = *next++;
+				}
+				else {
+					overrun++;
+				}
+				buffer |= byte << count;
+				count += 8;
+			}
+		}
+
+		uint32_t Peek(int bits) const {
+			return (uint32_t)buffer & ((1u << bits) - 1);
+		}
+
+		void Consume(int bits) {
+			buffer >>= bits;
+			count -= bits;
+		}
+
+		uint32_t Read(int bits) {
+			uint32_t value = Peek(bits);
+			Consume(bits);
+			return value;
+		}
+
+		// Whether any consumed bit lay past the end of the input
+		bool Overran() const {
+			return overrun * 8 > (size_t)count;
+		}
+
+		// Drops the bits up to the next byte boundary and rewinds to the
+		// first byte not yet consumed, for stored blocks
+		size_t AlignToByte(const uint8_t* begin) {
+			Consume(count & 7);
+			size_t position = (size_t)(next - begin) + overrun - (size_t)count / 8;
+			buffer = 0;
+			count = 0;
+			overrun = 0;
+			next = begin + position;
+			return position;
+		}
+	};
+
+	struct Huffman {
+		uint32_t fast[1 << kFastBits];
+		uint16_t counts[kMaxCodeLength + 1];    // Codes of each length
+		uint16_t symbols[288];                  // In canonical code order
+		uint32_t entries[288];                  // Per symbol, without the length
+
+		// False for an over-subscribed code. Incomplete codes are allowed, as
+		// a distance code with a single symbol is.
+		bool Build(const uint8_t* lengths, int symbolCount, uint32_t (*entryOf)(int), bool pairLiterals) {
+			std::memset(counts, 0, sizeof(counts));
+			for (int i = 0; i < symbolCount; i++) {
+				counts[lengths[i]]++;
+			}
+			counts[0] = 0;
+			int left = 1;
+			uint16_t offsets[kMaxCodeLength + 2];
+			offsets[1] = 0;
+			for (int length = 1; length <= kMaxCodeLength; length++) {
+				left = (left << 1) - counts[length];
+				if (left < 0) {
+					return false;
+				}
+				offsets[length + 1] = (uint16_t)(offsets[length] + counts[length]);
+			}
+
+			for (uint32_t& entry : fast) {
+				entry = makeEntry(kSlow, 0, 0);
+			}
+			uint32_t nextCode[kMaxCodeLength + 1];
+			uint32_t code = 0;
+			for (int length = 1; length <= kMaxCodeLength; length++) {
+				code = (code + counts[length - 1]) << 1;
+				nextCode[length] = code;
+			}
+			for (int symbol = 0; symbol < symbolCount; symbol++) {
+				int length = lengths[symbol];
+				entries[symbol] = entryOf(symbol);
+				if (length == 0) {
+					continue;
+				}
+				symbols[offsets[length]++] = (uint16_t)symbol;
+				uint32_t reversed = 0;
+				for (uint32_t bits = nextCode[length]++, i = 0; i < (uint32_t)length; i++, bits >>= 1) {
+					reversed = reversed << 1 | (bits & 1);
+				}
+				if (length <= kFastBits) {
+					for (uint32_t index = reversed; index < (1u << kFastBits); index += 1u << length) {
+						fast[index] = entries[symbol] | length;
+					}
+				}
+			}
+
+			if (pairLiterals) {
+				// The second code is looked up among the bits after the first.
+				// Going down, the entry at index >> length still holds a single
+				// symbol when it is read.
+				for (int index = (1 << kFastBits) - 1; index >= 0; index--) {
+					uint32_t first = fast[index];
+					int firstLength = first & 31;
+					if (kindOf(first) != kLiteral || firstLength == 0) {
+						continue;
+					}
+					uint32_t second = fast[index >> firstLength];
+					int secondLength = second & 31;
+					if (kindOf(second) == kLiteral && firstLength + secondLength <= kFastBits) {
+						fast[index] = makeEntry(kLiteralPair, 0, (first >> 16) | (second >> 16) << 8) | (firstLength + secondLength);
+					}
+				}
+			}
+			return true;
+		}
+
+		// The entry of the next symbol, with its code length. The reader
+		// holds at least kMaxCodeLength bits.
+		uint32_t Decode(const BitReader& bits) const {
+			uint32_t entry = fast[bits.Peek(kFastBits)];
+			if (kindOf(entry) != kSlow) {
+				return entry;
+			}
+			// Canonical codes of each length follow on from the shorter ones
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int length = 1; length <= kMaxCodeLength; length++) {
+				code |= (int)(bits.buffer >> (length - 1)) & 1;
+				int count = counts[length];
+				if (code - first < count) {
+					return entries[symbols[index + code - first]] | length;
+				}
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return makeEntry(kInvalid, 0, 0);
+		}
+	};
+
+	// Copies a match of `length` bytes from `distance` bytes back. Matches
+	// that do not overlap their own output within 8 bytes move 8 bytes at a
+	// time while there is room to overshoot.
+	static void copyMatch(uint8_t* out, size_t distance, size_t length, const uint8_t* outEnd) {
+		const uint8_t* from = out - distance;
+		if (distance >= 8 && (size_t)(outEnd - out) >= length + 8) {
+			uint8_t* end = out + length;
+			do {
+				uint64_t word;
+				std::memcpy(&word, from, sizeof(word));
+				std::memcpy(out, &word, sizeof(word));
+				from += 8;
+				out += 8;
+			} while (out < end);
+		}
+		else if (distance == 1) {
+			std::memset(out, *from, length);
+		}
+		else {
+			for (size_t i = 0; i < length; i++) {
+				out[i] = from[i];
+			}
+		}
+	}
+
+	static bool decodeSymbols(BitReader& bits, const Huffman& literalLengths, const Huffman& distances,
+		const uint8_t* dst, uint8_t*& out, const uint8_t* outEnd) {
+		// The reader holds enough for a length code, a distance code and
+		// their extra bits at the top of the loop. The next table entry is
+		// looked up as soon as a literal's bits are consumed, ahead of the
+		// refill, which only adds bits above those it looks at.
+		bits.Refill();
+		uint32_t entry = literalLengths.fast[bits.Peek(kFastBits)];
+		for (;;) {
+			if (kindOf(entry) == kSlow) {
+				entry = literalLengths.Decode(bits);
+			}
+			bits.Consume(entry & 31);
+			switch (kindOf(entry)) {
+			case kLiteral:
+				if (out == outEnd) {
+					return false;
+				}
+				*out++ = (uint8_t)(entry >> 16);
+				entry = literalLengths.fast[bits.Peek(kFastBits)];
+				bits.Refill();
+				continue;
+			case kLiteralPair:
+				if (outEnd - out < 2) {
+					return false;
+				}
+				out[0] = (uint8_t)(entry >> 16);
+				out[1] = (uint8_t)(entry >> 24);
+				out += 2;
+				entry = literalLengths.fast[bits.Peek(kFastBits)];
+				bits.Refill();
+				continue;
+			case kLength:
+				break;
+			case kEndOfBlock:
+				return true;
+			default:
+				return false;
+			}
+
+			size_t length = (entry >> 16) + bits.Read(entry >> 8 & 15);
+			entry = distances.Decode(bits);
+			if (kindOf(entry) != kDistance) {
+				return false;
+			}
+			bits.Consume(entry & 31);
+			size_t distance = (entry >> 16) + bits.Read(entry >> 8 & 15);
+			if (distance > (size_t)(out - dst) || length > (size_t)(outEnd - out)) {
+				return false;
+			}
+			copyMatch(out, distance, length, outEnd);
+			out += length;
+			bits.Refill();
+			entry = literalLengths.fast[bits.Peek(kFastBits)];
+		}
+	}
+
+	// Decodes the symbols of one Huffman-coded block up to its end of block.
+	// The reader and output position are copied to locals, so the compiler
+	// can keep them in registers across the output stores, which may alias
+	// anything.
+	static bool decodeBlock(BitReader& bits, const Huffman& literalLengths, const Huffman& distances,
+		const uint8_t* dst, uint8_t*& out, const uint8_t* outEnd) {
+		BitReader reader = bits;
+		uint8_t* position = out;
+		bool ok = decodeSymbols(reader, literalLengths, distances, dst, position, outEnd);
+		bits = reader;
+		out = position;
+		return ok;
+	}
+
+	static bool buildFixed(Huffman& literalLengths, Huffman& distances) {
+		uint8_t lengths[288];
+		std::memset(lengths, 8, 144);
+		std::memset(lengths + 144, 9, 256 - 144);
+		std::memset(lengths + 256, 7, 280 - 256);
+		std::memset(lengths + 280, 8, 288 - 280);
+		if (!literalLengths.Build(lengths, 288, literalLengthEntry, true)) {
+			return false;
+		}
+		std::memset(lengths, 5, 32);
+		return distances.Build(lengths, 32, distanceEntry, false);
+	}
+
+	static bool readDynamic(BitReader& bits, Huffman& literalLengths, Huffman& distances) {
+		bits.Refill();
+		int literalCount = (int)bits.Read(5) + 257;
+		int distanceCount = (int)bits.Read(5) + 1;
+		int codeLengthCount = (int)bits.Read(4) + 4;
+		if (literalCount > 286 || distanceCount > 30) {
+			return false;
+		}
+
+		uint8_t codeLengthLengths[19] = {};
+		for (int i = 0; i < codeLengthCount; i++) {
+			bits.Refill();
+			codeLengthLengths[kCodeLengthOrder[i]] = (uint8_t)bits.Read(3);
+		}
+		Huffman codeLengths;
+		if (!codeLengths.Build(codeLengthLengths, 19, codeLengthEntry, false)) {
+			return false;
+		}
+
+		// Literal/length and distance code lengths run on into each other
+		uint8_t lengths[286 + 30];
+		int total = literalCount + distanceCount;
+		for (int i = 0; i < total;) {
+			bits.Refill();
+			uint32_t entry = codeLengths.Decode(bits);
+			if (kindOf(entry) != kLiteral) {
+				return false;
+			}
+			bits.Consume(entry & 31);
+			int symbol = (int)(entry >> 16);
+			if (symbol < 16) {
+				lengths[i++] = (uint8_t)symbol;
+				continue;
+			}
+			int repeat;
+			uint8_t value = 0;
+			if (symbol == 16) {
+				if (i == 0) {
+					return false;
+				}
+				value = lengths[i - 1];
+				repeat = 3 + (int)bits.Read(2);
+			}
+			else if (symbol == 17) {
+				repeat = 3 + (int)bits.Read(3);
+			}
+			else {
+				repeat = 11 + (int)bits.Read(7);
+			}
+			if (repeat > total - i) {
+				return false;
+			}
+			std::memset(lengths + i, value, repeat);
+			i += repeat;
+		}
+
+		return literalLengths.Build(lengths, literalCount, literalLengthEntry, true) &&
+			distances.Build(lengths + literalCount, distanceCount, distanceEntry, false);
+	}
+
+	bool Zlib(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+		if (srcSize < 2) {
+			return false;
+		}
+		int cmf = src[0];
+		int flags = src[1];
+		// Deflate, header check, no preset dictionary
+		if ((cmf & 15) != 8 || (cmf * 256 + flags) % 31 != 0 || (flags & 32) != 0) {
+			return false;
+		}
+
+		const uint8_t* begin = src + 2;
+		const uint8_t* end = src + srcSize;
+		BitReader bits(begin, end);
+		uint8_t* out = dst;
+		const uint8_t* outEnd = dst + dstSize;
+		Huffman literalLengths;
+		Huffman distances;
+		bool last;
+		do {
+			bits.Refill();
+			last = bits.Read(1) != 0;
+			uint32_t type = bits.Read(2);
+			if (type == 0) {
+				size_t position = bits.AlignToByte(begin);
+				if (position > (size_t)(end - begin) || (size_t)(end - begin) - position < 4) {
+					return false;
+				}
+				const uint8_t* header = begin + position;
+				size_t length = header[0] | header[1] << 8;
+				size_t complement = header[2] | header[3] << 8;
+				if ((length ^ complement) != 0xFFFF ||
+					(size_t)(end - header) - 4 < length || (size_t)(outEnd - out) < length) {
+					return false;
+				}
+				std::memcpy(out, header + 4, length);
+				out += length;
+				bits.next = header + 4 + length;
+				continue;
+			}
+			if (type == 1) {
+				if (!buildFixed(literalLengths, distances)) {
+					return false;
+				}
+			}
+			else if (type != 2 || !readDynamic(bits, literalLengths, distances)) {
+				return false;
+			}
+			if (!decodeBlock(bits, literalLengths, distances, dst, out, outEnd)) {
+				return false;
+			}
+		} while (!last);
+
+		return out == outEnd && !bits.Overran();
+	}
+}
@@ -0,0 +1,162 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "input_recording.h"
+#include "imgui.h"
+#include "imgui_internal.h"
+
+static const char* const kRecordingHeader = "vgs-input-recording 1";
+
+bool InputRecording::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file) {
+		std::cerr << "Error: Could not write input recording " << path << std::endl;
+		return false;
+	}
+
+	file << kRecordingHeader << "\n";
+	char line[128];
+	for (const RecordedInputFrame& frame : frames) {
+		snprintf(line, sizeof(line), "frame %.9g %g %g\n", frame.deltaTime, frame.displayWidth, frame.displayHeight);
+		file << line;
+		for (const RecordedInputEvent& event : frame.events) {
+			switch (event.type) {
+			case RecordedInputEvent::MousePos: snprintf(line, sizeof(line), "pos %g %g\n", event.x, event.y); break;
+			case RecordedInputEvent::MouseButton: snprintf(line, sizeof(line), "button %d %d\n", event.code, (int)event.down); break;
+			case RecordedInputEvent::MouseWheel: snprintf(line, sizeof(line), "wheel %g %g\n", event.x, event.y); break;
+			case RecordedInputEvent::Key: snprintf(line, sizeof(line), "key %d %d\n", event.code, (int)event.down); break;
+			case RecordedInputEvent::Char: snprintf(line, sizeof(line), "char %d\n", event.code); break;
+			case RecordedInputEvent::Focus: snprintf(line, sizeof(line), "focus %d\n", (int)event.down); break;
+			}
+			file << line;
+		}
+	}
+	return (bool)file;
+}
+
+bool InputRecording::Load(const std::string& path) {
+	frames.clear();
+	std::ifstream file(path);
+	std::string line;
+	if (!file || !std::getline(file, line) || line != kRecordingHeader) {
+		std::cerr << "Error: " << path << " is not an input recording" << std::endl;
+		return false;
+	}
+
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string tag;
+		fields >> tag;
+		if (tag == "frame") {
+			RecordedInputFrame frame;
+			fields >> frame.deltaTime >> frame.displayWidth >> frame.displayHeight;
+			frames.push_back(std::move(frame));
+			continue;
+		}
+		if (frames.empty() || tag.empty()) {
+			continue;
+		}
+
+		RecordedInputEvent event;
+		int down = 0;
+		if (tag == "pos") {
+			event.type = RecordedInputEvent::MousePos;
+			fields >> event.x >> event.y;
+		}
+		else if (tag == "button") {
+			event.type = RecordedInputEvent::MouseButton;
+			fields >> event.code >> down;
+		}
+		else if (tag == "wheel") {
+			event.type = RecordedInputEvent::MouseWheel;
+			fields >> event.x >> event.y;
+		}
+		else if (tag == "key") {
+			event.type = RecordedInputEvent::Key;
+			fields >> event.code >> down;
+		}
+		else if (tag == "char") {
+			event.type = RecordedInputEvent::Char;
+			fields >> event.code;
+		}
+		else if (tag == "focus") {
+			event.type = RecordedInputEvent::Focus;
+			fields >> down;
+		}
+		else {
+			std::cerr << "Warning: Unknown input event '" << tag << "' in " << path << std::endl;
+			continue;
+		}
+		event.down = down != 0;
+		frames.back().events.push_back(event);
+	}
+	return true;
+}
+
+void captureInputFrame(RecordedInputFrame& out) {
+	ImGuiContext& g = *ImGui::GetCurrentContext();
+	ImGuiIO& io = g.IO;
+	out.deltaTime = io.DeltaTime;
+	out.displayWidth = io.DisplaySize.x;
+	out.displayHeight = io.DisplaySize.y;
+	out.events.clear();
+
+	for (const ImGuiInputEvent& source : g.InputEventsQueue) {
+		RecordedInputEvent event;
+		switch (source.Type) {
+		case ImGuiInputEventType_MousePos:
+			event.type = RecordedInputEvent::MousePos;
+			event.x = source.MousePos.PosX;
+			event.y = source.MousePos.PosY;
+			break;
+		case ImGuiInputEventType_MouseButton:
+			event.type = RecordedInputEvent::MouseButton;
+			event.code = source.MouseButton.Button;
+			event.down = source.MouseButton.Down;
+			break;
+		case ImGuiInputEventType_MouseWheel:
+			event.type = RecordedInputEvent::MouseWheel;
+			event.x = source.MouseWheel.WheelX;
+			event.y = source.MouseWheel.WheelY;
+			break;
+		case ImGuiInputEventType_Key:
+			event.type = RecordedInputEvent::Key;
+			event.code = (int)source.Key.Key;
+			event.down = source.Key.Down;
+			break;
+		case ImGuiInputEventType_Text:
+			event.type = RecordedInputEvent::Char;
+			event.code = (int)source.Text.Char;
+			break;
+		case ImGuiInputEventType_Focus:
+			event.type = RecordedInputEvent::Focus;
+			event.down = source.AppFocused.Focused;
+			break;
+		default:
+			continue; // Viewport hover only matters with multiple OS windows
+		}
+		out.events.push_back(event);
+	}
+}
+
+void applyInputFrame(const RecordedInputFrame& frame) {
+	ImGuiIO& io = ImGui::GetIO();
+	io.DeltaTime = frame.deltaTime > 0.0f ? frame.deltaTime : 1.0f / 60.0f;
+	io.DisplaySize = ImVec2(frame.displayWidth, frame.displayHeight);
+	io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+
+	for (const RecordedInputEvent& event : frame.events) {
+		switch (event.type) {
+		case RecordedInputEvent::MousePos: io.AddMousePosEvent(event.x, event.y); break;
+		case RecordedInputEvent::MouseButton: io.AddMouseButtonEvent(event.code, event.down); break;
+		case RecordedInputEvent::MouseWheel: io.AddMouseWheelEvent(event.x, event.y); break;
+		case RecordedInputEvent::Key: io.AddKeyEvent((ImGuiKey)event.code, event.down); break;
+		case RecordedInputEvent::Char: io.AddInputCharacter((unsigned int)event.code); break;
+		case RecordedInputEvent::Focus: io.AddFocusEvent(event.down); break;
+		}
+	}
+}
@@ -0,0 +1,646 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "jpeg_decoder.h"
+#include "pixel_kernels.h"
+#include "resize_service.h"
+#include "trace.h"
+
+namespace
+{
+	const int kFastBits = 9;
+
+	// Zigzag order to natural order, with the overflow of a corrupt run
+	// landing on the last coefficient
+	const uint8_t kDezigzag[64 + 15] = {
+		0, 1, 8, 16, 9, 2, 3, 10,
+		17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34,
+		27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36,
+		29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46,
+		53, 60, 61, 54, 47, 55, 62, 63,
+		63, 63, 63, 63, 63, 63, 63, 63,
+		63, 63, 63, 63, 63, 63, 63
+	};
+
+	// Entropy-coded bits of one restart interval. Past its end, or past a
+	// marker inside it, it reads zeros, as stb_image's reader does.
+	struct BitReader {
+		const unsigned char* next;
+		const unsigned char* end;
+		uint32_t buffer = 0;    // Left aligned
+		int count = 0;
+		bool noMore = false;
+
+		BitReader(const unsigned char* begin, const unsigned char* end) : next(begin), end(end) {}
+
+		void Fill() {
+			do {
+				uint32_t byte = 0;
+				if (!noMore) {
+					// The end is where the restart marker was
+					if (next == end) {
+						noMore = true;
+						return;
+					}
+					byte = *next++;
+					if (byte == 0xFF) {
+						unsigned char stuffed = next < end ? *next++ : 0xD0;
+						if (stuffed != 0) {
+							noMore = true;
+							return;
+						}
+					}
+				}
+				buffer |= byte << (24 - count);
+				count += 8;
+			} while (count <= 24);
+		}
+
+		// The next Huffman symbol, or -1 for a code the table does not have
+		int Decode(const uint16_t* fast, const uint8_t* sizes, const uint8_t* values, const uint32_t* maxCode, const int* delta) {
+			if (count < 16) {
+				Fill();
+			}
+			int index = fast[buffer >> (32 - kFastBits)];
+			if (index != 0) {
+				int length = sizes[index - 1];
+				if (length > count) {
+					return -1;
+				}
+				buffer <<= length;
+				count -= length;
+				return values[index - 1];
+			}
+			uint32_t top = buffer >> 16;
+			int length = kFastBits + 1;
+			while (top >= maxCode[length]) {
+				length++;
+			}
+			if (length == 17 || length > count) {
+				return -1;
+			}
+			int symbol = (int)(buffer >> (32 - length)) + delta[length];
+			if (symbol < 0 || symbol >= 256) {
+				return -1;
+			}
+			buffer <<= length;
+			count -= length;
+			return values[symbol];
+		}
+
+		// `bits` bits as a signed coefficient value
+		int Extend(int bits) {
+			if (count < bits) {
+				Fill();
+				if (count < bits) {
+					return 0;
+				}
+			}
+			int value = (int)(buffer >> (32 - bits));
+			bool negative = (buffer >> 31) == 0;
+			buffer <<= bits;
+			count -= bits;
+			return negative ? value - (1 << bits) + 1 : value;
+		}
+	};
+
+	// stb_image's upsampling of one row of a subsampled component to full
+	// width. `near` is the nearer source row, weighted 3 to the 1 of `far`.
+	const uint8_t* resampleRow(uint8_t* out, const uint8_t* near, const uint8_t* far, int w, int hs, int vs) {
+		if (hs == 1 && vs == 1) {
+			return near;
+		}
+		if (hs == 1 && vs == 2) {
+			for (int i = 0; i < w; i++) {
+				out[i] = (uint8_t)((3 * near[i] + far[i] + 2) >> 2);
+			}
+			return out;
+		}
+		if (hs == 2 && vs == 1) {
+			if (w == 1) {
+				out[0] = out[1] = near[0];
+				return out;
+			}
+			out[0] = near[0];
+			out[1] = (uint8_t)((near[0] * 3 + near[1] + 2) >> 2);
+			int i = 1;
+			for (; i < w - 1; i++) {
+				int n = 3 * near[i] + 2;
+				out[i * 2] = (uint8_t)((n + near[i - 1]) >> 2);
+				out[i * 2 + 1] = (uint8_t)((n + near[i + 1]) >> 2);
+			}
+			out[i * 2] = (uint8_t)((near[w - 2] * 3 + near[w - 1] + 2) >> 2);
+			out[i * 2 + 1] = near[w - 1];
+			return out;
+		}
+		if (hs == 2 && vs == 2) {
+			if (w == 1) {
+				out[0] = out[1] = (uint8_t)((3 * near[0] + far[0] + 2) >> 2);
+				return out;
+			}
+			int t1 = 3 * near[0] + far[0];
+			out[0] = (uint8_t)((t1 + 2) >> 2);
+			for (int i = 1; i < w; i++) {
+				int t0 = t1;
+				t1 = 3 * near[i] + far[i];
+				out[i * 2 - 1] = (uint8_t)((3 * t0 + t1 + 8) >> 4);
+				out[i * 2] = (uint8_t)((3 * t1 + t0 + 8) >> 4);
+			}
+			out[w * 2 - 1] = (uint8_t)((t1 + 2) >> 2);
+			return out;
+		}
+		// Any other factor takes the nearest sample
+		for (int i = 0; i < w; i++) {
+			for (int j = 0; j < hs; j++) {
+				out[i * hs + j] = near[i];
+			}
+		}
+		return out;
+	}
+}
+
+struct JpegDecoder::Planes {
+	int firstMcuRow = 0;
+	int endMcuRow = 0;
+	size_t stride[3] = {};
+	std::vector<uint8_t> samples[3];
+};
+
+bool JpegDecoder::Open(const unsigned char* bytes, size_t length) {
+	*this = JpegDecoder();
+	data = bytes;
+	size = length;
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+		return false;
+	}
+
+	bool haveFrame = false;
+	size_t pos = 2;
+	for (;;) {
+		// A marker may be preceded by any number of fill bytes
+		if (pos >= size || data[pos] != 0xFF) {
+			return false;
+		}
+		while (pos < size && data[pos] == 0xFF) {
+			pos++;
+		}
+		if (pos + 3 > size) {
+			return false;
+		}
+		int marker = data[pos];
+		size_t segmentLength = ((size_t)data[pos + 1] << 8) | data[pos + 2];
+		if (segmentLength < 2 || pos + 1 + segmentLength > size) {
+			return false;
+		}
+		const unsigned char* segment = data + pos + 3;
+		segmentLength -= 2;
+		pos += 3 + segmentLength;
+
+		switch (marker) {
+		case 0xC0: // Baseline
+		case 0xC1: // Extended, Huffman coded
+			if (haveFrame || !ReadFrame(segment, segmentLength)) {
+				return false;
+			}
+			haveFrame = true;
+			break;
+		case 0xC4: // Huffman tables
+		case 0xDB: // Quantization tables
+		case 0xDD: // Restart interval
+		case 0xE0: // JFIF
+		case 0xEE: // Adobe
+			if (!ReadTables(marker, segment, segmentLength)) {
+				return false;
+			}
+			break;
+		case 0xDA:
+			return haveFrame && ReadScan(segment, segmentLength) && IndexIntervals(pos);
+		default:
+			// Other application segments and comments are skipped; progressive,
+			// lossless and arithmetic coded frames are left to stb_image
+			if ((marker >= 0xE1 && marker <= 0xEF) || marker == 0xFE) {
+				break;
+			}
+			return false;
+		}
+	}
+}
+
+bool JpegDecoder::ReadTables(int marker, const unsigned char* segment, size_t length) {
+	const unsigned char* end = segment + length;
+	switch (marker) {
+	case 0xDB:
+		while (segment < end) {
+			int precision = segment[0] >> 4;
+			int table = segment[0] & 15;
+			size_t bytes = precision ? 128 : 64;
+			if (precision > 1 || table > 3 || (size_t)(end - segment) < 1 + bytes) {
+				return false;
+			}
+			for (int i = 0; i < 64; i++) {
+				quant[table][kDezigzag[i]] = precision ? (uint16_t)((segment[1 + i * 2] << 8) | segment[2 + i * 2]) : segment[1 + i];
+			}
+			quantDefined[table] = true;
+			segment += 1 + bytes;
+		}
+		return true;
+
+	case 0xC4:
+		while (segment < end) {
+			if (end - segment < 17) {
+				return false;
+			}
+			int tableClass = segment[0] >> 4;
+			int table = segment[0] & 15;
+			if (tableClass > 1 || table > 3) {
+				return false;
+			}
+			int symbols = 0;
+			for (int i = 0; i < 16; i++) {
+				symbols += segment[1 + i];
+			}
+			if (symbols > 256 || end - segment < 17 + symbols) {
+				return false;
+			}
+			HuffmanTable& h = tableClass ? ac[table] : dc[table];
+			h = HuffmanTable();
+
+			// Canonical codes, shortest first
+			int k = 0;
+			for (int i = 0; i < 16; i++) {
+				for (int j = 0; j < segment[1 + i]; j++) {
+					h.sizes[k++] = (uint8_t)(i + 1);
+				}
+			}
+			h.sizes[k] = 0;
+			uint32_t code = 0;
+			k = 0;
+			for (int j = 1; j <= 16; j++) {
+				h.delta[j] = k - (int)code;
+				if (h.sizes[k] == j) {
+					while (h.sizes[k] == j) {
+						h.codes[k++] = (uint16_t)code++;
+					}
+					if (code - 1 >= (1u << j)) {
+						return false;
+					}
+				}
+				h.maxCode[j] = code << (16 - j);
+				code <<= 1;
+			}
+			h.maxCode[17] = 0xffffffff;
+			std::memcpy(h.values, segment + 17, symbols);
+
+			for (int i = 0; i < k; i++) {
+				int s = h.sizes[i];
+				if (s <= kFastBits) {
+					int first = h.codes[i] << (kFastBits - s);
+					for (int j = 0; j < (1 << (kFastBits - s)); j++) {
+						h.fast[first + j] = (uint16_t)(i + 1);
+					}
+				}
+			}
+
+			// Short AC codes with their value bits, decoded in one lookup
+			if (tableClass == 1) {
+				for (int i = 0; i < (1 << kFastBits); i++) {
+					if (h.fast[i] == 0) {
+						continue;
+					}
+					int rs = h.values[h.fast[i] - 1];
+					int run = rs >> 4;
+					int bits = rs & 15;
+					int codeLength = h.sizes[h.fast[i] - 1];
+					if (bits && codeLength + bits <= kFastBits) {
+						int value = ((i << codeLength) & ((1 << kFastBits) - 1)) >> (kFastBits - bits);
+						if (value < (1 << (bits - 1))) {
+							value -= (1 << bits) - 1;
+						}
+						if (value >= -128 && value <= 127) {
+							h.fastAc[i] = (int16_t)(value * 256 + run * 16 + codeLength + bits);
+						}
+					}
+				}
+			}
+			h.defined = true;
+			segment += 17 + symbols;
+		}
+		return true;
+
+	case 0xDD:
+		if (length != 2) {
+			return false;
+		}
+		restartInterval = (segment[0] << 8) | segment[1];
+		return true;
+
+	case 0xE0:
+		if (length >= 5 && std::memcmp(segment, "JFIF", 5) == 0) {
+			jfif = true;
+		}
+		return true;
+
+	case 0xEE:
+		if (length >= 12 && std::memcmp(segment, "Adobe", 6) == 0) {
+			adobeTransform = segment[11];
+		}
+		return true;
+	}
+	return false;
+}
+
+bool JpegDecoder::ReadFrame(const unsigned char* segment, size_t length) {
+	if (length < 6 || segment[0] != 8) {
+		return false;
+	}
+	height = (segment[1] << 8) | segment[2];
+	width = (segment[3] << 8) | segment[4];
+	// Grey and CMYK are left to stb_image
+	if (width == 0 || height == 0 || segment[5] != 3 || length != 6 + 3 * 3) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		const unsigned char* c = segment + 6 + i * 3;
+		Component& component = components[i];
+		component.id = c[0];
+		component.h = c[1] >> 4;
+		component.v = c[1] & 15;
+		component.quantTable = c[2];
+		if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantTable > 3) {
+			return false;
+		}
+		maxH = std::max(maxH, component.h);
+		maxV = std::max(maxV, component.v);
+	}
+	for (Component& component : components) {
+		if (maxH % component.h != 0 || maxV % component.v != 0) {
+			return false;
+		}
+		component.width = (width * component.h + maxH - 1) / maxH;
+		component.height = (height * component.v + maxV - 1) / maxV;
+	}
+	mcusX = (width + maxH * 8 - 1) / (maxH * 8);
+	mcusY = (height + maxV * 8 - 1) / (maxV * 8);
+	return true;
+}
+
+bool JpegDecoder::ReadScan(const unsigned char* segment, size_t length) {
+	// All three components interleaved in one sequential scan
+	if (length != 1 + 3 * 2 + 3 || segment[0] != 3) {
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		const unsigned char* s = segment + 1 + i * 2;
+		int index = 0;
+		while (index < 3 && components[index].id != s[0]) {
+			index++;
+		}
+		if (index == 3) {
+			return false;
+		}
+		Component& component = components[index];
+		component.dcTable = s[1] >> 4;
+		component.acTable = s[1] & 15;
+		if (component.dcTable > 3 || component.acTable > 3 || !dc[component.dcTable].defined ||
+			!ac[component.acTable].defined || !quantDefined[component.quantTable]) {
+			return false;
+		}
+		scanOrder[i] = index;
+	}
+	const unsigned char* spectral = segment + 7;
+	// RGB rather than YCbCr as stb_image tells them apart, by the component
+	// ids or an Adobe segment without JFIF, either of which may come after
+	// the frame header
+	rgb = (components[0].id == 'R' && components[1].id == 'G' && components[2].id == 'B') || (adobeTransform == 0 && !jfif);
+	return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+bool JpegDecoder::IndexIntervals(size_t scanStart) {
+	// Without restart markers the scan can only be decoded from the start
+	if (restartInterval == 0) {
+		return false;
+	}
+	size_t mcus = (size_t)mcusX * mcusY;
+	size_t expected = (mcus + restartInterval - 1) / restartInterval;
+	if (expected < 2) {
+		return false;
+	}
+	intervals.reserve(expected);
+
+	size_t begin = scanStart;
+	size_t pos = scanStart;
+	for (;;) {
+		const void* found = std::memchr(data + pos, 0xFF, size - pos);
+		if (!found) {
+			return false;
+		}
+		size_t markerStart = (const unsigned char*)found - data;
+		pos = markerStart;
+		while (pos + 1 < size && data[pos + 1] == 0xFF) {
+			pos++;
+		}
+		if (pos + 1 >= size) {
+			return false;
+		}
+		int marker = data[pos + 1];
+		pos += 2;
+		if (marker == 0x00) {
+			continue; // A stuffed 0xFF data byte
+		}
+		intervals.push_back({ begin, markerStart });
+		if (marker >= 0xD0 && marker <= 0xD7) {
+			// RST0 to RST7 in turn
+			if (marker - 0xD0 != (int)((intervals.size() - 1) % 8)) {
+				return false;
+			}
+			begin = pos;
+			continue;
+		}
+		// Any marker but the end of the image would start another scan
+		return marker == 0xD9 && intervals.size() == expected;
+	}
+}
+
+bool JpegDecoder::DecodeInterval(size_t index, Planes& planes) const {
+	const Interval& interval = intervals[index];
+	BitReader bits(data + interval.begin, data + interval.end);
+	int predictions[3] = {};
+	int16_t coefficients[64];
+
+	size_t mcus = (size_t)mcusX * mcusY;
+	size_t firstMcu = index * restartInterval;
+	size_t endMcu = std::min(firstMcu + restartInterval, mcus);
+	for (size_t mcu = firstMcu; mcu < endMcu; mcu++) {
+		int mcuX = (int)(mcu % mcusX);
+		int mcuY = (int)(mcu / mcusX);
+		if (mcuY >= planes.endMcuRow) {
+			return true;
+		}
+		// Rows above the region still have to be decoded to get to it
+		bool keep = mcuY >= planes.firstMcuRow;
+
+		for (int k : scanOrder) {
+			const Component& component = components[k];
+			const HuffmanTable& dcTable = dc[component.dcTable];
+			const HuffmanTable& acTable = ac[component.acTable];
+			const uint16_t* dequant = quant[component.quantTable];
+			for (int by = 0; by < component.v; by++) {
+				for (int bx = 0; bx < component.h; bx++) {
+					int t = bits.Decode(dcTable.fast, dcTable.sizes, dcTable.values, dcTable.maxCode, dcTable.delta);
+					if (t < 0 || t > 15) {
+						return false;
+					}
+					std::memset(coefficients, 0, sizeof(coefficients));
+					// Values stb_image rejects are left to it
+					int64_t dcValue = (int64_t)predictions[k] + (t ? bits.Extend(t) : 0);
+					int64_t product = dcValue * dequant[0];
+					if (dcValue < -32768 || dcValue > 32767 || product < -32768 || product > 32767) {
+						return false;
+					}
+					predictions[k] = (int)dcValue;
+					coefficients[0] = (int16_t)product;
+
+					int i = 1;
+					do {
+						if (bits.count < 16) {
+							bits.Fill();
+						}
+						int fast = acTable.fastAc[bits.buffer >> (32 - kFastBits)];
+						if (fast) {
+							i += (fast >> 4) & 15;
+							int length = fast & 15;
+							if (length > bits.count) {
+								return false;
+							}
+							bits.buffer <<= length;
+							bits.count -= length;
+							int zig = kDezigzag[i++];
+							coefficients[zig] = (int16_t)((fast >> 8) * dequant[zig]);
+							continue;
+						}
+						int rs = bits.Decode(acTable.fast, acTable.sizes, acTable.values, acTable.maxCode, acTable.delta);
+						if (rs < 0) {
+							return false;
+						}
+						int valueBits = rs & 15;
+						if (valueBits == 0) {
+							if (rs != 0xF0) {
+								break; // End of block
+							}
+							i += 16;
+						}
+						else {
+							i += rs >> 4;
+							int zig = kDezigzag[i++];
+							coefficients[zig] = (int16_t)(bits.Extend(valueBits) * dequant[zig]);
+						}
+					} while (i < 64);
+
+					if (keep) {
+						size_t stride = planes.stride[k];
+						size_t row = ((size_t)(mcuY - planes.firstMcuRow) * component.v + by) * 8;
+						size_t column = ((size_t)mcuX * component.h + bx) * 8;
+						PixelKernels::IdctBlock(coefficients, planes.samples[k].data() + row * stride + column, stride);
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void JpegDecoder::ConvertRows(const Planes& planes, int firstRow, int rowCount, unsigned char* dst) const {
+	// Room for upsampling by up to 4 past the right edge
+	std::vector<uint8_t> lines[3];
+	for (auto& line : lines) {
+		line.resize(width + 3);
+	}
+	for (int y = firstRow; y < firstRow + rowCount; y++) {
+		const uint8_t* rows[3];
+		for (int k = 0; k < 3; k++) {
+			const Component& component = components[k];
+			int hs = maxH / component.h;
+			int vs = maxV / component.v;
+			int nearRow = y / vs;
+			int farRow = nearRow;
+			if (vs == 2) {
+				farRow = (y & 1) ? std::min(nearRow + 1, component.height - 1) : std::max(nearRow - 1, 0);
+			}
+			int planeRow = planes.firstMcuRow * component.v * 8;
+			const uint8_t* plane = planes.samples[k].data();
+			rows[k] = resampleRow(lines[k].data(), plane + (nearRow - planeRow) * planes.stride[k],
+				plane + (farRow - planeRow) * planes.stride[k], (width + hs - 1) / hs, hs, vs);
+		}
+
+		unsigned char* out = dst + (size_t)(y - firstRow) * width * 3;
+		if (rgb) {
+			for (int x = 0; x < width; x++) {
+				out[x * 3 + 0] = rows[0][x];
+				out[x * 3 + 1] = rows[1][x];
+				out[x * 3 + 2] = rows[2][x];
+			}
+		}
+		else {
+			PixelKernels::YCbCrToRgb(rows[0], rows[1], rows[2], out, width);
+		}
+	}
+}
+
+bool JpegDecoder::DecodeRows(int firstRow, int rowCount, unsigned char* dst) const {
+	if (intervals.empty() || firstRow < 0 || rowCount <= 0 || firstRow + rowCount > height) {
+		return false;
+	}
+	VGS_TRACE_SCOPE("Decode JPEG");
+
+	// The MCU rows that hold every sample the rows are upsampled from
+	Planes planes;
+	planes.firstMcuRow = mcusY;
+	planes.endMcuRow = 0;
+	for (const Component& component : components) {
+		int vs = maxV / component.v;
+		int first = std::max(firstRow / vs - 1, 0);
+		int last = std::min((firstRow + rowCount - 1) / vs + 1, component.height - 1);
+		planes.firstMcuRow = std::min(planes.firstMcuRow, first / (component.v * 8));
+		planes.endMcuRow = std::max(planes.endMcuRow, last / (component.v * 8) + 1);
+	}
+	for (int k = 0; k < 3; k++) {
+		planes.stride[k] = (size_t)mcusX * components[k].h * 8;
+		planes.samples[k].resize(planes.stride[k] * (planes.endMcuRow - planes.firstMcuRow) * components[k].v * 8);
+	}
+
+	// Runs of intervals, a few per thread so one slow run does not hold up
+	// the rest
+	size_t firstInterval = (size_t)planes.firstMcuRow * mcusX / restartInterval;
+	size_t endInterval = ((size_t)planes.endMcuRow * mcusX - 1) / restartInterval + 1;
+	int parallelism = (int)ResizeService::GetParallelism();
+	int runs = (int)std::min(endInterval - firstInterval, (size_t)parallelism * 4);
+	std::atomic<bool> failed{ false };
+	ResizeService::ParallelFor(runs, [&](int run) {
+		VGS_TRACE_SCOPE("JPEG intervals");
+		size_t count = endInterval - firstInterval;
+		size_t begin = firstInterval + count * run / runs;
+		size_t end = firstInterval + count * (run + 1) / runs;
+		for (size_t i = begin; i < end && !failed.load(std::memory_order_relaxed); i++) {
+			if (!DecodeInterval(i, planes)) {
+				failed.store(true, std::memory_order_relaxed);
+			}
+		}
+	});
+	if (failed.load(std::memory_order_relaxed)) {
+		return false;
+	}
+
+	int bands = std::min(rowCount, parallelism);
+	ResizeService::ParallelFor(bands, [&](int band) {
+		VGS_TRACE_SCOPE("JPEG colour");
+		int begin = firstRow + (int)((int64_t)rowCount * band / bands);
+		int end = firstRow + (int)((int64_t)rowCount * (band + 1) / bands);
+		ConvertRows(planes, begin, end - begin, dst + (size_t)(begin - firstRow) * width * 3);
+	});
+	return true;
+}
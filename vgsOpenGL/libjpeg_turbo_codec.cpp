@@ -0,0 +1,177 @@
+#ifdef VGS_WITH_LIBJPEG_TURBO
+
+#include <climits>
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+#include "image_codec.h"
+#include "trace.h"
+
+namespace
+{
+	// libjpeg reports errors through error_exit, which must not return
+	struct ErrorManager {
+		jpeg_error_mgr base;
+		std::jmp_buf jump;
+	};
+
+	void onError(j_common_ptr info) {
+		std::longjmp(((ErrorManager*)info->err)->jump, 1);
+	}
+
+	void onMessage(j_common_ptr) {
+		// Warnings on corrupt data are not worth a line on stderr each
+	}
+
+	// A decompressor over an in-memory JPEG. The setjmp lives in each
+	// caller, as longjmp must not leave the frame that set it.
+	struct Decompressor {
+		jpeg_decompress_struct info = {};
+		ErrorManager error = {};
+
+		Decompressor() {
+			info.err = jpeg_std_error(&error.base);
+			error.base.error_exit = onError;
+			error.base.output_message = onMessage;
+			jpeg_create_decompress(&info);
+		}
+
+		~Decompressor() { jpeg_destroy_decompress(&info); }
+
+		// Reads the header and picks grey or RGB output, as stb_image does.
+		// CMYK and YCCK files are left to stb_image.
+		bool ReadHeader(const unsigned char* data, size_t size) {
+			jpeg_mem_src(&info, data, (unsigned long)size);
+			if (jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK) {
+				return false;
+			}
+			if (info.num_components == 1) {
+				info.out_color_space = JCS_GRAYSCALE;
+			}
+			else if (info.num_components == 3) {
+				info.out_color_space = JCS_RGB;
+			}
+			else {
+				return false;
+			}
+			return true;
+		}
+
+		int Channels() const { return info.out_color_space == JCS_GRAYSCALE ? 1 : 3; }
+
+		// Decodes output rows until `last`, skipping the first `skip` of them
+		bool ReadRows(JDIMENSION skip, JDIMENSION last, unsigned char* dst) {
+			size_t stride = (size_t)info.output_width * info.output_components;
+			if (skip > 0 && jpeg_skip_scanlines(&info, skip) != skip) {
+				return false;
+			}
+			while (info.output_scanline < last) {
+				JSAMPROW row = dst + (info.output_scanline - skip) * stride;
+				if (jpeg_read_scanlines(&info, &row, 1) != 1) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	unsigned char* allocatePixels(DecodedImage& out, int width, int height, int channels) {
+		out.pixels = { (unsigned char*)std::malloc((size_t)width * height * channels), std::free };
+		out.width = width;
+		out.height = height;
+		out.channels = channels;
+		return out.pixels.get();
+	}
+
+	// Baseline and progressive JPEGs through libjpeg-turbo, which scales by
+	// M/8 in the inverse DCT and skips rows without colour converting them
+	class LibjpegTurboCodec : public ImageCodec {
+	public:
+		const char* Name() const override { return "libjpeg-turbo"; }
+
+		bool Handles(ImageFormat format) const override { return format == ImageFormat::Jpeg; }
+
+		bool Info(const unsigned char* data, size_t size, ImageInfo& info) const override {
+			Decompressor decompressor;
+			if (setjmp(decompressor.error.jump)) {
+				return false;
+			}
+			if (!decompressor.ReadHeader(data, size)) {
+				return false;
+			}
+			info.width = (int)decompressor.info.image_width;
+			info.height = (int)decompressor.info.image_height;
+			info.channels = decompressor.Channels();
+			return true;
+		}
+
+		bool Decode(const unsigned char* data, size_t size, DecodedImage& out) const override {
+			// No M/8 short of 8/8 covers this
+			return DecodeScaled(data, size, INT_MAX, INT_MAX, out);
+		}
+
+		bool DecodeScaled(const unsigned char* data, size_t size, int minWidth, int minHeight, DecodedImage& out) const override {
+			VGS_TRACE_SCOPE("Decode JPEG (libjpeg-turbo)");
+			Decompressor decompressor;
+			if (setjmp(decompressor.error.jump)) {
+				out.pixels.reset();
+				return false;
+			}
+			jpeg_decompress_struct& info = decompressor.info;
+			if (!decompressor.ReadHeader(data, size)) {
+				return false;
+			}
+			// The smallest M/8 that still covers the minimum size
+			info.scale_denom = 8;
+			for (info.scale_num = 1; info.scale_num < 8; info.scale_num++) {
+				jpeg_calc_output_dimensions(&info);
+				if ((int)info.output_width >= minWidth && (int)info.output_height >= minHeight) {
+					break;
+				}
+			}
+			jpeg_start_decompress(&info);
+			unsigned char* pixels = allocatePixels(out, (int)info.output_width, (int)info.output_height, decompressor.Channels());
+			if (!pixels || !decompressor.ReadRows(0, info.output_height, pixels)) {
+				out.pixels.reset();
+				return false;
+			}
+			jpeg_finish_decompress(&info);
+			return true;
+		}
+
+		bool Scales() const override { return true; }
+
+		bool DecodeRows(const unsigned char* data, size_t size, int firstRow, int rowCount, DecodedImage& out) const override {
+			VGS_TRACE_SCOPE("Decode JPEG rows (libjpeg-turbo)");
+			Decompressor decompressor;
+			if (setjmp(decompressor.error.jump)) {
+				out.pixels.reset();
+				return false;
+			}
+			jpeg_decompress_struct& info = decompressor.info;
+			if (!decompressor.ReadHeader(data, size)) {
+				return false;
+			}
+			if (firstRow < 0 || rowCount <= 0 || rowCount > (int)info.image_height - firstRow) {
+				return false;
+			}
+			jpeg_start_decompress(&info);
+			unsigned char* pixels = allocatePixels(out, (int)info.output_width, rowCount, decompressor.Channels());
+			if (!pixels || !decompressor.ReadRows((JDIMENSION)firstRow, (JDIMENSION)(firstRow + rowCount), pixels)) {
+				out.pixels.reset();
+				return false;
+			}
+			// The rows below are never decoded
+			jpeg_abort_decompress(&info);
+			return true;
+		}
+	};
+}
+
+std::unique_ptr<ImageCodec> CreateLibjpegTurboCodec() {
+	return std::make_unique<LibjpegTurboCodec>();
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "lz4_block.h"
+
+#include <cstring>
+
+namespace LZ4Block
+{
+	static const int kHashBits = 12;
+	static const size_t kMinMatch = 4;
+	static const size_t kLastLiterals = 5;   // The last 5 bytes are always literals
+	static const size_t kMatchFindLimit = 12; // A match must start at least 12 bytes before the end
+	static const size_t kMaxOffset = 65535;
+
+	static uint32_t read32(const uint8_t* p) {
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static uint32_t hash32(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - kHashBits);
+	}
+
+	static uint8_t* writeLength(uint8_t* op, size_t length) {
+		while (length >= 255) {
+			*op++ = 255;
+			length -= 255;
+		}
+		*op++ = (uint8_t)length;
+		return op;
+	}
+
+	size_t CompressBound(size_t srcSize) {
+		return srcSize + srcSize / 255 + 16;
+	}
+
+	size_t Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) {
+		if (dstCapacity < CompressBound(srcSize)) {
+			return 0;
+		}
+
+		uint8_t* op = dst;
+		const uint8_t* ip = src;
+		const uint8_t* anchor = src;
+		const uint8_t* const end = src + srcSize;
+
+		if (srcSize > kMatchFindLimit) {
+			uint32_t table[1 << kHashBits];
+			std::memset(table, 0, sizeof(table));
+
+			const uint8_t* const matchFindLimit = end - kMatchFindLimit;
+			const uint8_t* const matchLimit = end - kLastLiterals;
+			unsigned searchCount = 0;
+
+			while (ip < matchFindLimit) {
+				uint32_t sequence = read32(ip);
+				uint32_t h = hash32(sequence);
+				const uint8_t* ref = src + table[h];
+				table[h] = (uint32_t)(ip - src);
+
+				if (ref >= ip || (size_t)(ip - ref) > kMaxOffset || read32(ref) != sequence) {
+					// Skip faster through incompressible regions
+					ip += 1 + (searchCount++ >> 6);
+					continue;
+				}
+				searchCount = 0;
+
+				// Extend the match backwards over pending literals
+				while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+					ip--;
+					ref--;
+				}
+
+				const uint8_t* matchEnd = ip + kMinMatch;
+				const uint8_t* refEnd = ref + kMinMatch;
+				while (matchEnd < matchLimit && *matchEnd == *refEnd) {
+					matchEnd++;
+					refEnd++;
+				}
+
+				size_t literalLength = (size_t)(ip - anchor);
+				size_t matchLength = (size_t)(matchEnd - ip) - kMinMatch;
+				uint8_t* token = op++;
+
+				if (literalLength >= 15) {
+					*token = 15 << 4;
+					op = writeLength(op, literalLength - 15);
+				}
+				else {
+					*token = (uint8_t)(literalLength << 4);
+				}
+				std::memcpy(op, anchor, literalLength);
+				op += literalLength;
+
+				size_t offset = (size_t)(ip - ref);
+				*op++ = (uint8_t)(offset & 0xFF);
+				*op++ = (uint8_t)(offset >> 8);
+
+				if (matchLength >= 15) {
+					*token |= 15;
+					op = writeLength(op, matchLength - 15);
+				}
+				else {
+					*token |= (uint8_t)matchLength;
+				}
+
+				ip = matchEnd;
+				anchor = ip;
+			}
+		}
+
+		// Trailing literals
+		size_t literalLength = (size_t)(end - anchor);
+		uint8_t* token = op++;
+		if (literalLength >= 15) {
+			*token = 15 << 4;
+			op = writeLength(op, literalLength - 15);
+		}
+		else {
+			*token = (uint8_t)(literalLength << 4);
+		}
+		std::memcpy(op, anchor, literalLength);
+		op += literalLength;
+
+		return (size_t)(op - dst);
+	}
+
+	bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+		const uint8_t* ip = src;
+		const uint8_t* const iend = src + srcSize;
+		uint8_t* op = dst;
+		uint8_t* const oend = dst + dstSize;
+
+		while (ip < iend) {
+			uint8_t token = *ip++;
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15) {
+				uint8_t b;
+				do {
+					if (ip >= iend) return false;
+					b = *ip++;
+					literalLength += b;
+				} while (b == 255);
+			}
+			if (literalLength > (size_t)(oend - op) || literalLength > (size_t)(iend - ip)) {
+				return false;
+			}
+			std::memcpy(op, ip, literalLength);
+			op += literalLength;
+			ip += literalLength;
+
+			if (ip >= iend) {
+				break; // Last sequence has no match part
+			}
+
+			if (iend - ip < 2) return false;
+			size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - dst)) {
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15) {
+				uint8_t b;
+				do {
+					if (ip >= iend) return false;
+					b = *ip++;
+					matchLength += b;
+				} while (b == 255);
+			}
+			matchLength += kMinMatch;
+			if (matchLength > (size_t)(oend - op)) {
+				return false;
+			}
+
+			const uint8_t* match = op - offset;
+			if (offset >= matchLength) {
+				std::memcpy(op, match, matchLength);
+				op += matchLength;
+			}
+			else {
+				// Overlapping copy repeats the last `offset` bytes
+				for (size_t i = 0; i < matchLength; i++) {
+					*op++ = *match++;
+				}
+			}
+		}
+
+		return op == oend;
+	}
+}
@@ -8,11 +8,50 @@
 #include <GLFW/glfw3.h>
 
 #include "application.h"
+#include "frame_pacer.h"
+#include "gl_stats.h"
+#include "grid_renderer.h"
+#include "image_codec.h"
+#include "input_recording.h"
+#include "perf_stats.h"
+#include "trace.h"
+#include "ui_renderer.h"
+
+// Longest the loop sleeps without any event. Keeps the loop statistics
+// ticking while idle without costing measurable CPU.
+static const double kIdleWaitSeconds = 0.5;
+static const double kStatsIntervalSeconds = 10.0;
+
+static FramePacer g_framePacer;
+static InputRecording g_inputRecording;
+
+// Installed before ImGui so its GLFW backend chains to them: any input or
+// window change means the UI has to be redrawn.
+static void onCursorPos(GLFWwindow*, double, double) { g_framePacer.RequestFrames(); }
+static void onMouseButton(GLFWwindow*, int, int, int) { g_framePacer.RequestFrames(); }
+static void onScroll(GLFWwindow*, double, double) { g_framePacer.RequestFrames(); }
+static void onKey(GLFWwindow*, int, int, int, int) { g_framePacer.RequestFrames(); }
+static void onChar(GLFWwindow*, unsigned int) { g_framePacer.RequestFrames(); }
+static void onWindowFocus(GLFWwindow*, int) { g_framePacer.RequestFrames(); }
+static void onCursorEnter(GLFWwindow*, int) { g_framePacer.RequestFrames(); }
+static void onFramebufferSize(GLFWwindow*, int, int) { g_framePacer.RequestFrames(); }
+static void onWindowRefresh(GLFWwindow*) { g_framePacer.RequestFrames(); }
 
 int main(void)
 {
     GLFWwindow* window;
 
+    // VGS_TRACE=1 records from startup into vgs_trace.json, VGS_TRACE=<path>
+    // into <path>. The trace is written at exit and on F2.
+    Trace::SetThreadName("Main");
+    if (const char* traceEnv = std::getenv("VGS_TRACE")) {
+        if (traceEnv[0] != '\0' && std::string(traceEnv) != "0") {
+            if (std::string(traceEnv) != "1")
+                Trace::SetOutputPath(traceEnv);
+            Trace::SetEnabled(true);
+        }
+    }
+
     /* Initialize the library */
     if (!glfwInit())
         return -1;
@@ -33,27 +72,129 @@ int main(void)
         return -1;
     }
 
+    glfwSetCursorPosCallback(window, onCursorPos);
+    glfwSetMouseButtonCallback(window, onMouseButton);
+    glfwSetScrollCallback(window, onScroll);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetCharCallback(window, onChar);
+    glfwSetWindowFocusCallback(window, onWindowFocus);
+    glfwSetCursorEnterCallback(window, onCursorEnter);
+    glfwSetFramebufferSizeCallback(window, onFramebufferSize);
+    glfwSetWindowRefreshCallback(window, onWindowRefresh);
+
     IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io; 
 	
     ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init("#version 460");
+    GLStats::HookImGuiBackend();
+
+    // VGS_GL_STATS=1 counts GL calls per frame, VGS_GL_STATS=2 also times the
+    // upload pass and the grid's draw callback on the GPU. Written to
+    // vgs_gl_stats.json at exit and on F3.
+    if (const char* glStatsEnv = std::getenv("VGS_GL_STATS")) {
+        if (glStatsEnv[0] == '1')
+            GLStats::SetMode(GLStatsMode::Counters);
+        else if (glStatsEnv[0] == '2')
+            GLStats::SetMode(GLStatsMode::GpuTimers);
+    }
+    const bool glStatsAtStartup = GLStats::GetMode() != GLStatsMode::Off;
+
+    // VGS_LEAN_UI_RENDERER=1 draws ImGui without the backend's per-frame GL
+    // state backup and buffer re-creation (also switchable in the F1 overlay)
+    const char* leanRendererEnv = std::getenv("VGS_LEAN_UI_RENDERER");
+    UIRenderer::SetEnabled(leanRendererEnv && leanRendererEnv[0] == '1');
+
+    // VGS_INSTANCED_GRID=0 draws the grid tiles as draw list quads instead
+    // of one instanced draw callback
+    if (const char* instancedGridEnv = std::getenv("VGS_INSTANCED_GRID"))
+        GridRenderer::SetEnabled(instancedGridEnv[0] != '0');
+
+    // VGS_RETAINED_GRID=1 caches the rendered grid in strips and only
+    // composites them while nothing in view changes
+    const char* retainedGridEnv = std::getenv("VGS_RETAINED_GRID");
+    GridRenderer::SetRetained(retainedGridEnv && retainedGridEnv[0] == '1');
+
+    // VGS_GRID_LAYOUT=masonry|justified|uniform picks the grid layout
+    if (const char* gridLayoutEnv = std::getenv("VGS_GRID_LAYOUT")) {
+        GridLayoutKind layout;
+        if (ParseGridLayout(gridLayoutEnv, layout))
+            App::SetGridLayout(layout);
+        else
+            std::cerr << "Unknown VGS_GRID_LAYOUT '" << gridLayoutEnv << "', using masonry" << std::endl;
+    }
+
+    // VGS_CODECS=libjpeg-turbo,png tries those image codecs first for their
+    // formats, ahead of the default order
+    if (const char* codecsEnv = std::getenv("VGS_CODECS")) {
+        if (!ImageCodecs::SetPreferred(codecsEnv))
+            std::cerr << "Ignoring VGS_CODECS '" << codecsEnv << "'" << std::endl;
+    }
     
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
     ImGui::StyleColorsDark();
 
+    // Loader threads wake the loop when a thumbnail is ready to upload
+    App::SetBackgroundWakeCallback([] {
+        g_framePacer.RequestFrames();
+        glfwPostEmptyEvent();
+    });
+
+    // VGS_CONTINUOUS_RENDER=1 restores the old render-every-iteration loop
+    const char* continuousEnv = std::getenv("VGS_CONTINUOUS_RENDER");
+    const bool continuousRender = continuousEnv && continuousEnv[0] == '1';
+
+    // VGS_RECORD_INPUT=<path> saves the session's input at exit, for replay
+    // with vgs_bench_replay against a fixed corpus
+    const char* recordInputPath = std::getenv("VGS_RECORD_INPUT");
+    const bool recordInput = recordInputPath && recordInputPath[0] != '\0';
+
+    // VGS_FRAME_LOOP_STATS=1 prints the frames, wake-ups and CPU use of the
+    // loop every 10 s
+    const char* loopStatsEnv = std::getenv("VGS_FRAME_LOOP_STATS");
+    const bool printLoopStats = loopStatsEnv && loopStatsEnv[0] == '1';
+
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window))
     {
-        /* Render here */
-        glClear(GL_COLOR_BUFFER_BIT);
+        bool animating = continuousRender || App::IsAnimating() || io.WantTextInput;
+
+        /* Block until there is something to do, or poll while work is pending */
+        if (g_framePacer.CanSleep(animating)) {
+            glfwWaitEventsTimeout(kIdleWaitSeconds);
+            g_framePacer.CountWakeup();
+        }
+        else {
+            glfwPollEvents();
+        }
+
+        if (printLoopStats && g_framePacer.UpdateStats(glfwGetTime(), kStatsIntervalSeconds)) {
+            const FrameLoopStats& stats = g_framePacer.GetLastStats();
+            std::cout << "Frame loop: " << stats.framesRendered << " frames, " << stats.framesSkipped << " skipped, "
+                << stats.wakeups << " wake-ups, CPU " << stats.cpuPercent << "% over " << stats.intervalSeconds << "s" << std::endl;
+        }
+
+        /* Nothing changed since the last frame: keep the previous image */
+        if (!g_framePacer.BeginFrame(animating))
+            continue;
+
+        double frameStart = glfwGetTime();
+        uint64_t frameTraceStart = Trace::Now();
 
 		ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
+        if (recordInput) {
+            g_inputRecording.frames.emplace_back();
+            captureInputFrame(g_inputRecording.frames.back());
+        }
         ImGui::NewFrame();
 
-		App::RenderUI();
+        {
+            VGS_TRACE_SCOPE("App::RenderUI");
+            VGS_GL_PASS(GLPass::Upload);
+            App::RenderUI();
+        }
 
         ImGui::Render();
         int display_w, display_h;
@@ -61,19 +202,43 @@ int main(void)
         glViewport(0, 0, display_w, display_h);
         glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());;
+        {
+            VGS_PERF_SCOPE(PerfStage::Render);
+            UIRenderer::RenderDrawData(ImGui::GetDrawData());
+        }
+
+        /* Release textures dropped this frame in one batch */
+        FlushTextureDeletions();
+        GLStats::EndFrame();
+
+        /* CPU time of the frame, excluding the (possibly vsync-blocked) swap */
+        Perf::EndFrame(glfwGetTime() - frameStart);
 
         /* Swap front and back buffers */
-        glfwSwapBuffers(window);
+        {
+            VGS_TRACE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
-        /* Poll for and process events */
-        glfwPollEvents();
+        if (Trace::IsEnabled())
+            Trace::RecordZone("Frame", frameTraceStart, Trace::Now());
     }
 
+    App::Shutdown();
+
+    if (recordInput && g_inputRecording.Save(recordInputPath))
+        std::cout << "Input recording: " << g_inputRecording.frames.size() << " frames saved to " << recordInputPath << std::endl;
+
+    if (Trace::IsEnabled())
+        Trace::Flush();
+    if (glStatsAtStartup)
+        GLStats::Flush();
+
+    UIRenderer::Shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glfwTerminate();
     return 0;
-}
\ No newline at end of file
+}
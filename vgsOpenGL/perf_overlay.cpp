@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cfloat>
+
+#include "perf_overlay.h"
+#include "gl_stats.h"
+#include "grid_renderer.h"
+#include "perf_stats.h"
+#include "resize_service.h"
+#include "thumbnail.h"
+#include "trace.h"
+#include "ui_renderer.h"
+#include "imgui.h"
+
+namespace Perf
+{
+	static const int kHistogramBuckets = 40;
+
+	// Value `framesAgo` frames back in a ring written by EndFrame()
+	static float historyAt(const float* values, const FrameHistory& history, int framesAgo) {
+		int index = (history.next - 1 - framesAgo + kHistorySize) % kHistorySize;
+		return values[index];
+	}
+
+	static float historyAverage(const float* values, const FrameHistory& history) {
+		if (history.count == 0) {
+			return 0.0f;
+		}
+		float sum = 0.0f;
+		for (int i = 0; i < history.count; i++) {
+			sum += values[i];
+		}
+		return sum / (float)history.count;
+	}
+
+	void RenderOverlay(bool* open) {
+		ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(560, 620), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Performance", open, ImGuiWindowFlags_NoDocking)) {
+			ImGui::End();
+			return;
+		}
+
+		const FrameHistory& history = GetHistory();
+		int plotOffset = history.count < kHistorySize ? 0 : history.next;
+
+		// --- Frame times ---
+		float p50, p95, p99;
+		FramePercentiles(p50, p95, p99);
+		float lastFrame = history.count ? historyAt(history.frameMs, history, 0) : 0.0f;
+		ImGui::Text("Frame %.2f ms   p50 %.2f   p95 %.2f   p99 %.2f   (%d frames)", lastFrame, p50, p95, p99, history.count);
+
+		float plotMax = std::max(p99 * 1.25f, 1.0f);
+		ImGui::PlotLines("##frameTimes", history.frameMs, history.count, plotOffset, "frame ms", 0.0f, plotMax, ImVec2(-1, 80));
+
+		float buckets[kHistogramBuckets] = {};
+		for (int i = 0; i < history.count; i++) {
+			int bucket = (int)(history.frameMs[i] / plotMax * kHistogramBuckets);
+			buckets[std::clamp(bucket, 0, kHistogramBuckets - 1)] += 1.0f;
+		}
+		ImGui::PlotHistogram("##frameHistogram", buckets, kHistogramBuckets, 0, "distribution (0 .. p99 x1.25)", 0.0f, FLT_MAX, ImVec2(-1, 60));
+
+		// --- Stages ---
+		ImGui::SeparatorText("Stages");
+		StageTotals totals = GetTotals();
+		if (ImGui::BeginTable("stages", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp)) {
+			ImGui::TableSetupColumn("Stage");
+			ImGui::TableSetupColumn("Last frame ms");
+			ImGui::TableSetupColumn("Avg/frame ms");
+			ImGui::TableSetupColumn("Total ms");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableHeadersRow();
+
+			for (int i = 0; i < (int)PerfStage::Count; i++) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(StageName((PerfStage)i));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", history.count ? historyAt(history.stageMs[i], history, 0) : 0.0f);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", historyAverage(history.stageMs[i], history));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", totals.nanoseconds[i] * 1e-6);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", (unsigned long long)totals.calls[i]);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::TextDisabled("Decode, resize, encode and cache I/O are summed over all loader threads.");
+
+		static int plottedStage = (int)PerfStage::Upload;
+		ImGui::SetNextItemWidth(160);
+		if (ImGui::BeginCombo("##plottedStage", StageName((PerfStage)plottedStage))) {
+			for (int i = 0; i < (int)PerfStage::Count; i++) {
+				if (ImGui::Selectable(StageName((PerfStage)i), i == plottedStage)) {
+					plottedStage = i;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::PlotLines("##stageTimes", history.stageMs[plottedStage], history.count, plotOffset, "ms per frame", 0.0f, FLT_MAX, ImVec2(-1, 60));
+
+		if (ImGui::Button("Reset totals")) {
+			ResetTotals();
+		}
+
+		// --- Queues and memory ---
+		ImGui::SeparatorText("Queues and memory");
+		ImGui::Text("%s: %llu   %s: %llu",
+			GaugeName(PerfGauge::LoaderPending), (unsigned long long)GetGauge(PerfGauge::LoaderPending),
+			GaugeName(PerfGauge::LoaderCompleted), (unsigned long long)GetGauge(PerfGauge::LoaderCompleted));
+		ImGui::Text("Uploaded: %.1f KB last frame, %.1f KB/frame avg, %.1f MB total",
+			history.count ? historyAt(history.uploadKB, history, 0) : 0.0f,
+			historyAverage(history.uploadKB, history),
+			totals.uploadBytes / (1024.0 * 1024.0));
+		ImGui::PlotHistogram("##uploadKB", history.uploadKB, history.count, plotOffset, "KB uploaded per frame", 0.0f, FLT_MAX, ImVec2(-1, 50));
+		ImGui::Text("%s: %llu   %s: %.1f MB   %s: %.1f MB",
+			GaugeName(PerfGauge::TextureCount), (unsigned long long)GetGauge(PerfGauge::TextureCount),
+			GaugeName(PerfGauge::VramBytes), GetGauge(PerfGauge::VramBytes) / (1024.0 * 1024.0),
+			GaugeName(PerfGauge::RamCacheBytes), GetGauge(PerfGauge::RamCacheBytes) / (1024.0 * 1024.0));
+		ImGui::Text("%s: %llu px/s", GaugeName(PerfGauge::ScrollSpeed), (unsigned long long)GetGauge(PerfGauge::ScrollSpeed));
+
+		// --- GL calls ---
+		ImGui::SeparatorText("GL calls");
+		int glMode = (int)GLStats::GetMode();
+		ImGui::SetNextItemWidth(200);
+		if (ImGui::BeginCombo("Mode", GLStats::ModeName((GLStatsMode)glMode))) {
+			for (int i = 0; i <= (int)GLStatsMode::GpuTimers; i++) {
+				if (ImGui::Selectable(GLStats::ModeName((GLStatsMode)i), i == glMode)) {
+					GLStats::SetMode((GLStatsMode)i);
+				}
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save GL stats (F3)")) {
+			GLStats::Flush();
+		}
+		if (GLStats::GetMode() != GLStatsMode::Off) {
+			const GLFrameStats& glFrame = GLStats::GetLastFrame();
+			if (ImGui::BeginTable("glCalls", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp)) {
+				ImGui::TableSetupColumn("Last frame");
+				ImGui::TableSetupColumn("App calls");
+				ImGui::TableSetupColumn("App KB");
+				ImGui::TableSetupColumn("ImGui calls");
+				ImGui::TableSetupColumn("ImGui KB");
+				ImGui::TableHeadersRow();
+
+				for (int kind = 0; kind < (int)GLCallKind::Count; kind++) {
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(GLStats::KindName((GLCallKind)kind));
+					for (const GLCallCounts& counts : glFrame.sources) {
+						ImGui::TableNextColumn();
+						ImGui::Text("%llu", (unsigned long long)counts.calls[kind]);
+						ImGui::TableNextColumn();
+						if (counts.bytes[kind]) {
+							ImGui::Text("%.1f", counts.bytes[kind] / 1024.0);
+						}
+					}
+				}
+				ImGui::EndTable();
+			}
+			if (GLStats::GetMode() == GLStatsMode::GpuTimers) {
+				ImGui::Text("GPU  %s %.3f ms   %s %.3f ms",
+					GLStats::PassName(GLPass::Upload), GLStats::GetLatestGpuMs(GLPass::Upload),
+					GLStats::PassName(GLPass::Grid), GLStats::GetLatestGpuMs(GLPass::Grid));
+			}
+		}
+
+		bool leanRenderer = UIRenderer::IsEnabled();
+		if (ImGui::Checkbox("Lean UI renderer", &leanRenderer)) {
+			UIRenderer::SetEnabled(leanRenderer);
+		}
+		UIRendererStats rendererStats = UIRenderer::GetStats();
+		if (rendererStats.active) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("%s, %.1f/%.0f KB per frame, %llu reallocations, %llu fence waits",
+				rendererStats.persistent ? "persistent ring" : "single glBufferSubData",
+				rendererStats.lastFrameBytes / 1024.0, rendererStats.capacityBytes / 1024.0,
+				(unsigned long long)rendererStats.reallocations, (unsigned long long)rendererStats.fenceWaits);
+		}
+
+		bool instancedGrid = GridRenderer::IsEnabled();
+		if (ImGui::Checkbox("Instanced grid", &instancedGrid)) {
+			GridRenderer::SetEnabled(instancedGrid);
+		}
+		GridRendererStats gridStats = GridRenderer::GetStats();
+		if (gridStats.active) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("%zu tiles in %d draws (%d units), %llu instance uploads, last %.1f KB",
+				gridStats.tiles, gridStats.batches, gridStats.textureUnits,
+				(unsigned long long)gridStats.instanceUploads, gridStats.lastUploadBytes / 1024.0);
+		}
+		bool retainedGrid = GridRenderer::IsRetained();
+		if (ImGui::Checkbox("Retained grid", &retainedGrid)) {
+			GridRenderer::SetRetained(retainedGrid);
+		}
+		if (gridStats.active && gridStats.retained) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("%d strips cached (%.1f MB), %d rendered last frame",
+				gridStats.cachedBands, gridStats.cacheBytes / (1024.0 * 1024.0), gridStats.bandsRendered);
+		}
+
+		int resizeQuality = (int)getResizeQuality();
+		ImGui::SetNextItemWidth(120.0f);
+		if (ImGui::Combo("Thumbnail resize", &resizeQuality, [](void*, int index) { return resizeQualityName((ResizeQuality)index); },
+			nullptr, (int)ResizeQuality::Count)) {
+			setResizeQuality((ResizeQuality)resizeQuality);
+		}
+		ImGui::SameLine();
+		ImGui::TextDisabled("for thumbnails generated from now on");
+		ResizeServiceStats resizeStats = ResizeService::GetStats();
+		ImGui::TextDisabled("Resizes: %llu inline, %llu split over %u threads, samplers built %llu, reused %llu",
+			(unsigned long long)resizeStats.inlineJobs, (unsigned long long)resizeStats.splitJobs, ResizeService::GetParallelism(),
+			(unsigned long long)resizeStats.samplerBuilds, (unsigned long long)resizeStats.samplerReuses);
+
+		// --- Tracing ---
+		ImGui::SeparatorText("Trace");
+		bool recording = Trace::IsEnabled();
+		if (ImGui::Checkbox("Record", &recording)) {
+			Trace::SetEnabled(recording);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save trace (F2)")) {
+			Trace::Flush();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Clear")) {
+			Trace::Clear();
+		}
+		ImGui::TextDisabled("%s", Trace::GetOutputPath().c_str());
+
+		ImGui::End();
+	}
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <vector>
+
+#include "perf_stats.h"
+
+namespace Perf
+{
+	static const int kStageCount = (int)PerfStage::Count;
+	static const int kGaugeCount = (int)PerfGauge::Count;
+
+	// Time since the last EndFrame() (drained every frame)
+	static std::atomic<uint64_t> g_frameStageNs[kStageCount];
+	static std::atomic<uint64_t> g_frameUploadBytes{ 0 };
+
+	// Running totals
+	static std::atomic<uint64_t> g_totalStageNs[kStageCount];
+	static std::atomic<uint64_t> g_totalStageCalls[kStageCount];
+	static std::atomic<uint64_t> g_totalUploadBytes{ 0 };
+
+	static std::atomic<uint64_t> g_gauges[kGaugeCount];
+
+	static FrameHistory g_history;
+
+	const char* StageName(PerfStage stage) {
+		switch (stage) {
+		case PerfStage::Scan: return "Scan";
+		case PerfStage::Probe: return "Probe";
+		case PerfStage::Decode: return "Decode";
+		case PerfStage::Resize: return "Resize";
+		case PerfStage::Encode: return "Encode";
+		case PerfStage::CacheIO: return "Cache I/O";
+		case PerfStage::Upload: return "Upload";
+		case PerfStage::Layout: return "Layout";
+		case PerfStage::Render: return "Render";
+		default: return "?";
+		}
+	}
+
+	const char* GaugeName(PerfGauge gauge) {
+		switch (gauge) {
+		case PerfGauge::LoaderPending: return "Loader queue";
+		case PerfGauge::LoaderCompleted: return "Upload queue";
+		case PerfGauge::TextureCount: return "Textures";
+		case PerfGauge::VramBytes: return "VRAM estimate";
+		case PerfGauge::RamCacheBytes: return "RAM cache";
+		case PerfGauge::ScrollSpeed: return "Scroll speed";
+		default: return "?";
+		}
+	}
+
+	void AddStageTime(PerfStage stage, uint64_t nanoseconds) {
+		int i = (int)stage;
+		g_frameStageNs[i].fetch_add(nanoseconds, std::memory_order_relaxed);
+		g_totalStageNs[i].fetch_add(nanoseconds, std::memory_order_relaxed);
+		g_totalStageCalls[i].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AddUploadBytes(uint64_t bytes) {
+		g_frameUploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+		g_totalUploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	void SetGauge(PerfGauge gauge, uint64_t value) {
+		g_gauges[(int)gauge].store(value, std::memory_order_relaxed);
+	}
+
+	void EndFrame(double frameSeconds) {
+		int slot = g_history.next;
+		g_history.frameMs[slot] = (float)(frameSeconds * 1000.0);
+		for (int i = 0; i < kStageCount; i++) {
+			uint64_t ns = g_frameStageNs[i].exchange(0, std::memory_order_relaxed);
+			g_history.stageMs[i][slot] = (float)(ns * 1e-6);
+		}
+		g_history.uploadKB[slot] = (float)(g_frameUploadBytes.exchange(0, std::memory_order_relaxed) / 1024.0);
+
+		g_history.next = (slot + 1) % kHistorySize;
+		g_history.count = std::min(g_history.count + 1, kHistorySize);
+	}
+
+	const FrameHistory& GetHistory() {
+		return g_history;
+	}
+
+	StageTotals GetTotals() {
+		StageTotals totals;
+		for (int i = 0; i < kStageCount; i++) {
+			totals.nanoseconds[i] = g_totalStageNs[i].load(std::memory_order_relaxed);
+			totals.calls[i] = g_totalStageCalls[i].load(std::memory_order_relaxed);
+		}
+		totals.uploadBytes = g_totalUploadBytes.load(std::memory_order_relaxed);
+		return totals;
+	}
+
+	uint64_t GetGauge(PerfGauge gauge) {
+		return g_gauges[(int)gauge].load(std::memory_order_relaxed);
+	}
+
+	void ResetTotals() {
+		for (int i = 0; i < kStageCount; i++) {
+			g_totalStageNs[i].store(0, std::memory_order_relaxed);
+			g_totalStageCalls[i].store(0, std::memory_order_relaxed);
+		}
+		g_totalUploadBytes.store(0, std::memory_order_relaxed);
+	}
+
+	void FramePercentiles(float& p50, float& p95, float& p99) {
+		p50 = p95 = p99 = 0.0f;
+		if (g_history.count == 0) {
+			return;
+		}
+
+		// Only computed while the overlay is visible, so a copy per call is fine
+		std::vector<float> sorted(g_history.frameMs, g_history.frameMs + g_history.count);
+		std::sort(sorted.begin(), sorted.end());
+		auto at = [&](float q) {
+			size_t index = (size_t)(q * (float)(sorted.size() - 1) + 0.5f);
+			return sorted[std::min(index, sorted.size() - 1)];
+		};
+		p50 = at(0.50f);
+		p95 = at(0.95f);
+		p99 = at(0.99f);
+	}
+}
@@ -0,0 +1,1165 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pixel_kernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VGS_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+	using ConvertFunction = void (*)(const uint8_t* src, uint8_t* dst, size_t count);
+	using BoxRowsFunction = void (*)(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int outWidth);
+	using UnfilterFunction = void (*)(const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length);
+
+	// The entry points of one level. Kernels per format are indexed by
+	// channel count.
+	struct KernelTable {
+		ConvertFunction convert[5][5] = {}; // [from][to]
+		bool (*isOpaque)(const uint8_t* rgba, size_t count) = nullptr;
+		void (*premultiply)(uint8_t* rgba, size_t count) = nullptr;
+		void (*unpremultiply)(uint8_t* rgba, size_t count) = nullptr;
+		void (*srgbToLinear)(const uint8_t* src, uint16_t* dst, size_t count) = nullptr;
+		void (*linearToSrgb)(const uint16_t* src, uint8_t* dst, size_t count) = nullptr;
+		BoxRowsFunction boxRows[5] = {};    // One output row of BoxHalve()
+		// Adds a row to the column sums of BoxDecimate() and BoxDecimateLinear()
+		void (*accumulate8)(const uint8_t* src, uint16_t* sums, size_t count) = nullptr;
+		void (*accumulate16)(const uint16_t* src, uint32_t* sums, size_t count) = nullptr;
+		void (*idctBlock)(const int16_t* coefficients, uint8_t* dst, size_t stride) = nullptr;
+		void (*ycbcrToRgb)(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) = nullptr;
+		UnfilterFunction unfilter[5][5] = {}; // [PNG filter][bytes per pixel]
+	};
+
+	// The sRGB transfer curve with linear light as 12-bit values. 32-bit
+	// entries so SIMD code can gather from them.
+	struct SrgbTables {
+		int32_t toLinear[256];
+		int32_t toSrgb[4096];
+		uint8_t average[4 * 4095 + 1]; // Sum of four linear values to the sRGB byte of their mean
+	};
+}
+
+// Filled before any kernel can run, see dispatch()
+static SrgbTables g_srgb;
+
+static double srgbToLinearValue(double s) {
+	return s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgbValue(double l) {
+	return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+static void buildSrgbTables() {
+	for (int i = 0; i < 256; i++) {
+		g_srgb.toLinear[i] = (int32_t)std::lround(srgbToLinearValue(i / 255.0) * 4095.0);
+	}
+	for (int i = 0; i < 4096; i++) {
+		g_srgb.toSrgb[i] = (int32_t)std::lround(linearToSrgbValue(i / 4095.0) * 255.0);
+	}
+	for (int i = 0; i <= 4 * 4095; i++) {
+		g_srgb.average[i] = (uint8_t)std::lround(linearToSrgbValue(i / (4.0 * 4095.0)) * 255.0);
+	}
+}
+
+// The scalar kernels, which every other variant must match exactly
+namespace reference
+{
+	// Any format to RGBA, and RGBA to RGB
+	template <PixelFormat From, PixelFormat To>
+	static void convert(const uint8_t* src, uint8_t* dst, size_t count) {
+		constexpr int in = (int)From;
+		constexpr int out = (int)To;
+		for (size_t i = 0; i < count; i++, src += in, dst += out) {
+			if constexpr (in <= 2) {
+				dst[0] = dst[1] = dst[2] = src[0];
+			}
+			else {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+			}
+			if constexpr (out == 4) {
+				dst[3] = (in == 2 || in == 4) ? src[in - 1] : 255;
+			}
+		}
+	}
+
+	// Two pixels are ANDed per step as one 64-bit word
+	static bool isOpaque(const uint8_t* rgba, size_t count) {
+		uint64_t all = ~0ull;
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			uint64_t pair;
+			memcpy(&pair, rgba + i * 4, 8);
+			all &= pair;
+		}
+		if (i < count) {
+			uint32_t last;
+			memcpy(&last, rgba + i * 4, 4);
+			all &= (uint64_t)last | 0xFFFFFFFF00000000ull;
+		}
+		const uint64_t alphaMask = 0xFF000000FF000000ull;
+		return (all & alphaMask) == alphaMask;
+	}
+
+	static void premultiply(uint8_t* rgba, size_t count) {
+		for (size_t i = 0; i < count; i++, rgba += 4) {
+			unsigned alpha = rgba[3];
+			for (int c = 0; c < 3; c++) {
+				// c * alpha / 255 rounded, without a division
+				unsigned t = rgba[c] * alpha + 128;
+				rgba[c] = (uint8_t)((t + (t >> 8)) >> 8);
+			}
+		}
+	}
+
+	static void unpremultiply(uint8_t* rgba, size_t count) {
+		for (size_t i = 0; i < count; i++, rgba += 4) {
+			unsigned alpha = rgba[3];
+			for (int c = 0; c < 3; c++) {
+				rgba[c] = alpha == 0 ? 0 : (uint8_t)std::min(255u, (rgba[c] * 255u + alpha / 2) / alpha);
+			}
+		}
+	}
+
+	static void srgbToLinear(const uint8_t* src, uint16_t* dst, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			dst[i] = (uint16_t)g_srgb.toLinear[src[i]];
+		}
+	}
+
+	static void linearToSrgb(const uint16_t* src, uint8_t* dst, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			dst[i] = (uint8_t)g_srgb.toSrgb[std::min<int>(src[i], 4095)];
+		}
+	}
+
+	// Output pixels [firstX, outWidth) of one BoxHalve() row. A last column
+	// of an odd width is dropped, a width of 1 is averaged with itself.
+	template <PixelFormat Format>
+	static void boxRowsFrom(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int firstX, int outWidth) {
+		constexpr int channels = (int)Format;
+		for (int x = firstX; x < outWidth; x++) {
+			size_t left = (size_t)std::min(2 * x, width - 1) * channels;
+			size_t right = (size_t)std::min(2 * x + 1, width - 1) * channels;
+			for (int c = 0; c < channels; c++) {
+				dst[x * channels + c] = (uint8_t)((row0[left + c] + row0[right + c] + row1[left + c] + row1[right + c] + 2) >> 2);
+			}
+		}
+	}
+
+	template <PixelFormat Format>
+	static void boxRows(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* dst, int outWidth) {
+		boxRowsFrom<Format>(row0, row1, width, dst, 0, outWidth);
+	}
+
+	// BoxHalveLinear() of rows already converted to linear light
+	template <int Channels>
+	static void linearBoxRows(const uint16_t* row0, const uint16_t* row1, int width, uint8_t* dst, int outWidth) {
+		for (int x = 0; x < outWidth; x++) {
+			size_t left = (size_t)std::min(2 * x, width - 1) * Channels;
+			size_t right = (size_t)std::min(2 * x + 1, width - 1) * Channels;
+			for (int c = 0; c < Channels; c++) {
+				dst[x * Channels + c] = g_srgb.average[row0[left + c] + row0[right + c] + row1[left + c] + row1[right + c]];
+			}
+		}
+	}
+
+	static void accumulate8(const uint8_t* src, uint16_t* sums, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			sums[i] = (uint16_t)(sums[i] + src[i]);
+		}
+	}
+
+	static void accumulate16(const uint16_t* src, uint32_t* sums, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			sums[i] += src[i];
+		}
+	}
+
+	// stb_image's fixed-point constants: 12 fraction bits for the IDCT, 20
+	// for the colour conversion
+	static constexpr int idctFixed(float x) { return (int)(x * 4096 + 0.5); }
+	static constexpr int colourFixed(float x) { return ((int)(x * 4096.0f + 0.5f)) << 8; }
+
+	static constexpr int kCrToR = colourFixed(1.40200f);
+	static constexpr int kCrToG = -colourFixed(0.71414f);
+	static constexpr int kCbToG = -colourFixed(0.34414f);
+	static constexpr int kCbToB = colourFixed(1.77200f);
+
+	// One 1-D pass of the IDCT over s[0..7], in place: the results are
+	// rounded with `bias` and shifted down by `shift`
+	static void idctPass(int* s, int bias, int shift) {
+		int p2 = s[2];
+		int p3 = s[6];
+		int p1 = (p2 + p3) * idctFixed(0.5411961f);
+		int t2 = p1 + p3 * idctFixed(-1.847759065f);
+		int t3 = p1 + p2 * idctFixed(0.765366865f);
+		p2 = s[0];
+		p3 = s[4];
+		int t0 = (p2 + p3) * 4096;
+		int t1 = (p2 - p3) * 4096;
+		int x0 = t0 + t3 + bias;
+		int x3 = t0 - t3 + bias;
+		int x1 = t1 + t2 + bias;
+		int x2 = t1 - t2 + bias;
+
+		t0 = s[7];
+		t1 = s[5];
+		t2 = s[3];
+		t3 = s[1];
+		p3 = t0 + t2;
+		int p4 = t1 + t3;
+		p1 = t0 + t3;
+		p2 = t1 + t2;
+		int p5 = (p3 + p4) * idctFixed(1.175875602f);
+		t0 = t0 * idctFixed(0.298631336f);
+		t1 = t1 * idctFixed(2.053119869f);
+		t2 = t2 * idctFixed(3.072711026f);
+		t3 = t3 * idctFixed(1.501321110f);
+		p1 = p5 + p1 * idctFixed(-0.899976223f);
+		p2 = p5 + p2 * idctFixed(-2.562915447f);
+		p3 = p3 * idctFixed(-1.961570560f);
+		p4 = p4 * idctFixed(-0.390180644f);
+		t3 += p1 + p4;
+		t2 += p2 + p3;
+		t1 += p2 + p4;
+		t0 += p1 + p3;
+
+		s[0] = (x0 + t3) >> shift;
+		s[7] = (x0 - t3) >> shift;
+		s[1] = (x1 + t2) >> shift;
+		s[6] = (x1 - t2) >> shift;
+		s[2] = (x2 + t1) >> shift;
+		s[5] = (x2 - t1) >> shift;
+		s[3] = (x3 + t0) >> shift;
+		s[4] = (x3 - t0) >> shift;
+	}
+
+	// Columns with 2 extra bits kept, then rows, which also take off the
+	// level shift of 128
+	static const int kIdctColumnBias = 512;
+	static const int kIdctColumnShift = 10;
+	static const int kIdctRowBias = 65536 + (128 << 17);
+	static const int kIdctRowShift = 17;
+
+	static void idctBlock(const int16_t* coefficients, uint8_t* dst, size_t stride) {
+		int values[64];
+		for (int x = 0; x < 8; x++) {
+			int column[8];
+			for (int y = 0; y < 8; y++) {
+				column[y] = coefficients[y * 8 + x];
+			}
+			idctPass(column, kIdctColumnBias, kIdctColumnShift);
+			for (int y = 0; y < 8; y++) {
+				values[y * 8 + x] = column[y];
+			}
+		}
+		for (int y = 0; y < 8; y++, dst += stride) {
+			int* row = values + y * 8;
+			idctPass(row, kIdctRowBias, kIdctRowShift);
+			for (int x = 0; x < 8; x++) {
+				dst[x] = (uint8_t)std::clamp(row[x], 0, 255);
+			}
+		}
+	}
+
+	static void ycbcrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+		for (size_t i = 0; i < count; i++, rgb += 3) {
+			int luma = (y[i] << 20) + (1 << 19);
+			int blue = cb[i] - 128;
+			int red = cr[i] - 128;
+			int r = (luma + red * kCrToR) >> 20;
+			int g = (luma + red * kCrToG + ((blue * kCbToG) & (int)0xffff0000)) >> 20;
+			int b = (luma + blue * kCbToB) >> 20;
+			rgb[0] = (uint8_t)std::clamp(r, 0, 255);
+			rgb[1] = (uint8_t)std::clamp(g, 0, 255);
+			rgb[2] = (uint8_t)std::clamp(b, 0, 255);
+		}
+	}
+
+	static uint8_t paeth(int left, int above, int aboveLeft) {
+		int p = left + above - aboveLeft;
+		int pa = std::abs(p - left);
+		int pb = std::abs(p - above);
+		int pc = std::abs(p - aboveLeft);
+		if (pa <= pb && pa <= pc) {
+			return (uint8_t)left;
+		}
+		return (uint8_t)(pb <= pc ? above : aboveLeft);
+	}
+
+	// PNG filters None, Sub, Up, Average and Paeth. Each output byte is
+	// written after the raw byte at the same offset is read, which is what
+	// lets `out` start before `raw` in the same buffer.
+	template <int Filter, int Bpp>
+	static void unfilter(const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			int x = raw[i];
+			int left = i >= Bpp ? out[i - Bpp] : 0;
+			if constexpr (Filter == 1) {
+				x += left;
+			}
+			else if constexpr (Filter == 2) {
+				x += previous[i];
+			}
+			else if constexpr (Filter == 3) {
+				x += (left + previous[i]) >> 1;
+			}
+			else if constexpr (Filter == 4) {
+				x += paeth(left, previous[i], i >= Bpp ? previous[i - Bpp] : 0);
+			}
+			out[i] = (uint8_t)x;
+		}
+	}
+
+	template <int Bpp>
+	static void fillUnfilter(KernelTable& table) {
+		table.unfilter[0][Bpp] = unfilter<0, Bpp>;
+		table.unfilter[1][Bpp] = unfilter<1, Bpp>;
+		table.unfilter[2][Bpp] = unfilter<2, Bpp>;
+		table.unfilter[3][Bpp] = unfilter<3, Bpp>;
+		table.unfilter[4][Bpp] = unfilter<4, Bpp>;
+	}
+
+	static void fill(KernelTable& table) {
+		table.convert[1][4] = convert<PixelFormat::Grey, PixelFormat::RGBA>;
+		table.convert[2][4] = convert<PixelFormat::GreyAlpha, PixelFormat::RGBA>;
+		table.convert[3][4] = convert<PixelFormat::RGB, PixelFormat::RGBA>;
+		table.convert[4][3] = convert<PixelFormat::RGBA, PixelFormat::RGB>;
+		table.isOpaque = isOpaque;
+		table.premultiply = premultiply;
+		table.unpremultiply = unpremultiply;
+		table.srgbToLinear = srgbToLinear;
+		table.linearToSrgb = linearToSrgb;
+		table.boxRows[1] = boxRows<PixelFormat::Grey>;
+		table.boxRows[2] = boxRows<PixelFormat::GreyAlpha>;
+		table.boxRows[3] = boxRows<PixelFormat::RGB>;
+		table.boxRows[4] = boxRows<PixelFormat::RGBA>;
+		table.accumulate8 = accumulate8;
+		table.accumulate16 = accumulate16;
+		table.idctBlock = idctBlock;
+		table.ycbcrToRgb = ycbcrToRgb;
+		fillUnfilter<1>(table);
+		fillUnfilter<2>(table);
+		fillUnfilter<3>(table);
+		fillUnfilter<4>(table);
+	}
+}
+
+#ifdef VGS_KERNELS_X86
+
+// Every instruction set gets the kernels of pixel_kernels_simd.inl compiled
+// for it, in a namespace of its own with its own vector traits `V`. GCC and
+// Clang only emit the instructions inside the target regions; MSVC emits
+// intrinsics for any instruction set anywhere.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace sse2
+{
+	struct V {
+		using Vec = __m128i;
+		using Float = __m128;
+		static constexpr size_t kBytes = 16;
+
+		static Vec load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+		static void store(void* p, Vec v) { _mm_storeu_si128((__m128i*)p, v); }
+		static Vec zero() { return _mm_setzero_si128(); }
+		static Vec set16(int x) { return _mm_set1_epi16((short)x); }
+		static Vec set32(int x) { return _mm_set1_epi32(x); }
+		static Vec set64(long long x) { return _mm_set1_epi64x(x); }
+		static Vec lanes(__m128i x) { return x; }
+
+		static Vec and_(Vec a, Vec b) { return _mm_and_si128(a, b); }
+		static Vec or_(Vec a, Vec b) { return _mm_or_si128(a, b); }
+		static Vec andnot(Vec a, Vec b) { return _mm_andnot_si128(a, b); }
+		static Vec add16(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+		static Vec add32(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+		static Vec mullo16(Vec a, Vec b) { return _mm_mullo_epi16(a, b); }
+		template <int N> static Vec srli16(Vec v) { return _mm_srli_epi16(v, N); }
+		template <int N> static Vec slli16(Vec v) { return _mm_slli_epi16(v, N); }
+		template <int N> static Vec srli32(Vec v) { return _mm_srli_epi32(v, N); }
+
+		static Vec unpacklo8(Vec a, Vec b) { return _mm_unpacklo_epi8(a, b); }
+		static Vec unpackhi8(Vec a, Vec b) { return _mm_unpackhi_epi8(a, b); }
+		static Vec unpacklo16(Vec a, Vec b) { return _mm_unpacklo_epi16(a, b); }
+		static Vec unpackhi16(Vec a, Vec b) { return _mm_unpackhi_epi16(a, b); }
+		static Vec unpacklo64(Vec a, Vec b) { return _mm_unpacklo_epi64(a, b); }
+		static Vec unpackhi64(Vec a, Vec b) { return _mm_unpackhi_epi64(a, b); }
+		static Vec packus16(Vec a, Vec b) { return _mm_packus_epi16(a, b); }
+		static Vec packs32(Vec a, Vec b) { return _mm_packs_epi32(a, b); }
+
+		// 128-bit vectors have a single lane, so unpacking and packing
+		// keep the order as it is
+		static Vec spread(Vec v) { return v; }
+		static Vec unspread(Vec v) { return v; }
+
+		static Vec broadcastAlpha16(Vec v) { return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF); }
+		static Vec broadcastAlpha32(Vec v) { return _mm_shuffle_epi32(v, 0xFF); }
+		static bool allSet(Vec v, Vec mask) { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, mask), mask)) == 0xFFFF; }
+		static Vec keepWhereNonZero(Vec test, Vec v) { return _mm_andnot_si128(_mm_cmpeq_epi32(test, _mm_setzero_si128()), v); }
+
+		static Float toFloat(Vec v) { return _mm_cvtepi32_ps(v); }
+		static Vec truncate(Float f) { return _mm_cvttps_epi32(f); }
+		static Float setf(float x) { return _mm_set1_ps(x); }
+		static Float addf(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float mulf(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float divf(Float a, Float b) { return _mm_div_ps(a, b); }
+		static Float minf(Float a, Float b) { return _mm_min_ps(a, b); }
+	};
+
+#define VGS_KERNELS_BYTE_SHUFFLE 0
+#include "pixel_kernels_simd.inl"
+#undef VGS_KERNELS_BYTE_SHUFFLE
+
+	// The PNG filters of RGB and RGBA rows. Sub, Average and Paeth depend
+	// on the pixel to the left, so they go one pixel at a time, with the
+	// channels side by side; wider vectors gain nothing, and the levels
+	// above use these as they are. Up has no such chain.
+
+	// Exactly one pixel, assembled in a register: going through memory would
+	// stall on forwarding three narrow stores to a wide load
+	template <int Bpp>
+	static __m128i loadPixel(const uint8_t* p) {
+		int32_t value;
+		if constexpr (Bpp == 4) {
+			std::memcpy(&value, p, 4);
+		}
+		else {
+			uint16_t low;
+			std::memcpy(&low, p, 2);
+			value = low | p[2] << 16;
+		}
+		return _mm_cvtsi32_si128(value);
+	}
+
+	template <int Bpp>
+	static void storePixel(uint8_t* p, __m128i v) {
+		int32_t value = _mm_cvtsi128_si32(v);
+		if constexpr (Bpp == 4) {
+			std::memcpy(p, &value, 4);
+		}
+		else {
+			uint16_t low = (uint16_t)value;
+			std::memcpy(p, &low, 2);
+			p[2] = (uint8_t)(value >> 16);
+		}
+	}
+
+	static void unfilterUp(const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length) {
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)(raw + i));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_add_epi8(x, _mm_loadu_si128((const __m128i*)(previous + i))));
+		}
+		reference::unfilter<2, 1>(raw + i, previous + i, out + i, length - i);
+	}
+
+	template <int Bpp>
+	static void unfilterSub(const uint8_t* raw, const uint8_t*, uint8_t* out, size_t length) {
+		__m128i left = _mm_setzero_si128();
+		for (size_t i = 0; i + Bpp <= length; i += Bpp) {
+			left = _mm_add_epi8(left, loadPixel<Bpp>(raw + i));
+			storePixel<Bpp>(out + i, left);
+		}
+	}
+
+	template <int Bpp>
+	static void unfilterAverage(const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length) {
+		const __m128i one = _mm_set1_epi8(1);
+		__m128i left = _mm_setzero_si128();
+		for (size_t i = 0; i + Bpp <= length; i += Bpp) {
+			__m128i above = loadPixel<Bpp>(previous + i);
+			// _mm_avg_epu8 rounds up; PNG rounds down
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(left, above), _mm_and_si128(_mm_xor_si128(left, above), one));
+			left = _mm_add_epi8(average, loadPixel<Bpp>(raw + i));
+			storePixel<Bpp>(out + i, left);
+		}
+	}
+
+	static __m128i abs16(__m128i v) {
+		return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+	}
+
+	static __m128i select(__m128i mask, __m128i a, __m128i b) {
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	// reference::paeth() on 16-bit channels
+	template <int Bpp>
+	static void unfilterPaeth(const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i left = zero, above = zero, aboveLeft = zero;
+		for (size_t i = 0; i + Bpp <= length; i += Bpp) {
+			aboveLeft = above;
+			above = _mm_unpacklo_epi8(loadPixel<Bpp>(previous + i), zero);
+			__m128i pa = _mm_sub_epi16(above, aboveLeft); // |p - left|
+			__m128i pb = _mm_sub_epi16(left, aboveLeft);  // |p - above|
+			__m128i pc = abs16(_mm_add_epi16(pa, pb));    // |p - aboveLeft|
+			pa = abs16(pa);
+			pb = abs16(pb);
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i predicted = select(_mm_cmpeq_epi16(smallest, pa), left,
+				select(_mm_cmpeq_epi16(smallest, pb), above, aboveLeft));
+			__m128i x = _mm_unpacklo_epi8(loadPixel<Bpp>(raw + i), zero);
+			// Adding the bytes wraps within each channel, the high bytes stay 0
+			left = _mm_add_epi8(x, predicted);
+			storePixel<Bpp>(out + i, _mm_packus_epi16(left, left));
+		}
+	}
+
+	static void fillPng(KernelTable& table) {
+		for (int bpp = 1; bpp <= 4; bpp++) {
+			table.unfilter[2][bpp] = unfilterUp;
+		}
+		// The scalar Sub of RGB rows is already as fast
+		table.unfilter[1][4] = unfilterSub<4>;
+		table.unfilter[3][3] = unfilterAverage<3>;
+		table.unfilter[3][4] = unfilterAverage<4>;
+		table.unfilter[4][3] = unfilterPaeth<3>;
+		table.unfilter[4][4] = unfilterPaeth<4>;
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace avx2
+{
+	struct V {
+		using Vec = __m256i;
+		using Float = __m256;
+		static constexpr size_t kBytes = 32;
+
+		static Vec load(const void* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		static void store(void* p, Vec v) { _mm256_storeu_si256((__m256i*)p, v); }
+		static Vec zero() { return _mm256_setzero_si256(); }
+		static Vec set16(int x) { return _mm256_set1_epi16((short)x); }
+		static Vec set32(int x) { return _mm256_set1_epi32(x); }
+		static Vec set64(long long x) { return _mm256_set1_epi64x(x); }
+		static Vec lanes(__m128i x) { return _mm256_broadcastsi128_si256(x); }
+
+		static Vec and_(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+		static Vec or_(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+		static Vec andnot(Vec a, Vec b) { return _mm256_andnot_si256(a, b); }
+		static Vec add16(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+		static Vec add32(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+		static Vec mullo16(Vec a, Vec b) { return _mm256_mullo_epi16(a, b); }
+		template <int N> static Vec srli16(Vec v) { return _mm256_srli_epi16(v, N); }
+		template <int N> static Vec slli16(Vec v) { return _mm256_slli_epi16(v, N); }
+		template <int N> static Vec srli32(Vec v) { return _mm256_srli_epi32(v, N); }
+
+		static Vec unpacklo8(Vec a, Vec b) { return _mm256_unpacklo_epi8(a, b); }
+		static Vec unpackhi8(Vec a, Vec b) { return _mm256_unpackhi_epi8(a, b); }
+		static Vec unpacklo16(Vec a, Vec b) { return _mm256_unpacklo_epi16(a, b); }
+		static Vec unpackhi16(Vec a, Vec b) { return _mm256_unpackhi_epi16(a, b); }
+		static Vec unpacklo64(Vec a, Vec b) { return _mm256_unpacklo_epi64(a, b); }
+		static Vec unpackhi64(Vec a, Vec b) { return _mm256_unpackhi_epi64(a, b); }
+		static Vec packus16(Vec a, Vec b) { return _mm256_packus_epi16(a, b); }
+		static Vec packs32(Vec a, Vec b) { return _mm256_packs_epi32(a, b); }
+
+		// Unpacking works within 128-bit lanes: spread() moves the first
+		// half of the bytes into the low halves of the lanes so unpacking
+		// the low halves covers them in order; unspread() puts the result of
+		// packing two such vectors back in order
+		static Vec spread(Vec v) { return _mm256_permute4x64_epi64(v, 0xD8); }
+		static Vec unspread(Vec v) { return _mm256_permute4x64_epi64(v, 0xD8); }
+
+		static Vec shuffle8(Vec v, Vec control) { return _mm256_shuffle_epi8(v, control); }
+		// Four pixels of RGB per lane, from the first 12 of 16 bytes loaded
+		static Vec loadLanes12(const uint8_t* p) {
+			return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+		}
+		// Stores the first 12 bytes of every lane back to back, writing 4
+		// bytes past them
+		static void storeLanes12(uint8_t* p, Vec v) {
+			_mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+			_mm_storeu_si128((__m128i*)(p + 12), _mm256_extracti128_si256(v, 1));
+		}
+
+		static Vec broadcastAlpha16(Vec v) { return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xFF), 0xFF); }
+		static Vec broadcastAlpha32(Vec v) { return _mm256_shuffle_epi32(v, 0xFF); }
+		static bool allSet(Vec v, Vec mask) { return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(v, mask), mask)) == -1; }
+		static Vec keepWhereNonZero(Vec test, Vec v) { return _mm256_andnot_si256(_mm256_cmpeq_epi32(test, _mm256_setzero_si256()), v); }
+
+		static Float toFloat(Vec v) { return _mm256_cvtepi32_ps(v); }
+		static Vec truncate(Float f) { return _mm256_cvttps_epi32(f); }
+		static Float setf(float x) { return _mm256_set1_ps(x); }
+		static Float addf(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float mulf(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float divf(Float a, Float b) { return _mm256_div_ps(a, b); }
+		static Float minf(Float a, Float b) { return _mm256_min_ps(a, b); }
+	};
+
+#define VGS_KERNELS_BYTE_SHUFFLE 1
+#include "pixel_kernels_simd.inl"
+#undef VGS_KERNELS_BYTE_SHUFFLE
+
+	// Table lookups eight at a time. Only AVX2 has these: the AVX-512 level
+	// uses them as they are.
+	static void srgbToLinearGather(const uint8_t* src, uint16_t* dst, size_t count) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+			__m256i linear = _mm256_i32gather_epi32(g_srgb.toLinear, index, 4);
+			__m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(linear), _mm256_extracti128_si256(linear, 1));
+			_mm_storeu_si128((__m128i*)(dst + i), packed);
+		}
+		reference::srgbToLinear(src + i, dst + i, count - i);
+	}
+
+	static void linearToSrgbGather(const uint16_t* src, uint8_t* dst, size_t count) {
+		const __m256i maxIndex = _mm256_set1_epi32(4095);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i index = _mm256_min_epu32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i))), maxIndex);
+			__m256i srgb = _mm256_i32gather_epi32(g_srgb.toSrgb, index, 4);
+			__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(srgb), _mm256_extracti128_si256(srgb, 1));
+			_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(words, words));
+		}
+		reference::linearToSrgb(src + i, dst + i, count - i);
+	}
+
+	static void fillGather(KernelTable& table) {
+		table.srgbToLinear = srgbToLinearGather;
+		table.linearToSrgb = linearToSrgbGather;
+	}
+
+	// The JPEG kernels work on 32-bit lanes, eight to a vector, which
+	// SSE2 has no multiply for; AVX-512 uses these as they are.
+
+	static __m256i mul(__m256i v, int c) {
+		return _mm256_mullo_epi32(v, _mm256_set1_epi32(c));
+	}
+
+	// reference::idctPass() on eight columns at once, s[i] holding row i
+	static void idctPass(__m256i* s, __m256i bias, int shift) {
+		__m256i p2 = s[2];
+		__m256i p3 = s[6];
+		__m256i p1 = mul(_mm256_add_epi32(p2, p3), reference::idctFixed(0.5411961f));
+		__m256i t2 = _mm256_add_epi32(p1, mul(p3, reference::idctFixed(-1.847759065f)));
+		__m256i t3 = _mm256_add_epi32(p1, mul(p2, reference::idctFixed(0.765366865f)));
+		p2 = s[0];
+		p3 = s[4];
+		__m256i t0 = _mm256_slli_epi32(_mm256_add_epi32(p2, p3), 12);
+		__m256i t1 = _mm256_slli_epi32(_mm256_sub_epi32(p2, p3), 12);
+		__m256i x0 = _mm256_add_epi32(_mm256_add_epi32(t0, t3), bias);
+		__m256i x3 = _mm256_add_epi32(_mm256_sub_epi32(t0, t3), bias);
+		__m256i x1 = _mm256_add_epi32(_mm256_add_epi32(t1, t2), bias);
+		__m256i x2 = _mm256_add_epi32(_mm256_sub_epi32(t1, t2), bias);
+
+		t0 = s[7];
+		t1 = s[5];
+		t2 = s[3];
+		t3 = s[1];
+		p3 = _mm256_add_epi32(t0, t2);
+		__m256i p4 = _mm256_add_epi32(t1, t3);
+		p1 = _mm256_add_epi32(t0, t3);
+		p2 = _mm256_add_epi32(t1, t2);
+		__m256i p5 = mul(_mm256_add_epi32(p3, p4), reference::idctFixed(1.175875602f));
+		t0 = mul(t0, reference::idctFixed(0.298631336f));
+		t1 = mul(t1, reference::idctFixed(2.053119869f));
+		t2 = mul(t2, reference::idctFixed(3.072711026f));
+		t3 = mul(t3, reference::idctFixed(1.501321110f));
+		p1 = _mm256_add_epi32(p5, mul(p1, reference::idctFixed(-0.899976223f)));
+		p2 = _mm256_add_epi32(p5, mul(p2, reference::idctFixed(-2.562915447f)));
+		p3 = mul(p3, reference::idctFixed(-1.961570560f));
+		p4 = mul(p4, reference::idctFixed(-0.390180644f));
+		t3 = _mm256_add_epi32(t3, _mm256_add_epi32(p1, p4));
+		t2 = _mm256_add_epi32(t2, _mm256_add_epi32(p2, p3));
+		t1 = _mm256_add_epi32(t1, _mm256_add_epi32(p2, p4));
+		t0 = _mm256_add_epi32(t0, _mm256_add_epi32(p1, p3));
+
+		__m128i count = _mm_cvtsi32_si128(shift);
+		s[0] = _mm256_sra_epi32(_mm256_add_epi32(x0, t3), count);
+		s[7] = _mm256_sra_epi32(_mm256_sub_epi32(x0, t3), count);
+		s[1] = _mm256_sra_epi32(_mm256_add_epi32(x1, t2), count);
+		s[6] = _mm256_sra_epi32(_mm256_sub_epi32(x1, t2), count);
+		s[2] = _mm256_sra_epi32(_mm256_add_epi32(x2, t1), count);
+		s[5] = _mm256_sra_epi32(_mm256_sub_epi32(x2, t1), count);
+		s[3] = _mm256_sra_epi32(_mm256_add_epi32(x3, t0), count);
+		s[4] = _mm256_sra_epi32(_mm256_sub_epi32(x3, t0), count);
+	}
+
+	static void transpose8x8(__m256i* r) {
+		__m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+		__m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+		__m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+		__m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+		__m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+		__m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+		__m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+		__m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+		__m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+		__m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+		__m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+		__m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+		__m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+		__m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+		__m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+		__m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+		r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+		r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+		r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+		r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+		r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+		r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+		r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+		r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+	}
+
+	static void idctBlock(const int16_t* coefficients, uint8_t* dst, size_t stride) {
+		__m256i s[8];
+		for (int y = 0; y < 8; y++) {
+			s[y] = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(coefficients + y * 8)));
+		}
+		idctPass(s, _mm256_set1_epi32(reference::kIdctColumnBias), reference::kIdctColumnShift);
+		transpose8x8(s);
+		idctPass(s, _mm256_set1_epi32(reference::kIdctRowBias), reference::kIdctRowShift);
+		transpose8x8(s);
+
+		// Saturating packs clamp to 0-255; each vector ends up with rows
+		// y and y + 2 in its low lane and y + 1 and y + 3 in its high one
+		for (int y = 0; y < 8; y += 4) {
+			__m256i rows01 = _mm256_permute4x64_epi64(_mm256_packs_epi32(s[y], s[y + 1]), 0xD8);
+			__m256i rows23 = _mm256_permute4x64_epi64(_mm256_packs_epi32(s[y + 2], s[y + 3]), 0xD8);
+			__m256i bytes = _mm256_packus_epi16(rows01, rows23);
+			__m128i low = _mm256_castsi256_si128(bytes);
+			__m128i high = _mm256_extracti128_si256(bytes, 1);
+			_mm_storel_epi64((__m128i*)(dst + (y + 0) * stride), low);
+			_mm_storel_epi64((__m128i*)(dst + (y + 1) * stride), high);
+			_mm_storel_epi64((__m128i*)(dst + (y + 2) * stride), _mm_unpackhi_epi64(low, low));
+			_mm_storel_epi64((__m128i*)(dst + (y + 3) * stride), _mm_unpackhi_epi64(high, high));
+		}
+	}
+
+	static __m256i loadBytes8(const uint8_t* p) {
+		return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+	}
+
+	// A 20-bit fixed-point colour to 0-255
+	static __m256i clampColour(__m256i v) {
+		return _mm256_max_epi32(_mm256_min_epi32(_mm256_srai_epi32(v, 20), _mm256_set1_epi32(255)), _mm256_setzero_si256());
+	}
+
+	static void ycbcrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+		const __m256i rounding = _mm256_set1_epi32(1 << 19);
+		const __m256i offset = _mm256_set1_epi32(128);
+		const __m256i crToR = _mm256_set1_epi32(reference::kCrToR);
+		const __m256i crToG = _mm256_set1_epi32(reference::kCrToG);
+		const __m256i cbToG = _mm256_set1_epi32(reference::kCbToG);
+		const __m256i cbToB = _mm256_set1_epi32(reference::kCbToB);
+		const __m256i highBits = _mm256_set1_epi32((int)0xffff0000);
+		// The three low bytes of every pixel word, back to back in each lane
+		const __m256i pack = V::lanes(_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+
+		size_t i = 0;
+		// storeLanes12() writes 4 bytes past the 24 of eight pixels
+		for (; (i + 8) * 3 + 4 <= count * 3; i += 8) {
+			__m256i luma = _mm256_add_epi32(_mm256_slli_epi32(loadBytes8(y + i), 20), rounding);
+			__m256i blue = _mm256_sub_epi32(loadBytes8(cb + i), offset);
+			__m256i red = _mm256_sub_epi32(loadBytes8(cr + i), offset);
+			__m256i r = clampColour(_mm256_add_epi32(luma, _mm256_mullo_epi32(red, crToR)));
+			__m256i g = clampColour(_mm256_add_epi32(_mm256_add_epi32(luma, _mm256_mullo_epi32(red, crToG)),
+				_mm256_and_si256(_mm256_mullo_epi32(blue, cbToG), highBits)));
+			__m256i b = clampColour(_mm256_add_epi32(luma, _mm256_mullo_epi32(blue, cbToB)));
+			__m256i pixels = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_slli_epi32(b, 16));
+			V::storeLanes12(rgb + i * 3, V::shuffle8(pixels, pack));
+		}
+		reference::ycbcrToRgb(y + i, cb + i, cr + i, rgb + i * 3, count - i);
+	}
+
+	static void fillJpeg(KernelTable& table) {
+		table.idctBlock = idctBlock;
+		table.ycbcrToRgb = ycbcrToRgb;
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#endif
+
+namespace avx512
+{
+	struct V {
+		using Vec = __m512i;
+		using Float = __m512;
+		static constexpr size_t kBytes = 64;
+
+		static Vec load(const void* p) { return _mm512_loadu_si512(p); }
+		static void store(void* p, Vec v) { _mm512_storeu_si512(p, v); }
+		static Vec zero() { return _mm512_setzero_si512(); }
+		static Vec set16(int x) { return _mm512_set1_epi16((short)x); }
+		static Vec set32(int x) { return _mm512_set1_epi32(x); }
+		static Vec set64(long long x) { return _mm512_set1_epi64(x); }
+		static Vec lanes(__m128i x) { return _mm512_broadcast_i32x4(x); }
+
+		static Vec and_(Vec a, Vec b) { return _mm512_and_si512(a, b); }
+		static Vec or_(Vec a, Vec b) { return _mm512_or_si512(a, b); }
+		static Vec andnot(Vec a, Vec b) { return _mm512_andnot_si512(a, b); }
+		static Vec add16(Vec a, Vec b) { return _mm512_add_epi16(a, b); }
+		static Vec add32(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+		static Vec mullo16(Vec a, Vec b) { return _mm512_mullo_epi16(a, b); }
+		template <int N> static Vec srli16(Vec v) { return _mm512_srli_epi16(v, N); }
+		template <int N> static Vec slli16(Vec v) { return _mm512_slli_epi16(v, N); }
+		template <int N> static Vec srli32(Vec v) { return _mm512_srli_epi32(v, N); }
+
+		static Vec unpacklo8(Vec a, Vec b) { return _mm512_unpacklo_epi8(a, b); }
+		static Vec unpackhi8(Vec a, Vec b) { return _mm512_unpackhi_epi8(a, b); }
+		static Vec unpacklo16(Vec a, Vec b) { return _mm512_unpacklo_epi16(a, b); }
+		static Vec unpackhi16(Vec a, Vec b) { return _mm512_unpackhi_epi16(a, b); }
+		static Vec unpacklo64(Vec a, Vec b) { return _mm512_unpacklo_epi64(a, b); }
+		static Vec unpackhi64(Vec a, Vec b) { return _mm512_unpackhi_epi64(a, b); }
+		static Vec packus16(Vec a, Vec b) { return _mm512_packus_epi16(a, b); }
+		static Vec packs32(Vec a, Vec b) { return _mm512_packs_epi32(a, b); }
+
+		// As for AVX2, over four lanes
+		static Vec spread(Vec v) { return _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7), v); }
+		static Vec unspread(Vec v) { return _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7), v); }
+
+		static Vec shuffle8(Vec v, Vec control) { return _mm512_shuffle_epi8(v, control); }
+		static Vec loadLanes12(const uint8_t* p) {
+			Vec v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)p));
+			v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+			v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 24)), 2);
+			return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 36)), 3);
+		}
+		static void storeLanes12(uint8_t* p, Vec v) {
+			_mm_storeu_si128((__m128i*)p, _mm512_castsi512_si128(v));
+			_mm_storeu_si128((__m128i*)(p + 12), _mm512_extracti32x4_epi32(v, 1));
+			_mm_storeu_si128((__m128i*)(p + 24), _mm512_extracti32x4_epi32(v, 2));
+			_mm_storeu_si128((__m128i*)(p + 36), _mm512_extracti32x4_epi32(v, 3));
+		}
+
+		static Vec broadcastAlpha16(Vec v) { return _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(v, 0xFF), 0xFF); }
+		static Vec broadcastAlpha32(Vec v) { return _mm512_shuffle_epi32(v, (_MM_PERM_ENUM)0xFF); }
+		static bool allSet(Vec v, Vec mask) { return _mm512_cmpneq_epi32_mask(_mm512_and_si512(v, mask), mask) == 0; }
+		static Vec keepWhereNonZero(Vec test, Vec v) { return _mm512_maskz_mov_epi32(_mm512_test_epi32_mask(test, test), v); }
+
+		static Float toFloat(Vec v) { return _mm512_cvtepi32_ps(v); }
+		static Vec truncate(Float f) { return _mm512_cvttps_epi32(f); }
+		static Float setf(float x) { return _mm512_set1_ps(x); }
+		static Float addf(Float a, Float b) { return _mm512_add_ps(a, b); }
+		static Float mulf(Float a, Float b) { return _mm512_mul_ps(a, b); }
+		static Float divf(Float a, Float b) { return _mm512_div_ps(a, b); }
+		static Float minf(Float a, Float b) { return _mm512_min_ps(a, b); }
+	};
+
+#define VGS_KERNELS_BYTE_SHUFFLE 1
+#include "pixel_kernels_simd.inl"
+#undef VGS_KERNELS_BYTE_SHUFFLE
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#ifdef _MSC_VER
+static void cpuid(unsigned leaf, unsigned regs[4]) {
+	int info[4];
+	__cpuidex(info, (int)leaf, 0);
+	for (int i = 0; i < 4; i++) regs[i] = (unsigned)info[i];
+}
+
+static uint64_t xgetbv0() {
+	return _xgetbv(0);
+}
+#else
+static void cpuid(unsigned leaf, unsigned regs[4]) {
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+}
+
+static uint64_t xgetbv0() {
+	uint32_t low, high;
+	__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((uint64_t)high << 32) | low;
+}
+#endif
+
+#endif // VGS_KERNELS_X86
+
+static CpuLevel detectLevel() {
+#ifdef VGS_KERNELS_X86
+	unsigned regs[4];
+	cpuid(0, regs);
+	unsigned maxLeaf = regs[0];
+	cpuid(1, regs);
+	if (!(regs[3] & (1u << 26))) {
+		return CpuLevel::Scalar;
+	}
+	// AVX needs the OS to save the YMM (and for AVX-512 the ZMM) registers
+	bool osxsave = (regs[2] & (1u << 27)) && (regs[2] & (1u << 28));
+	if (!osxsave || maxLeaf < 7) {
+		return CpuLevel::SSE2;
+	}
+	uint64_t xcr0 = xgetbv0();
+	cpuid(7, regs);
+	bool avx2 = (xcr0 & 0x6) == 0x6 && (regs[1] & (1u << 5));
+	bool avx512 = (xcr0 & 0xE6) == 0xE6 && (regs[1] & (1u << 16)) && (regs[1] & (1u << 30));
+	return avx512 && avx2 ? CpuLevel::AVX512 : avx2 ? CpuLevel::AVX2 : CpuLevel::SSE2;
+#else
+	return CpuLevel::Scalar;
+#endif
+}
+
+namespace
+{
+	struct Dispatch {
+		KernelTable tables[(int)CpuLevel::Count];
+		CpuLevel supported = CpuLevel::Scalar;
+		std::atomic<CpuLevel> active{ CpuLevel::Scalar };
+
+		Dispatch() {
+			buildSrgbTables();
+			// Each level starts from the one below and replaces what it has
+			// variants for
+			reference::fill(tables[(int)CpuLevel::Scalar]);
+			tables[(int)CpuLevel::SSE2] = tables[(int)CpuLevel::Scalar];
+			tables[(int)CpuLevel::AVX2] = tables[(int)CpuLevel::Scalar];
+			tables[(int)CpuLevel::AVX512] = tables[(int)CpuLevel::Scalar];
+#ifdef VGS_KERNELS_X86
+			sse2::fill(tables[(int)CpuLevel::SSE2]);
+			sse2::fillPng(tables[(int)CpuLevel::SSE2]);
+			tables[(int)CpuLevel::AVX2] = tables[(int)CpuLevel::SSE2];
+			avx2::fill(tables[(int)CpuLevel::AVX2]);
+			avx2::fillGather(tables[(int)CpuLevel::AVX2]);
+			avx2::fillJpeg(tables[(int)CpuLevel::AVX2]);
+			tables[(int)CpuLevel::AVX512] = tables[(int)CpuLevel::AVX2];
+			avx512::fill(tables[(int)CpuLevel::AVX512]);
+#endif
+			supported = detectLevel();
+			active = supported;
+		}
+	};
+}
+
+static Dispatch& dispatch() {
+	static Dispatch instance;
+	return instance;
+}
+
+static const KernelTable& kernels() {
+	Dispatch& d = dispatch();
+	return d.tables[(int)d.active.load(std::memory_order_relaxed)];
+}
+
+const char* CpuLevelName(CpuLevel level) {
+	switch (level) {
+	case CpuLevel::Scalar: return "scalar";
+	case CpuLevel::SSE2: return "sse2";
+	case CpuLevel::AVX2: return "avx2";
+	case CpuLevel::AVX512: return "avx512";
+	default: return "unknown";
+	}
+}
+
+CpuLevel PixelKernels::SupportedLevel() {
+	return dispatch().supported;
+}
+
+CpuLevel PixelKernels::ActiveLevel() {
+	return dispatch().active.load(std::memory_order_relaxed);
+}
+
+CpuLevel PixelKernels::SetActiveLevel(CpuLevel level) {
+	Dispatch& d = dispatch();
+	level = std::min(level, d.supported);
+	d.active.store(level, std::memory_order_relaxed);
+	return level;
+}
+
+bool PixelKernels::Convert(PixelFormat from, PixelFormat to, const uint8_t* src, uint8_t* dst, size_t count) {
+	ConvertFunction convert = kernels().convert[(int)from][(int)to];
+	if (!convert) {
+		return false;
+	}
+	convert(src, dst, count);
+	return true;
+}
+
+bool PixelKernels::IsOpaque(const uint8_t* rgba, size_t count) {
+	return kernels().isOpaque(rgba, count);
+}
+
+void PixelKernels::Premultiply(uint8_t* rgba, size_t count) {
+	kernels().premultiply(rgba, count);
+}
+
+void PixelKernels::Unpremultiply(uint8_t* rgba, size_t count) {
+	kernels().unpremultiply(rgba, count);
+}
+
+void PixelKernels::SrgbToLinear(const uint8_t* src, uint16_t* dst, size_t count) {
+	kernels().srgbToLinear(src, dst, count);
+}
+
+void PixelKernels::LinearToSrgb(const uint16_t* src, uint8_t* dst, size_t count) {
+	kernels().linearToSrgb(src, dst, count);
+}
+
+void PixelKernels::IdctBlock(const int16_t* coefficients, uint8_t* dst, size_t stride) {
+	kernels().idctBlock(coefficients, dst, stride);
+}
+
+void PixelKernels::YCbCrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+	kernels().ycbcrToRgb(y, cb, cr, rgb, count);
+}
+
+bool PixelKernels::UnfilterPngRow(int filter, int bytesPerPixel, const uint8_t* raw, const uint8_t* previous, uint8_t* out, size_t length) {
+	if (filter < 0 || filter > 4 || bytesPerPixel < 1 || bytesPerPixel > 4) {
+		return false;
+	}
+	kernels().unfilter[filter][bytesPerPixel](raw, previous, out, length);
+	return true;
+}
+
+void PixelKernels::BoxHalve(PixelFormat format, const uint8_t* src, int width, int height, uint8_t* dst) {
+	BoxRowsFunction boxRows = kernels().boxRows[(int)format];
+	int outWidth = std::max(1, width / 2);
+	int outHeight = std::max(1, height / 2);
+	size_t stride = (size_t)width * (int)format;
+	for (int y = 0; y < outHeight; y++) {
+		const uint8_t* row0 = src + std::min(2 * y, height - 1) * stride;
+		const uint8_t* row1 = src + std::min(2 * y + 1, height - 1) * stride;
+		boxRows(row0, row1, width, dst + (size_t)y * outWidth * (int)format, outWidth);
+	}
+}
+
+void PixelKernels::BoxHalveLinear(PixelFormat format, const uint8_t* src, int width, int height, uint8_t* dst) {
+	if (format != PixelFormat::Grey && format != PixelFormat::RGB) {
+		BoxHalve(format, src, width, height, dst);
+		return;
+	}
+	const KernelTable& table = kernels();
+	int outWidth = std::max(1, width / 2);
+	int outHeight = std::max(1, height / 2);
+	size_t stride = (size_t)width * (int)format;
+	std::vector<uint16_t> linear(stride * 2);
+	for (int y = 0; y < outHeight; y++) {
+		table.srgbToLinear(src + std::min(2 * y, height - 1) * stride, linear.data(), stride);
+		table.srgbToLinear(src + std::min(2 * y + 1, height - 1) * stride, linear.data() + stride, stride);
+		uint8_t* out = dst + (size_t)y * outWidth * (int)format;
+		if (format == PixelFormat::Grey) {
+			reference::linearBoxRows<1>(linear.data(), linear.data() + stride, width, out, outWidth);
+		}
+		else {
+			reference::linearBoxRows<3>(linear.data(), linear.data() + stride, width, out, outWidth);
+		}
+	}
+}
+
+// Sums each `factor` wide run of pixels of the column sums of a block row
+// and rounds the mean, a side narrower than `factor` being repeated
+template <typename Sum, typename Out>
+static void averageBlocks(const Sum* sums, int width, int channels, int factor, int shift, Out* out, int outWidth) {
+	const uint32_t half = (1u << shift) >> 1;
+	for (int x = 0; x < outWidth; x++) {
+		const Sum* block = sums + (size_t)x * factor * channels;
+		bool inside = (x + 1) * factor <= width;
+		for (int c = 0; c < channels; c++) {
+			uint32_t sum = 0;
+			if (inside) {
+				for (int i = 0; i < factor * channels; i += channels) {
+					sum += block[i + c];
+				}
+			}
+			else {
+				for (int i = 0; i < factor; i++) {
+					sum += sums[(size_t)std::min(x * factor + i, width - 1) * channels + c];
+				}
+			}
+			*out++ = (Out)((sum + half) >> shift);
+		}
+	}
+}
+
+static int blockShift(int factor) {
+	int shift = 0;
+	while ((1 << shift) < factor) {
+		shift++;
+	}
+	return 2 * shift;
+}
+
+void PixelKernels::BoxDecimate(PixelFormat format, const uint8_t* src, int width, int height, int factor, uint8_t* dst) {
+	const KernelTable& table = kernels();
+	int channels = (int)format;
+	int outWidth = std::max(1, width / factor);
+	int outHeight = std::max(1, height / factor);
+	int shift = blockShift(factor);
+	size_t stride = (size_t)width * channels;
+	std::vector<uint16_t> sums(stride);
+	std::vector<uint8_t> premultiplied(format == PixelFormat::RGBA ? stride : 0);
+	for (int y = 0; y < outHeight; y++) {
+		std::fill(sums.begin(), sums.end(), (uint16_t)0);
+		for (int row = 0; row < factor; row++) {
+			const uint8_t* line = src + std::min(y * factor + row, height - 1) * stride;
+			if (!premultiplied.empty()) {
+				std::copy(line, line + stride, premultiplied.begin());
+				table.premultiply(premultiplied.data(), (size_t)width);
+				line = premultiplied.data();
+			}
+			table.accumulate8(line, sums.data(), stride);
+		}
+		uint8_t* out = dst + (size_t)y * outWidth * channels;
+		averageBlocks(sums.data(), width, channels, factor, shift, out, outWidth);
+		if (!premultiplied.empty()) {
+			table.unpremultiply(out, (size_t)outWidth);
+		}
+	}
+}
+
+void PixelKernels::BoxDecimateLinear(PixelFormat format, const uint8_t* src, int width, int height, int factor, uint8_t* dst) {
+	if (format != PixelFormat::Grey && format != PixelFormat::RGB) {
+		BoxDecimate(format, src, width, height, factor, dst);
+		return;
+	}
+	const KernelTable& table = kernels();
+	int channels = (int)format;
+	int outWidth = std::max(1, width / factor);
+	int outHeight = std::max(1, height / factor);
+	int shift = blockShift(factor);
+	size_t stride = (size_t)width * channels;
+	std::vector<uint16_t> linear(stride);
+	std::vector<uint32_t> sums(stride);
+	std::vector<uint16_t> averages((size_t)outWidth * channels);
+	for (int y = 0; y < outHeight; y++) {
+		std::fill(sums.begin(), sums.end(), 0u);
+		for (int row = 0; row < factor; row++) {
+			table.srgbToLinear(src + std::min(y * factor + row, height - 1) * stride, linear.data(), stride);
+			table.accumulate16(linear.data(), sums.data(), stride);
+		}
+		averageBlocks(sums.data(), width, channels, factor, shift, averages.data(), outWidth);
+		table.linearToSrgb(averages.data(), dst + (size_t)y * outWidth * channels, averages.size());
+	}
+}
@@ -0,0 +1,123 @@
+#include <climits>
+#include <cstring>
+
+#include "inflate.h"
+#include "pixel_kernels.h"
+#include "png_decoder.h"
+#include "trace.h"
+
+namespace
+{
+	const unsigned char kSignature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	const uint32_t kMaxDimension = 1u << 24; // stb_image's limit
+
+	uint32_t readBigEndian32(const unsigned char* p) {
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+
+	uint32_t chunkType(const char* name) {
+		return readBigEndian32((const unsigned char*)name);
+	}
+}
+
+bool PngDecoder::Open(const unsigned char* bytes, size_t length) {
+	*this = PngDecoder();
+	data = bytes;
+	size = length;
+	if (size < sizeof(kSignature) || std::memcmp(data, kSignature, sizeof(kSignature)) != 0) {
+		return false;
+	}
+
+	size_t pos = sizeof(kSignature);
+	for (bool first = true;; first = false) {
+		if (size - pos < 12) {
+			return false;
+		}
+		size_t chunkLength = readBigEndian32(data + pos);
+		uint32_t type = readBigEndian32(data + pos + 4);
+		if (chunkLength > size - pos - 12) {
+			return false;
+		}
+		const unsigned char* chunk = data + pos + 8;
+		pos += 12 + chunkLength; // CRCs are not checked, as stb_image does not
+
+		if (first != (type == chunkType("IHDR"))) {
+			return false;
+		}
+		if (type == chunkType("IHDR")) {
+			if (chunkLength != 13) {
+				return false;
+			}
+			uint32_t w = readBigEndian32(chunk);
+			uint32_t h = readBigEndian32(chunk + 4);
+			int bitDepth = chunk[8];
+			int colourType = chunk[9];
+			if (w == 0 || h == 0 || w > kMaxDimension || h > kMaxDimension) {
+				return false;
+			}
+			// Compression, filter method and interlacing
+			if (bitDepth != 8 || chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) {
+				return false;
+			}
+			switch (colourType) {
+			case 0: channels = 1; break;
+			case 4: channels = 2; break;
+			case 2: channels = 3; break;
+			case 6: channels = 4; break;
+			default: return false; // Palette images are left to stb_image
+			}
+			width = (int)w;
+			height = (int)h;
+			if (GetBufferSize() > INT_MAX) {
+				return false;
+			}
+		}
+		else if (type == chunkType("IDAT")) {
+			imageData.push_back({ (size_t)(chunk - data), chunkLength });
+		}
+		else if (type == chunkType("IEND")) {
+			return !imageData.empty();
+		}
+		else if (!(type & 0x20000000) || type == chunkType("tRNS") || type == chunkType("CgBI")) {
+			// Critical chunks such as PLTE, transparency that stb_image turns
+			// into an alpha channel and Apple's variant are left to stb_image
+			return false;
+		}
+	}
+}
+
+bool PngDecoder::Decode(unsigned char* buffer) const {
+	if (imageData.empty()) {
+		return false;
+	}
+	VGS_TRACE_SCOPE("Decode PNG");
+
+	size_t stride = (size_t)width * channels;
+	bool inflated;
+	if (imageData.size() == 1) {
+		inflated = Inflate::Zlib(data + imageData[0].offset, imageData[0].length, buffer, GetBufferSize());
+	}
+	else {
+		std::vector<unsigned char> stream;
+		for (const Chunk& chunk : imageData) {
+			stream.insert(stream.end(), data + chunk.offset, data + chunk.offset + chunk.length);
+		}
+		inflated = Inflate::Zlib(stream.data(), stream.size(), buffer, GetBufferSize());
+	}
+	if (!inflated) {
+		return false;
+	}
+
+	// Row y moves down by y + 1 bytes as its filter byte and those of the
+	// rows above drop out, which the kernels allow
+	std::vector<unsigned char> zeros(stride, 0);
+	for (int y = 0; y < height; y++) {
+		const unsigned char* raw = buffer + (size_t)y * (stride + 1);
+		unsigned char* row = buffer + (size_t)y * stride;
+		const unsigned char* previous = y > 0 ? row - stride : zeros.data();
+		if (!PixelKernels::UnfilterPngRow(raw[0], channels, raw + 1, previous, row, stride)) {
+			return false;
+		}
+	}
+	return true;
+}
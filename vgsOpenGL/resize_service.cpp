@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "resize_service.h"
+#include "trace.h"
+
+namespace ResizeService
+{
+	// Input plus output pixels from which a resize is split over the pool
+	static const uint64_t kSplitMinPixels = 4u * 1024u * 1024u;
+	// Idle sampler sets kept for later jobs of the same geometry
+	static const size_t kMaxCachedSamplers = 4;
+
+	// The indices of one ParallelFor() call. It lives on the caller's stack;
+	// the caller returns only after every index has finished.
+	struct Batch {
+		const std::function<void(int)>* task = nullptr;
+		int count = 0;
+		int next = 0;       // Next index to hand out
+		int finished = 0;
+	};
+
+	struct SamplerKey {
+		int width = 0;
+		int height = 0;
+		int newWidth = 0;
+		int newHeight = 0;
+		int channels = 0;
+		stbir_filter filter = STBIR_FILTER_DEFAULT;
+		int splits = 1;     // Asked of stbir, which may build fewer
+
+		bool operator==(const SamplerKey&) const = default;
+	};
+
+	struct Samplers {
+		SamplerKey key;
+		STBIR_RESIZE resize{};
+		int splits = 0;     // Built
+
+		Samplers() = default;
+		Samplers(const Samplers&) = delete;
+		Samplers& operator=(const Samplers&) = delete;
+		~Samplers() { stbir_free_samplers(&resize); }
+	};
+
+	// Guarded by g_mutex
+	static std::vector<std::thread> g_workers;
+	static std::mutex g_mutex;
+	static std::condition_variable g_wakeWorkers;
+	static std::condition_variable g_batchFinished;
+	static std::vector<Batch*> g_batches;       // Batches with indices left to hand out
+	static std::vector<std::unique_ptr<Samplers>> g_idleSamplers; // Least recently used first
+	static ResizeServiceStats g_stats;
+	static bool g_stopping = false;
+
+	// Hands out the next index of `batch`; the caller holds g_mutex
+	static int takeIndex(Batch& batch) {
+		int index = batch.next++;
+		if (batch.next == batch.count) {
+			g_batches.erase(std::find(g_batches.begin(), g_batches.end(), &batch));
+		}
+		return index;
+	}
+
+	// The caller holds g_mutex; `batch` may be gone once it is released
+	static void finishIndex(Batch& batch) {
+		if (++batch.finished == batch.count) {
+			g_batchFinished.notify_all();
+		}
+	}
+
+	static void workerMain(unsigned workerIndex) {
+		std::string threadName = "Resize " + std::to_string(workerIndex + 1);
+		Trace::SetThreadName(threadName.c_str());
+
+		std::unique_lock<std::mutex> lock(g_mutex);
+		for (;;) {
+			g_wakeWorkers.wait(lock, [] { return g_stopping || !g_batches.empty(); });
+			if (g_stopping) {
+				return; // Callers run the indices nobody took
+			}
+			Batch& batch = *g_batches.front();
+			int index = takeIndex(batch);
+			lock.unlock();
+			(*batch.task)(index);
+			lock.lock();
+			finishIndex(batch);
+		}
+	}
+
+	void Start(unsigned threadCount) {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		if (!g_workers.empty()) {
+			return;
+		}
+		g_stopping = false;
+		for (unsigned i = 0; i < threadCount; i++) {
+			g_workers.emplace_back(workerMain, i);
+		}
+	}
+
+	void Stop() {
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<Samplers>> samplers;
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			g_stopping = true;
+			workers.swap(g_workers);
+			samplers.swap(g_idleSamplers);
+		}
+		g_wakeWorkers.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	unsigned GetParallelism() {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		return (unsigned)g_workers.size() + 1;
+	}
+
+	void ParallelFor(int count, const std::function<void(int)>& task) {
+		std::unique_lock<std::mutex> lock(g_mutex);
+		if (count < 2 || g_workers.empty()) {
+			lock.unlock();
+			for (int i = 0; i < count; i++) {
+				task(i);
+			}
+			return;
+		}
+
+		Batch batch;
+		batch.task = &task;
+		batch.count = count;
+		g_batches.push_back(&batch);
+		g_wakeWorkers.notify_all();
+
+		// Only this batch's own indices, so another image's bands never hold
+		// up this caller
+		while (batch.next < batch.count) {
+			int index = takeIndex(batch);
+			lock.unlock();
+			task(index);
+			lock.lock();
+			finishIndex(batch);
+		}
+		g_batchFinished.wait(lock, [&batch] { return batch.finished == batch.count; });
+	}
+
+	static stbir_pixel_layout layoutOf(int channels) {
+		switch (channels) {
+		case 1: return STBIR_1CHANNEL;
+		case 2: return STBIR_RA;
+		case 3: return STBIR_RGB;
+		default: return STBIR_RGBA;
+		}
+	}
+
+	// A cached sampler set of `key`'s geometry, or new samplers
+	static std::unique_ptr<Samplers> takeSamplers(const SamplerKey& key) {
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			for (auto it = g_idleSamplers.end(); it != g_idleSamplers.begin();) {
+				--it;
+				if ((*it)->key == key) {
+					std::unique_ptr<Samplers> samplers = std::move(*it);
+					g_idleSamplers.erase(it);
+					g_stats.samplerReuses++;
+					return samplers;
+				}
+			}
+			g_stats.samplerBuilds++;
+		}
+
+		VGS_TRACE_SCOPE("Resize samplers");
+		auto samplers = std::make_unique<Samplers>();
+		samplers->key = key;
+		stbir_resize_init(&samplers->resize, nullptr, key.width, key.height, 0,
+			nullptr, key.newWidth, key.newHeight, 0, layoutOf(key.channels), STBIR_TYPE_UINT8_SRGB);
+		stbir_set_edgemodes(&samplers->resize, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP);
+		stbir_set_filters(&samplers->resize, key.filter, key.filter);
+		samplers->splits = stbir_build_samplers_with_splits(&samplers->resize, key.splits);
+		if (samplers->splits == 0) {
+			return nullptr;
+		}
+		return samplers;
+	}
+
+	static void returnSamplers(std::unique_ptr<Samplers> samplers) {
+		std::unique_ptr<Samplers> evicted; // Freed outside the lock
+		std::lock_guard<std::mutex> lock(g_mutex);
+		g_idleSamplers.push_back(std::move(samplers));
+		if (g_idleSamplers.size() > kMaxCachedSamplers) {
+			evicted = std::move(g_idleSamplers.front());
+			g_idleSamplers.erase(g_idleSamplers.begin());
+		}
+	}
+
+	bool Resize(const unsigned char* src, int width, int height, int channels,
+		unsigned char* dst, int newWidth, int newHeight, stbir_filter filter) {
+		SamplerKey key{ width, height, newWidth, newHeight, channels, filter, 1 };
+		uint64_t pixels = (uint64_t)width * height + (uint64_t)newWidth * newHeight;
+		if (pixels >= kSplitMinPixels) {
+			key.splits = (int)GetParallelism();
+		}
+
+		std::unique_ptr<Samplers> samplers = takeSamplers(key);
+		if (!samplers) {
+			return false;
+		}
+		stbir_set_buffer_ptrs(&samplers->resize, src, 0, dst, 0);
+
+		bool ok;
+		if (samplers->splits > 1) {
+			std::atomic<bool> failed{ false };
+			ParallelFor(samplers->splits, [&samplers, &failed](int split) {
+				VGS_TRACE_SCOPE("Resize split");
+				if (!stbir_resize_extended_split(&samplers->resize, split, 1)) {
+					failed.store(true, std::memory_order_relaxed);
+				}
+			});
+			ok = !failed.load(std::memory_order_relaxed);
+		}
+		else {
+			ok = stbir_resize_extended(&samplers->resize) != 0;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g_mutex);
+			if (samplers->splits > 1) {
+				g_stats.splitJobs++;
+			}
+			else {
+				g_stats.inlineJobs++;
+			}
+		}
+		returnSamplers(std::move(samplers));
+		return ok;
+	}
+
+	ResizeServiceStats GetStats() {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		return g_stats;
+	}
+}
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "texture.h"
+#include "gl_stats.h"
+#include "perf_stats.h"
+#include "pixel_kernels.h"
+#include "thumbnail.h"
+#include "trace.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+size_t g_texturePoolBudgetBytes = 128u * 1024u * 1024u;
+
+namespace
+{
+	// Textures are only interchangeable when their level 0 matches exactly
+	struct TextureShape {
+		int width = 0;
+		int height = 0;
+		GLenum format = 0;
+
+		bool operator==(const TextureShape& other) const {
+			return width == other.width && height == other.height && format == other.format;
+		}
+	};
+
+	struct TextureShapeHash {
+		size_t operator()(const TextureShape& shape) const {
+			return ((size_t)shape.width * 73856093u) ^ ((size_t)shape.height * 19349663u) ^ ((size_t)shape.format * 83492791u);
+		}
+	};
+}
+
+// Guarded by g_textureMutex: written by any thread that drops a handle
+static std::mutex g_textureMutex;
+static std::vector<GLuint> g_pendingRelease;
+static std::unordered_map<GLuint, TextureShape> g_liveTextures;
+
+// GL thread only
+static std::unordered_map<TextureShape, std::vector<GLuint>, TextureShapeHash> g_texturePool;
+static std::vector<GLuint> g_releaseScratch;
+static std::vector<GLuint> g_deleteBatch;
+static std::vector<unsigned char> g_expandScratch;
+static TextureStats g_textureStats;
+
+// Shape of textures filled level by level: their level range is changed
+// while they are in use, so they never go back into the pool
+static const GLenum kUnpooledFormat = 0;
+
+static size_t bytesPerPixel(GLenum format) {
+	return format == GL_RED ? 1 : 4;
+}
+
+static size_t storageBytes(const TextureShape& shape) {
+	// Level 0 plus a full mip chain
+	return (size_t)shape.width * shape.height * bytesPerPixel(shape.format) * 4 / 3;
+}
+
+void releaseTextureName(GLuint textureID) {
+	std::lock_guard<std::mutex> lock(g_textureMutex);
+	g_pendingRelease.push_back(textureID);
+}
+
+// Drivers keep RGB8 textures as RGBA8 and convert RGB uploads texel by
+// texel on the calling thread, which costs far more than the copy itself, so
+// RGB pixels are stored as RGBA and expanded here before the upload
+static GLenum formatFor(int channels) {
+	return channels == 1 ? GL_RED : GL_RGBA;
+}
+
+static GLenum sizedFormat(GLenum format) {
+	return format == GL_RED ? GL_R8 : GL_RGBA8;
+}
+
+// `count` pixels of `channels` as the format formatFor() uploads them. RGB is
+// expanded into a scratch buffer that stays valid until the next call.
+static const unsigned char* uploadPixels(const unsigned char* pixels, size_t count, int channels) {
+	if (channels != 3) {
+		return pixels;
+	}
+	g_expandScratch.resize(count * 4);
+	PixelKernels::Convert(PixelFormat::RGB, PixelFormat::RGBA, pixels, g_expandScratch.data(), count);
+	return g_expandScratch.data();
+}
+
+// Storage for `levels` mip levels of the bound texture: immutable storage
+// where glTexStorage2D exists (GL 4.2), one empty glTexImage2D per level
+// otherwise
+static void allocateStorage(GLenum format, int width, int height, int levels) {
+	if (glTexStorage2D) {
+		glTexStorage2D(GL_TEXTURE_2D, levels, sizedFormat(format), width, height);
+		GLStats::CountCall(GLSource::App, GLCallKind::TextureUpload);
+		return;
+	}
+	for (int level = 0; level < levels; level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, sizedFormat(format), std::max(1, width >> level), std::max(1, height >> level), 0, format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	GLStats::CountCalls(GLSource::App, GLCallKind::TextureUpload, levels);
+}
+
+// Grey textures sample as (r, r, r, 1) so they draw like the RGB they stand for
+static void setGreySwizzle(GLenum format) {
+	if (format != GL_RED) {
+		return;
+	}
+	const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+}
+
+// Rows of grey levels are tightly packed and need not start on the 4-byte
+// boundary GL assumes by default
+static void setUnpackAlignment(int channels) {
+	if (channels == 1) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+	}
+}
+
+static void resetUnpackAlignment(int channels) {
+	if (channels == 1) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		GLStats::CountCall(GLSource::App, GLCallKind::StateChange);
+	}
+}
+
+TextureHandle generateTexture(const unsigned char* pixels, int width, int height, int channels, int levels) {
+	if (!pixels || width <= 0 || height <= 0 || channels <= 0 || levels <= 0) {
+		std::cerr << "Invalid pixel data for texture creation." << std::endl;
+		return TextureHandle();
+	}
+
+	VGS_TRACE_SCOPE("generateTexture");
+	VGS_PERF_SCOPE(PerfStage::Upload);
+	int storageLevels = mipLevelCount(width, height);
+	levels = std::min(levels, storageLevels);
+
+	GLenum format = formatFor(channels);
+	TextureShape shape{ width, height, format };
+
+	// Reuse pooled storage of the same shape instead of allocating new storage
+	GLuint textureID = 0;
+	auto pooled = g_texturePool.find(shape);
+	if (pooled != g_texturePool.end() && !pooled->second.empty()) {
+		textureID = pooled->second.back();
+		pooled->second.pop_back();
+		g_textureStats.pooledCount--;
+		g_textureStats.pooledBytes -= storageBytes(shape);
+		g_textureStats.reused++;
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		GLStats::CountCall(GLSource::App, GLCallKind::BindTexture);
+	}
+	else {
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		g_textureStats.created++;
+
+		// Set texture wrapping and filtering options
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		setGreySwizzle(format);
+		allocateStorage(format, width, height, storageLevels);
+		GLStats::CountCall(GLSource::App, GLCallKind::Object);
+		GLStats::CountCall(GLSource::App, GLCallKind::BindTexture);
+		GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 4);
+	}
+	setUnpackAlignment(channels);
+
+	// The levels come from the CPU; the driver only builds the ones missing
+	const unsigned char* level = pixels;
+	uint64_t uploadBytes = 0;
+	for (int i = 0; i < levels; i++) {
+		int levelWidth = std::max(1, width >> i);
+		int levelHeight = std::max(1, height >> i);
+		size_t levelPixels = (size_t)levelWidth * levelHeight;
+		uint64_t levelBytes = (uint64_t)levelPixels * bytesPerPixel(format);
+		glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, levelWidth, levelHeight, format, GL_UNSIGNED_BYTE, uploadPixels(level, levelPixels, channels));
+		GLStats::CountCall(GLSource::App, GLCallKind::TextureUpload, levelBytes);
+		level += levelPixels * channels;
+		uploadBytes += levelBytes;
+	}
+	Perf::AddUploadBytes(uploadBytes);
+	resetUnpackAlignment(channels);
+	if (levels < storageLevels) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+		GLStats::CountCall(GLSource::App, GLCallKind::Mipmap);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0); // Unbind texture
+	GLStats::CountCall(GLSource::App, GLCallKind::BindTexture);
+
+	{
+		std::lock_guard<std::mutex> lock(g_textureMutex);
+		g_liveTextures[textureID] = shape;
+	}
+	return TextureHandle(textureID);
+}
+
+TextureHandle allocateTexture(int width, int height, int channels, int levels) {
+	if (width <= 0 || height <= 0 || channels <= 0 || levels <= 0) {
+		std::cerr << "Invalid size for texture allocation." << std::endl;
+		return TextureHandle();
+	}
+
+	VGS_TRACE_SCOPE("allocateTexture");
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	g_textureStats.created++;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	setGreySwizzle(formatFor(channels));
+	allocateStorage(formatFor(channels), width, height, levels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStats::CountCall(GLSource::App, GLCallKind::Object);
+	GLStats::CountCalls(GLSource::App, GLCallKind::BindTexture, 2);
+	GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 6);
+
+	{
+		std::lock_guard<std::mutex> lock(g_textureMutex);
+		g_liveTextures[textureID] = TextureShape{ width, height, kUnpooledFormat };
+	}
+	return TextureHandle(textureID);
+}
+
+void uploadTextureRows(GLuint textureID, int level, int levelWidth, int channels, int firstRow, int rowCount, const unsigned char* pixels) {
+	VGS_PERF_SCOPE(PerfStage::Upload);
+	GLenum format = formatFor(channels);
+	size_t count = (size_t)levelWidth * rowCount;
+	uint64_t bytes = (uint64_t)count * bytesPerPixel(format);
+	Perf::AddUploadBytes(bytes);
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	setUnpackAlignment(channels);
+	glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, levelWidth, rowCount, format, GL_UNSIGNED_BYTE, uploadPixels(pixels, count, channels));
+	resetUnpackAlignment(channels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStats::CountCalls(GLSource::App, GLCallKind::BindTexture, 2);
+	GLStats::CountCall(GLSource::App, GLCallKind::TextureUpload, bytes);
+}
+
+void setTextureLevels(GLuint textureID, int baseLevel, int maxLevel) {
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStats::CountCalls(GLSource::App, GLCallKind::BindTexture, 2);
+	GLStats::CountCalls(GLSource::App, GLCallKind::StateChange, 2);
+}
+
+void FlushTextureDeletions() {
+	VGS_TRACE_SCOPE("FlushTextureDeletions");
+	g_releaseScratch.clear();
+	g_deleteBatch.clear();
+	{
+		std::lock_guard<std::mutex> lock(g_textureMutex);
+		if (g_pendingRelease.empty()) {
+			return;
+		}
+		g_releaseScratch.swap(g_pendingRelease);
+
+		for (GLuint textureID : g_releaseScratch) {
+			auto live = g_liveTextures.find(textureID);
+			if (live == g_liveTextures.end()) {
+				g_deleteBatch.push_back(textureID);
+				continue;
+			}
+			TextureShape shape = live->second;
+			g_liveTextures.erase(live);
+
+			// Keep the storage for the next texture of the same shape while the
+			// pool has room, otherwise give it back to the driver
+			size_t bytes = storageBytes(shape);
+			if (shape.format != kUnpooledFormat && g_textureStats.pooledBytes + bytes <= g_texturePoolBudgetBytes) {
+				g_texturePool[shape].push_back(textureID);
+				g_textureStats.pooledCount++;
+				g_textureStats.pooledBytes += bytes;
+			}
+			else {
+				g_deleteBatch.push_back(textureID);
+			}
+		}
+	}
+
+	if (!g_deleteBatch.empty()) {
+		glDeleteTextures((GLsizei)g_deleteBatch.size(), g_deleteBatch.data());
+		GLStats::CountCall(GLSource::App, GLCallKind::Object);
+		g_textureStats.deleted += g_deleteBatch.size();
+		g_textureStats.deleteBatches++;
+	}
+}
+
+void ShutdownTextures() {
+	std::vector<GLuint> names;
+	{
+		std::lock_guard<std::mutex> lock(g_textureMutex);
+		// Pending names are still in g_liveTextures until they are flushed
+		g_pendingRelease.clear();
+		for (auto& live : g_liveTextures) {
+			names.push_back(live.first);
+		}
+		g_liveTextures.clear();
+	}
+	for (auto& pooled : g_texturePool) {
+		names.insert(names.end(), pooled.second.begin(), pooled.second.end());
+	}
+	g_texturePool.clear();
+	g_textureStats.pooledCount = 0;
+	g_textureStats.pooledBytes = 0;
+
+	if (!names.empty()) {
+		glDeleteTextures((GLsizei)names.size(), names.data());
+		g_textureStats.deleted += names.size();
+		g_textureStats.deleteBatches++;
+	}
+}
+
+TextureStats GetTextureStats() {
+	TextureStats stats = g_textureStats;
+	std::lock_guard<std::mutex> lock(g_textureMutex);
+	stats.liveCount = g_liveTextures.size();
+	return stats;
+}
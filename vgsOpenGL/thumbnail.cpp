@@ -0,0 +1,389 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+
+#include "thumbnail.h"
+#include "image_codec.h"
+#include "perf_stats.h"
+#include "pixel_kernels.h"
+#include "resize_service.h"
+#include "trace.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize2.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+static bool readFile(const char* path, std::vector<unsigned char>& out) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+	std::streamsize size = file.tellg();
+	if (size <= 0) {
+		return false;
+	}
+	out.resize((size_t)size);
+	file.seekg(0, std::ios::beg);
+	return (bool)file.read((char*)out.data(), size);
+}
+
+static bool writeFile(const char* path, const unsigned char* data, size_t size) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+	return (bool)file.write((const char*)data, (std::streamsize)size);
+}
+
+// Drops the alpha of opaque RGBA pixels in place; returns the new channel count
+static int dropOpaqueAlpha(unsigned char* pixels, int width, int height, int channels) {
+	size_t count = (size_t)width * height;
+	if (channels != 4 || !PixelKernels::IsOpaque(pixels, count)) {
+		return channels;
+	}
+	PixelKernels::Convert(PixelFormat::RGBA, PixelFormat::RGB, pixels, pixels, count);
+	return 3;
+}
+
+// Copies decoded pixels into `out` with the channels they are uploaded with:
+// grey and RGB stay as decoded, opaque RGBA loses its alpha and grey with
+// alpha, which has no GL format of its own here, becomes RGBA.
+static void takeNativePixels(unsigned char* pixels, int width, int height, int channels, ThumbnailPixels& out) {
+	size_t count = (size_t)width * height;
+	out.width = width;
+	out.height = height;
+	out.levels = 1;
+	if (channels == 2) {
+		out.channels = 4;
+		out.pixels.resize(count * 4);
+		PixelKernels::Convert(PixelFormat::GreyAlpha, PixelFormat::RGBA, pixels, out.pixels.data(), count);
+		return;
+	}
+	out.channels = dropOpaqueAlpha(pixels, width, height, channels);
+	out.pixels.assign(pixels, pixels + count * out.channels);
+}
+
+bool generateThumbnails(const char* inputImagePath, const char* outputImagePath, int newWidth, int newHeight) {
+	VGS_TRACE_SCOPE("generateThumbnails");
+	ResizeQuality quality = getResizeQuality();
+	DecodedImage image;
+	bool decoded;
+	{
+		VGS_PERF_SCOPE(PerfStage::Decode);
+		std::vector<unsigned char> fileData;
+		decoded = readFile(inputImagePath, fileData);
+		if (decoded && quality != ResizeQuality::High) {
+			// A codec that scales in the DCT can stop at the size the box
+			// pre-decimation of resizePixels() would have reduced to anyway
+			decoded = ImageCodecs::DecodeScaled(fileData.data(), fileData.size(), newWidth * 2, newHeight * 2, image);
+		}
+		else if (decoded) {
+			decoded = ImageCodecs::Decode(fileData.data(), fileData.size(), image);
+		}
+	}
+
+	if (!decoded) {
+		std::cerr << "Error: Could not load image " << inputImagePath << std::endl;
+		return false;
+	}
+
+	// The thumbnail keeps the channels the content needs: an opaque RGBA
+	// source is resized and stored as RGB
+	int outputChannels = dropOpaqueAlpha(image.pixels.get(), image.width, image.height, image.channels);
+	std::vector<unsigned char> resizedImageData((size_t)newWidth * newHeight * outputChannels);
+
+	bool resized;
+	{
+		VGS_PERF_SCOPE(PerfStage::Resize);
+		resized = resizePixels(image.pixels.get(), image.width, image.height, outputChannels,
+			resizedImageData.data(), newWidth, newHeight, quality);
+	}
+
+	image.pixels.reset(); // Free the original image data
+
+	if (!resized) { // Check if resizing failed
+		std::cerr << "Error: Failed to resize image for thumbnail." << std::endl;
+		return false;
+	}
+
+	// Encode the resized image as PNG, then save it
+	int pngSize = 0;
+	unsigned char* png;
+	{
+		VGS_PERF_SCOPE(PerfStage::Encode);
+		png = stbi_write_png_to_mem(resizedImageData.data(), newWidth * outputChannels, newWidth, newHeight, outputChannels, &pngSize);
+	}
+
+	bool saved = false;
+	if (png) {
+		VGS_PERF_SCOPE(PerfStage::CacheIO);
+		saved = writeFile(outputImagePath, png, (size_t)pngSize);
+		STBIW_FREE(png);
+	}
+
+	if (!saved) {
+		std::cerr << "Error: Could not save resized thumbnail to " << outputImagePath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadThumbnailPixels(const char* thumbnailPath, ThumbnailPixels& out) {
+	VGS_TRACE_SCOPE("loadThumbnailPixels");
+	std::vector<unsigned char> fileData;
+	bool read;
+	{
+		VGS_PERF_SCOPE(PerfStage::CacheIO);
+		read = readFile(thumbnailPath, fileData);
+	}
+
+	DecodedImage image;
+	bool decoded = false;
+	if (read) {
+		VGS_PERF_SCOPE(PerfStage::Decode);
+		decoded = ImageCodecs::Decode(fileData.data(), fileData.size(), image);
+	}
+	if (!decoded) {
+		std::cerr << "Error loading thumbnail for display: " << thumbnailPath << std::endl;
+		return false;
+	}
+
+	takeNativePixels(image.pixels.get(), image.width, image.height, image.channels, out);
+	return true;
+}
+
+// A `width` x `height` downscale of pixels takeNativePixels() gave
+static void previewPixels(const ThumbnailPixels& source, int width, int height, ThumbnailPixels& preview) {
+	VGS_PERF_SCOPE(PerfStage::Resize);
+	preview.width = width;
+	preview.height = height;
+	preview.channels = source.channels;
+	preview.levels = 1;
+	preview.pixels.resize((size_t)width * height * source.channels);
+	resizePixels(source.pixels.data(), source.width, source.height, source.channels,
+		preview.pixels.data(), width, height, ResizeQuality::Fast);
+}
+
+bool loadImagePixels(const char* imagePath, ThumbnailPixels& out,
+	int previewWidth, int previewHeight, const std::function<void(ThumbnailPixels&&)>& onPreview) {
+	VGS_TRACE_SCOPE("loadImagePixels");
+	std::vector<unsigned char> fileData;
+	DecodedImage image;
+	bool decoded = false;
+	bool previewed = false;
+	if (readFile(imagePath, fileData)) {
+		const unsigned char* data = fileData.data();
+		size_t size = fileData.size();
+		if (onPreview) {
+			// A codec that scales in the DCT gives the preview ahead of the
+			// full decode; any other decodes the full image right away
+			ImageInfo info;
+			{
+				VGS_PERF_SCOPE(PerfStage::Decode);
+				decoded = ImageCodecs::Info(data, size, info) && ImageCodecs::DecodeScaled(data, size, previewWidth, previewHeight, image);
+			}
+			if (decoded && image.width < info.width) {
+				ThumbnailPixels scaled, preview;
+				takeNativePixels(image.pixels.get(), image.width, image.height, image.channels, scaled);
+				previewPixels(scaled, previewWidth, previewHeight, preview);
+				onPreview(std::move(preview));
+				previewed = true;
+				VGS_PERF_SCOPE(PerfStage::Decode);
+				decoded = ImageCodecs::Decode(data, size, image);
+			}
+		}
+		else {
+			VGS_PERF_SCOPE(PerfStage::Decode);
+			decoded = ImageCodecs::Decode(data, size, image);
+		}
+	}
+	if (!decoded) {
+		std::cerr << "Error: Could not load image " << imagePath << std::endl;
+		return false;
+	}
+
+	takeNativePixels(image.pixels.get(), image.width, image.height, image.channels, out);
+	if (onPreview && !previewed) {
+		ThumbnailPixels preview;
+		previewPixels(out, previewWidth, previewHeight, preview);
+		onPreview(std::move(preview));
+	}
+	return true;
+}
+
+// The next mip level of a `width` x `height` level. Colour is averaged in
+// linear light; RGBA is averaged premultiplied, so the colour of transparent
+// pixels does not bleed into their neighbours. `scratch` holds the
+// premultiplied copy.
+static void halveLevel(const unsigned char* src, int width, int height, int channels, unsigned char* dst, std::vector<unsigned char>& scratch) {
+	PixelFormat format = PixelFormatOf(channels);
+	if (format != PixelFormat::RGBA) {
+		PixelKernels::BoxHalveLinear(format, src, width, height, dst);
+		return;
+	}
+	size_t count = (size_t)width * height;
+	scratch.assign(src, src + count * 4);
+	PixelKernels::Premultiply(scratch.data(), count);
+	PixelKernels::BoxHalve(format, scratch.data(), width, height, dst);
+	PixelKernels::Unpremultiply(dst, (size_t)std::max(1, width / 2) * std::max(1, height / 2));
+}
+
+// Source pixels from which a reduction is split into bands of rows
+static const uint64_t kBandMinPixels = 4u * 1024u * 1024u;
+
+// Calls `reduce(y0, y1)` for bands of output rows that together cover
+// [0, outHeight), on the resize pool when the source is large. Each output
+// row only reads its own source rows, so the bands match one whole call.
+static void reduceInBands(uint64_t sourcePixels, int outHeight, const std::function<void(int, int)>& reduce) {
+	int bands = 1;
+	if (sourcePixels >= kBandMinPixels) {
+		bands = std::min(outHeight, (int)ResizeService::GetParallelism());
+	}
+	if (bands <= 1) {
+		reduce(0, outHeight);
+		return;
+	}
+	ResizeService::ParallelFor(bands, [&](int band) {
+		VGS_TRACE_SCOPE("Reduce band");
+		reduce(band * outHeight / bands, (band + 1) * outHeight / bands);
+	});
+}
+
+int mipLevelCount(int width, int height) {
+	int levels = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2) {
+		levels++;
+	}
+	return levels;
+}
+
+size_t mipChainBytes(int width, int height, int channels, int levels) {
+	size_t bytes = 0;
+	for (int level = 0; level < levels; level++) {
+		bytes += (size_t)std::max(1, width >> level) * std::max(1, height >> level) * channels;
+	}
+	return bytes;
+}
+
+void buildMipChain(ThumbnailPixels& thumbnail) {
+	int levels = mipLevelCount(thumbnail.width, thumbnail.height);
+	if (thumbnail.levels >= levels || thumbnail.pixels.empty()) {
+		return;
+	}
+	VGS_TRACE_SCOPE("buildMipChain");
+	VGS_PERF_SCOPE(PerfStage::Resize);
+	thumbnail.pixels.resize(mipChainBytes(thumbnail.width, thumbnail.height, thumbnail.channels, levels));
+	std::vector<unsigned char> scratch;
+	unsigned char* level = thumbnail.pixels.data();
+	for (int i = 0; i + 1 < levels; i++) {
+		int width = std::max(1, thumbnail.width >> i);
+		int height = std::max(1, thumbnail.height >> i);
+		unsigned char* next = level + (size_t)width * height * thumbnail.channels;
+		halveLevel(level, width, height, thumbnail.channels, next, scratch);
+		level = next;
+	}
+	thumbnail.levels = levels;
+}
+
+void downsampleHalf(const ThumbnailPixels& in, ThumbnailPixels& out) {
+	VGS_PERF_SCOPE(PerfStage::Resize);
+	out.width = std::max(1, in.width / 2);
+	out.height = std::max(1, in.height / 2);
+	out.channels = in.channels;
+	out.levels = 1;
+	out.pixels.resize((size_t)out.width * out.height * out.channels);
+	size_t inRow = (size_t)in.width * in.channels;
+	size_t outRow = (size_t)out.width * out.channels;
+	reduceInBands((uint64_t)in.width * in.height, out.height, [&](int y0, int y1) {
+		// The last band takes the odd source row the whole level would drop
+		int rows = y1 == out.height ? in.height - 2 * y0 : 2 * (y1 - y0);
+		std::vector<unsigned char> scratch;
+		halveLevel(in.pixels.data() + 2 * y0 * inRow, in.width, rows, in.channels, out.pixels.data() + y0 * outRow, scratch);
+	});
+}
+
+static std::atomic<ResizeQuality> g_resizeQuality{ ResizeQuality::Balanced };
+
+const char* resizeQualityName(ResizeQuality quality) {
+	switch (quality) {
+	case ResizeQuality::Fast: return "Fast";
+	case ResizeQuality::Balanced: return "Balanced";
+	case ResizeQuality::High: return "High";
+	default: return "?";
+	}
+}
+
+bool parseResizeQuality(const char* name, ResizeQuality& quality) {
+	if (std::strcmp(name, "fast") == 0) {
+		quality = ResizeQuality::Fast;
+	}
+	else if (std::strcmp(name, "balanced") == 0) {
+		quality = ResizeQuality::Balanced;
+	}
+	else if (std::strcmp(name, "high") == 0) {
+		quality = ResizeQuality::High;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void setResizeQuality(ResizeQuality quality) {
+	g_resizeQuality.store(quality, std::memory_order_relaxed);
+}
+
+ResizeQuality getResizeQuality() {
+	return g_resizeQuality.load(std::memory_order_relaxed);
+}
+
+bool resizePixels(const unsigned char* src, int width, int height, int channels,
+	unsigned char* dst, int newWidth, int newHeight, ResizeQuality quality) {
+	// Box pre-decimation by the largest power of two that leaves at least
+	// twice the thumbnail size. Grey with alpha has no premultiplied box
+	// kernel and goes to stbir whole.
+	int factor = 1;
+	if (quality != ResizeQuality::High && channels != 2) {
+		while (width / (factor * 2) >= newWidth * 2 && height / (factor * 2) >= newHeight * 2) {
+			factor *= 2;
+		}
+	}
+	const unsigned char* level = src;
+	std::vector<unsigned char> decimated;
+	if (factor > 1) {
+		PixelFormat format = PixelFormatOf(channels);
+		int decimatedWidth = width / factor;
+		int decimatedHeight = height / factor;
+		decimated.resize((size_t)decimatedWidth * decimatedHeight * channels);
+		size_t srcRow = (size_t)width * channels;
+		size_t decimatedRow = (size_t)decimatedWidth * channels;
+		reduceInBands((uint64_t)width * height, decimatedHeight, [&](int y0, int y1) {
+			const unsigned char* bandSrc = src + (size_t)y0 * factor * srcRow;
+			unsigned char* bandDst = decimated.data() + y0 * decimatedRow;
+			int rows = y1 == decimatedHeight ? height - y0 * factor : (y1 - y0) * factor;
+			if (quality == ResizeQuality::Fast) {
+				PixelKernels::BoxDecimate(format, bandSrc, width, rows, factor, bandDst);
+			}
+			else {
+				PixelKernels::BoxDecimateLinear(format, bandSrc, width, rows, factor, bandDst);
+			}
+		});
+		level = decimated.data();
+		width = decimatedWidth;
+		height = decimatedHeight;
+	}
+
+	stbir_filter filter = quality == ResizeQuality::Fast ? STBIR_FILTER_TRIANGLE : STBIR_FILTER_DEFAULT;
+	return ResizeService::Resize(level, width, height, channels, dst, newWidth, newHeight, filter);
+}
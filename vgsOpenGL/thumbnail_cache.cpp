@@ -0,0 +1,97 @@
+#include <iostream>
+
+#include "thumbnail_cache.h"
+#include "lz4_block.h"
+#include "perf_stats.h"
+
+bool compressThumbnail(const ThumbnailPixels& thumbnail, std::vector<unsigned char>& out) {
+	if (thumbnail.pixels.empty()) {
+		return false;
+	}
+	VGS_PERF_SCOPE(PerfStage::CacheIO);
+	out.resize(LZ4Block::CompressBound(thumbnail.pixels.size()));
+	size_t compressedSize = LZ4Block::Compress(thumbnail.pixels.data(), thumbnail.pixels.size(), out.data(), out.size());
+	if (compressedSize == 0) {
+		out.clear();
+		return false;
+	}
+	out.resize(compressedSize);
+	out.shrink_to_fit();
+	return true;
+}
+
+void RamThumbnailCache::SetBudget(size_t bytes) {
+	budgetBytes = bytes;
+	EvictToBudget();
+}
+
+void RamThumbnailCache::Insert(uint32_t key, std::vector<unsigned char>&& compressed, int width, int height, int channels, int levels) {
+	auto it = entries.find(key);
+	if (it != entries.end()) {
+		usedBytes -= it->second.compressed.size();
+		lru.erase(it->second.lruPosition);
+		entries.erase(it);
+	}
+
+	// An entry larger than the whole budget would just evict everything else
+	if (compressed.size() > budgetBytes) {
+		return;
+	}
+
+	lru.push_front(key);
+	Entry& entry = entries[key];
+	entry.compressed = std::move(compressed);
+	entry.width = width;
+	entry.height = height;
+	entry.channels = channels;
+	entry.levels = levels;
+	entry.lruPosition = lru.begin();
+	usedBytes += entry.compressed.size();
+
+	EvictToBudget();
+}
+
+bool RamThumbnailCache::Contains(uint32_t key) const {
+	return entries.find(key) != entries.end();
+}
+
+bool RamThumbnailCache::Fetch(uint32_t key, ThumbnailPixels& out) {
+	auto it = entries.find(key);
+	if (it == entries.end()) {
+		return false;
+	}
+
+	VGS_PERF_SCOPE(PerfStage::CacheIO);
+	Entry& entry = it->second;
+	out.width = entry.width;
+	out.height = entry.height;
+	out.channels = entry.channels;
+	out.levels = entry.levels;
+	out.pixels.resize(mipChainBytes(entry.width, entry.height, entry.channels, entry.levels));
+	if (!LZ4Block::Decompress(entry.compressed.data(), entry.compressed.size(), out.pixels.data(), out.pixels.size())) {
+		std::cerr << "Error: Corrupt RAM cache entry for thumbnail " << key << std::endl;
+		usedBytes -= entry.compressed.size();
+		lru.erase(entry.lruPosition);
+		entries.erase(it);
+		return false;
+	}
+
+	lru.splice(lru.begin(), lru, entry.lruPosition);
+	return true;
+}
+
+void RamThumbnailCache::Clear() {
+	entries.clear();
+	lru.clear();
+	usedBytes = 0;
+}
+
+void RamThumbnailCache::EvictToBudget() {
+	while (usedBytes > budgetBytes && !lru.empty()) {
+		uint32_t key = lru.back();
+		lru.pop_back();
+		auto it = entries.find(key);
+		usedBytes -= it->second.compressed.size();
+		entries.erase(it);
+	}
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#include "thumbnail_loader.h"
+#include "thumbnail_cache.h"
+#include "trace.h"
+
+ThumbnailLoader::~ThumbnailLoader() {
+	Stop();
+}
+
+void ThumbnailLoader::Start(unsigned threadCount) {
+	if (!workers.empty()) {
+		return;
+	}
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+
+	stopping = false;
+	for (unsigned i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThumbnailLoader::WorkerMain, this, i);
+	}
+}
+
+void ThumbnailLoader::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		pending.clear();
+	}
+	wakeWorkers.notify_all();
+	becameIdle.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	completed.clear();
+}
+
+void ThumbnailLoader::Request(ThumbnailLoadRequest&& request) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		request.sequence = nextSequence++;
+		pending.push_back(std::move(request));
+	}
+	wakeWorkers.notify_one();
+}
+
+void ThumbnailLoader::CancelPending() {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.clear();
+	completed.clear();
+	if (activeJobs == 0) {
+		becameIdle.notify_all();
+	}
+}
+
+size_t ThumbnailLoader::PollResults(std::vector<ThumbnailLoadResult>& out, size_t maxResults) {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t count = std::min(maxResults, completed.size());
+	for (size_t i = 0; i < count; i++) {
+		out.push_back(std::move(completed[i]));
+	}
+	completed.erase(completed.begin(), completed.begin() + count);
+	return count;
+}
+
+size_t ThumbnailLoader::GetPendingCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending.size();
+}
+
+size_t ThumbnailLoader::GetCompletedCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return completed.size();
+}
+
+void ThumbnailLoader::Drain() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (workers.empty()) {
+		paused = true; // Workers started later must not race the next frame either
+		return;
+	}
+	size_t firstNew = completed.size();
+	paused = false;
+	wakeWorkers.notify_all();
+	becameIdle.wait(lock, [this] { return stopping || (pending.empty() && activeJobs == 0); });
+	paused = true;
+
+	// A single worker serves the newest request first
+	std::sort(completed.begin() + std::min(firstNew, completed.size()), completed.end(),
+		[](const ThumbnailLoadResult& a, const ThumbnailLoadResult& b) { return a.sequence > b.sequence; });
+}
+
+void ThumbnailLoader::WorkerMain(unsigned workerIndex) {
+	std::string threadName = "Loader " + std::to_string(workerIndex + 1);
+	Trace::SetThreadName(threadName.c_str());
+
+	for (;;) {
+		ThumbnailLoadRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeWorkers.wait(lock, [this] { return stopping || (!paused && !pending.empty()); });
+			if (stopping) {
+				return;
+			}
+			request = std::move(pending.back());
+			pending.pop_back();
+			activeJobs++;
+		}
+
+		ThumbnailLoadResult result;
+		{
+			VGS_TRACE_SCOPE("Thumbnail load");
+			result = Execute(request);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeJobs--;
+			if (stopping) {
+				return;
+			}
+			completed.push_back(std::move(result));
+			if (pending.empty() && activeJobs == 0) {
+				becameIdle.notify_all();
+			}
+		}
+		if (onResultReady) {
+			onResultReady();
+		}
+	}
+}
+
+ThumbnailLoadResult ThumbnailLoader::Execute(const ThumbnailLoadRequest& request) {
+	ThumbnailLoadResult result;
+	result.index = request.index;
+	result.generation = request.generation;
+	result.sequence = request.sequence;
+	result.large = request.large;
+
+	// Check if thumbnail already exists, otherwise generate it
+	if (!std::filesystem::exists(request.thumbnailPath)) {
+		if (!generateThumbnails(request.filePath.c_str(), request.thumbnailPath.c_str(), request.thumbnailWidth, request.thumbnailHeight)) {
+			std::cerr << "Failed to generate thumbnail for " << request.filePath << std::endl;
+			return result;
+		}
+		result.generated = true;
+	}
+
+	if (!loadThumbnailPixels(request.thumbnailPath.c_str(), result.thumbnail)) {
+		return result;
+	}
+	// The chain is built here once; the RAM tier keeps it and uploads take it as is
+	buildMipChain(result.thumbnail);
+
+	if (!request.large) {
+		compressThumbnail(result.thumbnail, result.compressed);
+	}
+	result.ok = true;
+	return result;
+}
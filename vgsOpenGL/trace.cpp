@@ -0,0 +1,174 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+namespace Trace
+{
+	std::atomic<bool> g_enabled{ false };
+	static std::string g_outputPath = "vgs_trace.json";
+
+	namespace
+	{
+		struct TraceEvent {
+			const char* name;
+			uint64_t startNs;
+			uint64_t endNs;
+		};
+
+		// One per thread, written only by its owner. `head` counts every event
+		// ever written; the ring keeps the most recent kCapacity of them.
+		struct ThreadBuffer {
+			static const uint64_t kCapacity = 1u << 14;
+
+			TraceEvent events[kCapacity];
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> clearedBefore{ 0 };
+			uint32_t threadId = 0;
+			std::string threadName;
+		};
+	}
+
+	static const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+	// Buffers are kept until exit so threads that already finished still show up
+	static std::mutex g_buffersMutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+	// The ring of a thread is made on its first zone, so threads that only
+	// name themselves while tracing is off cost no more than the name
+	static thread_local ThreadBuffer* t_buffer = nullptr;
+	static thread_local std::string t_threadName;
+
+	static ThreadBuffer* threadBuffer() {
+		if (!t_buffer) {
+			auto owned = std::make_unique<ThreadBuffer>();
+			t_buffer = owned.get();
+			std::lock_guard<std::mutex> lock(g_buffersMutex);
+			t_buffer->threadId = (uint32_t)g_buffers.size() + 1;
+			t_buffer->threadName = t_threadName.empty() ? "Thread " + std::to_string(t_buffer->threadId) : t_threadName;
+			g_buffers.push_back(std::move(owned));
+		}
+		return t_buffer;
+	}
+
+	void SetEnabled(bool enabled) {
+		g_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	void SetOutputPath(const std::string& path) {
+		g_outputPath = path;
+	}
+
+	const std::string& GetOutputPath() {
+		return g_outputPath;
+	}
+
+	void SetThreadName(const char* name) {
+		t_threadName = name;
+		if (t_buffer) {
+			std::lock_guard<std::mutex> lock(g_buffersMutex);
+			t_buffer->threadName = name;
+		}
+	}
+
+	uint64_t Now() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+	}
+
+	void RecordZone(const char* name, uint64_t startNs, uint64_t endNs) {
+		ThreadBuffer* buffer = threadBuffer();
+		uint64_t index = buffer->head.load(std::memory_order_relaxed);
+		buffer->events[index & (ThreadBuffer::kCapacity - 1)] = TraceEvent{ name, startNs, endNs };
+		buffer->head.store(index + 1, std::memory_order_release);
+	}
+
+	static void writeJsonString(FILE* file, const char* text) {
+		fputc('"', file);
+		for (const char* c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				fputc('\\', file);
+			}
+			if ((unsigned char)*c >= 0x20) {
+				fputc(*c, file);
+			}
+		}
+		fputc('"', file);
+	}
+
+	long long WriteChromeTrace(const std::string& path) {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			return -1;
+		}
+
+		long long written = 0;
+		fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+		std::lock_guard<std::mutex> lock(g_buffersMutex);
+		std::vector<TraceEvent> snapshot;
+		for (auto& buffer : g_buffers) {
+			if (written > 0) {
+				fputs(",\n", file);
+			}
+			fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", buffer->threadId);
+			writeJsonString(file, buffer->threadName.c_str());
+			fputs("}}", file);
+			written++;
+
+			// Copy the live part of the ring, then drop whatever the owner may
+			// have overwritten while we were copying
+			uint64_t head = buffer->head.load(std::memory_order_acquire);
+			uint64_t first = head > ThreadBuffer::kCapacity ? head - ThreadBuffer::kCapacity : 0;
+			first = std::max(first, buffer->clearedBefore.load(std::memory_order_relaxed));
+			snapshot.clear();
+			for (uint64_t i = first; i < head; i++) {
+				snapshot.push_back(buffer->events[i & (ThreadBuffer::kCapacity - 1)]);
+			}
+			uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+			// The owner may be writing event headAfter, in the slot of
+			// headAfter - kCapacity, right now
+			uint64_t firstValid = headAfter + 1 > ThreadBuffer::kCapacity ? headAfter + 1 - ThreadBuffer::kCapacity : 0;
+			size_t skip = firstValid > first ? (size_t)std::min<uint64_t>(firstValid - first, snapshot.size()) : 0;
+
+			for (size_t i = skip; i < snapshot.size(); i++) {
+				const TraceEvent& event = snapshot[i];
+				fputs(",\n{\"name\":", file);
+				writeJsonString(file, event.name);
+				fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					buffer->threadId, event.startNs * 1e-3, (event.endNs - event.startNs) * 1e-3);
+				written++;
+			}
+		}
+
+		fputs("\n]}\n", file);
+		fclose(file);
+		return written;
+	}
+
+	long long Flush() {
+		long long written = WriteChromeTrace(g_outputPath);
+		if (written < 0) {
+			std::cerr << "Error: Could not write trace to " << g_outputPath << std::endl;
+		}
+		else {
+			std::cout << "Trace written to " << g_outputPath << " (" << written << " events)" << std::endl;
+		}
+		return written;
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(g_buffersMutex);
+		for (auto& buffer : g_buffers) {
+			buffer->clearedBefore.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+		}
+	}
+}
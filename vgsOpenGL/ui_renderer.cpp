@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "ui_renderer.h"
+#include "gl_stats.h"
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+namespace UIRenderer
+{
+	// Regions of the persistent ring; the GPU may still read the previous two
+	static const int kFramesInFlight = 3;
+
+	// Region sizes stay a multiple of this so every region starts on a whole
+	// ImDrawVert (20 bytes) and on a 64 byte boundary
+	static const size_t kRegionAlign = 320;
+	static const size_t kMinCapacity = 256 * 1024;
+
+	// Shrink only when a whole window of frames used less than a quarter
+	static const int kShrinkWindowFrames = 600;
+
+	static const char* const kVertexShader =
+		"#version 330 core\n"
+		"layout (location = 0) in vec2 Position;\n"
+		"layout (location = 1) in vec2 UV;\n"
+		"layout (location = 2) in vec4 Color;\n"
+		"uniform mat4 ProjMtx;\n"
+		"out vec2 Frag_UV;\n"
+		"out vec4 Frag_Color;\n"
+		"void main() {\n"
+		"    Frag_UV = UV;\n"
+		"    Frag_Color = Color;\n"
+		"    gl_Position = ProjMtx * vec4(Position.xy, 0, 1);\n"
+		"}\n";
+
+	static const char* const kFragmentShader =
+		"#version 330 core\n"
+		"in vec2 Frag_UV;\n"
+		"in vec4 Frag_Color;\n"
+		"uniform sampler2D Texture;\n"
+		"layout (location = 0) out vec4 Out_Color;\n"
+		"void main() {\n"
+		"    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
+		"}\n";
+
+	static bool g_enabled = false;
+	static bool g_initialized = false;
+	static bool g_failed = false; // GL objects could not be created; stay on the backend
+
+	static GLuint g_program = 0;
+	static GLint g_projectionLocation = -1;
+	static GLuint g_vertexArray = 0;
+	static GLuint g_buffer = 0;
+	static bool g_persistent = false;
+	static unsigned char* g_mapped = nullptr;
+	static GLsync g_fences[kFramesInFlight] = {};
+	static int g_region = 0;
+	static size_t g_capacity = 0;
+	static size_t g_peakBytes = 0;
+	static int g_framesSincePeakReset = 0;
+	static ImVector<unsigned char> g_staging; // Packed frame for the non-persistent path
+	static UIRendererStats g_stats;
+
+	void SetEnabled(bool enabled) {
+		g_enabled = enabled;
+	}
+
+	bool IsEnabled() {
+		return g_enabled;
+	}
+
+	static GLuint compileShader(GLenum type, const char* source) {
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		GLint status = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if (!status) {
+			char log[512] = {};
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			std::cerr << "Error: UI renderer shader failed to compile: " << log << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	static bool createProgram() {
+		GLuint vertexShader = compileShader(GL_VERTEX_SHADER, kVertexShader);
+		GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+		if (!vertexShader || !fragmentShader) {
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return false;
+		}
+		g_program = glCreateProgram();
+		glAttachShader(g_program, vertexShader);
+		glAttachShader(g_program, fragmentShader);
+		glLinkProgram(g_program);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		GLint status = 0;
+		glGetProgramiv(g_program, GL_LINK_STATUS, &status);
+		if (!status) {
+			char log[512] = {};
+			glGetProgramInfoLog(g_program, sizeof(log), nullptr, log);
+			std::cerr << "Error: UI renderer program failed to link: " << log << std::endl;
+			return false;
+		}
+		g_projectionLocation = glGetUniformLocation(g_program, "ProjMtx");
+		glUseProgram(g_program);
+		glUniform1i(glGetUniformLocation(g_program, "Texture"), 0);
+		return true;
+	}
+
+	static void releaseBuffer() {
+		for (GLsync& fence : g_fences) {
+			if (fence) {
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+		if (g_buffer) {
+			// Deleting unmaps; the driver keeps the storage alive for draws in flight
+			glDeleteBuffers(1, &g_buffer);
+			g_buffer = 0;
+		}
+		g_mapped = nullptr;
+		g_capacity = 0;
+	}
+
+	// (Re)creates the shared vertex+index buffer with `capacity` bytes per
+	// frame region and points the VAO at it
+	static bool allocateBuffer(size_t capacity) {
+		releaseBuffer();
+		capacity = std::max(capacity, kMinCapacity);
+		capacity = (capacity + kRegionAlign - 1) / kRegionAlign * kRegionAlign;
+
+		glBindVertexArray(g_vertexArray);
+		glGenBuffers(1, &g_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, g_buffer);
+		if (g_persistent) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			GLsizeiptr total = (GLsizeiptr)(capacity * kFramesInFlight);
+			glBufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+			g_mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+			if (!g_mapped) {
+				std::cerr << "Error: Could not map the UI vertex buffer" << std::endl;
+				return false;
+			}
+		}
+		else {
+			// Storage is only (re)specified here; frames update it in place
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_buffer);
+
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, pos));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, uv));
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, col));
+
+		g_capacity = capacity;
+		g_region = 0;
+		g_stats.reallocations++;
+		GLStats::CountCalls(GLSource::ImGui, GLCallKind::Object, 1);
+		GLStats::CountCalls(GLSource::ImGui, GLCallKind::StateChange, 9);
+		return true;
+	}
+
+	static bool initialize() {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major * 10 + minor < 33) {
+			std::cerr << "Error: The lean UI renderer needs OpenGL 3.3" << std::endl;
+			return false;
+		}
+		if (!createProgram()) {
+			return false;
+		}
+		glGenVertexArrays(1, &g_vertexArray);
+
+		// glBufferStorage is core in 4.4; without it each frame is one
+		// glBufferSubData. Software rasterizers also take that path: Mesa's
+		// llvmpipe renders synchronously while a coherent mapping is bound,
+		// which costs more than the copy saves.
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		bool software = renderer && (strstr(renderer, "llvmpipe") || strstr(renderer, "softpipe") || strstr(renderer, "SwiftShader") || strstr(renderer, "GDI Generic"));
+		g_persistent = !software && major * 10 + minor >= 44 && glBufferStorage && glMapBufferRange && glFenceSync;
+		return allocateBuffer(kMinCapacity);
+	}
+
+	static void setupRenderState(const ImDrawData* drawData, int framebufferWidth, int framebufferHeight) {
+		glEnable(GL_BLEND);
+		glBlendEquation(GL_FUNC_ADD);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_STENCIL_TEST);
+		glEnable(GL_SCISSOR_TEST);
+		glActiveTexture(GL_TEXTURE0);
+		glViewport(0, 0, framebufferWidth, framebufferHeight);
+
+		float L = drawData->DisplayPos.x;
+		float R = drawData->DisplayPos.x + drawData->DisplaySize.x;
+		float T = drawData->DisplayPos.y;
+		float B = drawData->DisplayPos.y + drawData->DisplaySize.y;
+		const float projection[4][4] = {
+			{ 2.0f / (R - L), 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 2.0f / (T - B), 0.0f, 0.0f },
+			{ 0.0f, 0.0f, -1.0f, 0.0f },
+			{ (R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f },
+		};
+		glUseProgram(g_program);
+		glUniformMatrix4fv(g_projectionLocation, 1, GL_FALSE, &projection[0][0]);
+		glBindVertexArray(g_vertexArray);
+		GLStats::CountCalls(GLSource::ImGui, GLCallKind::StateChange, 12);
+	}
+
+	// Grows right away, shrinks only after a long quiet window
+	static bool fitBuffer(size_t frameBytes) {
+		g_peakBytes = std::max(g_peakBytes, frameBytes);
+		if (frameBytes > g_capacity) {
+			g_peakBytes = 0;
+			g_framesSincePeakReset = 0;
+			return allocateBuffer(frameBytes + frameBytes / 2);
+		}
+		if (++g_framesSincePeakReset >= kShrinkWindowFrames) {
+			size_t peak = g_peakBytes;
+			g_peakBytes = 0;
+			g_framesSincePeakReset = 0;
+			if (peak * 4 < g_capacity && g_capacity > kMinCapacity) {
+				return allocateBuffer(peak + peak / 2);
+			}
+		}
+		return true;
+	}
+
+	// Waits until the GPU is done with the region this frame writes
+	static void waitForRegion(int region) {
+		GLsync& fence = g_fences[region];
+		if (!fence) {
+			return;
+		}
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			g_stats.fenceWaits++;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// Copies every draw list into `destination`: all vertices, then all indices
+	static void packDrawLists(const ImDrawData* drawData, unsigned char* destination, size_t vertexBytes) {
+		unsigned char* vertices = destination;
+		unsigned char* indices = destination + vertexBytes;
+		for (const ImDrawList* drawList : drawData->CmdLists) {
+			size_t listVertexBytes = (size_t)drawList->VtxBuffer.Size * sizeof(ImDrawVert);
+			size_t listIndexBytes = (size_t)drawList->IdxBuffer.Size * sizeof(ImDrawIdx);
+			memcpy(vertices, drawList->VtxBuffer.Data, listVertexBytes);
+			memcpy(indices, drawList->IdxBuffer.Data, listIndexBytes);
+			vertices += listVertexBytes;
+			indices += listIndexBytes;
+		}
+	}
+
+	static bool renderLean(ImDrawData* drawData, int framebufferWidth, int framebufferHeight) {
+		// Font and other ImGui textures stay with the backend
+		if (drawData->Textures != nullptr) {
+			for (ImTextureData* texture : *drawData->Textures) {
+				if (texture->Status != ImTextureStatus_OK) {
+					ImGui_ImplOpenGL3_UpdateTexture(texture);
+				}
+			}
+		}
+
+		size_t vertexBytes = (size_t)drawData->TotalVtxCount * sizeof(ImDrawVert);
+		size_t indexBytes = (size_t)drawData->TotalIdxCount * sizeof(ImDrawIdx);
+		size_t frameBytes = vertexBytes + indexBytes;
+		if (!fitBuffer(frameBytes)) {
+			return false;
+		}
+
+		setupRenderState(drawData, framebufferWidth, framebufferHeight);
+
+		// Single upload: a memcpy into the mapped ring, or one glBufferSubData
+		size_t regionOffset = 0;
+		if (g_persistent) {
+			g_region = (g_region + 1) % kFramesInFlight;
+			waitForRegion(g_region);
+			regionOffset = (size_t)g_region * g_capacity;
+			packDrawLists(drawData, g_mapped + regionOffset, vertexBytes);
+			GLStats::CountCalls(GLSource::ImGui, GLCallKind::BufferUpload, 0, frameBytes);
+		}
+		else if (frameBytes > 0) {
+			g_staging.resize((int)frameBytes);
+			packDrawLists(drawData, g_staging.Data, vertexBytes);
+			glBindBuffer(GL_ARRAY_BUFFER, g_buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)frameBytes, g_staging.Data);
+			GLStats::CountCall(GLSource::ImGui, GLCallKind::StateChange);
+			GLStats::CountCall(GLSource::ImGui, GLCallKind::BufferUpload, frameBytes);
+		}
+		g_stats.lastFrameBytes = frameBytes;
+
+		const GLenum indexType = sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		const ImVec2 clipOffset = drawData->DisplayPos;
+		const ImVec2 clipScale = drawData->FramebufferScale;
+		GLint baseVertex = (GLint)(regionOffset / sizeof(ImDrawVert));
+		size_t indexOffset = regionOffset + vertexBytes;
+
+		// Redundant binds and scissors are skipped; most grid tiles differ in
+		// texture only, and text shares the font atlas
+		GLuint boundTexture = 0;
+		bool textureKnown = false;
+		ImVec4 scissor(-1.0f, -1.0f, -1.0f, -1.0f);
+
+		for (const ImDrawList* drawList : drawData->CmdLists) {
+			for (const ImDrawCmd& cmd : drawList->CmdBuffer) {
+				if (cmd.UserCallback != nullptr) {
+					if (cmd.UserCallback == ImDrawCallback_ResetRenderState) {
+						setupRenderState(drawData, framebufferWidth, framebufferHeight);
+					}
+					else {
+						cmd.UserCallback(drawList, &cmd);
+					}
+					textureKnown = false;
+					scissor = ImVec4(-1.0f, -1.0f, -1.0f, -1.0f);
+					continue;
+				}
+
+				ImVec2 clipMin((cmd.ClipRect.x - clipOffset.x) * clipScale.x, (cmd.ClipRect.y - clipOffset.y) * clipScale.y);
+				ImVec2 clipMax((cmd.ClipRect.z - clipOffset.x) * clipScale.x, (cmd.ClipRect.w - clipOffset.y) * clipScale.y);
+				if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) {
+					continue;
+				}
+				if (clipMin.x != scissor.x || clipMin.y != scissor.y || clipMax.x != scissor.z || clipMax.y != scissor.w) {
+					scissor = ImVec4(clipMin.x, clipMin.y, clipMax.x, clipMax.y);
+					glScissor((int)clipMin.x, (int)((float)framebufferHeight - clipMax.y), (int)(clipMax.x - clipMin.x), (int)(clipMax.y - clipMin.y));
+					GLStats::CountCall(GLSource::ImGui, GLCallKind::StateChange);
+				}
+
+				GLuint texture = (GLuint)(intptr_t)cmd.GetTexID();
+				if (!textureKnown || texture != boundTexture) {
+					glBindTexture(GL_TEXTURE_2D, texture);
+					boundTexture = texture;
+					textureKnown = true;
+					GLStats::CountCall(GLSource::ImGui, GLCallKind::BindTexture);
+				}
+
+				glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)cmd.ElemCount, indexType,
+					(void*)(intptr_t)(indexOffset + cmd.IdxOffset * sizeof(ImDrawIdx)), baseVertex + (GLint)cmd.VtxOffset);
+				GLStats::CountCall(GLSource::ImGui, GLCallKind::Draw);
+			}
+			baseVertex += drawList->VtxBuffer.Size;
+			indexOffset += (size_t)drawList->IdxBuffer.Size * sizeof(ImDrawIdx);
+		}
+
+		if (g_persistent) {
+			g_fences[g_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		// Leave the VAO and scissor as the rest of the frame expects them
+		glBindVertexArray(0);
+		glDisable(GL_SCISSOR_TEST);
+		GLStats::CountCalls(GLSource::ImGui, GLCallKind::StateChange, 2);
+		return true;
+	}
+
+	void RenderDrawData(ImDrawData* drawData) {
+		if (!g_enabled || g_failed) {
+			ImGui_ImplOpenGL3_RenderDrawData(drawData);
+			return;
+		}
+
+		int framebufferWidth = (int)(drawData->DisplaySize.x * drawData->FramebufferScale.x);
+		int framebufferHeight = (int)(drawData->DisplaySize.y * drawData->FramebufferScale.y);
+		if (framebufferWidth <= 0 || framebufferHeight <= 0) {
+			return;
+		}
+
+		if (!g_initialized) {
+			g_initialized = true;
+			g_failed = !initialize();
+		}
+		if (g_failed || !renderLean(drawData, framebufferWidth, framebufferHeight)) {
+			std::cerr << "Warning: Falling back to the ImGui OpenGL3 renderer" << std::endl;
+			Shutdown();
+			g_failed = true;
+			ImGui_ImplOpenGL3_RenderDrawData(drawData);
+		}
+	}
+
+	UIRendererStats GetStats() {
+		UIRendererStats stats = g_stats;
+		stats.active = g_enabled && g_initialized && !g_failed;
+		stats.persistent = g_persistent;
+		stats.capacityBytes = g_capacity;
+		return stats;
+	}
+
+	void Shutdown() {
+		releaseBuffer();
+		if (g_vertexArray) {
+			glDeleteVertexArrays(1, &g_vertexArray);
+			g_vertexArray = 0;
+		}
+		if (g_program) {
+			glDeleteProgram(g_program);
+			g_program = 0;
+		}
+		g_initialized = false;
+	}
+}